@@ -35,16 +35,118 @@ BEGIN_SRC( COPLAY_SOURCE_FILES "Source Files" )
 			"${COPLAY_SRCDIR}/coplay_system.cpp"
 			"${COPLAY_SRCDIR}/coplay_client.cpp"
 			"${COPLAY_SRCDIR}/coplay_host.cpp"
+			"${COPLAY_SRCDIR}/coplay_steamtransport.cpp"
+			"${COPLAY_SRCDIR}/coplay_callbackthread.cpp"
 
 			"${COPLAY_SRCDIR}/coplay.h"
 			"${COPLAY_SRCDIR}/coplay_connection.h"
 			"${COPLAY_SRCDIR}/coplay_system.h"
 			"${COPLAY_SRCDIR}/coplay_client.h"
 			"${COPLAY_SRCDIR}/coplay_host.h"
+			"${COPLAY_SRCDIR}/coplay_steamtransport.h"
+			"${COPLAY_SRCDIR}/coplay_callbackthread.h"
 		#}
 	)
 END_SRC( COPLAY_SOURCE_FILES "Source Files" )
 
+# No engine headers in these, they're built once into coplay_core and shared with the standalone tools
+set( COPLAY_CORE_SOURCE_FILES )
+BEGIN_SRC( COPLAY_CORE_SOURCE_FILES "Source Files" )
+	SRC_GRP(
+		SUBGROUP "Coplay Core"
+		SOURCES
+		#{
+			"${COPLAY_SRCDIR}/coplay_relay.cpp"
+			"${COPLAY_SRCDIR}/coplay_capture.cpp"
+			"${COPLAY_SRCDIR}/coplay_timer.cpp"
+			"${COPLAY_SRCDIR}/coplay_stats.cpp"
+			"${COPLAY_SRCDIR}/coplay_metrics.cpp"
+			"${COPLAY_SRCDIR}/coplay_log.cpp"
+			"${COPLAY_SRCDIR}/coplay_config.cpp"
+			"${COPLAY_SRCDIR}/coplay_udptransport.cpp"
+			"${COPLAY_SRCDIR}/coplay_handshake.cpp"
+			"${COPLAY_SRCDIR}/coplay_ports.cpp"
+			"${COPLAY_SRCDIR}/coplay_ticket.cpp"
+			"${COPLAY_SRCDIR}/coplay_frameprofile.cpp"
+			"${COPLAY_SRCDIR}/coplay_packetpool.cpp"
+			"${COPLAY_SRCDIR}/coplay_pacer.cpp"
+			"${COPLAY_SRCDIR}/coplay_threadplacement.cpp"
+			"${COPLAY_SRCDIR}/coplay_netchan.cpp"
+			"${COPLAY_SRCDIR}/coplay_sendcontrol.cpp"
+			"${COPLAY_SRCDIR}/coplay_sendrate.cpp"
+			"${COPLAY_SRCDIR}/coplay_fragment.cpp"
+			"${COPLAY_SRCDIR}/coplay_ratecontrol.cpp"
+			"${COPLAY_SRCDIR}/coplay_fec.cpp"
+			"${COPLAY_SRCDIR}/coplay_redundancy.cpp"
+
+			"${COPLAY_SRCDIR}/coplay_relay.h"
+			"${COPLAY_SRCDIR}/coplay_capture.h"
+			"${COPLAY_SRCDIR}/coplay_timer.h"
+			"${COPLAY_SRCDIR}/coplay_stats.h"
+			"${COPLAY_SRCDIR}/coplay_metrics.h"
+			"${COPLAY_SRCDIR}/coplay_log.h"
+			"${COPLAY_SRCDIR}/coplay_config.h"
+			"${COPLAY_SRCDIR}/coplay_transport.h"
+			"${COPLAY_SRCDIR}/coplay_udptransport.h"
+			"${COPLAY_SRCDIR}/coplay_handshake.h"
+			"${COPLAY_SRCDIR}/coplay_ports.h"
+			"${COPLAY_SRCDIR}/coplay_ticket.h"
+			"${COPLAY_SRCDIR}/coplay_frameprofile.h"
+			"${COPLAY_SRCDIR}/coplay_packetpool.h"
+			"${COPLAY_SRCDIR}/coplay_pacer.h"
+			"${COPLAY_SRCDIR}/coplay_threadplacement.h"
+			"${COPLAY_SRCDIR}/coplay_netchan.h"
+			"${COPLAY_SRCDIR}/coplay_sendcontrol.h"
+			"${COPLAY_SRCDIR}/coplay_sendrate.h"
+			"${COPLAY_SRCDIR}/coplay_fragment.h"
+			"${COPLAY_SRCDIR}/coplay_ratecontrol.h"
+			"${COPLAY_SRCDIR}/coplay_fec.h"
+			"${COPLAY_SRCDIR}/coplay_redundancy.h"
+		#}
+	)
+END_SRC( COPLAY_CORE_SOURCE_FILES "Source Files" )
+
+set( COPLAY_TOOLS_SOURCE_FILES )
+BEGIN_SRC( COPLAY_TOOLS_SOURCE_FILES "Source Files" )
+	SRC_GRP(
+		SUBGROUP "Tools"
+		SOURCES
+		#{
+			"${COPLAY_SRCDIR}/tools/coplay_mocksteam.cpp"
+			"${COPLAY_SRCDIR}/tools/coplay_steamemu.cpp"
+			"${COPLAY_SRCDIR}/tools/coplay_toolcommon.cpp"
+
+			"${COPLAY_SRCDIR}/tools/coplay_mocksteam.h"
+			"${COPLAY_SRCDIR}/tools/coplay_steamemu.h"
+			"${COPLAY_SRCDIR}/tools/coplay_toolcommon.h"
+		#}
+	)
+END_SRC( COPLAY_TOOLS_SOURCE_FILES "Source Files" )
+
+# The relay, handshake, port allocator, timing and stats, with nothing from the Source SDK or Steam.
+# Only needs SDL2_net's headers, whatever links it brings SDL2 and SDL2_net along.
+function( coplay_add_core )
+	if( TARGET coplay_core )
+		return()
+	endif()
+
+	add_library( coplay_core STATIC ${COPLAY_CORE_SOURCE_FILES} )
+
+	target_include_directories(
+		coplay_core PUBLIC
+		"${COPLAY_SRCDIR}"
+		"${SRCDIR}/coplay/include"
+	)
+
+	# it ends up inside the client library
+	set_target_properties( coplay_core PROPERTIES POSITION_INDEPENDENT_CODE ON )
+
+	if( UNIX )
+		find_package( Threads REQUIRED )
+		target_link_libraries( coplay_core PUBLIC Threads::Threads )
+	endif()
+endfunction()
+
 function( target_use_coplay )
 	cmake_parse_arguments(
 		COPLAY
@@ -59,6 +161,9 @@ function( target_use_coplay )
 		${COPLAY_SOURCE_FILES}
 	)
 
+	coplay_add_core()
+	target_link_libraries( ${COPLAY_TARGET} PRIVATE coplay_core )
+
 	target_link_directories(
 		${COPLAY_TARGET} PRIVATE
 		"${COPLAY_LIBDIR}"
@@ -86,3 +191,48 @@ function( target_use_coplay )
 		"$<$<AND:${IS_WINDOWS},$<NOT:$<BOOL:${COPLAY_DONT_LINK_SDL2_NET}>>>:${COPLAY_LIBDIR}/SDL2_net${IMPLIB_EXT}>"
 	)
 endfunction()
+
+# Standalone tools, these run without the engine or Steam.
+# On Linux they link against the system's SDL2 and SDL2_net since the bundled ones are 32 bit.
+function( coplay_add_tools )
+	if( UNIX )
+		find_package( PkgConfig REQUIRED )
+		pkg_check_modules( COPLAY_TOOLS_SDL REQUIRED IMPORTED_TARGET sdl2 SDL2_net )
+		set( COPLAY_TOOLS_LIBS PkgConfig::COPLAY_TOOLS_SDL )
+	else()
+		set( COPLAY_TOOLS_LIBS "${COPLAY_LIBDIR}/SDL2${IMPLIB_EXT}" "${COPLAY_LIBDIR}/SDL2_net${IMPLIB_EXT}" )
+	endif()
+
+	coplay_add_core()
+
+	foreach( COPLAY_TOOL coplay_replay coplay_bench coplay_e2e )
+		add_executable( ${COPLAY_TOOL}
+			${COPLAY_TOOLS_SOURCE_FILES}
+			"${COPLAY_SRCDIR}/tools/${COPLAY_TOOL}.cpp"
+		)
+
+		target_include_directories(
+			${COPLAY_TOOL} PRIVATE
+			"${COPLAY_SRCDIR}/tools"
+		)
+
+		target_link_libraries( ${COPLAY_TOOL} PRIVATE coplay_core ${COPLAY_TOOLS_LIBS} )
+	endforeach()
+
+	# Plain checks of the engine free modules, run with ctest
+	add_executable( coplay_tests
+		"${COPLAY_SRCDIR}/tools/coplay_toolcommon.cpp"
+		"${COPLAY_SRCDIR}/tools/coplay_toolcommon.h"
+		"${COPLAY_SRCDIR}/tools/coplay_tests.cpp"
+	)
+
+	target_include_directories(
+		coplay_tests PRIVATE
+		"${COPLAY_SRCDIR}/tools"
+	)
+
+	target_link_libraries( coplay_tests PRIVATE coplay_core ${COPLAY_TOOLS_LIBS} )
+
+	# only picked up by ctest if the project calling this has called enable_testing() or included CTest
+	add_test( NAME coplay_tests COMMAND coplay_tests )
+endfunction()
@@ -26,6 +26,7 @@
 
 #include "tier0/valve_minmax_off.h"	// GCC 4.2.2 headers screw up our min/max defs.
 #include <string>
+#include "coplay_handshake.h"
 #include "tier0/valve_minmax_on.h"
 
 #ifdef COPLAY_USE_LOBBIES
@@ -38,13 +39,8 @@ extern ConVar coplay_use_lobbies;
 #define COPLAY_MSG_COLOR Color(170, 255, 0, 255)
 #define COPLAY_DEBUG_MSG_COLOR Color(255, 170, 0, 255)
 
-#define COPLAY_MAX_PACKETS 8 // max packets proccessed in a single loop of running the connection.
-
 #define COPLAY_VERSION "1.3" // Don't change for your PR, a maintainer will update this
 
-#define COPLAY_NETMSG_NEEDPASS "NeedPasscode"
-#define COPLAY_NETMSG_OK "OK"
-
 
 enum JoinFilter
 {
@@ -78,6 +74,12 @@ enum ConnectionEndReason // see the enum ESteamNetConnectionEnd in steamnetworki
     k_ESteamNetConnectionEnd_App_BadPassword,
 };
 
+// Reasons in the app range mean someone closed the connection on purpose, the rest are Steam giving up on it
+static inline bool CoplayIsAppEndReason(int reason)
+{
+    return reason >= k_ESteamNetConnectionEnd_App_Min && reason <= k_ESteamNetConnectionEnd_App_Max;
+}
+
 static bool IsUserInLobby(CSteamID LobbyID, CSteamID UserID)
 {
     uint32 numMembers = SteamMatchmaking()->GetNumLobbyMembers(LobbyID);
@@ -0,0 +1,63 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "cbase.h"
+#include "coplay_callbackthread.h"
+#include "coplay_system.h"
+
+// how long to nap between checks for the rate being turned back on
+#define COPLAY_CALLBACK_IDLE_MS 100
+
+CCoplayCallbackThread::CCoplayCallbackThread()
+{
+    m_rate          = 0;
+    m_stopRequested = false;
+    SetName("coplaycallbacks");
+}
+
+void CCoplayCallbackThread::Begin()
+{
+    SteamNetworkingUtils()->SetGlobalCallback_SteamNetConnectionStatusChanged(StatusChanged);
+    m_stopRequested = false;
+    Start();
+}
+
+void CCoplayCallbackThread::End()
+{
+    if (!IsAlive())
+        return;
+
+    m_stopRequested = true;
+    Join();
+    SteamNetworkingUtils()->SetGlobalCallback_SteamNetConnectionStatusChanged(nullptr);
+}
+
+int CCoplayCallbackThread::Run()
+{
+    while (!m_stopRequested)
+    {
+        int rate = m_rate;
+        if (rate <= 0)
+        {
+            ThreadSleep(COPLAY_CALLBACK_IDLE_MS);
+            continue;
+        }
+
+        SteamNetworkingSockets()->RunCallbacks();
+        ThreadSleep(1000 / rate); // coplay_callback_rate tops out at 1000
+    }
+    return 0;
+}
+
+void CCoplayCallbackThread::StatusChanged(SteamNetConnectionStatusChangedCallback_t *pParam)
+{
+    CCoplaySystem::GetInstance()->ConnectionStatusUpdated(pParam);
+}
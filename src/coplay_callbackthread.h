@@ -0,0 +1,43 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#ifndef COPLAY_CALLBACKTHREAD_H
+#define COPLAY_CALLBACKTHREAD_H
+#pragma once
+
+#include <tier0/threadtools.h>
+#include "steam/isteamnetworkingsockets.h"
+
+// Runs SteamNetworkingSockets callbacks on their own thread so connection changes aren't stuck waiting on the next frame.
+// Everything it dispatches goes through CCoplaySystem::ConnectionStatusUpdated with the system's lock held,
+// anything that has to touch the engine is left for the main thread to pick up in Update.
+class CCoplayCallbackThread : public CThread
+{
+public:
+    CCoplayCallbackThread();
+
+    // Installs the global status changed callback, from then on Steam only hands status changes to RunCallbacks
+    void Begin();
+    void End();
+
+    // Dispatches per second, 0 leaves it to the main thread once a frame
+    void SetRate(int rate) { m_rate = rate; }
+    bool IsPumping() { return m_rate > 0 && IsAlive(); }
+
+private:
+    virtual int Run();
+    static void StatusChanged(SteamNetConnectionStatusChangedCallback_t *pParam);
+
+    CInterlockedInt m_rate;
+    CInterlockedInt m_stopRequested;
+};
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_capture.h"
+#include "coplay_timer.h"
+#include "SDL2/SDL_endian.h"
+#include <string.h>
+
+#define CAPTURE_HEADER_SIZE 16
+#define CAPTURE_RECORD_HEADER_SIZE 11
+
+CCoplayCaptureWriter::CCoplayCaptureWriter() : m_pFile(NULL), m_startTime(0), m_bytesWritten(0), m_maxBytes(0)
+{
+}
+
+CCoplayCaptureWriter::~CCoplayCaptureWriter()
+{
+    Close();
+}
+
+bool CCoplayCaptureWriter::Open(const char *pszPath, int role, int64_t maxBytes)
+{
+    Close();
+
+    m_pFile = fopen(pszPath, "wb");
+    if (!m_pFile)
+        return false;
+
+    uint8_t header[CAPTURE_HEADER_SIZE] = {};
+    memcpy(header, COPLAY_CAPTURE_MAGIC, sizeof(COPLAY_CAPTURE_MAGIC));
+    uint32_t version = SDL_SwapLE32(COPLAY_CAPTURE_VERSION);
+    uint32_t role32  = SDL_SwapLE32((uint32_t)role);
+    memcpy(header + 8, &version, 4);
+    memcpy(header + 12, &role32, 4);
+    fwrite(header, sizeof(header), 1, m_pFile);
+
+    m_startTime    = CoplayTimeUsec();
+    m_bytesWritten = sizeof(header);
+    m_maxBytes     = maxBytes;
+    return true;
+}
+
+void CCoplayCaptureWriter::Close()
+{
+    if (m_pFile)
+    {
+        fclose(m_pFile);
+        m_pFile = NULL;
+    }
+}
+
+void CCoplayCaptureWriter::Write(CaptureDirection direction, const void *pData, int len)
+{
+    if (!m_pFile || len < 0 || len > COPLAY_CAPTURE_MAX_DATAGRAM)
+        return;
+
+    // stop recording instead of filling someones disk
+    if (m_maxBytes > 0 && m_bytesWritten + CAPTURE_RECORD_HEADER_SIZE + len > m_maxBytes)
+    {
+        Close();
+        return;
+    }
+
+    uint8_t  header[CAPTURE_RECORD_HEADER_SIZE];
+    uint64_t time   = SDL_SwapLE64((uint64_t)(CoplayTimeUsec() - m_startTime));
+    uint16_t len16  = SDL_SwapLE16((uint16_t)len);
+    memcpy(header, &time, 8);
+    header[8] = (uint8_t)direction;
+    memcpy(header + 9, &len16, 2);
+
+    fwrite(header, sizeof(header), 1, m_pFile);
+    fwrite(pData, len, 1, m_pFile);
+    m_bytesWritten += sizeof(header) + len;
+}
+
+CCoplayCaptureReader::CCoplayCaptureReader() : m_pFile(NULL), m_firstRecord(0), m_role(0)
+{
+}
+
+CCoplayCaptureReader::~CCoplayCaptureReader()
+{
+    Close();
+}
+
+bool CCoplayCaptureReader::Open(const char *pszPath)
+{
+    Close();
+
+    m_pFile = fopen(pszPath, "rb");
+    if (!m_pFile)
+        return false;
+
+    uint8_t header[CAPTURE_HEADER_SIZE];
+    if (fread(header, sizeof(header), 1, m_pFile) != 1 || memcmp(header, COPLAY_CAPTURE_MAGIC, sizeof(COPLAY_CAPTURE_MAGIC)))
+    {
+        Close();
+        return false;
+    }
+
+    uint32_t version, role;
+    memcpy(&version, header + 8, 4);
+    memcpy(&role, header + 12, 4);
+    if (SDL_SwapLE32(version) != COPLAY_CAPTURE_VERSION)
+    {
+        Close();
+        return false;
+    }
+
+    m_role = (int)SDL_SwapLE32(role);
+    m_firstRecord = ftell(m_pFile);
+    return true;
+}
+
+void CCoplayCaptureReader::Close()
+{
+    if (m_pFile)
+    {
+        fclose(m_pFile);
+        m_pFile = NULL;
+    }
+}
+
+void CCoplayCaptureReader::Rewind()
+{
+    if (m_pFile)
+        fseek(m_pFile, m_firstRecord, SEEK_SET);
+}
+
+bool CCoplayCaptureReader::Next(CoplayCaptureRecord_t *pRecord)
+{
+    if (!m_pFile)
+        return false;
+
+    uint8_t header[CAPTURE_RECORD_HEADER_SIZE];
+    if (fread(header, sizeof(header), 1, m_pFile) != 1)
+        return false;
+
+    uint64_t time;
+    uint16_t len;
+    memcpy(&time, header, 8);
+    memcpy(&len, header + 9, 2);
+
+    pRecord->timeUsec  = (int64_t)SDL_SwapLE64(time);
+    pRecord->direction = header[8];
+    pRecord->len       = SDL_SwapLE16(len);
+
+    if (pRecord->len && fread(pRecord->data, pRecord->len, 1, m_pFile) != 1)
+        return false;
+
+    return true;
+}
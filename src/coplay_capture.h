@@ -0,0 +1,85 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Recording of the datagrams a relay moves, so a session can be replayed later with coplay_replay.
+//
+// File layout, everything little endian:
+//  header : "CPLYCAP\0", uint32 version, uint32 role (see ConnectionRole)
+//  record : uint64 usec since capture start, uint8 direction, uint16 length, data[length]
+#ifndef COPLAY_CAPTURE_H
+#define COPLAY_CAPTURE_H
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define COPLAY_CAPTURE_MAGIC "CPLYCAP"
+#define COPLAY_CAPTURE_VERSION 1
+#define COPLAY_CAPTURE_MAX_DATAGRAM 0xFFFF
+
+enum CaptureDirection
+{
+    eCaptureDir_Outbound = 0, // game -> relay -> peer
+    eCaptureDir_Inbound,      // peer -> relay -> game
+};
+
+struct CoplayCaptureRecord_t
+{
+    int64_t  timeUsec;
+    uint8_t  direction;
+    uint16_t len;
+    uint8_t  data[COPLAY_CAPTURE_MAX_DATAGRAM];
+};
+
+// Only ever touched by the relay thread that owns it
+class CCoplayCaptureWriter
+{
+public:
+    CCoplayCaptureWriter();
+    ~CCoplayCaptureWriter();
+
+    bool Open(const char *pszPath, int role, int64_t maxBytes);
+    void Close();
+    bool IsOpen() const { return m_pFile != NULL; }
+
+    void Write(CaptureDirection direction, const void *pData, int len);
+
+    int64_t GetBytesWritten() const { return m_bytesWritten; }
+
+private:
+    FILE   *m_pFile;
+    int64_t m_startTime;
+    int64_t m_bytesWritten;
+    int64_t m_maxBytes;
+};
+
+class CCoplayCaptureReader
+{
+public:
+    CCoplayCaptureReader();
+    ~CCoplayCaptureReader();
+
+    bool Open(const char *pszPath);
+    void Close();
+    void Rewind();
+
+    // false at the end of the file or on a truncated record
+    bool Next(CoplayCaptureRecord_t *pRecord);
+
+    int GetRole() const { return m_role; }
+
+private:
+    FILE *m_pFile;
+    long  m_firstRecord;
+    int   m_role;
+};
+
+#endif
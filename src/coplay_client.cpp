@@ -13,12 +13,75 @@
 #include <inetchannel.h>
 #include <inetchannelinfo.h>
 #include "coplay_connection.h"
+#include "coplay_system.h"
+
+extern ConVar coplay_timeoutduration;
+extern ConVar coplay_resume;
 
 CCoplayClient::CCoplayClient()
 {
 	m_hConn = k_HSteamNetConnection_Invalid;
 	m_hostLobby.SetFromUint64(0);
 	m_pConnection = nullptr;
+	m_bResuming = false;
+	m_hResumeConn = k_HSteamNetConnection_Invalid;
+	m_pResumeHandshake = nullptr;
+	m_resumeStartTime = 0;
+	m_hPendingConn = k_HSteamNetConnection_Invalid;
+}
+
+void CCoplayClient::Update()
+{
+    FOR_EACH_VEC_BACK(m_oldConnections, i)
+    {
+        if (!m_oldConnections[i]->IsAlive())
+        {
+            delete m_oldConnections[i];
+            m_oldConnections.Remove(i);
+        }
+    }
+
+    if (m_hPendingConn != k_HSteamNetConnection_Invalid)
+    {
+        HSteamNetConnection hConnection = m_hPendingConn;
+        m_hPendingConn = k_HSteamNetConnection_Invalid;
+        if (CreateConnection(hConnection))
+            m_pConnection->ConnectToHost();
+        else
+        {
+            SteamNetworkingSockets()->CloseConnection(hConnection, k_ESteamNetConnectionEnd_App_RemoteIssue, "", true);
+            if (UseCoplayLobbies())
+            {
+                SteamMatchmaking()->LeaveLobby(m_hostLobby);
+                m_hostLobby.Clear();
+            }
+        }
+    }
+
+    if (!m_pResumeHandshake)
+        return;
+
+    ICoplayTransport *pTransport = CCoplaySystem::GetInstance()->GetTransport();
+    if (m_pResumeHandshake->Poll() == eCoplayHandshake_Accepted)
+    {
+        m_pConnection->Resume(m_hResumeConn, m_pResumeHandshake->GetTicket());
+        // the host didn't have our old slot anymore and gave us a new one, the game has to connect to it
+        if (!m_pResumeHandshake->WasResumed())
+            m_pConnection->ConnectToHost();
+        else
+            ConColorMsg(COPLAY_MSG_COLOR, "[Coplay] Resumed our connection to the host.\n");
+
+        delete m_pResumeHandshake;
+        m_pResumeHandshake = nullptr;
+        m_hResumeConn = k_HSteamNetConnection_Invalid;
+        m_bResuming = false;
+        m_resumeTicket.clear();
+    }
+    else if (m_resumeStartTime + coplay_timeoutduration.GetFloat() < gpGlobals->realtime)
+    {
+        pTransport->Close(m_hResumeConn, k_ESteamNetConnectionEnd_Misc_Timeout, "resumetimeout", false);
+        CloseConnection(k_ESteamNetConnectionEnd_Misc_Timeout);
+    }
 }
 
 void CCoplayClient::ConnectToHost(CSteamID host, std::string passcode)
@@ -37,6 +100,8 @@ void CCoplayClient::ConnectToHost(CSteamID host, std::string passcode)
 
     ConColorMsg(COPLAY_MSG_COLOR, "[Coplay] Attempting Connection to user with ID %llu....\n", netID.GetSteamID64());
     m_passcode = passcode;
+    m_hostID   = netID.GetSteamID();
+    m_resumeTicket.clear();
     SteamNetworkingSockets()->ConnectP2P(netID, 0, 0, NULL);
 }
 
@@ -51,49 +116,80 @@ bool CCoplayClient::ConnectionStatusUpdated(SteamNetConnectionStatusChangedCallb
         break;
 
     case k_ESteamNetworkingConnectionState_Connected:
-        if (!CreateConnection(pParam->m_hConn))
+        // the connection is still there waiting for us, just need the host to take our ticket
+        if (m_bResuming && m_pConnection && m_pConnection->IsSuspended())
         {
-            SteamNetworkingSockets()->CloseConnection(pParam->m_hConn, k_ESteamNetConnectionEnd_App_RemoteIssue, "", true);
-            if (UseCoplayLobbies())
-            {
-                SteamMatchmaking()->LeaveLobby(m_hostLobby);
-                m_hostLobby.Clear();
-            }
+            m_hResumeConn = pParam->m_hConn;
+            m_resumeStartTime = gpGlobals->realtime;
+            m_pResumeHandshake = new CCoplayClientHandshake(CCoplaySystem::GetInstance()->GetTransport(), pParam->m_hConn, m_passcode, m_resumeTicket);
+            m_pResumeHandshake->Start();
+            break;
         }
+        // usually on the callback thread, the connection's made in Update
+        m_hPendingConn = pParam->m_hConn;
         break;
 
     case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
         SteamNetworkingSockets()->CloseConnection(pParam->m_hConn, k_ESteamNetConnectionEnd_Misc_Timeout, "timeout", true);
+        if (TryResume())
+            break;
         CloseConnection(k_ESteamNetConnectionEnd_Misc_Timeout);
         stateFailed = true;
         break;
 
     case k_ESteamNetworkingConnectionState_ClosedByPeer:
         SteamNetworkingSockets()->CloseConnection(pParam->m_hConn, k_ESteamNetConnectionEnd_App_ClosedByPeer, "closedbypeer", true);
-        CloseConnection(k_ESteamNetConnectionEnd_App_ClosedByPeer);
-		stateFailed = true;
+        // the host closing us on purpose always has an app reason, anything else is the path going away under us
+        if (CoplayIsAppEndReason(pParam->m_info.m_eEndReason) || !TryResume())
+        {
+            CloseConnection(k_ESteamNetConnectionEnd_App_ClosedByPeer);
+            stateFailed = true;
+        }
         break;
     }
 
     if (pParam->m_info.m_eEndReason == k_ESteamNetConnectionEnd_App_BadPassword)
-            Warning("Bad Password.\n");
+            CoplayLog(eCoplayLog_General, eCoplayLogLevel_Warning, "Bad Password.\n");
 
 	return stateFailed;
 }
 
 bool CCoplayClient::CreateConnection(HSteamNetConnection hConnection)
 {
-    SteamNetConnectionInfo_t newinfo;
-    if (!SteamNetworkingSockets()->GetConnectionInfo(hConnection, &newinfo))
+    ICoplayTransport *pTransport = CCoplaySystem::GetInstance()->GetTransport();
+    uint64_t remoteID;
+    if (!pTransport->GetRemoteID(hConnection, &remoteID))
         return false;
 
-    CloseConnection();
-    m_pConnection = new CCoplayConnection(hConnection);
-    m_pConnection->ConnectToHost();
+    DestroyConnection(k_ESteamNetConnectionEnd_App_ConnectionFinished);
+    m_pConnection = new CCoplayConnection(pTransport, hConnection, m_passcode, m_resumeTicket);
 	m_pConnection->Start();
     return true;
 }
 
+bool CCoplayClient::TryResume()
+{
+    // one redial per ticket, if that drops too before we're back in theres no new ticket and we give up
+    std::string ticket = m_pConnection ? m_pConnection->GetResumeTicket() : "";
+    if (ticket.empty() || m_bResuming)
+        return false;
+
+    // stays in the lobby, the host checks the ticket instead.
+    // The game keeps going through the connection we have if we can, otherwise it'll be reconnected once we're back
+    m_bResuming = coplay_resume.GetBool();
+    if (m_bResuming)
+        m_pConnection->Suspend();
+    else
+        DestroyConnection(k_ESteamNetConnectionEnd_Misc_Timeout);
+    m_resumeTicket = ticket;
+
+    CoplayLog(eCoplayLog_General, eCoplayLogLevel_Info, "[Coplay] Lost the connection, trying to resume....\n");
+    SteamNetworkingIdentity netID;
+    netID.SetSteamID(m_hostID);
+    SteamNetworkingSockets()->ConnectP2P(netID, 0, 0, NULL);
+    return true;
+}
+
 void CCoplayClient::CloseConnection(int reason)
 {
     if (m_hostLobby != k_steamIDNil)
@@ -101,12 +197,27 @@ void CCoplayClient::CloseConnection(int reason)
         SteamMatchmaking()->LeaveLobby(m_hostLobby);
 		m_hostLobby.Clear();
     }
+    m_resumeTicket.clear();
 
+    if (m_pResumeHandshake)
+    {
+        delete m_pResumeHandshake;
+        m_pResumeHandshake = nullptr;
+    }
+    m_hResumeConn = k_HSteamNetConnection_Invalid;
+    m_bResuming = false;
+
+    DestroyConnection(reason);
+}
+
+void CCoplayClient::DestroyConnection(int reason)
+{
+    m_hPendingConn = k_HSteamNetConnection_Invalid;
     if (m_pConnection)
     {
+        // we can be on the callback thread holding the system lock, waiting on the thread here would hold up the frame
         m_pConnection->QueueForDeletion(reason);
-        m_pConnection->Join();
-        delete m_pConnection;
+        m_oldConnections.AddToTail(m_pConnection);
         m_pConnection = nullptr;
     }
 }
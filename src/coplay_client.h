@@ -23,19 +23,38 @@ class CCoplayClient
 public:
 	CCoplayClient();
 
+	void Update();
+
 	void ConnectToHost(CSteamID host, std::string passcode = "");
 	void CloseConnection(int reason = k_ESteamNetConnectionEnd_App_ConnectionFinished);
 	bool ConnectionStatusUpdated(SteamNetConnectionStatusChangedCallback_t* pParam);
 	bool IsConnected() const { return m_hConn != k_HSteamNetConnection_Invalid; }
 	std::string GetPasscode(){return m_passcode;}
+	std::string GetResumeTicket(){return m_resumeTicket;}
+	CCoplayConnection* GetConnection() { return m_pConnection; }
 
 private:
 	bool CreateConnection(HSteamNetConnection hConnection);
+	void DestroyConnection(int reason);
+	bool TryResume(); // redials the host with our ticket after a drop, false if theres nothing to resume
 
 private:
 	HSteamNetConnection m_hConn;
 	CSteamID m_hostLobby;
 	CCoplayConnection* m_pConnection;
 	std::string m_passcode;
+
+	CSteamID m_hostID;
+	std::string m_resumeTicket; // only set while we're redialing
+
+	// Resuming into a suspended connection, the handshake runs here instead of on the connection's thread
+	bool m_bResuming;
+	HSteamNetConnection m_hResumeConn;
+	CCoplayClientHandshake* m_pResumeHandshake;
+	float m_resumeStartTime;
+
+	// Steam tells us about these on the callback thread, making and joining the connection threads waits for Update
+	HSteamNetConnection m_hPendingConn; // connected, waiting on a connection to go with it
+	CUtlVector<CCoplayConnection*> m_oldConnections; // on their way out, deleted once their thread's done
 };
 #endif
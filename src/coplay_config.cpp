@@ -0,0 +1,41 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_config.h"
+#include <stddef.h>
+
+CCoplayRelayConfigStore::CCoplayRelayConfigStore()
+{
+    m_published.push_back(new CoplayRelayConfig_t());
+    m_pCurrent.store(m_published.back(), std::memory_order_release);
+}
+
+CCoplayRelayConfigStore::~CCoplayRelayConfigStore()
+{
+    for (size_t i = 0; i < m_published.size(); i++)
+        delete m_published[i];
+}
+
+void CCoplayRelayConfigStore::Publish(const CoplayRelayConfig_t &config)
+{
+    CoplayRelayConfig_t *pConfig = new CoplayRelayConfig_t(config);
+    pConfig->version = m_published.back()->version + 1;
+    m_published.push_back(pConfig);
+
+    // filled in before anyone can see it
+    m_pCurrent.store(pConfig, std::memory_order_release);
+}
+
+CCoplayRelayConfigStore *CoplayRelayConfig()
+{
+    static CCoplayRelayConfigStore s_store;
+    return &s_store;
+}
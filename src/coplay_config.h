@@ -0,0 +1,88 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// What the connection threads need to know from the cvars, taken all at once on the main thread.
+// A published config is never modified, the threads hold on to the one they started a loop with
+// and only come back for a new one when the version changes. Publishing swaps a pointer, reading never waits on anything.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_CONFIG_H
+#define COPLAY_CONFIG_H
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include "coplay_threadplacement.h"
+
+// How much the relay loop reports on itself, each level is a separate instantiation of the loop
+enum CoplayInstrumentation
+{
+    eCoplayInstrumentation_Off = 0,
+    eCoplayInstrumentation_Debug, // coplay_debuglog_scream or coplay_debuglog_socketspam
+};
+
+struct CoplayRelayConfig_t
+{
+    // These defaults only last until the cvars are published
+    int     threadHz        = 300;  // how often a parked loop checks the peer
+    int64_t spinMaxUsec     = 500;  // longest a loop keeps spinning after traffic, 0 to always park
+    float   timeoutSeconds  = 30;
+    CoplayThreadPlacement_t placement; // applied by each connection thread when it changes
+
+    bool    scream          = false;
+    bool    socketSpam      = false;
+    bool    socketCreation  = false;
+
+    bool    capture         = false;
+    int64_t captureMaxBytes = 256ll * 1024 * 1024;
+
+    int     resumeBufferBytes = 64 * 1024; // what a client holds on to from the game while it redials
+    bool    lanes             = true;      // new connections send on a lane per CoplayTrafficClass
+    bool    fragments         = true;      // new connections split datagrams too big for one of Steam's packets
+    bool    fec               = false;     // new connections send parity so the other side can rebuild what it lost
+    int     redundantCopies   = 0;         // clients only, most earlier usercmds to send again with each one
+    int64_t backpressureUsec  = 50000;     // queue time the peer's sends can build up before we start shedding, 0 never
+    int64_t staleBudgetUsec   = 0;         // clients only, how long a snapshot can wait before a newer one makes it pointless
+
+    uint32_t version        = 0; // filled in by Publish
+
+    CoplayInstrumentation GetInstrumentation() const
+    {
+        return scream || socketSpam ? eCoplayInstrumentation_Debug : eCoplayInstrumentation_Off;
+    }
+};
+
+typedef const CoplayRelayConfig_t *CoplayRelayConfigRef;
+
+class CCoplayRelayConfigStore
+{
+public:
+    CCoplayRelayConfigStore();
+    ~CCoplayRelayConfigStore();
+
+    // Main thread, replaces the current config for any loop that starts after this
+    void Publish(const CoplayRelayConfig_t &config);
+
+    // Any thread. What you get stays good for as long as the store is around
+    CoplayRelayConfigRef Get() const { return m_pCurrent.load(std::memory_order_acquire); }
+    uint32_t GetVersion() const { return Get()->version; }
+
+private:
+    std::atomic<CoplayRelayConfigRef> m_pCurrent;
+
+    // Everything ever published, main thread only. A thread could be partway through a loop with any of these,
+    // so nothing is freed till we are. They only pile up when someone changes a cvar
+    std::vector<CoplayRelayConfig_t*> m_published;
+};
+
+CCoplayRelayConfigStore *CoplayRelayConfig();
+
+#endif
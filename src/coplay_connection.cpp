@@ -12,94 +12,198 @@
 #include "cbase.h"
 #include "coplay_connection.h"
 #include "coplay_system.h"
-#include <inetchannel.h>
-#include <inetchannelinfo.h>
 
-ConVar coplay_timeoutduration("coplay_timeoutduration", "30", FCVAR_ARCHIVE);
+static void RelayConfigChanged(IConVar *var, const char *pOldValue, float flOldValue);
+
+ConVar coplay_timeoutduration("coplay_timeoutduration", "30", FCVAR_ARCHIVE, "Seconds without any traffic before a connection is closed.\n", RelayConfigChanged);
 ConVar coplay_portrange_begin("coplay_portrange_begin", "3600", FCVAR_ARCHIVE, "Where to start looking for ports to bind on, a range of atleast 64 is recomended.\n");
 ConVar coplay_portrange_end  ("coplay_portrange_end", "3700", FCVAR_ARCHIVE, "Where to stop looking for ports to bind on, a range of atleast 64 is recomended.\n");
 
-ConVar coplay_debuglog_socketspam("coplay_debuglog_socketspam", "0", 0, "Prints the number of packets recieved by either interface if more than 0.\n");
-ConVar coplay_debuglog_scream("coplay_debuglog_scream", "0", 0, "Yells if the connection loop is working\n");
+ConVar coplay_debuglog_socketspam("coplay_debuglog_socketspam", "0", 0, "Prints the number of packets recieved by either interface if more than 0.\n", RelayConfigChanged);
+ConVar coplay_debuglog_scream("coplay_debuglog_scream", "0", 0, "Yells if the connection loop is working\n", RelayConfigChanged);
 
-ConVar coplay_debuglog_socketcreation("coplay_debuglog_socketcreation", "0", 0, "Prints more information when a socket is opened or closed.\n");
+ConVar coplay_debuglog_socketcreation("coplay_debuglog_socketcreation", "0", 0, "Prints more information when a socket is opened or closed.\n", RelayConfigChanged);
 ConVar coplay_connectionthread_hz("coplay_connectionthread_hz", "300", FCVAR_ARCHIVE,
-    "Number of times to run a connection per second. Only change this if you know what it means.\n",
-    true, 10, false, 0);
+    "Number of times a second an idle connection checks for packets from Steam, the game's own packets wake it straight away. Only change this if you know what it means.\n",
+    true, 10, false, 0, RelayConfigChanged);
+ConVar coplay_connectionthread_spin_us("coplay_connectionthread_spin_us", "500", FCVAR_ARCHIVE,
+    "Most microseconds a connection keeps polling without sleeping after it moves a packet, it adapts to the traffic up to this. "
+    "Trades CPU for latency, 0 to always sleep.\n",
+    true, 0, true, 100000, RelayConfigChanged);
+
+ConVar coplay_connectionthread_cores("coplay_connectionthread_cores", "", FCVAR_ARCHIVE,
+    "Cores to keep the connection threads on, like \"2,3\" or \"2-3\". Empty lets the OS decide. See coplay_status for where they ended up.\n",
+    RelayConfigChanged);
+ConVar coplay_connectionthread_priority("coplay_connectionthread_priority", "0", FCVAR_ARCHIVE,
+    "Scheduling priority of the connection threads. 0 normal, 1 high, 2 realtime. "
+    "On Linux high needs a nice limit and realtime needs an rtprio limit or CAP_SYS_NICE, otherwise they step down.\n",
+    true, 0, true, eCoplayThreadPriority_Count - 1, RelayConfigChanged);
+
+ConVar coplay_lanes("coplay_lanes", "1", FCVAR_ARCHIVE,
+    "Sends plain snapshots and usercmds on their own Steam lane, ahead of reliable data and split packets, so they don't queue behind them when the connection's backed up. "
+    "Only new connections pick this up.\n", RelayConfigChanged);
+
+ConVar coplay_fragment("coplay_fragment", "1", FCVAR_ARCHIVE,
+    "Splits datagrams too big for one of Steam's packets ourselves and puts them back together on the other side, if the other side can. "
+    "Only new connections pick this up.\n", RelayConfigChanged);
+
+ConVar coplay_fec("coplay_fec", "0", FCVAR_ARCHIVE,
+    "Sends a parity packet after every few snapshots and usercmds so the other side can rebuild one that went missing without waiting on the game to resend it, "
+    "if the other side can. How many go per parity follows the loss Steam measures. Costs some bandwidth, see coplay_status. "
+    "Wrapped datagrams still get split by coplay_fragment and skipped by coplay_stale_snapshot_ms. Only new connections pick this up.\n",
+    RelayConfigChanged);
+
+ConVar coplay_usercmd_redundancy("coplay_usercmd_redundancy", "0", FCVAR_ARCHIVE,
+    "Clients only. Sends up to this many of the last usercmds again along with each new one, so one lost on the way to the host still gets there, "
+    "if the host can take them. Fewer go while Steam says the host is losing less, none once it's about nothing. 0 to never.\n",
+    true, 0, true, COPLAY_REDUNDANCY_MAX_COPIES, RelayConfigChanged);
+
+ConVar coplay_backpressure_ms("coplay_backpressure_ms", "50", FCVAR_ARCHIVE,
+    "Once what we send Steam would wait more than this many milliseconds to go out, every other plain snapshot or usercmd is left out "
+    "and ones with reliable data in them are queued instead of dropped, until it's back under half. 0 to never do this.\n",
+    true, 0, false, 0, RelayConfigChanged);
+
+ConVar coplay_stale_snapshot_ms("coplay_stale_snapshot_ms", "0", FCVAR_ARCHIVE,
+    "Clients only. Snapshots that waited in Steam longer than this many milliseconds are skipped if a newer one arrived with them, "
+    "ones with reliable data in them are always passed on. 0 passes on everything.\n",
+    true, 0, false, 0, RelayConfigChanged);
+
+ConVar coplay_capture("coplay_capture", "0", 0, "Records relayed traffic of new connections to coplay_capture_<port>.cpcap in the game directory, for use with coplay_replay.\n", RelayConfigChanged);
+ConVar coplay_resume("coplay_resume", "1", FCVAR_ARCHIVE, "When Steam drops our connection to the host, keep the game connected and resume in the background instead of reconnecting it.\n");
+ConVar coplay_resume_buffer_kb("coplay_resume_buffer_kb", "64", FCVAR_ARCHIVE, "Kilobytes of what the game sends to hold on to while resuming, the oldest is dropped past this.\n",
+    true, 0, false, 0, RelayConfigChanged);
+ConVar coplay_capture_maxmb("coplay_capture_maxmb", "256", 0, "Stop capturing a connection once its file reaches this many megabytes, 0 for no limit.\n", true, 0, false, 0, RelayConfigChanged);
+
+// The connection threads never read the cvars themselves, they get a snapshot of them
+void PublishRelayConfig()
+{
+    CoplayRelayConfig_t config;
+    config.threadHz        = coplay_connectionthread_hz.GetInt();
+    config.spinMaxUsec     = coplay_connectionthread_spin_us.GetInt();
+    config.timeoutSeconds  = coplay_timeoutduration.GetFloat();
+    config.placement.priority = (CoplayThreadPriority)coplay_connectionthread_priority.GetInt();
+    if (!CoplayParseCoreList(coplay_connectionthread_cores.GetString(), &config.placement.affinityMask))
+        Warning("[Coplay Warning] Couldn't make sense of coplay_connectionthread_cores \"%s\", not pinning the connection threads.\n",
+                coplay_connectionthread_cores.GetString());
+    config.scream          = coplay_debuglog_scream.GetBool();
+    config.socketSpam      = coplay_debuglog_socketspam.GetBool();
+    config.socketCreation  = coplay_debuglog_socketcreation.GetBool();
+    config.capture         = coplay_capture.GetBool();
+    config.captureMaxBytes = (int64)coplay_capture_maxmb.GetInt() * 1024 * 1024;
+    config.resumeBufferBytes = coplay_resume_buffer_kb.GetInt() * 1024;
+    config.lanes           = coplay_lanes.GetBool();
+    config.fragments       = coplay_fragment.GetBool();
+    config.fec             = coplay_fec.GetBool();
+    config.redundantCopies = coplay_usercmd_redundancy.GetInt();
+    config.backpressureUsec = (int64)coplay_backpressure_ms.GetInt() * 1000;
+    config.staleBudgetUsec  = (int64)coplay_stale_snapshot_ms.GetInt() * 1000;
+    CoplayRelayConfig()->Publish(config);
+}
+
+static void RelayConfigChanged(IConVar *var, const char *pOldValue, float flOldValue)
+{
+    PublishRelayConfig();
+}
 
-CCoplayConnection::CCoplayConnection(HSteamNetConnection hConn) : m_localSocket(nullptr), m_port(0), m_sendbackAddress(), m_hSteamConnection(0), m_timeStarted(0)
+CCoplayConnection::CCoplayConnection(ICoplayTransport *pTransport, HCoplayPeer hPeer, const std::string &passcode, const std::string &dialTicket) :
+    m_localSocket(nullptr), m_port(0), m_sendbackAddress(), m_timeStarted(0), m_passcode(passcode), m_dialTicket(dialTicket)
 {
-    m_hSteamConnection = hConn;
-    m_lastPacketTime = gpGlobals->realtime;
+    m_pTransport     = pTransport;
+    m_hPeer          = hPeer;
+    m_role           = CCoplaySystem::GetInstance()->GetRole();
+    m_lastPacketTime = 0;
     m_deletionQueued = false;
+    m_parked         = false;
+    m_suspendRequested = false;
+    m_resumePeer     = COPLAY_INVALID_PEER;
     m_gameReady      = false;
     m_endReason      = k_ESteamNetConnectionEnd_App_ConnectionFinished;
 
-    UDPsocket sock = NULL;
-    // TODO - Do all ports need to be opened?
-    for (uint16 port = coplay_portrange_begin.GetInt(); port < coplay_portrange_end.GetInt(); port++)
-    {
-        sock = SDLNet_UDP_Open(port);
-        if(!sock)
-        {
-			ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] Couldn't bind to port %u\n", port);
-            continue;
-		}
-
-        m_localSocket = sock;
-        m_port = port;
-        break;
-    }
-
-    if (!sock)
+    m_localSocket = CoplayOpenSocketInRange(coplay_portrange_begin.GetInt(), coplay_portrange_end.GetInt(), &m_port);
+    if (!m_localSocket)
     {
-        Warning("[Coplay Error] What do you need all those ports for anyway? (Couldn't bind to a port on range %d-%d!)\n", 
+        CoplayLog(eCoplayLog_General, eCoplayLogLevel_Warning, "[Coplay Error] What do you need all those ports for anyway? (Couldn't bind to a port on range %d-%d!)\n",
             coplay_portrange_begin.GetInt(), coplay_portrange_end.GetInt());
     }
 
+    BindToGame();
+}
+
+CCoplayConnection::CCoplayConnection(ICoplayTransport *pTransport, HCoplayPeer hPeer, UDPsocket localSocket, uint16 port) : m_localSocket(localSocket), m_port(port), m_sendbackAddress(), m_timeStarted(0)
+{
+    m_pTransport     = pTransport;
+    m_hPeer          = hPeer;
+    m_role           = CCoplaySystem::GetInstance()->GetRole();
+    m_lastPacketTime = 0;
+    m_deletionQueued = false;
+    m_parked         = false;
+    m_suspendRequested = false;
+    m_resumePeer     = COPLAY_INVALID_PEER;
+    m_gameReady      = false;
+    m_endReason      = k_ESteamNetConnectionEnd_App_ConnectionFinished;
+
+    // the old connection's bind is still there, don't end up sending everything twice
+    SDLNet_UDP_Unbind(m_localSocket, 1);
+    BindToGame();
+}
+
+void CCoplayConnection::BindToGame()
+{
     IPaddress addr{};
     addr.host = SDL_Swap32(INADDR_LOOPBACK);
 
-    if (CCoplaySystem::GetInstance()->GetRole() == eConnectionRole_CLIENT)
-    {
-        ConVarRef clientport("clientport");
-        addr.port = SDL_Swap16(clientport.GetInt());
-    }
+    // we can be made on the callback thread, the main thread keeps these up to date for us
+    if (m_role == eConnectionRole_CLIENT)
+        addr.port = SDL_Swap16(CCoplaySystem::GetInstance()->GetClientPort());
     else
-    {
-        INetChannelInfo* netinfo = engine->GetNetChannelInfo();
-        // netchannel is set to NULL when disconnecting as a host. be safe
-        if (!netinfo)
-        {
-            addr.port = SDL_Swap16(27015);
-        }
-        else
-        {
-            std::string ip = netinfo->GetAddress();
-            if (ip.find(':') == std::string::npos || ip.length() - 1 == ip.find(':'))
-            {
-                addr.port = SDL_Swap16(27015);
-            }
-            else
-            {
-                std::string portstr = ip.substr(ip.find(':') + 1, std::string::npos);
-                int port = std::stoi(portstr);
-                addr.port = SDL_Swap16(port);
-            }
-        }
-    }
+        addr.port = SDL_Swap16(CCoplaySystem::GetInstance()->GetGameServerPort());
     SDLNet_UDP_Bind(m_localSocket, 1, &addr);// "Inbound" Channel
     m_sendbackAddress = addr;
 
     if (coplay_debuglog_socketcreation.GetBool())
     {
-        ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] New socket : %u\n", m_port);
+        CoplayLog(eCoplayLog_SocketCreation, eCoplayLogLevel_Debug, "[Coplay Debug] New socket : %u\n", m_port);
     }
 
     std::string threadname = "coplayconnection_" + std::to_string(m_port);
     SetName(threadname.c_str());
 }
 
+std::string CCoplayConnection::GetResumeTicket()
+{
+    AUTO_LOCK(m_ticketMutex);
+    return m_resumeTicket;
+}
+
+void CCoplayConnection::Resume(HCoplayPeer hPeer, const std::string &ticket)
+{
+    {
+        AUTO_LOCK(m_ticketMutex);
+        m_resumeTicket = ticket;
+    }
+    m_hPeer      = hPeer;
+    m_resumePeer = hPeer;
+}
+
+// Relay thread, picks up Suspend and Resume from the main thread
+void CCoplayConnection::UpdateSuspension(const CoplayRelayConfig_t &config)
+{
+    if (!m_relay.IsHolding())
+    {
+        m_relay.Hold(config.resumeBufferBytes);
+        CoplayLog(eCoplayLog_General, eCoplayLogLevel_Debug, "[Coplay Debug] Holding port %u while we resume\n", m_port);
+    }
+
+    HCoplayPeer hPeer = (HCoplayPeer)(int)m_resumePeer;
+    if (hPeer == COPLAY_INVALID_PEER)
+        return;
+
+    m_resumePeer       = COPLAY_INVALID_PEER;
+    m_suspendRequested = false;
+    int numHeld = m_relay.Resume(hPeer);
+    CoplayLog(eCoplayLog_General, eCoplayLogLevel_Info, "[Coplay] Resumed, sent on %i held packets\n", numHeld);
+}
+
 void CCoplayConnection::ConnectToHost()
 {
     ConColorMsg(COPLAY_MSG_COLOR, "[Coplay] Connecting to server...\n");
@@ -112,153 +216,232 @@ void CCoplayConnection::ConnectToHost()
     engine->ClientCmd_Unrestricted(cmd);
 }
 
-int CCoplayConnection::Run()
+void CCoplayConnection::StartCapture(const CoplayRelayConfig_t &config)
 {
-    ConVarRef net_maxroutable("net_maxroutable"); // Defaults to min( 1260, MTU ), i think.
-    m_timeStarted = gpGlobals->realtime;
-    m_lastPacketTime = gpGlobals->realtime;
-    UDPpacket **LocalInboundPackets = SDLNet_AllocPacketV(COPLAY_MAX_PACKETS, net_maxroutable.GetInt());
+    char path[MAX_PATH];
+    V_snprintf(path, sizeof(path), "%s/coplay_capture_%u.cpcap", engine->GetGameDirectory(), m_port);
+
+    if (!m_capture.Open(path, m_role, config.captureMaxBytes))
+    {
+        CoplayLog(eCoplayLog_General, eCoplayLogLevel_Debug, "[Coplay Debug] Couldn't open capture file %s\n", path);
+        return;
+    }
+    CoplayLog(eCoplayLog_General, eCoplayLogLevel_Info, "[Coplay] Capturing traffic to %s\n", path);
+    m_relay.SetCapture(&m_capture);
+}
 
-    SteamNetworkingMessage_t *InboundSteamMessages[COPLAY_MAX_PACKETS];
-    UDPpacket SteamPacket;
+void CCoplayConnection::RunHandshake(const CoplayRelayConfig_t &config)
+{
+    CCoplayClientHandshake handshake(m_pTransport, m_hPeer, m_passcode, m_dialTicket);
+    int64 timeStarted = CoplayTimeUsec();
 
-    int numSDLRecv;
-    int numSteamRecv;
+    // we're only started once Steam says we're connected, so the passcode can go out now instead of waiting to be asked
+    handshake.Start();
 
-    int64 messageOut;
-    
-    // Send passcode if needed
-    if (!UseCoplayLobbies() && CCoplaySystem::GetInstance()->GetRole() == eConnectionRole_CLIENT)
+    // wait till we're told we will be let in to start forwarding stuff, checked as often as the relay would
+    const int sleepTime = 1000 / config.threadHz;
+    while (!m_deletionQueued && timeStarted + (int64)(config.timeoutSeconds * 1000000) > CoplayTimeUsec())
     {
-        // see if the server needs a password and wait till we're told we will be let in to start forwarding stuff
-        while (!m_gameReady && !m_deletionQueued && m_timeStarted + coplay_timeoutduration.GetFloat() > gpGlobals->curtime)
+        m_gameReady = handshake.Poll() == eCoplayHandshake_Accepted;
+        if (m_gameReady)
         {
-            if (coplay_debuglog_scream.GetBool())
-                Msg("Waiting for Server response..\n");
-            ThreadSleep(50);
-            numSteamRecv = SteamNetworkingSockets()->ReceiveMessagesOnConnection(m_hSteamConnection, InboundSteamMessages, sizeof(InboundSteamMessages));
-            for (int i = 0; i < numSteamRecv; i++)
-            {
-
-                std::string recvMsg((const char*)(InboundSteamMessages[i]->GetData()));
-                if (recvMsg == std::string(COPLAY_NETMSG_NEEDPASS))
-                {
-                    SteamNetworkingSockets()->SendMessageToConnection(m_hSteamConnection,
-                        CCoplaySystem::GetInstance()->GetClient()->GetPasscode().c_str(),
-                        CCoplaySystem::GetInstance()->GetClient()->GetPasscode().length(),
-                        k_nSteamNetworkingSend_ReliableNoNagle | k_nSteamNetworkingSend_UseCurrentThread, &messageOut);
-                }
-                else if (recvMsg == std::string(COPLAY_NETMSG_OK))
-                    m_gameReady = true;//Server said our password was good, start relaying packets
-                else
-                    Warning("[Coplay] Got unexpected handshake message, \"%s\"\n", recvMsg.c_str());
-            }
+            AUTO_LOCK(m_ticketMutex);
+            m_resumeTicket = handshake.GetTicket();
+            break;
         }
+
+        if (config.scream)
+            CoplayLog(eCoplayLog_Scream, eCoplayLogLevel_Plain, "Waiting for Server response..\n");
+        ThreadSleep(sleepTime);
     }
+}
 
-    // Ready to game
-    while(!m_deletionQueued)
+// One instantiation per role and instrumentation level, the Off ones have no logging or cvar checks in them at all.
+// Runs until the connection is closing or a new config gets published.
+template <ConnectionRole ROLE, CoplayInstrumentation INSTRUMENTATION>
+void CCoplayConnection::RelayLoop(const CoplayRelayConfig_t &config)
+{
+    const int   sleepTime    = 1000 / config.threadHz;
+    const int64 timeoutUsec  = (int64)(config.timeoutSeconds * 1000000);
+    CCoplayRelayConfigStore *pConfigStore = CoplayRelayConfig();
+
+    CCoplayRelayPacer pacer;
+    pacer.Init(config.spinMaxUsec);
+    m_relay.SetBackpressure(config.backpressureUsec);
+    m_relay.SetStaleBudget(ROLE == eConnectionRole_CLIENT ? config.staleBudgetUsec : 0);
+    m_relay.SetRedundancy(ROLE == eConnectionRole_CLIENT ? config.redundantCopies : 0);
+
+    while (!m_deletionQueued && pConfigStore->GetVersion() == config.version)
     {
-        if (coplay_debuglog_scream.GetBool())
-        {
-            Msg("LOOP START ");
-        }
-        if (m_localSocket == NULL || m_hSteamConnection == 0)
-        {
-            Warning("[Coplay Warning] A registered Coplay socket was invalid! Deleting.\n");
-            QueueForDeletion();
-            continue;
-        }
+        if (ROLE == eConnectionRole_CLIENT && m_suspendRequested)
+            UpdateSuspension(config);
 
-        // TODO - cache me?
-        // TODO - should this be moved to the end?
-        int sleepTime = 1000/coplay_connectionthread_hz.GetInt();
-        if (coplay_debuglog_scream.GetBool())
-        {
-            Msg("Sleep %ims", sleepTime);
-        }
-        ThreadSleep(sleepTime);//dont work too hard
+        CoplayPumpResult_t result = m_relay.Pump();
 
-        //Outbound to SDR
-        if (coplay_debuglog_scream.GetBool())
+        if (INSTRUMENTATION >= eCoplayInstrumentation_Debug)
         {
-            Msg("OUTBOUND START");
-        }
-        numSDLRecv = SDLNet_UDP_RecvV(m_localSocket, LocalInboundPackets);
+            if (config.scream)
+            {
+                CoplayLog(eCoplayLog_Scream, eCoplayLogLevel_Plain, "LOOP port %u spinning up to %lldus, SDL %i Steam %i\n",
+                          m_port, (long long)pacer.GetSpinWindow(), result.numLocalRecv, result.numPeerRecv);
+            }
 
-        if( numSDLRecv > 0 && coplay_debuglog_socketspam.GetBool())
-        {
-            ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] SDL %i\n", numSDLRecv);
+            if (config.socketSpam)
+            {
+                if (result.numLocalRecv > 0)
+                    CoplayLog(eCoplayLog_SocketSpam, eCoplayLogLevel_Debug, "[Coplay Debug] SDL %i\n", result.numLocalRecv);
+                if (result.numPeerRecv > 0)
+                    CoplayLog(eCoplayLog_SocketSpam, eCoplayLogLevel_Debug, "[Coplay Debug] Steam %i\n", result.numPeerRecv);
+            }
         }
 
-        if (numSDLRecv == -1)
+        // errors get reported at every level, the log rate limits them
+        if (result.localError)
         {
             // TODO - warn as we don't crash out, I think
-            ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] SDL Error! %s\n", SDLNet_GetError());
+            CoplayLog(eCoplayLog_LocalError, eCoplayLogLevel_Debug, "[Coplay Debug] SDL Error! %s\n", SDLNet_GetError());
         }
 
-        for (int j = 0; j < numSDLRecv; j++)
+        if (result.numLocalSendFailed > 0)
         {
-            SteamNetworkingSockets()->SendMessageToConnection(m_hSteamConnection, (const void*)LocalInboundPackets[j]->data,
-                                                              LocalInboundPackets[j]->len,
-                                                              k_nSteamNetworkingSend_UnreliableNoDelay | k_nSteamNetworkingSend_UseCurrentThread,
-                                                              &messageOut);//use unreliable mode, source already handles it, dont do double duty for no reason
-            //if (coplay_debuglog_socketspam.GetBool())
-            //    ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] Result %i\n", result);
+            CoplayLog(eCoplayLog_LocalSendFailed, eCoplayLogLevel_Debug, "[Coplay Debug] %i Wasnt sent! %s\n", result.numLocalSendFailed, SDLNet_GetError());
         }
 
-        if (coplay_debuglog_scream.GetBool())
+        // For a client our game being connected means its still using us.
+        // The host's game is always "connected", but its server stops sending to a player once they're gone
+        bool active = result.numPeerRecv > 0;
+        if (ROLE == eConnectionRole_CLIENT)
+            active = active || CCoplaySystem::GetInstance()->IsGameConnected();
+        else
+            active = active || result.numLocalRecv > 0;
+
+        int64 now = CoplayTimeUsec();
+        if (active)
+        {
+            m_lastPacketTime = now;
+        }
+        else if (m_lastPacketTime + timeoutUsec < now)
         {
-            Msg("OUTBOUND END\n");
+            if (config.socketCreation)
+                CoplayLog(eCoplayLog_SocketCreation, eCoplayLogLevel_Debug, "[Coplay Debug] Socket with port %i timed out.\n", m_port);
+            QueueForDeletion();
         }
 
-        //Inbound from SDR
+        // keep going while things are moving, otherwise wait on the game or till its time to check the peer again
+        pacer.OnPump(now, result.numLocalRecv > 0 || result.numPeerRecv > 0);
+        if (pacer.ShouldSpin(now))
+            CoplayCPUPause();
+        else
+            m_relay.WaitForLocal(sleepTime);
+    }
+}
 
-        numSteamRecv = SteamNetworkingSockets()->ReceiveMessagesOnConnection(m_hSteamConnection, InboundSteamMessages, COPLAY_MAX_PACKETS);
+void CCoplayConnection::UpdatePlacement(const CoplayRelayConfig_t &config)
+{
+    if (config.placement == m_wantedPlacement)
+        return;
+    m_wantedPlacement = config.placement;
 
-        if (numSteamRecv > 0 && coplay_debuglog_socketspam.GetBool())
-        {
-            ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] Steam %i\n", numSteamRecv);
-        }
+    CoplayThreadPlacement_t placement;
+    CoplayApplyThreadPlacement(m_wantedPlacement, &placement);
+    {
+        AUTO_LOCK(m_placementMutex);
+        m_placement = placement;
+    }
 
-        if (numSteamRecv > 0 || engine->IsConnected())
-        {
-            m_lastPacketTime = gpGlobals->realtime;
-        }
+    if (placement != m_wantedPlacement)
+    {
+        char wantedCores[128], cores[128];
+        CoplayFormatCoreList(m_wantedPlacement.affinityMask, wantedCores, sizeof(wantedCores));
+        CoplayFormatCoreList(placement.affinityMask, cores, sizeof(cores));
+        CoplayLog(eCoplayLog_General, eCoplayLogLevel_Warning,
+                  "[Coplay Warning] Connection on port %u wanted cores %s at %s priority, but got cores %s at %s priority.\n",
+                  m_port, wantedCores, CoplayThreadPriorityName(m_wantedPlacement.priority),
+                  cores, CoplayThreadPriorityName(placement.priority));
+    }
+}
 
+CoplayThreadPlacement_t CCoplayConnection::GetPlacement()
+{
+    AUTO_LOCK(m_placementMutex);
+    return m_placement;
+}
 
-        for (int j = 0; j < numSteamRecv; j++)
-        {
-            SteamPacket.data = (uint8*)InboundSteamMessages[j]->GetData();
-            SteamPacket.len  = InboundSteamMessages[j]->GetSize();
+int CCoplayConnection::Run()
+{
+    m_timeStarted = CoplayTimeUsec();
 
-            if (!SDLNet_UDP_Send(m_localSocket, 1, &SteamPacket))
-            {
-                ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] Wasnt sent! %s\n", SDLNet_GetError());
-            }
-        }
+    CoplayRelayConfigRef pConfig = CoplayRelayConfig()->Get();
+    UpdatePlacement(*pConfig);
 
-        for (int j = 0; j < numSteamRecv; j++)
+    // Send passcode if needed, with lobbies its just to pick up OK and the ticket in it
+    if (m_role == eConnectionRole_CLIENT)
+        RunHandshake(*pConfig);
+
+    if (!m_relay.Init(m_localSocket, m_pTransport, m_hPeer))
+    {
+        CoplayLog(eCoplayLog_General, eCoplayLogLevel_Warning, "[Coplay Warning] Couldn't start relaying on port %u!\n", m_port);
+        QueueForDeletion(k_ESteamNetConnectionEnd_App_RemoteIssue);
+    }
+    else
+    {
+        if (m_role == eConnectionRole_HOST)
+            m_relay.DropHandshake();
+        if (pConfig->lanes && !m_relay.EnableLanes() && pConfig->socketCreation)
+            CoplayLog(eCoplayLog_SocketCreation, eCoplayLogLevel_Debug, "[Coplay Debug] Couldn't set up lanes on port %u, everything goes on one.\n", m_port);
+
+        // the client offers since its handshake is done by now, the host's Hello could land in the middle of it
+        // anyone can take usercmd copies, it's only the client that sends them and only if it's been told to
+        int caps = COPLAY_RELAY_CAP_REDUNDANCY | (pConfig->fragments ? COPLAY_RELAY_CAP_FRAGMENTS : 0) | (pConfig->fec ? COPLAY_RELAY_CAP_FEC : 0);
+        int maxDatagram = m_relay.EnableRelayMessages(m_role == eConnectionRole_CLIENT, caps);
+        if (maxDatagram > 0 && pConfig->socketCreation)
+            CoplayLog(eCoplayLog_SocketCreation, eCoplayLogLevel_Debug, "[Coplay Debug] Datagrams over %i bytes on port %u go in pieces once the other side can take them.\n", maxDatagram, m_port);
+    }
+
+    if (m_localSocket == NULL || m_hPeer == COPLAY_INVALID_PEER)
+    {
+        CoplayLog(eCoplayLog_General, eCoplayLogLevel_Warning, "[Coplay Warning] A registered Coplay socket was invalid! Deleting.\n");
+        QueueForDeletion();
+    }
+
+    if (pConfig->capture)
+        StartCapture(*pConfig);
+
+    // Ready to game
+    m_lastPacketTime = CoplayTimeUsec();
+    while (!m_deletionQueued)
+    {
+        pConfig = CoplayRelayConfig()->Get();
+        UpdatePlacement(*pConfig);
+        bool debug = pConfig->GetInstrumentation() >= eCoplayInstrumentation_Debug;
+
+        if (m_role == eConnectionRole_CLIENT)
         {
-            InboundSteamMessages[j]->Release();
+            if (debug)
+                RelayLoop<eConnectionRole_CLIENT, eCoplayInstrumentation_Debug>(*pConfig);
+            else
+                RelayLoop<eConnectionRole_CLIENT, eCoplayInstrumentation_Off>(*pConfig);
         }
-
-        if (m_lastPacketTime + coplay_timeoutduration.GetFloat() < gpGlobals->realtime)
+        else
         {
-            if (coplay_debuglog_socketcreation.GetBool())
-                ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] Socket with port %i timed out.\n", m_port);
-            QueueForDeletion();
+            if (debug)
+                RelayLoop<eConnectionRole_HOST, eCoplayInstrumentation_Debug>(*pConfig);
+            else
+                RelayLoop<eConnectionRole_HOST, eCoplayInstrumentation_Off>(*pConfig);
         }
     }
 
     //Cleanup
-    SDLNet_FreePacketV(LocalInboundPackets);
-    SDLNet_UDP_Close(m_localSocket);
-    SteamNetworkingSockets()->CloseConnection(m_hSteamConnection, m_endReason, "", true);
-
-    if (coplay_debuglog_socketcreation.GetBool())
+    m_relay.SetCapture(NULL);
+    m_capture.Close();
+    m_relay.Shutdown();
+    if (m_parked.AssignIf(0, -1))
+        SDLNet_UDP_Close(m_localSocket);
+    m_pTransport->Close(m_hPeer, m_endReason, "", true);
+
+    if (pConfig->socketCreation)
     {
-        ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] Socket with port %i closed.\n", m_port);
+        CoplayLog(eCoplayLog_SocketCreation, eCoplayLogLevel_Debug, "[Coplay Debug] Socket with port %i closed.\n", m_port);
     }
 
     return 0;
@@ -18,16 +18,59 @@
 #include "steam/isteamnetworkingsockets.h"
 #include "SDL2/SDL_net.h"
 
+#include "tier0/valve_minmax_off.h"
+#include "coplay_relay.h"
+#include "coplay_capture.h"
+#include "coplay_log.h"
+#include "coplay_config.h"
+#include "coplay_timer.h"
+#include "coplay_pacer.h"
+#include "coplay_sendrate.h"
+#include "coplay_handshake.h"
+#include "coplay_ports.h"
+#include "tier0/valve_minmax_on.h"
+
+// Snapshots the relay cvars for the connection threads, they also republish themselves whenever they change
+void PublishRelayConfig();
+
 //a single SDL/Steam connection pair, clients will only have 0 or 1 of these, one per remote player on the host
 class CCoplayConnection : public CThread
 {
 public:
-    CCoplayConnection(HSteamNetConnection hConn);
+    // Clients pass what the handshake sends, the thread can't go asking the client for it while the main thread changes it
+    CCoplayConnection(ICoplayTransport *pTransport, HCoplayPeer hPeer, const std::string &passcode = "", const std::string &dialTicket = "");
+    // Takes over a socket a parked connection left behind, so the game sees the same port again
+    CCoplayConnection(ICoplayTransport *pTransport, HCoplayPeer hPeer, UDPsocket localSocket, uint16 port);
     void QueueForDeletion(int reason = k_ESteamNetConnectionEnd_App_ConnectionFinished){ m_deletionQueued = true; m_endReason = reason;}
+    // Like QueueForDeletion but the socket is left open for whoever resumes the session.
+    // False if we were already on our way out and the socket's gone
+    bool Park(int reason) { if (!m_parked.AssignIf(0, 1)) return false; QueueForDeletion(reason); return true; }
+    bool IsParked() const { return m_parked == 1; }
     void ConnectToHost();
 
+    // Client side, the ticket the host gave us for reconnecting, empty till we're let in or if it didn't give one
+    std::string GetResumeTicket();
+
+    // Client side, for when Steam drops us but the game shouldn't notice. Suspend keeps the game's socket open and holds
+    // on to what it sends, Resume hands over the new Steam connection once the host has taken our ticket
+    void Suspend() { m_suspendRequested = true; }
+    void Resume(HCoplayPeer hPeer, const std::string &ticket);
+    bool IsSuspended() const { return m_suspendRequested != 0; }
+
+    // Safe to call from the main thread while we're running
+    const CCoplayRelayStats &GetStats() const { return m_relay.GetStats(); }
+    // Where the thread ended up after the last coplay_connectionthread_cores/priority it applied
+    CoplayThreadPlacement_t GetPlacement();
+
 private:
+    void BindToGame();
     int Run();
+    void RunHandshake(const CoplayRelayConfig_t &config);
+    template <ConnectionRole ROLE, CoplayInstrumentation INSTRUMENTATION>
+    void RelayLoop(const CoplayRelayConfig_t &config);
+    void StartCapture(const CoplayRelayConfig_t &config);
+    void UpdateSuspension(const CoplayRelayConfig_t &config);
+    void UpdatePlacement(const CoplayRelayConfig_t &config);
 
 public:
     // only check for inital messaging for passwords, if needed, a connecting client cant know for sure
@@ -35,14 +78,43 @@ public:
     uint16    m_port = 0;
     IPaddress m_sendbackAddress;
 
-    HSteamNetConnection     m_hSteamConnection = 0;
-    float                   m_timeStarted;
+    ICoplayTransport       *m_pTransport = NULL;
+    HCoplayPeer             m_hPeer = COPLAY_INVALID_PEER; // the Steam connection in game
+    int64                   m_timeStarted;
+
+    // Host side, who this is for and the session their ticket names
+    uint64                  m_remoteID = 0;
+    uint64                  m_sessionSerial = 0;
+
+    // Main thread only, what CCoplaySystem::UpdateSendTuning last gave Steam for this connection
+    CoplaySendTuning_t      m_sendTuning;
+    HCoplayPeer             m_tunedPeer = COPLAY_INVALID_PEER; // resuming gets us a new one that hasn't been tuned
+    uint64                  m_tunedBytesOut = 0;
 
 private:
     CInterlockedInt m_deletionQueued;
+    CInterlockedInt m_parked; // 1 once parked, -1 once the thread has closed the socket instead
+    CInterlockedInt m_suspendRequested;
+    CInterlockedInt m_resumePeer; // the connection to carry on with, COPLAY_INVALID_PEER till theres one
     bool            m_gameReady;
-    // For when the steam connection is still being kept alive but there is no actual activity
-    float m_lastPacketTime = 0; 
+    ConnectionRole  m_role; // what we were made as, the system's role can change under a running thread
+
+    CCoplayRelay         m_relay;
+    CCoplayCaptureWriter m_capture;
+
+    // For when the steam connection is still being kept alive but there is no actual activity, CoplayTimeUsec
+    int64 m_lastPacketTime = 0;
     int   m_endReason;
+
+    // Client side, sent in the handshake. Only set in the constructor
+    std::string m_passcode;
+    std::string m_dialTicket; // what we're redialing with, empty on a fresh connect
+
+    CThreadFastMutex m_ticketMutex;
+    std::string      m_resumeTicket;
+
+    CoplayThreadPlacement_t m_wantedPlacement; // only the thread touches this one
+    CThreadFastMutex        m_placementMutex;
+    CoplayThreadPlacement_t m_placement;
 };
 #endif
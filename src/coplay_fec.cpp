@@ -0,0 +1,375 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_fec.h"
+#include <math.h>
+#include <string.h>
+
+// every x64 compiler has SSE2, 32 bit builds only get it when they're told they can
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COPLAY_FEC_SSE2
+#endif
+
+static void WriteLittleShort(uint8_t *pOut, uint16_t value)
+{
+    pOut[0] = (uint8_t)value;
+    pOut[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t ReadLittleShort(const uint8_t *pData)
+{
+    return (uint16_t)(pData[0] | (pData[1] << 8));
+}
+
+int CoplayFecGroupSize(double loss)
+{
+    // two losses in a group of n + 1 with its parity is about (n + 1)n/2 * loss^2
+    if (loss <= 0)
+        return COPLAY_FEC_MAX_GROUP;
+    int groupSize = (int)(sqrt(2 * COPLAY_FEC_TARGET_LOSS) / loss) - 1;
+    if (groupSize < COPLAY_FEC_MIN_GROUP)
+        return COPLAY_FEC_MIN_GROUP;
+    return groupSize > COPLAY_FEC_MAX_GROUP ? COPLAY_FEC_MAX_GROUP : groupSize;
+}
+
+int CoplayReadFecStream(const uint8_t *pData, int len)
+{
+    if (len < COPLAY_FEC_DATA_HEADER_SIZE || pData[5] >= COPLAY_FEC_STREAMS)
+        return -1;
+    return pData[5];
+}
+
+const uint8_t *CoplayUnwrapFecData(const uint8_t *pData, int len, int *pLen)
+{
+    if (len < COPLAY_FEC_DATA_HEADER_SIZE || CoplayReadRelayMessage(pData, len) != eCoplayRelayMsg_FecData)
+    {
+        *pLen = len;
+        return pData;
+    }
+    *pLen = len - COPLAY_FEC_DATA_HEADER_SIZE;
+    return pData + COPLAY_FEC_DATA_HEADER_SIZE;
+}
+
+void CoplayXorBytes(uint8_t *pDst, const uint8_t *pSrc, int len)
+{
+    int i = 0;
+#ifdef COPLAY_FEC_SSE2
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i dst = _mm_loadu_si128((const __m128i*)(pDst + i));
+        __m128i src = _mm_loadu_si128((const __m128i*)(pSrc + i));
+        _mm_storeu_si128((__m128i*)(pDst + i), _mm_xor_si128(dst, src));
+    }
+#else
+    // a word at a time, memcpy keeps it legal on anything that minds unaligned loads
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t dst, src;
+        memcpy(&dst, pDst + i, 8);
+        memcpy(&src, pSrc + i, 8);
+        dst ^= src;
+        memcpy(pDst + i, &dst, 8);
+    }
+#endif
+    for (; i < len; i++)
+        pDst[i] ^= pSrc[i];
+}
+
+void CCoplayFecEncoder::Init(int stream)
+{
+    m_stream           = (uint8_t)stream;
+    m_group            = 0;
+    m_index            = 0;
+    m_groupSize        = COPLAY_FEC_MAX_GROUP;
+    m_currentGroupSize = m_groupSize;
+    m_maxLen           = 0;
+    m_lenXor           = 0;
+    m_startUsec        = 0;
+}
+
+void CCoplayFecEncoder::SetGroupSize(int groupSize)
+{
+    if (groupSize < COPLAY_FEC_MIN_GROUP)
+        groupSize = COPLAY_FEC_MIN_GROUP;
+    m_groupSize = groupSize > COPLAY_FEC_MAX_GROUP ? COPLAY_FEC_MAX_GROUP : groupSize;
+}
+
+int CCoplayFecEncoder::WriteData(uint8_t *pOut, const uint8_t *pData, int len, int64_t now)
+{
+    if (m_index == 0)
+    {
+        m_currentGroupSize = m_groupSize;
+        m_maxLen           = 0;
+        m_lenXor           = 0;
+        m_startUsec        = now;
+    }
+
+    // the parity is as long as the longest one, the shorter ones count as zero past their end
+    if (len > m_maxLen)
+    {
+        memset(m_parity + m_maxLen, 0, len - m_maxLen);
+        m_maxLen = len;
+    }
+    CoplayXorBytes(m_parity, pData, len);
+    m_lenXor ^= (uint16_t)len;
+
+    CoplayWriteRelayMessage(pOut, eCoplayRelayMsg_FecData);
+    pOut[5] = m_stream;
+    WriteLittleShort(pOut + 6, m_group);
+    pOut[8] = (uint8_t)m_index;
+    memcpy(pOut + COPLAY_FEC_DATA_HEADER_SIZE, pData, len);
+    m_index++;
+    return COPLAY_FEC_DATA_HEADER_SIZE + len;
+}
+
+int CCoplayFecEncoder::WriteParity(uint8_t *pOut, int64_t now)
+{
+    if (m_index == 0 || (m_index < m_currentGroupSize && now - m_startUsec < COPLAY_FEC_MAX_GROUP_USEC))
+        return 0;
+
+    CoplayWriteRelayMessage(pOut, eCoplayRelayMsg_FecParity);
+    pOut[5] = m_stream;
+    WriteLittleShort(pOut + 6, m_group);
+    pOut[8] = (uint8_t)m_index;
+    WriteLittleShort(pOut + 9, m_lenXor);
+    memcpy(pOut + COPLAY_FEC_PARITY_HEADER_SIZE, m_parity, m_maxLen);
+
+    m_group++;
+    m_index = 0;
+    return COPLAY_FEC_PARITY_HEADER_SIZE + m_maxLen;
+}
+
+void CCoplayFecDecoder::Reset()
+{
+    m_bActive      = false;
+    m_group        = 0;
+    m_count        = 0;
+    m_received     = 0;
+    m_skip         = 0;
+    m_highest      = -1;
+    m_next         = 0;
+    m_bGaveUp      = false;
+    m_holdStart    = 0;
+    m_bParity      = false;
+    m_parityLenXor = 0;
+    m_parityLen    = 0;
+    m_numRecovered = 0;
+    m_numLost      = 0;
+}
+
+int CCoplayFecDecoder::TakeNumRecovered()
+{
+    int numRecovered = m_numRecovered;
+    m_numRecovered   = 0;
+    return numRecovered;
+}
+
+int CCoplayFecDecoder::TakeNumLost()
+{
+    int numLost = m_numLost;
+    m_numLost   = 0;
+    return numLost;
+}
+
+int CCoplayFecDecoder::CountMissing(int end) const
+{
+    int numMissing = 0;
+    for (int i = 0; i < end; i++)
+    {
+        if (!(m_received & (1u << i)))
+            numMissing++;
+    }
+    return numMissing;
+}
+
+bool CCoplayFecDecoder::StartGroup(uint16_t group, CoplayFecDeliverFn pfnDeliver, void *pContext)
+{
+    if (m_bActive)
+    {
+        if (group == m_group)
+            return true;
+        if ((int16_t)(group - m_group) < 0)
+            return false;
+
+        // the next group's started, whatever we were still waiting on isn't coming
+        if (!m_bGaveUp)
+            GiveUp(pfnDeliver, pContext);
+    }
+
+    m_bActive   = true;
+    m_group     = group;
+    m_count     = 0;
+    m_received  = 0;
+    m_skip      = 0;
+    m_highest   = -1;
+    m_next      = 0;
+    m_bGaveUp   = false;
+    m_holdStart = 0;
+    m_bParity   = false;
+    return true;
+}
+
+void CCoplayFecDecoder::Deliver(int index, CoplayFecDeliverFn pfnDeliver, void *pContext)
+{
+    if (!(m_skip & (1u << index)))
+        pfnDeliver(pContext, m_data[index], m_lens[index]);
+}
+
+void CCoplayFecDecoder::Release(int64_t now, CoplayFecDeliverFn pfnDeliver, void *pContext)
+{
+    while (m_next <= m_highest && (m_received & (1u << m_next)))
+    {
+        Deliver(m_next, pfnDeliver, pContext);
+        m_next++;
+    }
+
+    if (m_next > m_highest)
+    {
+        m_holdStart = 0;
+        return;
+    }
+
+    // one gap can be filled in, any more and there's nothing worth waiting for
+    if (CountMissing(m_highest + 1) - CountMissing(m_next) > 1)
+        GiveUp(pfnDeliver, pContext);
+    else if (!m_holdStart)
+        m_holdStart = now;
+}
+
+void CCoplayFecDecoder::GiveUp(CoplayFecDeliverFn pfnDeliver, void *pContext)
+{
+    int end = m_count ? m_count : m_highest + 1;
+    for (int i = m_next; i < end; i++)
+    {
+        if (m_received & (1u << i))
+            Deliver(i, pfnDeliver, pContext);
+        else
+            m_numLost++;
+    }
+    m_next      = end;
+    m_bGaveUp   = true;
+    m_holdStart = 0;
+}
+
+void CCoplayFecDecoder::TryRecover(CoplayFecDeliverFn pfnDeliver, void *pContext)
+{
+    int numMissing = CountMissing(m_count);
+    if (numMissing == 0)
+        return;
+    if (numMissing > 1)
+    {
+        GiveUp(pfnDeliver, pContext);
+        return;
+    }
+
+    int missing = 0;
+    while (m_received & (1u << missing))
+        missing++;
+
+    // what's left of the parity once everything we've got is taken back out of it
+    uint16_t len = m_parityLenXor;
+    for (int i = 0; i < m_count; i++)
+    {
+        if (i == missing)
+            continue;
+        CoplayXorBytes(m_parity, m_data[i], m_lens[i]);
+        len ^= (uint16_t)m_lens[i];
+    }
+    if (len > m_parityLen)
+    {
+        GiveUp(pfnDeliver, pContext);
+        return;
+    }
+
+    memcpy(m_data[missing], m_parity, len);
+    m_lens[missing] = len;
+    m_received     |= 1u << missing;
+    if (missing > m_highest)
+        m_highest = missing;
+    m_numRecovered++;
+}
+
+void CCoplayFecDecoder::AddData(uint16_t group, int index, const uint8_t *pPayload, int len, int64_t now, bool bSkip, CoplayFecDeliverFn pfnDeliver, void *pContext)
+{
+    // too late to help anything, the game can still have it if it wants
+    if (!StartGroup(group, pfnDeliver, pContext))
+    {
+        if (!bSkip)
+            pfnDeliver(pContext, pPayload, len);
+        return;
+    }
+    if ((m_received & (1u << index)) || (m_count && index >= m_count))
+        return;
+
+    memcpy(m_data[index], pPayload, len);
+    m_lens[index] = len;
+    m_received   |= 1u << index;
+    if (bSkip)
+        m_skip |= 1u << index;
+    if (index > m_highest)
+        m_highest = index;
+
+    if (m_bGaveUp)
+    {
+        Deliver(index, pfnDeliver, pContext);
+        return;
+    }
+
+    if (m_bParity)
+        TryRecover(pfnDeliver, pContext);
+    if (!m_bGaveUp)
+        Release(now, pfnDeliver, pContext);
+}
+
+void CCoplayFecDecoder::AddParity(uint16_t group, int count, uint16_t lenXor, const uint8_t *pParity, int len, int64_t now, CoplayFecDeliverFn pfnDeliver, void *pContext)
+{
+    if (!StartGroup(group, pfnDeliver, pContext) || m_bParity || m_bGaveUp)
+        return;
+    // the sender never has more in a group than this, something's off
+    if (count == 0 || count > COPLAY_FEC_MAX_GROUP || m_highest >= count)
+        return;
+
+    m_bParity      = true;
+    m_count        = count;
+    m_parityLenXor = lenXor;
+    m_parityLen    = len;
+    memcpy(m_parity, pParity, len);
+
+    TryRecover(pfnDeliver, pContext);
+    if (!m_bGaveUp)
+        Release(now, pfnDeliver, pContext);
+}
+
+void CCoplayFecDecoder::Add(const uint8_t *pData, int len, int64_t now, bool bSkip, CoplayFecDeliverFn pfnDeliver, void *pContext)
+{
+    int type = CoplayReadRelayMessage(pData, len);
+    uint16_t group = ReadLittleShort(pData + 6);
+    if (type == eCoplayRelayMsg_FecData)
+    {
+        int index = pData[8];
+        int payloadLen = len - COPLAY_FEC_DATA_HEADER_SIZE;
+        if (index < COPLAY_FEC_MAX_GROUP && payloadLen <= COPLAY_FEC_MAX_PAYLOAD)
+            AddData(group, index, pData + COPLAY_FEC_DATA_HEADER_SIZE, payloadLen, now, bSkip, pfnDeliver, pContext);
+    }
+    else if (type == eCoplayRelayMsg_FecParity && len >= COPLAY_FEC_PARITY_HEADER_SIZE)
+    {
+        int parityLen = len - COPLAY_FEC_PARITY_HEADER_SIZE;
+        if (parityLen <= COPLAY_FEC_MAX_PAYLOAD)
+            AddParity(group, pData[8], ReadLittleShort(pData + 9), pData + COPLAY_FEC_PARITY_HEADER_SIZE, parityLen, now, pfnDeliver, pContext);
+    }
+}
+
+void CCoplayFecDecoder::Expire(int64_t now, CoplayFecDeliverFn pfnDeliver, void *pContext)
+{
+    if (m_holdStart && now - m_holdStart > COPLAY_FEC_HOLD_USEC)
+        GiveUp(pfnDeliver, pContext);
+}
@@ -0,0 +1,130 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Parity over groups of datagrams, so the other side can rebuild one that went missing without waiting on the game
+// to notice and send it again. One parity per group, the XOR of everything in it, which covers a single loss.
+// The netchannel throws out anything older than what it last got, so once there's a gap the datagrams after it
+// are held till the parity comes and the rebuilt one can go first. It's only ever a gap that waits.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_FEC_H
+#define COPLAY_FEC_H
+#pragma once
+
+#include <stdint.h>
+#include "coplay_fragment.h"
+
+#define COPLAY_FEC_STREAMS             2  // a group per traffic class, so groups don't straddle lanes. Bulk goes as it is
+#define COPLAY_FEC_MIN_GROUP           2
+#define COPLAY_FEC_MAX_GROUP           16
+#define COPLAY_FEC_DATA_HEADER_SIZE    9  // relay header, stream, group and index
+#define COPLAY_FEC_PARITY_HEADER_SIZE  11 // relay header, stream, group, how many it covers and their lengths XORed
+#define COPLAY_FEC_MAX_PAYLOAD         (COPLAY_POOL_BUFFER_SIZE - COPLAY_FEC_PARITY_HEADER_SIZE)
+#define COPLAY_FEC_TARGET_LOSS         0.001  // groups are kept small enough that two losses in one are about this rare
+#define COPLAY_FEC_MAX_GROUP_USEC      40000  // a group that's taking this long gets its parity early
+#define COPLAY_FEC_HOLD_USEC           50000  // longest anything is held waiting on a parity
+
+// How big a group to send in for the fraction of packets the peer's missing
+int CoplayFecGroupSize(double loss);
+
+// The stream an FEC message is for, -1 if it makes no sense
+int CoplayReadFecStream(const uint8_t *pData, int len);
+
+// The game's datagram inside FEC data, anything else comes back as it is
+const uint8_t *CoplayUnwrapFecData(const uint8_t *pData, int len, int *pLen);
+
+// dst ^= src
+void CoplayXorBytes(uint8_t *pDst, const uint8_t *pSrc, int len);
+
+class CCoplayFecEncoder
+{
+public:
+    CCoplayFecEncoder() { Init(0); }
+
+    void Init(int stream);
+    // From the next group on
+    void SetGroupSize(int groupSize);
+    int  GetGroupSize() const { return m_groupSize; }
+
+    // Wraps a datagram up as the next one in the group, pOut needs room for len + COPLAY_FEC_DATA_HEADER_SIZE.
+    // len can't be more than COPLAY_FEC_MAX_PAYLOAD
+    int WriteData(uint8_t *pOut, const uint8_t *pData, int len, int64_t now);
+    // The group's parity once it's full, or has had something in it for COPLAY_FEC_MAX_GROUP_USEC.
+    // 0 if it isn't time yet. pOut needs room for COPLAY_POOL_BUFFER_SIZE
+    int WriteParity(uint8_t *pOut, int64_t now);
+
+private:
+    uint8_t  m_stream;
+    uint16_t m_group;
+    int      m_index;
+    int      m_groupSize;
+    int      m_currentGroupSize; // the size the open group was started with
+    int      m_maxLen;
+    uint16_t m_lenXor;
+    int64_t  m_startUsec;
+    uint8_t  m_parity[COPLAY_FEC_MAX_PAYLOAD];
+};
+
+// Gets datagrams that are ready for the game, in the order they were sent
+typedef void (*CoplayFecDeliverFn)(void *pContext, const uint8_t *pData, int len);
+
+class CCoplayFecDecoder
+{
+public:
+    CCoplayFecDecoder() { Reset(); }
+
+    void Reset();
+
+    // Takes an FEC data or parity message, whatever that lets through goes to pfnDeliver before it returns.
+    // Data that's been superseded can still rebuild something else, bSkip keeps it for that but it never goes out
+    void Add(const uint8_t *pData, int len, int64_t now, bool bSkip, CoplayFecDeliverFn pfnDeliver, void *pContext);
+    // Gives up on a datagram that's been missing for COPLAY_FEC_HOLD_USEC, what was held behind it goes
+    void Expire(int64_t now, CoplayFecDeliverFn pfnDeliver, void *pContext);
+
+    // Since the last call
+    int TakeNumRecovered();
+    int TakeNumLost();
+
+private:
+    void AddData(uint16_t group, int index, const uint8_t *pPayload, int len, int64_t now, bool bSkip, CoplayFecDeliverFn pfnDeliver, void *pContext);
+    void AddParity(uint16_t group, int count, uint16_t lenXor, const uint8_t *pParity, int len, int64_t now, CoplayFecDeliverFn pfnDeliver, void *pContext);
+    // False if the group's older than the one we're on, it's no use to us then
+    bool StartGroup(uint16_t group, CoplayFecDeliverFn pfnDeliver, void *pContext);
+    // Everything from m_next up to the first gap
+    void Release(int64_t now, CoplayFecDeliverFn pfnDeliver, void *pContext);
+    // Everything we've got, gaps and all
+    void GiveUp(CoplayFecDeliverFn pfnDeliver, void *pContext);
+    void TryRecover(CoplayFecDeliverFn pfnDeliver, void *pContext);
+    int  CountMissing(int end) const;
+    void Deliver(int index, CoplayFecDeliverFn pfnDeliver, void *pContext);
+
+    bool     m_bActive;
+    uint16_t m_group;
+    int      m_count;    // 0 till the parity tells us
+    uint32_t m_received; // a bit per index
+    uint32_t m_skip;     // and the ones that don't go to the game
+    int      m_highest;  // highest index we've got, -1 for none
+    int      m_next;     // first index that hasn't gone to the game or been given up on
+    bool     m_bGaveUp;  // anything else in the group goes straight through
+    int64_t  m_holdStart; // 0 when nothing's held
+
+    bool     m_bParity;
+    uint16_t m_parityLenXor;
+    int      m_parityLen;
+
+    int m_numRecovered;
+    int m_numLost;
+
+    int     m_lens[COPLAY_FEC_MAX_GROUP];
+    uint8_t m_data[COPLAY_FEC_MAX_GROUP][COPLAY_FEC_MAX_PAYLOAD];
+    uint8_t m_parity[COPLAY_FEC_MAX_PAYLOAD];
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_fragment.h"
+#include <string.h>
+
+// little endian like the engine's own headers
+static void WriteLittleShort(uint8_t *pOut, uint16_t value)
+{
+    pOut[0] = (uint8_t)value;
+    pOut[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t ReadLittleShort(const uint8_t *pData)
+{
+    return (uint16_t)(pData[0] | (pData[1] << 8));
+}
+
+// every piece but the last is this big, so where one goes can be worked out from its index
+static int GetFragmentSize(int totalLen, int count)
+{
+    return (totalLen + count - 1) / count;
+}
+
+int CoplayReadRelayMessage(const uint8_t *pData, int len)
+{
+    if (len < COPLAY_RELAY_MSG_HEADER_SIZE)
+        return -1;
+
+    uint32_t header = (uint32_t)pData[0] | ((uint32_t)pData[1] << 8) | ((uint32_t)pData[2] << 16) | ((uint32_t)pData[3] << 24);
+    if ((int32_t)header != COPLAY_NET_HEADER_RELAY || pData[4] >= eCoplayRelayMsg_Count)
+        return -1;
+    return pData[4];
+}
+
+int CoplayWriteRelayMessage(uint8_t *pOut, CoplayRelayMessage type)
+{
+    uint32_t header = (uint32_t)COPLAY_NET_HEADER_RELAY;
+    pOut[0] = (uint8_t)header;
+    pOut[1] = (uint8_t)(header >> 8);
+    pOut[2] = (uint8_t)(header >> 16);
+    pOut[3] = (uint8_t)(header >> 24);
+    pOut[4] = (uint8_t)type;
+    return COPLAY_RELAY_MSG_HEADER_SIZE;
+}
+
+int CoplayCountFragments(int len, int maxLen)
+{
+    if (maxLen <= 0 || len <= maxLen)
+        return 1;
+    if (maxLen <= COPLAY_FRAGMENT_HEADER_SIZE || len > COPLAY_POOL_BUFFER_SIZE)
+        return 0;
+
+    int room  = maxLen - COPLAY_FRAGMENT_HEADER_SIZE;
+    int count = (len + room - 1) / room;
+    return count <= COPLAY_MAX_FRAGMENTS ? count : 0;
+}
+
+int CoplayWriteFragment(uint8_t *pOut, uint16_t id, const uint8_t *pData, int len, int index, int count)
+{
+    int fragmentSize = GetFragmentSize(len, count);
+    int offset       = index * fragmentSize;
+    int size         = len - offset < fragmentSize ? len - offset : fragmentSize;
+
+    CoplayWriteRelayMessage(pOut, eCoplayRelayMsg_Fragment);
+    WriteLittleShort(pOut + 5, id);
+    pOut[7] = (uint8_t)index;
+    pOut[8] = (uint8_t)count;
+    WriteLittleShort(pOut + 9, (uint16_t)len);
+    memcpy(pOut + COPLAY_FRAGMENT_HEADER_SIZE, pData + offset, size);
+    return COPLAY_FRAGMENT_HEADER_SIZE + size;
+}
+
+void CCoplayReassembler::Reset()
+{
+    for (int i = 0; i < COPLAY_REASSEMBLY_SLOTS; i++)
+        m_slots[i].used = false;
+    m_numUsed    = 0;
+    m_numLost    = 0;
+    m_spreadUsec = 0;
+}
+
+int64_t CCoplayReassembler::GetTimeoutUsec() const
+{
+    int64_t timeout = m_spreadUsec * COPLAY_REASSEMBLY_SPREAD_SCALE;
+    if (timeout < COPLAY_REASSEMBLY_TIMEOUT_MIN)
+        return COPLAY_REASSEMBLY_TIMEOUT_MIN;
+    if (timeout > COPLAY_REASSEMBLY_TIMEOUT_MAX)
+        return COPLAY_REASSEMBLY_TIMEOUT_MAX;
+    return timeout;
+}
+
+CCoplayReassembler::Slot_t *CCoplayReassembler::FindSlot(uint16_t id, int count, int totalLen, int64_t now)
+{
+    Slot_t *pFree   = NULL;
+    Slot_t *pOldest = NULL;
+    for (int i = 0; i < COPLAY_REASSEMBLY_SLOTS; i++)
+    {
+        Slot_t *pSlot = &m_slots[i];
+        if (!pSlot->used)
+        {
+            if (!pFree)
+                pFree = pSlot;
+            continue;
+        }
+        if (pSlot->id == id)
+            return pSlot->count == count && pSlot->totalLen == totalLen ? pSlot : NULL;
+        if (!pOldest || pSlot->firstUsec < pOldest->firstUsec)
+            pOldest = pSlot;
+    }
+
+    Slot_t *pSlot = pFree;
+    if (!pSlot)
+    {
+        // whatever's been waiting longest is the least likely to ever finish
+        pSlot = pOldest;
+        m_numLost++;
+        m_numUsed--;
+    }
+
+    pSlot->used      = true;
+    pSlot->id        = id;
+    pSlot->count     = (uint8_t)count;
+    pSlot->totalLen  = (uint16_t)totalLen;
+    pSlot->received  = 0;
+    pSlot->firstUsec = now;
+    m_numUsed++;
+    return pSlot;
+}
+
+int CCoplayReassembler::Add(const uint8_t *pData, int len, int64_t now, const uint8_t **ppData)
+{
+    if (len <= COPLAY_FRAGMENT_HEADER_SIZE)
+        return -1;
+
+    uint16_t id       = ReadLittleShort(pData + 5);
+    int      index    = pData[7];
+    int      count    = pData[8];
+    int      totalLen = ReadLittleShort(pData + 9);
+    if (count < 2 || count > COPLAY_MAX_FRAGMENTS || index >= count || totalLen > COPLAY_POOL_BUFFER_SIZE || totalLen < count)
+        return -1;
+
+    int fragmentSize = GetFragmentSize(totalLen, count);
+    int offset       = index * fragmentSize;
+    int size         = totalLen - offset < fragmentSize ? totalLen - offset : fragmentSize;
+    if (size <= 0 || len - COPLAY_FRAGMENT_HEADER_SIZE != size)
+        return -1;
+
+    Slot_t *pSlot = FindSlot(id, count, totalLen, now);
+    if (!pSlot)
+        return -1;
+
+    uint32_t bit = 1u << index;
+    if (pSlot->received & bit)
+        return 0;
+    pSlot->received |= bit;
+    memcpy(pSlot->data + offset, pData + COPLAY_FRAGMENT_HEADER_SIZE, size);
+
+    uint32_t all = count == 32 ? 0xFFFFFFFFu : (1u << count) - 1;
+    if (pSlot->received != all)
+        return 0;
+
+    // the slot stays as it is till something else needs it, so the data can be handed out straight from it
+    int64_t spread = now - pSlot->firstUsec;
+    m_spreadUsec  += (spread - m_spreadUsec) / 8;
+    pSlot->used    = false;
+    m_numUsed--;
+    *ppData = pSlot->data;
+    return totalLen;
+}
+
+int CCoplayReassembler::Expire(int64_t now)
+{
+    if (m_numUsed > 0)
+    {
+        int64_t timeout = GetTimeoutUsec();
+        for (int i = 0; i < COPLAY_REASSEMBLY_SLOTS; i++)
+        {
+            if (m_slots[i].used && now - m_slots[i].firstUsec > timeout)
+            {
+                m_slots[i].used = false;
+                m_numUsed--;
+                m_numLost++;
+            }
+        }
+    }
+
+    int numLost = m_numLost;
+    m_numLost   = 0;
+    return numLost;
+}
@@ -0,0 +1,102 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// What the relays say to each other in between the game's datagrams, and splitting datagrams too big for one of
+// the peer's packets. Steam would split them itself, but then a piece going missing is something we never hear about.
+// Ours start with a header the engine never sends, so a relay that doesn't know them passes them to the game
+// and the game throws them out as out of order. Nobody splits anything till the other end has said it can put them back together.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_FRAGMENT_H
+#define COPLAY_FRAGMENT_H
+#pragma once
+
+#include <stdint.h>
+#include "coplay_packetpool.h"
+
+// In place of a sequence number, alongside COPLAY_NET_HEADER_SPLIT and the rest
+#define COPLAY_NET_HEADER_RELAY -16
+
+#define COPLAY_RELAY_MSG_HEADER_SIZE 5  // the header and what kind of message
+#define COPLAY_FRAGMENT_HEADER_SIZE  11 // then the datagram's id, which piece of how many and the whole datagram's length
+#define COPLAY_MAX_FRAGMENTS         32
+#define COPLAY_REASSEMBLY_SLOTS      8  // datagrams we can be missing pieces of at once, the oldest goes for a new one
+
+// How long to wait on the rest of a datagram. Pieces are sent back to back, so once they're later than the
+// ones before them usually were it's down to loss and nothing more is coming
+#define COPLAY_REASSEMBLY_TIMEOUT_MIN  5000
+#define COPLAY_REASSEMBLY_TIMEOUT_MAX  100000
+#define COPLAY_REASSEMBLY_SPREAD_SCALE 4
+
+enum CoplayRelayMessage
+{
+    eCoplayRelayMsg_Hello = 0,  // what the client can take, sent reliably once it's relaying
+    eCoplayRelayMsg_HelloReply, // and what the host can
+    eCoplayRelayMsg_Fragment,
+    eCoplayRelayMsg_FecData,    // see coplay_fec.h
+    eCoplayRelayMsg_FecParity,
+    eCoplayRelayMsg_Redundant,  // see coplay_redundancy.h
+    eCoplayRelayMsg_Count
+};
+
+// What a relay can take from the other side, in the byte after a Hello or HelloReply's header.
+// One without it is from before there was anything but fragments
+#define COPLAY_RELAY_CAP_FRAGMENTS  (1 << 0)
+#define COPLAY_RELAY_CAP_FEC        (1 << 1)
+#define COPLAY_RELAY_CAP_REDUNDANCY (1 << 2)
+
+// -1 for anything that's the game's
+int CoplayReadRelayMessage(const uint8_t *pData, int len);
+// Just the header, returns its length
+int CoplayWriteRelayMessage(uint8_t *pOut, CoplayRelayMessage type);
+
+// Pieces a datagram has to go in to fit in maxLen, 1 if it fits as is or there's no limit and 0 if it can't be done
+int CoplayCountFragments(int len, int maxLen);
+// Piece index of count, pOut needs room for maxLen. Returns how much it wrote
+int CoplayWriteFragment(uint8_t *pOut, uint16_t id, const uint8_t *pData, int len, int index, int count);
+
+class CCoplayReassembler
+{
+public:
+    CCoplayReassembler() { Reset(); }
+
+    void Reset();
+
+    // Takes a piece, once it was the last one missing the whole datagram is in *ppData till the next Add and its length
+    // is returned. 0 while there's more to come or the piece was a copy of one we had, -1 if it makes no sense
+    int Add(const uint8_t *pData, int len, int64_t now, const uint8_t **ppData);
+
+    // Gives up on anything that's waited past GetTimeoutUsec. Returns how many datagrams went since the last call,
+    // ones pushed out to make room included
+    int Expire(int64_t now);
+
+    int64_t GetTimeoutUsec() const;
+
+private:
+    struct Slot_t
+    {
+        bool     used;
+        uint16_t id;
+        uint8_t  count;
+        uint16_t totalLen;
+        uint32_t received; // a bit per piece
+        int64_t  firstUsec;
+        uint8_t  data[COPLAY_POOL_BUFFER_SIZE];
+    };
+
+    Slot_t *FindSlot(uint16_t id, int count, int totalLen, int64_t now);
+
+    Slot_t  m_slots[COPLAY_REASSEMBLY_SLOTS];
+    int     m_numUsed;
+    int     m_numLost;
+    int64_t m_spreadUsec; // smoothed, from a datagram's first piece to its last
+};
+
+#endif
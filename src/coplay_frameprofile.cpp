@@ -0,0 +1,78 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_frameprofile.h"
+#include <string.h>
+
+const char *CoplayFrameStageName(CoplayFrameStage stage)
+{
+    switch (stage)
+    {
+    case eCoplayStage_Callbacks:    return "callbacks";
+    case eCoplayStage_Host:         return "host";
+    case eCoplayStage_Client:       return "client";
+    case eCoplayStage_Log:          return "log";
+    case eCoplayStage_Metrics:      return "metrics";
+    case eCoplayStage_RichPresence: return "richpresence";
+    case eCoplayStage_Total:        return "total";
+    default:                        return "unknown";
+    }
+}
+
+void CCoplayFrameProfile::Reset()
+{
+    memset(m_current, 0, sizeof(m_current));
+    memset(m_samples, 0, sizeof(m_samples));
+    memset(m_sums, 0, sizeof(m_sums));
+    m_next      = 0;
+    m_numFrames = 0;
+}
+
+void CCoplayFrameProfile::BeginFrame()
+{
+    memset(m_current, 0, sizeof(m_current));
+}
+
+void CCoplayFrameProfile::EndFrame()
+{
+    for (int i = 0; i < eCoplayStage_Count; i++)
+    {
+        m_sums[i] += m_current[i] - m_samples[i][m_next];
+        m_samples[i][m_next] = m_current[i];
+    }
+
+    m_next = (m_next + 1) % COPLAY_PROFILE_FRAMES;
+    if (m_numFrames < COPLAY_PROFILE_FRAMES)
+        m_numFrames++;
+}
+
+void CCoplayFrameProfile::GetStage(CoplayFrameStage stage, CoplayFrameStageTiming_t *pTiming) const
+{
+    pTiming->avgUsec = 0;
+    pTiming->maxUsec = 0;
+    if (m_numFrames == 0)
+        return;
+
+    // frames we don't have yet are 0 so they can't be the max
+    pTiming->avgUsec = (double)m_sums[stage] / m_numFrames;
+    for (int i = 0; i < COPLAY_PROFILE_FRAMES; i++)
+    {
+        if (m_samples[stage][i] > pTiming->maxUsec)
+            pTiming->maxUsec = m_samples[stage][i];
+    }
+}
+
+int64_t CCoplayFrameProfile::GetLastFrameUsec() const
+{
+    if (m_numFrames == 0)
+        return 0;
+    return m_samples[eCoplayStage_Total][(m_next + COPLAY_PROFILE_FRAMES - 1) % COPLAY_PROFILE_FRAMES];
+}
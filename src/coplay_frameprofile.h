@@ -0,0 +1,86 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// What CCoplaySystem::Update costs the main thread, per stage over the last few hundred frames.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_FRAMEPROFILE_H
+#define COPLAY_FRAMEPROFILE_H
+#pragma once
+
+#include <stdint.h>
+#include "coplay_timer.h"
+
+#define COPLAY_PROFILE_FRAMES 256
+
+enum CoplayFrameStage
+{
+    eCoplayStage_Callbacks = 0, // SteamAPI_RunCallbacks, and the connection callbacks if theres no thread for them
+    eCoplayStage_Host,
+    eCoplayStage_Client,
+    eCoplayStage_Log,
+    eCoplayStage_Metrics,
+    eCoplayStage_RichPresence,
+    eCoplayStage_Total,         // the whole of Update, including the lock and anything between stages
+
+    eCoplayStage_Count
+};
+
+const char *CoplayFrameStageName(CoplayFrameStage stage);
+
+struct CoplayFrameStageTiming_t
+{
+    double  avgUsec;
+    int64_t maxUsec;
+};
+
+// Main thread only
+class CCoplayFrameProfile
+{
+public:
+    CCoplayFrameProfile() { Reset(); }
+
+    void Reset();
+
+    // Stages that don't run in a frame count as 0 for it
+    void BeginFrame();
+    void AddStage(CoplayFrameStage stage, int64_t usec) { m_current[stage] += usec; }
+    void EndFrame();
+
+    // Over the frames we still have, none before the first EndFrame
+    int  GetNumFrames() const { return m_numFrames; }
+    void GetStage(CoplayFrameStage stage, CoplayFrameStageTiming_t *pTiming) const;
+
+    // Total of the frame that just ended
+    int64_t GetLastFrameUsec() const;
+
+private:
+    int64_t m_current[eCoplayStage_Count];
+    int64_t m_samples[eCoplayStage_Count][COPLAY_PROFILE_FRAMES];
+    int64_t m_sums[eCoplayStage_Count]; // of everything in m_samples, so the average doesn't need a pass
+    int     m_next;
+    int     m_numFrames;
+};
+
+// Adds the time until it goes out of scope to a stage
+class CCoplayScopedStage
+{
+public:
+    CCoplayScopedStage(CCoplayFrameProfile *pProfile, CoplayFrameStage stage)
+        : m_pProfile(pProfile), m_stage(stage), m_start(CoplayTimeUsec()) {}
+    ~CCoplayScopedStage() { m_pProfile->AddStage(m_stage, CoplayTimeUsec() - m_start); }
+
+private:
+    CCoplayFrameProfile *m_pProfile;
+    CoplayFrameStage     m_stage;
+    int64_t              m_start;
+};
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_handshake.h"
+#include "coplay_relay.h"
+#include "coplay_log.h"
+#include <string.h>
+
+std::string CoplayHandshakeString(const CoplayDatagram_t &datagram)
+{
+    const char *pszData = (const char*)datagram.pData;
+    return std::string(pszData, strnlen(pszData, datagram.len));
+}
+
+std::string CoplayHandshakeArg(const CoplayDatagram_t &datagram)
+{
+    const char *pszData = (const char*)datagram.pData;
+    int messageLen = (int)strnlen(pszData, datagram.len);
+    if (messageLen + 1 >= datagram.len)
+        return "";
+    return std::string(pszData + messageLen + 1, strnlen(pszData + messageLen + 1, datagram.len - messageLen - 1));
+}
+
+bool CoplayIsHandshakeMessage(const uint8_t *pData, int len)
+{
+    if (len <= 0)
+        return false;
+    if (len > (int)sizeof(COPLAY_NETMSG_RESUME) && !memcmp(pData, COPLAY_NETMSG_RESUME, sizeof(COPLAY_NETMSG_RESUME)))
+        return true;
+
+    // passcodes go without their terminator
+    for (int i = 0; i < len; i++)
+    {
+        if (pData[i] < 0x20 || pData[i] > 0x7E)
+            return false;
+    }
+    return true;
+}
+
+// message, its terminator, then the argument
+static void CoplaySendWithArg(ICoplayTransport *pTransport, HCoplayPeer hPeer, const char *pszMessage, const std::string &arg)
+{
+    std::string message(pszMessage, strlen(pszMessage) + 1);
+    message += arg;
+    pTransport->Send(hPeer, message.data(), message.length(), eCoplaySend_Reliable);
+}
+
+void CoplaySendNeedPasscode(ICoplayTransport *pTransport, HCoplayPeer hPeer)
+{
+    pTransport->Send(hPeer, COPLAY_NETMSG_NEEDPASS, sizeof(COPLAY_NETMSG_NEEDPASS), eCoplaySend_Reliable);
+}
+
+void CoplaySendOK(ICoplayTransport *pTransport, HCoplayPeer hPeer, const std::string &ticket)
+{
+    if (ticket.empty())
+        pTransport->Send(hPeer, COPLAY_NETMSG_OK, sizeof(COPLAY_NETMSG_OK), eCoplaySend_Reliable);
+    else
+        CoplaySendWithArg(pTransport, hPeer, COPLAY_NETMSG_OK, ticket);
+}
+
+void CoplaySendResumed(ICoplayTransport *pTransport, HCoplayPeer hPeer, const std::string &ticket)
+{
+    CoplaySendWithArg(pTransport, hPeer, COPLAY_NETMSG_RESUMED, ticket);
+}
+
+CoplayPendingReply CoplayReceivePendingReply(ICoplayTransport *pTransport, HCoplayPeer hPeer, std::string *pValue)
+{
+    CoplayDatagram_t msg;
+    if (pTransport->Receive(hPeer, &msg, 1) <= 0)
+        return eCoplayPending_None;
+
+    CoplayPendingReply reply = eCoplayPending_Passcode;
+    *pValue = CoplayHandshakeString(msg);
+    if (*pValue == COPLAY_NETMSG_RESUME)
+    {
+        reply   = eCoplayPending_Resume;
+        *pValue = CoplayHandshakeArg(msg);
+    }
+    pTransport->Release(&msg, 1);
+    return reply;
+}
+
+CoplayHandshakeState CoplayPollPendingPeer(ICoplayTransport *pTransport, HCoplayPeer hPeer, const std::string &passcode)
+{
+    std::string recvMsg;
+    switch (CoplayReceivePendingReply(pTransport, hPeer, &recvMsg))
+    {
+    case eCoplayPending_Passcode:
+        return recvMsg == passcode ? eCoplayHandshake_Accepted : eCoplayHandshake_Rejected;
+    default:
+        // a ticket we've got nothing for, it'll answer NeedPasscode like anyone else
+        return eCoplayHandshake_Waiting;
+    }
+}
+
+CCoplayClientHandshake::CCoplayClientHandshake(ICoplayTransport *pTransport, HCoplayPeer hPeer, const std::string &passcode, const std::string &ticket)
+    : m_pTransport(pTransport), m_hPeer(hPeer), m_passcode(passcode), m_ticket(ticket), m_bSentPasscode(false), m_bResumed(false)
+{
+}
+
+void CCoplayClientHandshake::Start()
+{
+    // the host only asks for the passcode if it doesn't take the ticket
+    if (!m_ticket.empty())
+        CoplaySendWithArg(m_pTransport, m_hPeer, COPLAY_NETMSG_RESUME, m_ticket);
+    // without one there's nothing to gain, let the host ask
+    else if (!m_passcode.empty())
+        SendPasscode();
+}
+
+void CCoplayClientHandshake::SendPasscode()
+{
+    m_pTransport->Send(m_hPeer, m_passcode.c_str(), m_passcode.length(), eCoplaySend_Reliable);
+    m_bSentPasscode = true;
+}
+
+CoplayHandshakeState CCoplayClientHandshake::Poll()
+{
+    CoplayDatagram_t inbound[COPLAY_MAX_PACKETS];
+    int numRecv = m_pTransport->Receive(m_hPeer, inbound, COPLAY_MAX_PACKETS);
+
+    CoplayHandshakeState state = eCoplayHandshake_Waiting;
+    for (int i = 0; i < numRecv && state == eCoplayHandshake_Waiting; i++)
+    {
+        std::string recvMsg = CoplayHandshakeString(inbound[i]);
+        if (recvMsg == COPLAY_NETMSG_NEEDPASS)
+        {
+            // the host asks everyone, if we already sent it a second one would end up relayed to the game
+            if (!m_bSentPasscode)
+                SendPasscode();
+        }
+        else if (recvMsg == COPLAY_NETMSG_OK || recvMsg == COPLAY_NETMSG_RESUMED)
+        {
+            // server said our password was good, start relaying packets
+            state       = eCoplayHandshake_Accepted;
+            m_newTicket = CoplayHandshakeArg(inbound[i]);
+            m_bResumed  = recvMsg == COPLAY_NETMSG_RESUMED;
+        }
+        else
+            CoplayLog(eCoplayLog_Handshake, eCoplayLogLevel_Warning, "[Coplay] Got unexpected handshake message, \"%s\"\n", recvMsg.c_str());
+    }
+    if (numRecv > 0)
+        m_pTransport->Release(inbound, numRecv);
+    return state;
+}
@@ -0,0 +1,94 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// The messages sent over a new connection before anything gets relayed.
+// Clients with a passcode send it as their first message as soon as they're connected, the host checks it as soon as it arrives
+// and says OK. Hosts still say NeedPasscode when they need one, older clients only send their passcode when asked.
+// Hosts that don't need a passcode send OK straight away.
+// OK can carry a reconnect ticket after its terminator, older clients read it as a C string and never see it.
+// A client coming back with a ticket sends Resume instead of its passcode, the host answers Resumed if it took it
+// and falls back to the usual checks if it didn't.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_HANDSHAKE_H
+#define COPLAY_HANDSHAKE_H
+#pragma once
+
+#include "coplay_transport.h"
+#include <string>
+
+#define COPLAY_NETMSG_NEEDPASS "NeedPasscode"
+#define COPLAY_NETMSG_OK "OK"
+#define COPLAY_NETMSG_RESUME "Resume"
+#define COPLAY_NETMSG_RESUMED "Resumed"
+
+enum CoplayHandshakeState
+{
+    eCoplayHandshake_Waiting = 0,
+    eCoplayHandshake_Accepted,
+    eCoplayHandshake_Rejected,
+};
+
+// What a pending peer sent first
+enum CoplayPendingReply
+{
+    eCoplayPending_None = 0,
+    eCoplayPending_Passcode,
+    eCoplayPending_Resume, // with a ticket
+};
+
+// Handshake messages are C strings but nothing promises the remote terminated them
+std::string CoplayHandshakeString(const CoplayDatagram_t &datagram);
+// Anything after the message's terminator, a ticket for OK, Resume and Resumed
+std::string CoplayHandshakeArg(const CoplayDatagram_t &datagram);
+
+// A passcode or Resume, handshakes are text and anything the game sends before its netchannel is up starts with 0xFF
+bool CoplayIsHandshakeMessage(const uint8_t *pData, int len);
+
+// Host side
+void CoplaySendNeedPasscode(ICoplayTransport *pTransport, HCoplayPeer hPeer);
+void CoplaySendOK(ICoplayTransport *pTransport, HCoplayPeer hPeer, const std::string &ticket = "");
+void CoplaySendResumed(ICoplayTransport *pTransport, HCoplayPeer hPeer, const std::string &ticket);
+
+// Host side, takes the first message off a pending peer without blocking, the passcode or ticket goes in pValue
+CoplayPendingReply CoplayReceivePendingReply(ICoplayTransport *pTransport, HCoplayPeer hPeer, std::string *pValue);
+
+// Host side, checks a pending peer for its answer to NeedPasscode without blocking.
+// Doesn't send OK or close anything, that's up to the caller. Resume is skipped, use CoplayReceivePendingReply to handle it.
+CoplayHandshakeState CoplayPollPendingPeer(ICoplayTransport *pTransport, HCoplayPeer hPeer, const std::string &passcode);
+
+// Client side. Start sends the ticket or passcode right away, then call Poll until it stops returning Waiting.
+// The host closes the connection on a bad passcode so there's no Rejected here.
+class CCoplayClientHandshake
+{
+public:
+    CCoplayClientHandshake(ICoplayTransport *pTransport, HCoplayPeer hPeer, const std::string &passcode, const std::string &ticket = "");
+
+    void                 Start();
+    CoplayHandshakeState Poll();
+
+    // Once accepted, the ticket for next time, empty if the host didn't give one
+    const std::string &GetTicket() const { return m_newTicket; }
+    // and whether the host took us back into our old session
+    bool               WasResumed() const { return m_bResumed; }
+
+private:
+    void SendPasscode();
+
+    ICoplayTransport *m_pTransport;
+    HCoplayPeer       m_hPeer;
+    std::string       m_passcode;
+    std::string       m_ticket;
+    std::string       m_newTicket;
+    bool              m_bSentPasscode;
+    bool              m_bResumed;
+};
+
+#endif
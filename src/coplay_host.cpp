@@ -42,6 +42,11 @@ ConVar coplay_joinfilter("coplay_joinfilter", "-1", FCVAR_ARCHIVE, "Whos allowed
                        true, -1, true, 2
                        ,(FnChangeCallback_t)ChangeLobbyType // See the enum ELobbyType in isteammatchmaking.h
                         );
+ConVar coplay_resume_window("coplay_resume_window", "15", FCVAR_ARCHIVE, "Seconds a player who lost their connection can come back to their old port with the ticket they were given, without going through the join filter again. 0 to turn it off.\n",
+                            true, 0, false, 0);
+
+// how long someone with a parked slot has to send their ticket before they get treated like a new player
+#define COPLAY_RESUME_GRACE 1.0f
 
 CCoplayHost::CCoplayHost() :
 	m_hSocket(k_HSteamListenSocket_Invalid),
@@ -83,6 +88,8 @@ void CCoplayHost::StartHosting()
 
 	// create a listen socket
     m_hSocket = SteamNetworkingSockets()->CreateListenSocketP2P(0, 0, NULL);
+    // tickets from last time are no good here
+    m_tickets.NewKey();
 
     if (UseCoplayLobbies())
     {
@@ -111,6 +118,11 @@ void CCoplayHost::StopHosting()
             m_connections[i]->Join();
 
 		m_connections.PurgeAndDeleteElements();
+		// the listen socket takes these with it
+		m_newConnections.RemoveAll();
+
+		FOR_EACH_VEC_BACK(m_parkedSlots, i)
+			CloseParkedSlot(i);
 
 		SteamNetworkingSockets()->CloseListenSocket(m_hSocket);
 		m_hSocket = k_HSteamListenSocket_Invalid;
@@ -141,36 +153,33 @@ void CCoplayHost::Update()
 	{
 		if (!m_connections[i]->IsAlive())
 		{
+			if (m_connections[i]->IsParked())
+				AddParkedSlot(m_connections[i]);
 			m_connections.Remove(i);
 		}
 	}
 
+	FOR_EACH_VEC_BACK(m_parkedSlots, i)
+	{
+		if (m_parkedSlots[i].expireTime < gpGlobals->realtime)
+			CloseParkedSlot(i);
+	}
+
+	FOR_EACH_VEC(m_newConnections, i)
+		SetupConnection(m_newConnections[i]);
+	m_newConnections.RemoveAll();
+
 	FOR_EACH_VEC_BACK(m_pendingConnections, i)
 	{
+		ICoplayTransport *pTransport = CCoplaySystem::GetInstance()->GetTransport();
 		if (m_pendingConnections[i].m_startTime + coplay_timeoutduration.GetFloat() < gpGlobals->realtime)
 		{
-			SteamNetworkingSockets()->CloseConnection(m_pendingConnections[i].m_hConnection, k_ESteamNetConnectionEnd_Misc_Timeout,
-													  "pendingtimeout", false);
+			pTransport->Close(m_pendingConnections[i].m_hConnection, k_ESteamNetConnectionEnd_Misc_Timeout, "pendingtimeout", false);
 			m_pendingConnections.Remove(i);
 			continue;
 		}
-		SteamNetworkingMessage_t *msg;
-		int numMessages = SteamNetworkingSockets()->ReceiveMessagesOnConnection(m_pendingConnections[i].m_hConnection, &msg, 1);
-		if (numMessages > 0)
-		{
-			std::string recvMsg((const char*)msg->GetData(), msg->GetSize());
-			Msg("Got msg %s\n", recvMsg.c_str());
-			if (recvMsg == GetPasscode())
-			{
-				if (!AddConnection(m_pendingConnections[i].m_hConnection))
-					SteamNetworkingSockets()->CloseConnection(m_pendingConnections[i].m_hConnection,
-															  k_ESteamNetConnectionEnd_App_RemoteIssue, "failedlocalconnection", true);
-			}
-			else
-				SteamNetworkingSockets()->CloseConnection(m_pendingConnections[i].m_hConnection,
-														  k_ESteamNetConnectionEnd_App_BadPassword, "badpassword", false);
+		if (PollPendingConnection(m_pendingConnections[i]) != eCoplayHandshake_Waiting)
 			m_pendingConnections.Remove(i);
-		}
 	}
 
 	if (UseCoplayLobbies())
@@ -187,7 +196,7 @@ bool CCoplayHost::ConnectionStatusUpdated(SteamNetConnectionStatusChangedCallbac
 {
 	bool stateFailed = false;
     // Somehow left without us catching it, map transistion load error or cancelation probably
-    if (!engine->IsConnected() || !IsHosting())
+    if (!CCoplaySystem::GetInstance()->IsGameConnected() || !IsHosting())
     {
         SteamNetworkingSockets()->CloseConnection(pParam->m_hConn, k_ESteamNetConnectionEnd_App_NotOpen, "", false);
         return true;
@@ -196,8 +205,13 @@ bool CCoplayHost::ConnectionStatusUpdated(SteamNetConnectionStatusChangedCallbac
     switch (pParam->m_info.m_eState)
     {
     case k_ESteamNetworkingConnectionState_Connecting:
+		// coming back to a parked slot, they got through the filter last time and their ticket gets checked once they're connected
+		if (HasSession(pParam->m_info.m_identityRemote.GetSteamID64()))
+		{
+			SteamNetworkingSockets()->AcceptConnection(pParam->m_hConn);
+		}
 		// lobbies filter for us already, so we can just accept the connection
-		if (UseCoplayLobbies())
+		else if (UseCoplayLobbies())
         {
             if (IsUserInLobby(m_lobby, pParam->m_info.m_identityRemote.GetSteamID()))
                 SteamNetworkingSockets()->AcceptConnection(pParam->m_hConn);
@@ -231,32 +245,49 @@ bool CCoplayHost::ConnectionStatusUpdated(SteamNetConnectionStatusChangedCallbac
         break;
 
     case k_ESteamNetworkingConnectionState_Connected:
-        // Need a passowrd to continue
-        if (coplay_joinfilter.GetInt() == eP2PFilter_CONTROLLED)
-        {
-            CreatePendingConnection(pParam->m_hConn);
-        }
-        else
-        {
-            // add the connection to our list
-            if (!AddConnection(pParam->m_hConn))
-                RemoveConnection(pParam->m_hConn, k_ESteamNetConnectionEnd_App_RemoteIssue, "failedlocalconnection", true);
-        }
+        // usually on the callback thread, making connections and joining their threads waits for Update
+        m_newConnections.AddToTail(pParam->m_hConn);
         break;
 
     // Theres no actual network activity here but we need to clean it up
     case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
-        RemoveConnection(pParam->m_hConn, k_ESteamNetConnectionEnd_Misc_Timeout, "timeout", true);
+        ParkConnection(pParam->m_hConn, k_ESteamNetConnectionEnd_Misc_Timeout, "timeout");
 
         break;
     case k_ESteamNetworkingConnectionState_ClosedByPeer:
-        RemoveConnection(pParam->m_hConn, k_ESteamNetConnectionEnd_App_ClosedByPeer, "peerclosed", true);
+        // a client leaving on purpose always gives an app reason
+        if (CoplayIsAppEndReason(pParam->m_info.m_eEndReason))
+            RemoveConnection(pParam->m_hConn, k_ESteamNetConnectionEnd_App_ClosedByPeer, "peerclosed", true);
+        else
+            ParkConnection(pParam->m_hConn, k_ESteamNetConnectionEnd_App_ClosedByPeer, "peerclosed");
         break;
     }
 
 	return stateFailed;
 }
 
+void CCoplayHost::SetupConnection(HSteamNetConnection hConnection)
+{
+    uint64_t remoteID = 0;
+    CCoplaySystem::GetInstance()->GetTransport()->GetRemoteID(hConnection, &remoteID);
+
+    // Need a ticket or passowrd to continue
+    if (HasSession(remoteID))
+    {
+        CreatePendingConnection(hConnection, true);
+    }
+    else if (coplay_joinfilter.GetInt() == eP2PFilter_CONTROLLED)
+    {
+        CreatePendingConnection(hConnection, false);
+    }
+    else
+    {
+        // add the connection to our list
+        if (!AddConnection(hConnection))
+            RemoveConnection(hConnection, k_ESteamNetConnectionEnd_App_RemoteIssue, "failedlocalconnection", true);
+    }
+}
+
 void CCoplayHost::RandomizePasscode()
 {
     static const std::string validchars = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
@@ -265,57 +296,261 @@ void CCoplayHost::RandomizePasscode()
         m_passcode += validchars[rand() % validchars.length()];
 }
 
-bool CCoplayHost::AddConnection(HSteamNetConnection hConnection)
+bool CCoplayHost::AddConnection(HSteamNetConnection hConnection, int parkedSlot)
 {
-    SteamNetConnectionInfo_t newinfo;
-    if (!SteamNetworkingSockets()->GetConnectionInfo(hConnection, &newinfo))
+    ICoplayTransport *pTransport = CCoplaySystem::GetInstance()->GetTransport();
+    uint64_t newID;
+    if (!pTransport->GetRemoteID(hConnection, &newID))
     {
-        ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] Couldn't make a new connection\n");
+        CoplayLog(eCoplayLog_General, eCoplayLogLevel_Debug, "[Coplay Debug] Couldn't make a new connection\n");
         return false;
     }
 
 	// delete any existing connections from the same user
 	FOR_EACH_VEC_BACK(m_connections, i)
 	{
-		SteamNetConnectionInfo_t info;
-		if (SteamNetworkingSockets()->GetConnectionInfo(m_connections[i]->m_hSteamConnection, &info))
+		uint64_t id;
+		if (pTransport->GetRemoteID(m_connections[i]->m_hPeer, &id) && id == newID)
 		{
-			if (info.m_identityRemote.GetSteamID64() == newinfo.m_identityRemote.GetSteamID64())
-			{
-				m_connections[i]->QueueForDeletion();
-				break;
-			}
+			m_connections[i]->QueueForDeletion();
+			break;
 		}
 	}
 
 	// create a new connection
-	CCoplayConnection* connection = new CCoplayConnection(hConnection);
-	SteamNetworkingSockets()->SendMessageToConnection(hConnection, COPLAY_NETMSG_OK, sizeof(COPLAY_NETMSG_OK)
-													  ,k_nSteamNetworkingSend_ReliableNoNagle, NULL);
+	CCoplayConnection* connection;
+	if (parkedSlot != -1)
+	{
+		CoplayParkedSlot_t slot = m_parkedSlots[parkedSlot];
+		m_parkedSlots.Remove(parkedSlot);
+		connection = new CCoplayConnection(pTransport, hConnection, slot.socket, slot.port);
+	}
+	else
+	{
+		// a fresh join, whatever they left behind isn't getting resumed
+		int oldSlot = FindParkedSlot(newID);
+		if (oldSlot != -1)
+			CloseParkedSlot(oldSlot);
+		connection = new CCoplayConnection(pTransport, hConnection);
+	}
+
+	// every session gets a new serial, a ticket only works once
+	connection->m_remoteID      = newID;
+	connection->m_sessionSerial = CoplayRandom64();
+	std::string ticket;
+	if (coplay_resume_window.GetFloat() > 0)
+		ticket = m_tickets.Issue(newID, connection->m_sessionSerial);
+
+	if (parkedSlot != -1)
+		CoplaySendResumed(pTransport, hConnection, ticket);
+	else
+		CoplaySendOK(pTransport, hConnection, ticket);
 
     connection->Start();
     m_connections.AddToTail(connection);
     return true;
 }
 
-void CCoplayHost::CreatePendingConnection(HSteamNetConnection hConnection)
+void CCoplayHost::CreatePendingConnection(HSteamNetConnection hConnection, bool bResumable)
+{
+    // newer clients send their passcode or ticket the moment they're connected, it may already be here
+    CCoplayPendingConnection pending(hConnection, bResumable);
+    if (PollPendingConnection(pending) != eCoplayHandshake_Waiting)
+        return;
+
+    m_pendingConnections.AddToTail(pending);
+    // older ones wait to be asked, newer ones ignore this. Someone who might have a ticket only gets asked if it turns out they don't
+    if (!bResumable)
+        CoplaySendNeedPasscode(CCoplaySystem::GetInstance()->GetTransport(), hConnection);
+}
+
+CoplayHandshakeState CCoplayHost::PollPendingConnection(CCoplayPendingConnection &pending)
+{
+    ICoplayTransport *pTransport = CCoplaySystem::GetInstance()->GetTransport();
+    HSteamNetConnection hConnection = pending.m_hConnection;
+    int resumeSlot = -1;
+    CoplayHandshakeState state;
+
+    if (!pending.m_bResumable)
+    {
+        state = CoplayPollPendingPeer(pTransport, hConnection, GetPasscode());
+    }
+    else
+    {
+        uint64_t remoteID = 0;
+        pTransport->GetRemoteID(hConnection, &remoteID);
+        std::string value;
+        CoplayPendingReply reply = eCoplayPending_None;
+        if (!pending.m_bValidTicket)
+        {
+            uint64_t serial;
+            reply = CoplayReceivePendingReply(pTransport, hConnection, &value);
+            if (reply == eCoplayPending_Resume && m_tickets.Verify(value, remoteID, &serial))
+            {
+                pending.m_bValidTicket = true;
+                pending.m_resumeSerial = serial;
+            }
+        }
+
+        int slot = FindParkedSlot(remoteID);
+        if (pending.m_bValidTicket && slot != -1 && pending.m_resumeSerial == m_parkedSlots[slot].serial)
+        {
+            resumeSlot = slot;
+            state      = eCoplayHandshake_Accepted;
+        }
+        // the old connection's thread lets go of the port in a frame or so, then it's a parked slot like any other
+        else if (pending.m_bValidTicket && slot == -1 && TakeOverSession(remoteID, pending.m_resumeSerial))
+        {
+            return eCoplayHandshake_Waiting;
+        }
+        // older clients don't know about tickets, give them a moment before treating them like anyone else
+        else if (reply == eCoplayPending_None && !pending.m_bValidTicket && HasSession(remoteID) && pending.m_startTime + COPLAY_RESUME_GRACE > gpGlobals->realtime)
+        {
+            return eCoplayHandshake_Waiting;
+        }
+        else
+        {
+            pending.m_bResumable = false;
+            if (!PassesJoinFilter(CSteamID((uint64)remoteID)))
+            {
+                pTransport->Close(hConnection, k_ESteamNetConnectionEnd_App_NotFriend, "accessdeny", false);
+                return eCoplayHandshake_Rejected;
+            }
+
+            if (coplay_joinfilter.GetInt() != eP2PFilter_CONTROLLED)
+            {
+                state = eCoplayHandshake_Accepted;
+            }
+            else if (reply == eCoplayPending_Passcode)
+            {
+                state = value == GetPasscode() ? eCoplayHandshake_Accepted : eCoplayHandshake_Rejected;
+            }
+            else
+            {
+                CoplaySendNeedPasscode(pTransport, hConnection);
+                return eCoplayHandshake_Waiting;
+            }
+        }
+    }
+
+    if (state == eCoplayHandshake_Accepted)
+    {
+        if (!AddConnection(hConnection, resumeSlot))
+            pTransport->Close(hConnection, k_ESteamNetConnectionEnd_App_RemoteIssue, "failedlocalconnection", true);
+    }
+    else if (state == eCoplayHandshake_Rejected)
+    {
+        pTransport->Close(hConnection, k_ESteamNetConnectionEnd_App_BadPassword, "badpassword", false);
+    }
+    return state;
+}
+
+bool CCoplayHost::PassesJoinFilter(CSteamID remote)
+{
+    if (UseCoplayLobbies())
+        return IsUserInLobby(m_lobby, remote);
+
+    switch (coplay_joinfilter.GetInt())
+    {
+    case eP2PFilter_EVERYONE:
+    case eP2PFilter_CONTROLLED:
+        return true;
+    case eP2PFilter_FRIENDS:
+        return SteamFriends()->HasFriend(remote, k_EFriendFlagImmediate);
+    default:
+        return false;
+    }
+}
+
+void CCoplayHost::ParkConnection(HSteamNetConnection hConnection, int reason, const char *pszDebug)
+{
+    m_newConnections.FindAndRemove(hConnection);
+    FOR_EACH_VEC(m_connections, i)
+    {
+        if (m_connections[i]->m_hPeer == hConnection)
+        {
+            if (coplay_resume_window.GetFloat() <= 0 || !m_connections[i]->Park(reason))
+                m_connections[i]->QueueForDeletion(reason);
+            break;
+        }
+    }
+    CCoplaySystem::GetInstance()->GetTransport()->Close(hConnection, reason, pszDebug, false);
+}
+
+bool CCoplayHost::TakeOverSession(uint64 remoteID, uint64 serial)
+{
+    // they noticed the old connection was gone before Steam told us, it's just taking up their port now.
+    // Update parks it once its thread is done, nothing waits on the thread here
+    FOR_EACH_VEC(m_connections, i)
+    {
+        CCoplayConnection *pConnection = m_connections[i];
+        if (pConnection->m_remoteID != remoteID || pConnection->m_sessionSerial != serial)
+            continue;
+
+        if (pConnection->IsParked())
+            return true;
+        if (!pConnection->Park(k_ESteamNetConnectionEnd_Misc_Timeout))
+            return false;
+        CCoplaySystem::GetInstance()->GetTransport()->Close(pConnection->m_hPeer, k_ESteamNetConnectionEnd_Misc_Timeout, "resumedelsewhere", false);
+        return true;
+    }
+    return false;
+}
+
+bool CCoplayHost::HasSession(uint64 remoteID)
+{
+    if (coplay_resume_window.GetFloat() <= 0)
+        return false;
+    if (FindParkedSlot(remoteID) != -1)
+        return true;
+
+    FOR_EACH_VEC(m_connections, i)
+    {
+        if (m_connections[i]->m_remoteID == remoteID && m_connections[i]->m_sessionSerial != 0)
+            return true;
+    }
+    return false;
+}
+
+int CCoplayHost::AddParkedSlot(CCoplayConnection *pConnection)
+{
+    CoplayParkedSlot_t slot;
+    slot.remoteID   = pConnection->m_remoteID;
+    slot.serial     = pConnection->m_sessionSerial;
+    slot.socket     = pConnection->m_localSocket;
+    slot.port       = pConnection->m_port;
+    slot.expireTime = gpGlobals->realtime + coplay_resume_window.GetFloat();
+    return m_parkedSlots.AddToTail(slot);
+}
+
+int CCoplayHost::FindParkedSlot(uint64 remoteID)
+{
+    FOR_EACH_VEC(m_parkedSlots, i)
+    {
+        if (m_parkedSlots[i].remoteID == remoteID)
+            return i;
+    }
+    return -1;
+}
+
+void CCoplayHost::CloseParkedSlot(int index)
 {
-    m_pendingConnections.AddToTail(CCoplayPendingConnection(hConnection));
-    SteamNetworkingSockets()->SendMessageToConnection(hConnection, COPLAY_NETMSG_NEEDPASS, sizeof(COPLAY_NETMSG_NEEDPASS)
-                                                      ,k_nSteamNetworkingSend_ReliableNoNagle, NULL);
+    SDLNet_UDP_Close(m_parkedSlots[index].socket);
+    m_parkedSlots.Remove(index);
 }
 
 void CCoplayHost::RemoveConnection(HSteamNetConnection hConnection, int reason, const char *pszDebug, bool bEnableLinger)
 {
+    m_newConnections.FindAndRemove(hConnection);
     FOR_EACH_VEC(m_connections, i)
     {
-        if (m_connections[i]->m_hSteamConnection == hConnection)
+        if (m_connections[i]->m_hPeer == hConnection)
         {
             m_connections[i]->QueueForDeletion();
             break;
         }
     }
-    SteamNetworkingSockets()->CloseConnection(hConnection, reason, pszDebug, bEnableLinger);
+    CCoplaySystem::GetInstance()->GetTransport()->Close(hConnection, reason, pszDebug, bEnableLinger);
 }
 
 void CCoplayHost::LobbyCreated(LobbyCreated_t *pParam)
@@ -323,8 +558,11 @@ void CCoplayHost::LobbyCreated(LobbyCreated_t *pParam)
     m_lobby = pParam->m_ulSteamIDLobby;
 }
 
-CCoplayPendingConnection::CCoplayPendingConnection(HSteamNetConnection connection)
+CCoplayPendingConnection::CCoplayPendingConnection(HSteamNetConnection connection, bool bResumable)
 {
     m_hConnection = connection;
     m_startTime   = gpGlobals->realtime;
+    m_bResumable  = bResumable;
+    m_bValidTicket = false;
+    m_resumeSerial = 0;
 }
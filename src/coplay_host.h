@@ -16,10 +16,26 @@
 #include "steam/isteamnetworkingsockets.h"
 #include "steam/isteamnetworkingutils.h"
 #include "steam/isteammatchmaking.h"
+#include "SDL2/SDL_net.h"
+
+#include "tier0/valve_minmax_off.h"
+#include "coplay_ticket.h"
+#include "tier0/valve_minmax_on.h"
 
 class  CCoplayConnection;
 struct CCoplayPendingConnection;
 
+// What's left of a connection whose Steam side dropped, kept for coplay_resume_window seconds
+// so the player can come back to the same port with their ticket
+struct CoplayParkedSlot_t
+{
+	uint64    remoteID;
+	uint64    serial;
+	UDPsocket socket;
+	uint16    port;
+	float     expireTime;
+};
+
 class CCoplayHost
 {
 public:
@@ -38,11 +54,23 @@ public:
 
 	CSteamID GetLobby() { return m_lobby; }
 	int GetConnectionCount(){return m_connections.Count();}
+	CCoplayConnection* GetConnection(int index) { return m_connections[index]; }
+	int GetPendingConnectionCount() { return m_pendingConnections.Count(); }
+	int GetParkedSlotCount() { return m_parkedSlots.Count(); }
 
 private:
-	bool AddConnection(HSteamNetConnection hConnection);
-	void CreatePendingConnection(HSteamNetConnection hConnection);
+	void SetupConnection(HSteamNetConnection hConnection); // lets it straight in or waits on its passcode or ticket
+	bool AddConnection(HSteamNetConnection hConnection, int parkedSlot = -1); // parkedSlot is the session its resuming
+	void CreatePendingConnection(HSteamNetConnection hConnection, bool bResumable);
+	CoplayHandshakeState PollPendingConnection(CCoplayPendingConnection &pending); // lets it in or closes it once the passcode or ticket is here
 	void RemoveConnection(HSteamNetConnection hConnection, int reason, const char *pszDebug, bool bEnableLinger);
+	void ParkConnection(HSteamNetConnection hConnection, int reason, const char *pszDebug); // keeps the slot if theres a ticket out for it
+	bool PassesJoinFilter(CSteamID remote); // everything but the passcode
+	bool HasSession(uint64 remoteID); // parked or still running, either can be resumed
+	bool TakeOverSession(uint64 remoteID, uint64 serial); // parks a running session for its owner, its slot turns up once the thread's done
+	int  AddParkedSlot(CCoplayConnection *pConnection);
+	int  FindParkedSlot(uint64 remoteID);
+	void CloseParkedSlot(int index);
 
 private:
 #ifdef COPLAY_USE_LOBBIES
@@ -53,7 +81,10 @@ private:
 private:
 	HSteamListenSocket	m_hSocket;
 	CUtlVector<CCoplayConnection*> m_connections;
+	CUtlVector<HSteamNetConnection> m_newConnections; // connected on the callback thread, Update sets them up
 	CUtlVector<CCoplayPendingConnection> m_pendingConnections;
+	CUtlVector<CoplayParkedSlot_t> m_parkedSlots;
+	CCoplayTicketAuthority m_tickets;
 
 	CSteamID			m_lobby;
 	std::string			m_passcode;
@@ -61,9 +92,12 @@ private:
 
 struct CCoplayPendingConnection
 {
-	CCoplayPendingConnection(HSteamNetConnection connection);
+	CCoplayPendingConnection(HSteamNetConnection connection, bool bResumable = false);
 	HSteamNetConnection m_hConnection;
 	float m_startTime;
+	bool m_bResumable; // theres a parked slot for them, waiting on a ticket before anything else
+	bool m_bValidTicket; // and it's here, waiting on the session it names to be parked
+	uint64 m_resumeSerial;
 };
 
 #endif // COPLAY_HOST_H
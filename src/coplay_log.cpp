@@ -0,0 +1,132 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_log.h"
+#include "coplay_timer.h"
+#include <stdio.h>
+
+CCoplayLogRing::CCoplayLogRing()
+{
+    for (uint32_t i = 0; i < COPLAY_LOG_RING_SIZE; i++)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    m_enqueuePos.store(0, std::memory_order_relaxed);
+    m_dequeuePos = 0;
+
+    for (int i = 0; i < eCoplayLog_Count; i++)
+    {
+        m_types[i].windowStart.store(0, std::memory_order_relaxed);
+        m_types[i].count.store(0, std::memory_order_relaxed);
+        m_types[i].suppressed.store(0, std::memory_order_relaxed);
+    }
+    m_rateLimit.store(20, std::memory_order_relaxed);
+    m_overflowed.store(0, std::memory_order_relaxed);
+}
+
+bool CCoplayLogRing::AllowType(CoplayLogType type)
+{
+    int limit = m_rateLimit.load(std::memory_order_relaxed);
+    if (limit <= 0)
+        return true;
+
+    // a fixed one second window, when two threads roll it over at once a couple extra get through which is fine
+    TypeLimit_t &limiter = m_types[type];
+    int64_t second = CoplayTimeUsec() / 1000000;
+    int64_t windowStart = limiter.windowStart.load(std::memory_order_relaxed);
+    if (windowStart != second && limiter.windowStart.compare_exchange_strong(windowStart, second, std::memory_order_relaxed))
+        limiter.count.store(0, std::memory_order_relaxed);
+
+    if (limiter.count.fetch_add(1, std::memory_order_relaxed) >= (uint32_t)limit)
+    {
+        limiter.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool CCoplayLogRing::Push(CoplayLogType type, CoplayLogLevel level, const char *pszFormat, va_list args)
+{
+    if (!AllowType(type))
+        return false;
+
+    Slot_t  *pSlot;
+    uint32_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        pSlot = &m_slots[pos & (COPLAY_LOG_RING_SIZE - 1)];
+        uint32_t sequence = pSlot->sequence.load(std::memory_order_acquire);
+        int32_t  diff     = (int32_t)(sequence - pos);
+        if (diff == 0)
+        {
+            // slot is free for this lap, claim it
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            // the main thread hasn't got to this one yet, we're full
+            m_overflowed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    pSlot->record.type  = type;
+    pSlot->record.level = level;
+    vsnprintf(pSlot->record.text, sizeof(pSlot->record.text), pszFormat, args);
+
+    pSlot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool CCoplayLogRing::Pop(CoplayLogRecord_t *pRecord)
+{
+    Slot_t  *pSlot    = &m_slots[m_dequeuePos & (COPLAY_LOG_RING_SIZE - 1)];
+    uint32_t sequence = pSlot->sequence.load(std::memory_order_acquire);
+    if ((int32_t)(sequence - (m_dequeuePos + 1)) < 0)
+        return false; // empty, or the producer hasn't finished writing it
+
+    *pRecord = pSlot->record;
+    pSlot->sequence.store(m_dequeuePos + COPLAY_LOG_RING_SIZE, std::memory_order_release);
+    m_dequeuePos++;
+    return true;
+}
+
+CCoplayLogRing *CoplayLogRing()
+{
+    static CCoplayLogRing s_ring;
+    return &s_ring;
+}
+
+const char *CoplayLogTypeName(CoplayLogType type)
+{
+    switch (type)
+    {
+    case eCoplayLog_General:         return "general";
+    case eCoplayLog_Scream:          return "scream";
+    case eCoplayLog_SocketSpam:      return "socketspam";
+    case eCoplayLog_SocketCreation:  return "socketcreation";
+    case eCoplayLog_Handshake:       return "handshake";
+    case eCoplayLog_LocalError:      return "local socket error";
+    case eCoplayLog_LocalSendFailed: return "local send failed";
+    default:                         return "unknown";
+    }
+}
+
+void CoplayLog(CoplayLogType type, CoplayLogLevel level, const char *pszFormat, ...)
+{
+    va_list args;
+    va_start(args, pszFormat);
+    CoplayLogRing()->Push(type, level, pszFormat, args);
+    va_end(args);
+}
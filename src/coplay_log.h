@@ -0,0 +1,106 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Logging for the relay threads. Printing to the console from them is slow and takes engine locks,
+// so instead they drop records into a lock free ring that the main thread drains and prints once a frame.
+// Each type of message is rate limited on its own, so an error storm can't flood the ring or the console.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_LOG_H
+#define COPLAY_LOG_H
+#pragma once
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <atomic>
+
+#define COPLAY_LOG_RING_SIZE   256 // must be a power of 2
+#define COPLAY_LOG_MAX_TEXT    192
+
+enum CoplayLogType
+{
+    eCoplayLog_General = 0,
+    eCoplayLog_Scream,       // coplay_debuglog_scream
+    eCoplayLog_SocketSpam,   // coplay_debuglog_socketspam
+    eCoplayLog_SocketCreation,
+    eCoplayLog_Handshake,
+    eCoplayLog_LocalError,   // reading the game socket failed
+    eCoplayLog_LocalSendFailed,
+
+    eCoplayLog_Count
+};
+
+enum CoplayLogLevel
+{
+    eCoplayLogLevel_Plain = 0, // Msg
+    eCoplayLogLevel_Info,      // COPLAY_MSG_COLOR
+    eCoplayLogLevel_Debug,     // COPLAY_DEBUG_MSG_COLOR
+    eCoplayLogLevel_Warning,
+};
+
+struct CoplayLogRecord_t
+{
+    CoplayLogType  type;
+    CoplayLogLevel level;
+    char           text[COPLAY_LOG_MAX_TEXT];
+};
+
+// Bounded multi producer, single consumer queue, each slot carries a sequence number
+// so producers only ever contend on the enqueue position.
+class CCoplayLogRing
+{
+public:
+    CCoplayLogRing();
+
+    // Any thread. False if the type is over its limit or the ring is full, it gets counted either way
+    bool Push(CoplayLogType type, CoplayLogLevel level, const char *pszFormat, va_list args);
+
+    // Main thread only
+    bool Pop(CoplayLogRecord_t *pRecord);
+
+    // Per type, per second. 0 for no limit
+    void SetRateLimit(int messagesPerSecond) { m_rateLimit.store(messagesPerSecond, std::memory_order_relaxed); }
+
+    // How many were thrown away since the last call
+    uint32_t TakeSuppressed(CoplayLogType type) { return m_types[type].suppressed.exchange(0, std::memory_order_relaxed); }
+    uint32_t TakeOverflowed() { return m_overflowed.exchange(0, std::memory_order_relaxed); }
+
+private:
+    bool AllowType(CoplayLogType type);
+
+    struct Slot_t
+    {
+        std::atomic<uint32_t> sequence;
+        CoplayLogRecord_t     record;
+    };
+
+    struct TypeLimit_t
+    {
+        std::atomic<int64_t>  windowStart; // second the current count is for
+        std::atomic<uint32_t> count;
+        std::atomic<uint32_t> suppressed;
+    };
+
+    Slot_t                m_slots[COPLAY_LOG_RING_SIZE];
+    std::atomic<uint32_t> m_enqueuePos;
+    uint32_t              m_dequeuePos; // only the consumer touches this
+
+    TypeLimit_t           m_types[eCoplayLog_Count];
+    std::atomic<int>      m_rateLimit;
+    std::atomic<uint32_t> m_overflowed;
+};
+
+CCoplayLogRing *CoplayLogRing();
+const char     *CoplayLogTypeName(CoplayLogType type);
+
+// What the relay threads call, printf style
+void CoplayLog(CoplayLogType type, CoplayLogLevel level, const char *pszFormat, ...);
+
+#endif
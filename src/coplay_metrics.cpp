@@ -0,0 +1,529 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_metrics.h"
+#include "coplay_timer.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+#define CoplayCloseSocket closesocket
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#define CoplayCloseSocket close
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // only linux has it, the rest don't raise SIGPIPE on a send
+#endif
+
+#define METRICS_MAX_CLIENTS     4
+#define METRICS_MAX_REQUEST     4096
+#define METRICS_CLIENT_TIMEOUT  2000000 // usec
+
+// ================================================================================================
+//
+// Formatting
+//
+// ================================================================================================
+
+static void AppendF(std::string &out, const char *pszFormat, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, pszFormat);
+    int len = vsnprintf(buf, sizeof(buf), pszFormat, args);
+    va_end(args);
+    if (len > 0)
+        out.append(buf, len < (int)sizeof(buf) ? len : (int)sizeof(buf) - 1);
+}
+
+static void AppendFamily(std::string &out, const char *pszName, const char *pszType, const char *pszHelp)
+{
+    AppendF(out, "# HELP %s %s\n# TYPE %s %s\n", pszName, pszHelp, pszName, pszType);
+}
+
+std::string CoplayFormatMetrics(const CoplayMetrics_t &metrics)
+{
+    std::string out;
+    out.reserve(1024 + metrics.peers.size() * 1024);
+
+    AppendFamily(out, "coplay_connections", "gauge", "Relayed connections currently open.");
+    AppendF(out, "coplay_connections{role=\"%s\"} %d\n", metrics.pszRole, metrics.numConnections);
+
+    AppendFamily(out, "coplay_pending_handshakes", "gauge", "Steam connections waiting on a passcode before they're relayed.");
+    AppendF(out, "coplay_pending_handshakes{role=\"%s\"} %d\n", metrics.pszRole, metrics.numPendingHandshakes);
+
+    // direction is from the local game's point of view
+    AppendFamily(out, "coplay_packets_total", "counter", "Datagrams relayed.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_packets_total{role=\"%s\",peer=\"%llu\",direction=\"out\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.packetsOut);
+        AppendF(out, "coplay_packets_total{role=\"%s\",peer=\"%llu\",direction=\"in\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.packetsIn);
+    }
+
+    AppendFamily(out, "coplay_bytes_total", "counter", "Payload bytes relayed.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_bytes_total{role=\"%s\",peer=\"%llu\",direction=\"out\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.bytesOut);
+        AppendF(out, "coplay_bytes_total{role=\"%s\",peer=\"%llu\",direction=\"in\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.bytesIn);
+    }
+
+    AppendFamily(out, "coplay_dropped_packets_total", "counter", "Datagrams the relay couldn't pass on.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_dropped_packets_total{role=\"%s\",peer=\"%llu\",direction=\"out\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.peerSendFailed);
+        AppendF(out, "coplay_dropped_packets_total{role=\"%s\",peer=\"%llu\",direction=\"in\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.localSendFailed);
+    }
+
+    AppendFamily(out, "coplay_peer_dropped_packets_total", "counter", "Datagrams from the game that didn't go to the peer, by why.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        for (int reason = 0; reason < eCoplayDrop_Count; reason++)
+        {
+            AppendF(out, "coplay_peer_dropped_packets_total{role=\"%s\",peer=\"%llu\",reason=\"%s\"} %llu\n", metrics.pszRole,
+                    (unsigned long long)peer.steamID, CoplayDropReasonName((CoplayDropReason)reason),
+                    (unsigned long long)peer.stats.peerDropped[reason]);
+        }
+    }
+
+    AppendFamily(out, "coplay_stale_snapshots_shed_total", "counter", "Datagrams from the peer left out since a newer one came right behind them.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_stale_snapshots_shed_total{role=\"%s\",peer=\"%llu\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.staleShed);
+    }
+
+    AppendFamily(out, "coplay_fragments_total", "counter", "Pieces of datagrams too big for one of the peer's packets.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_fragments_total{role=\"%s\",peer=\"%llu\",direction=\"out\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.fragmentsOut);
+        AppendF(out, "coplay_fragments_total{role=\"%s\",peer=\"%llu\",direction=\"in\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.fragmentsIn);
+    }
+
+    AppendFamily(out, "coplay_fragmented_packets_total", "counter", "Datagrams that went in pieces, and from the peer that were put back together.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_fragmented_packets_total{role=\"%s\",peer=\"%llu\",direction=\"out\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.fragmentedOut);
+        AppendF(out, "coplay_fragmented_packets_total{role=\"%s\",peer=\"%llu\",direction=\"in\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.reassembledIn);
+    }
+
+    AppendFamily(out, "coplay_reassembly_failed_total", "counter", "Datagrams from the peer that never got all their pieces.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_reassembly_failed_total{role=\"%s\",peer=\"%llu\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.reassemblyFailed);
+    }
+
+    AppendFamily(out, "coplay_fec_parity_packets_total", "counter", "Parity packets sent so the peer can rebuild a datagram it lost.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_fec_parity_packets_total{role=\"%s\",peer=\"%llu\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.fecParityOut);
+    }
+
+    AppendFamily(out, "coplay_fec_overhead_bytes_total", "counter", "Bytes FEC added on top of the game's datagrams.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_fec_overhead_bytes_total{role=\"%s\",peer=\"%llu\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.fecOverheadBytes);
+    }
+
+    AppendFamily(out, "coplay_fec_recovered_total", "counter", "Datagrams from the peer that went missing and were rebuilt from a parity.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_fec_recovered_total{role=\"%s\",peer=\"%llu\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.fecRecovered);
+    }
+
+    AppendFamily(out, "coplay_fec_unrecovered_total", "counter", "Datagrams from the peer that went missing and couldn't be rebuilt.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_fec_unrecovered_total{role=\"%s\",peer=\"%llu\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.fecUnrecovered);
+    }
+
+    AppendFamily(out, "coplay_fec_group_size", "gauge", "Datagrams sent per parity packet, adapted to the loss the peer sees.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        if (peer.stats.fecGroupSize > 0)
+            AppendF(out, "coplay_fec_group_size{role=\"%s\",peer=\"%llu\"} %i\n", metrics.pszRole,
+                    (unsigned long long)peer.steamID, peer.stats.fecGroupSize);
+    }
+
+    AppendFamily(out, "coplay_redundant_copies_total", "counter", "Earlier usercmds sent again along with a new one.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_redundant_copies_total{role=\"%s\",peer=\"%llu\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.redundantCopiesOut);
+    }
+
+    AppendFamily(out, "coplay_redundancy_overhead_bytes_total", "counter", "Bytes the usercmd copies added.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_redundancy_overhead_bytes_total{role=\"%s\",peer=\"%llu\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.redundancyOverheadBytes);
+    }
+
+    AppendFamily(out, "coplay_redundancy_recovered_total", "counter", "Usercmds from the peer that went missing and were passed on from a copy.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_redundancy_recovered_total{role=\"%s\",peer=\"%llu\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.redundancyRecovered);
+    }
+
+    AppendFamily(out, "coplay_redundant_duplicates_total", "counter", "Copies of usercmds from the peer the game already had, left out.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_redundant_duplicates_total{role=\"%s\",peer=\"%llu\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.redundantDuplicates);
+    }
+
+    AppendFamily(out, "coplay_redundant_copies", "gauge", "Copies of earlier usercmds going with each one, adapted to the loss the peer sees.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_redundant_copies{role=\"%s\",peer=\"%llu\"} %i\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, peer.stats.redundantCopies);
+    }
+
+    AppendFamily(out, "coplay_local_socket_errors_total", "counter", "Errors reading the local game socket.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        AppendF(out, "coplay_local_socket_errors_total{role=\"%s\",peer=\"%llu\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.localErrors);
+    }
+
+    AppendFamily(out, "coplay_steam_ping_seconds", "gauge", "Round trip time Steam measured to the peer.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        if (peer.hasSteamStatus)
+            AppendF(out, "coplay_steam_ping_seconds{role=\"%s\",peer=\"%llu\"} %.3f\n", metrics.pszRole,
+                    (unsigned long long)peer.steamID, peer.pingMs / 1000.0);
+    }
+
+    AppendFamily(out, "coplay_steam_quality_ratio", "gauge", "Fraction of packets Steam says are arriving, 0 to 1.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        if (!peer.hasSteamStatus)
+            continue;
+        // Steam uses a negative quality when it doesn't know yet
+        if (peer.qualityLocal >= 0)
+            AppendF(out, "coplay_steam_quality_ratio{role=\"%s\",peer=\"%llu\",side=\"local\"} %.4f\n", metrics.pszRole,
+                    (unsigned long long)peer.steamID, peer.qualityLocal);
+        if (peer.qualityRemote >= 0)
+            AppendF(out, "coplay_steam_quality_ratio{role=\"%s\",peer=\"%llu\",side=\"remote\"} %.4f\n", metrics.pszRole,
+                    (unsigned long long)peer.steamID, peer.qualityRemote);
+    }
+
+    AppendFamily(out, "coplay_steam_pending_bytes", "gauge", "Bytes waiting in Steam to go to the peer.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        if (!peer.hasSteamStatus)
+            continue;
+        AppendF(out, "coplay_steam_pending_bytes{role=\"%s\",peer=\"%llu\",kind=\"unreliable\"} %d\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, peer.pendingUnreliableBytes);
+        AppendF(out, "coplay_steam_pending_bytes{role=\"%s\",peer=\"%llu\",kind=\"reliable\"} %d\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, peer.pendingReliableBytes);
+    }
+
+    AppendFamily(out, "coplay_steam_queue_seconds", "gauge", "How long Steam says something sent to the peer now would wait to go out.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        if (peer.hasSteamStatus)
+            AppendF(out, "coplay_steam_queue_seconds{role=\"%s\",peer=\"%llu\"} %.6f\n", metrics.pszRole,
+                    (unsigned long long)peer.steamID, peer.queueTimeUsec / 1000000.0);
+    }
+
+    // The time between relay loops that had something to move, the most a datagram can have waited on us
+    static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+    AppendFamily(out, "coplay_relay_latency_seconds", "summary", "Time a datagram may have waited in the relay.");
+    for (size_t i = 0; i < metrics.peers.size(); i++)
+    {
+        const CoplayMetricsPeer_t &peer = metrics.peers[i];
+        for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); q++)
+        {
+            AppendF(out, "coplay_relay_latency_seconds{role=\"%s\",peer=\"%llu\",quantile=\"%g\"} %.6f\n", metrics.pszRole,
+                    (unsigned long long)peer.steamID, quantiles[q], peer.stats.LatencyPercentileUsec(quantiles[q] * 100) / 1000000.0);
+        }
+        AppendF(out, "coplay_relay_latency_seconds_sum{role=\"%s\",peer=\"%llu\"} %.6f\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, peer.stats.latencySumUsec / 1000000.0);
+        AppendF(out, "coplay_relay_latency_seconds_count{role=\"%s\",peer=\"%llu\"} %llu\n", metrics.pszRole,
+                (unsigned long long)peer.steamID, (unsigned long long)peer.stats.latencyCount);
+    }
+
+    if (metrics.numProfiledFrames > 0)
+    {
+        AppendFamily(out, "coplay_frame_stage_avg_seconds", "gauge", "Average main thread time spent in each stage of a frame, over the last few hundred frames.");
+        for (int i = 0; i < eCoplayStage_Count; i++)
+        {
+            AppendF(out, "coplay_frame_stage_avg_seconds{role=\"%s\",stage=\"%s\"} %.6f\n", metrics.pszRole,
+                    CoplayFrameStageName((CoplayFrameStage)i), metrics.frameStages[i].avgUsec / 1000000.0);
+        }
+
+        AppendFamily(out, "coplay_frame_stage_max_seconds", "gauge", "Most main thread time one frame spent in each stage, over the same frames.");
+        for (int i = 0; i < eCoplayStage_Count; i++)
+        {
+            AppendF(out, "coplay_frame_stage_max_seconds{role=\"%s\",stage=\"%s\"} %.6f\n", metrics.pszRole,
+                    CoplayFrameStageName((CoplayFrameStage)i), metrics.frameStages[i].maxUsec / 1000000.0);
+        }
+    }
+
+    return out;
+}
+
+bool CoplayWriteMetricsFile(const char *pszPath, const std::string &text)
+{
+    std::string tempPath = std::string(pszPath) + ".tmp";
+    FILE *pFile = fopen(tempPath.c_str(), "wb");
+    if (!pFile)
+        return false;
+
+    bool ok = fwrite(text.data(), 1, text.size(), pFile) == text.size();
+    ok = fclose(pFile) == 0 && ok;
+    if (!ok)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    // rename won't replace on windows
+    remove(pszPath);
+#endif
+    return rename(tempPath.c_str(), pszPath) == 0;
+}
+
+// ================================================================================================
+//
+// HTTP listener
+//
+// ================================================================================================
+
+static bool SetNonBlocking(CoplaySocket_t sock)
+{
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    return ioctlsocket((SOCKET)sock, FIONBIO, &nonBlocking) == 0;
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    return flags != -1 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+static bool WouldBlock()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EWOULDBLOCK || errno == EAGAIN || errno == EINTR;
+#endif
+}
+
+CCoplayMetricsServer::CCoplayMetricsServer() : m_listenSocket(COPLAY_INVALID_SOCKET), m_port(0)
+{
+}
+
+CCoplayMetricsServer::~CCoplayMetricsServer()
+{
+    Close();
+}
+
+bool CCoplayMetricsServer::Open(uint16_t port)
+{
+    Close();
+
+    CoplaySocket_t sock = (CoplaySocket_t)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock == COPLAY_INVALID_SOCKET)
+        return false;
+
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    sockaddr_in addr = {};
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(sock, METRICS_MAX_CLIENTS) != 0 || !SetNonBlocking(sock))
+    {
+        CoplayCloseSocket(sock);
+        return false;
+    }
+
+    m_listenSocket = sock;
+    m_port         = port;
+    return true;
+}
+
+void CCoplayMetricsServer::Close()
+{
+    while (!m_clients.empty())
+        CloseClient((int)m_clients.size() - 1);
+
+    if (m_listenSocket != COPLAY_INVALID_SOCKET)
+    {
+        CoplayCloseSocket(m_listenSocket);
+        m_listenSocket = COPLAY_INVALID_SOCKET;
+    }
+    m_port = 0;
+}
+
+void CCoplayMetricsServer::CloseClient(int index)
+{
+    CoplayCloseSocket(m_clients[index].socket);
+    m_clients.erase(m_clients.begin() + index);
+}
+
+bool CCoplayMetricsServer::Poll()
+{
+    if (!IsOpen())
+        return false;
+
+    int64_t now = CoplayTimeUsec();
+    while (m_clients.size() < METRICS_MAX_CLIENTS)
+    {
+        CoplaySocket_t sock = (CoplaySocket_t)accept(m_listenSocket, NULL, NULL);
+        if (sock == COPLAY_INVALID_SOCKET)
+            break;
+        if (!SetNonBlocking(sock))
+        {
+            CoplayCloseSocket(sock);
+            continue;
+        }
+
+        Client_t client;
+        client.socket   = sock;
+        client.deadline = now + METRICS_CLIENT_TIMEOUT;
+        client.sent     = 0;
+        client.waiting  = false;
+        m_clients.push_back(client);
+    }
+
+    bool anyWaiting = false;
+    for (int i = (int)m_clients.size() - 1; i >= 0; i--)
+    {
+        Client_t &client = m_clients[i];
+        if (now > client.deadline)
+        {
+            CloseClient(i);
+            continue;
+        }
+
+        // still reading the request
+        if (client.response.empty() && !client.waiting)
+        {
+            char buf[1024];
+            int numRecv = recv(client.socket, buf, sizeof(buf), 0);
+            if (numRecv == 0 || (numRecv < 0 && !WouldBlock()))
+            {
+                CloseClient(i);
+                continue;
+            }
+            if (numRecv > 0)
+                client.request.append(buf, numRecv);
+
+            if (client.request.find("\r\n\r\n") == std::string::npos && client.request.find("\n\n") == std::string::npos)
+            {
+                if (client.request.size() > METRICS_MAX_REQUEST)
+                    CloseClient(i);
+                continue;
+            }
+
+            if (client.request.compare(0, 13, "GET /metrics ") == 0 || client.request.compare(0, 6, "GET / ") == 0)
+            {
+                client.waiting = true;
+            }
+            else
+            {
+                client.response = "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: 10\r\nConnection: close\r\n\r\nnot found\n";
+            }
+        }
+
+        if (client.waiting)
+        {
+            anyWaiting = true;
+            continue;
+        }
+
+        // writing the response
+        while (client.sent < client.response.size())
+        {
+            int numSent = send(client.socket, client.response.data() + client.sent, (int)(client.response.size() - client.sent), MSG_NOSIGNAL);
+            if (numSent <= 0)
+                break;
+            client.sent += numSent;
+        }
+        if (client.sent >= client.response.size())
+            CloseClient(i);
+    }
+
+    return anyWaiting;
+}
+
+void CCoplayMetricsServer::Respond(const std::string &text)
+{
+    char header[192];
+    snprintf(header, sizeof(header),
+             "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+             (unsigned)text.size());
+
+    for (size_t i = 0; i < m_clients.size(); i++)
+    {
+        Client_t &client = m_clients[i];
+        if (!client.waiting)
+            continue;
+        client.response = header + text;
+        client.waiting  = false;
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Relay statistics in the Prometheus text format, either written out to a file
+// or served to whoever asks over a loopback only HTTP listener.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_METRICS_H
+#define COPLAY_METRICS_H
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "coplay_stats.h"
+#include "coplay_frameprofile.h"
+
+// plain OS sockets, SDL_net can't listen on a specific address
+#ifdef _WIN32
+typedef uintptr_t CoplaySocket_t; // SOCKET, without dragging winsock into every includer
+#define COPLAY_INVALID_SOCKET (~(CoplaySocket_t)0)
+#else
+typedef int CoplaySocket_t;
+#define COPLAY_INVALID_SOCKET (-1)
+#endif
+
+// One relayed connection as it'll appear in the labels
+struct CoplayMetricsPeer_t
+{
+    uint64_t                   steamID;
+    CoplayRelayStatsSnapshot_t stats;
+
+    bool  hasSteamStatus; // false if Steam couldn't tell us about the connection
+    int   pingMs;
+    float qualityLocal;  // 0-1, fraction of packets delivered to us
+    float qualityRemote; // as reported by the remote end
+
+    int     pendingUnreliableBytes; // waiting in Steam to go to the peer
+    int     pendingReliableBytes;
+    int64_t queueTimeUsec;          // how long something sent now would wait in there
+};
+
+struct CoplayMetrics_t
+{
+    const char *pszRole; // "host", "client" or "inactive"
+    int         numConnections;
+    int         numPendingHandshakes;
+    std::vector<CoplayMetricsPeer_t> peers;
+
+    // Main thread cost of each stage of CCoplaySystem::Update, left out if numProfiledFrames is 0
+    int                      numProfiledFrames = 0;
+    CoplayFrameStageTiming_t frameStages[eCoplayStage_Count];
+};
+
+// Every stat is its own metric family, with a sample per peer
+std::string CoplayFormatMetrics(const CoplayMetrics_t &metrics);
+
+// Writes next to the destination and renames over it so readers never see half a file
+bool CoplayWriteMetricsFile(const char *pszPath, const std::string &text);
+
+// Minimal HTTP/1.0 listener, answers GET /metrics and nothing else.
+// Everything is non blocking and done in Poll, meant to be called once a frame from the main thread.
+class CCoplayMetricsServer
+{
+public:
+    CCoplayMetricsServer();
+    ~CCoplayMetricsServer();
+
+    // Only ever binds 127.0.0.1
+    bool Open(uint16_t port);
+    void Close();
+    bool IsOpen() const { return m_listenSocket != COPLAY_INVALID_SOCKET; }
+    uint16_t GetPort() const { return m_port; }
+
+    // Accepts, reads requests and flushes responses. True if someone is waiting on a call to Respond
+    bool Poll();
+
+    // Answer everyone Poll found waiting
+    void Respond(const std::string &text);
+
+private:
+    struct Client_t
+    {
+        CoplaySocket_t socket;
+        int64_t        deadline;
+        std::string    request;
+        std::string    response;
+        size_t         sent;
+        bool           waiting; // has a full request and no response yet
+    };
+
+    void CloseClient(int index);
+
+    CoplaySocket_t        m_listenSocket;
+    uint16_t              m_port;
+    std::vector<Client_t> m_clients;
+};
+
+#endif
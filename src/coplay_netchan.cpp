@@ -0,0 +1,59 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_netchan.h"
+
+// bf_write puts everything down little endian, whatever we're running on
+static int32_t ReadLittleLong(const uint8_t *pData)
+{
+    return (int32_t)((uint32_t)pData[0] | ((uint32_t)pData[1] << 8) | ((uint32_t)pData[2] << 16) | ((uint32_t)pData[3] << 24));
+}
+
+bool CoplayReadNetchanHeader(const uint8_t *pData, int len, CoplayNetchanHeader_t *pHeader)
+{
+    if (len < COPLAY_NETCHAN_HEADER_SIZE)
+        return false;
+
+    int32_t sequence = ReadLittleLong(pData);
+    if (sequence < 0)
+        return false;
+
+    pHeader->sequence    = sequence;
+    pHeader->sequenceAck = ReadLittleLong(pData + 4);
+    pHeader->flags       = pData[8];
+    return true;
+}
+
+bool CoplayIsConnectionless(const uint8_t *pData, int len)
+{
+    return len >= 4 && ReadLittleLong(pData) == COPLAY_NET_HEADER_CONNECTIONLESS;
+}
+
+CoplayTrafficClass CoplayClassifyDatagram(const uint8_t *pData, int len)
+{
+    if (len < 4)
+        return eCoplayTraffic_Realtime;
+
+    CoplayNetchanHeader_t header;
+    if (CoplayReadNetchanHeader(pData, len, &header))
+        return header.flags & COPLAY_PACKET_FLAG_RELIABLE ? eCoplayTraffic_Reliable : eCoplayTraffic_Realtime;
+
+    switch (ReadLittleLong(pData))
+    {
+    case COPLAY_NET_HEADER_CONNECTIONLESS:
+        return eCoplayTraffic_Reliable;
+    case COPLAY_NET_HEADER_SPLIT:
+    case COPLAY_NET_HEADER_COMPRESSED:
+        return eCoplayTraffic_Bulk;
+    default:
+        return eCoplayTraffic_Realtime;
+    }
+}
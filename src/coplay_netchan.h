@@ -0,0 +1,61 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Peeks at the header CNetChan puts on every datagram, so the relay can tell what the game is sending
+// without the engine or decoding any of the messages inside.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_NETCHAN_H
+#define COPLAY_NETCHAN_H
+#pragma once
+
+#include <stdint.h>
+
+// What can be in place of a sequence number, same as the engine's net_ws.cpp
+#define COPLAY_NET_HEADER_CONNECTIONLESS -1
+#define COPLAY_NET_HEADER_SPLIT          -2
+#define COPLAY_NET_HEADER_COMPRESSED     -3
+
+// Same as netchan.cpp
+#define COPLAY_PACKET_FLAG_RELIABLE   (1<<0)
+#define COPLAY_PACKET_FLAG_COMPRESSED (1<<1)
+#define COPLAY_PACKET_FLAG_ENCRYPTED  (1<<2)
+#define COPLAY_PACKET_FLAG_SPLIT      (1<<3)
+#define COPLAY_PACKET_FLAG_CHOKED     (1<<4)
+#define COPLAY_PACKET_FLAG_CHALLENGE  (1<<5)
+
+#define COPLAY_NETCHAN_HEADER_SIZE 9 // sequence, ack, flags. The checksum and everything after it is bits
+
+struct CoplayNetchanHeader_t
+{
+    int32_t sequence;
+    int32_t sequenceAck;
+    uint8_t flags;
+};
+
+// False for anything without a sequence number, connectionless, split and compressed datagrams included
+bool CoplayReadNetchanHeader(const uint8_t *pData, int len, CoplayNetchanHeader_t *pHeader);
+
+// Challenges, connects and the rest of what goes on before there's a netchannel, or while a new one's being set up
+bool CoplayIsConnectionless(const uint8_t *pData, int len);
+
+// What a datagram is carrying, as far as the header can tell. Voice can't be told apart,
+// it goes out in the same datagrams as the snapshots
+enum CoplayTrafficClass
+{
+    eCoplayTraffic_Realtime = 0, // plain snapshots and usercmds
+    eCoplayTraffic_Reliable,     // has part of the reliable stream in it, signon and stringtables mostly. Connectionless too
+    eCoplayTraffic_Bulk,         // a piece of something too big for one datagram
+    eCoplayTraffic_Count
+};
+
+CoplayTrafficClass CoplayClassifyDatagram(const uint8_t *pData, int len);
+
+#endif
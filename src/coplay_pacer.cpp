@@ -0,0 +1,46 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_pacer.h"
+
+void CCoplayRelayPacer::Init(int64_t maxSpinUsec)
+{
+    m_maxSpin    = maxSpinUsec > 0 ? maxSpinUsec : 0;
+    m_minSpin    = m_maxSpin / COPLAY_PACER_MIN_SPIN_DIVISOR;
+    m_spinWindow = m_minSpin;
+    m_spinUntil  = 0;
+}
+
+void CCoplayRelayPacer::OnPump(int64_t now, bool bTraffic)
+{
+    if (m_maxSpin == 0)
+        return;
+
+    if (bTraffic)
+    {
+        // caught something we'd have slept through otherwise
+        if (ShouldSpin(now))
+        {
+            m_spinWindow *= 2;
+            if (m_spinWindow > m_maxSpin)
+                m_spinWindow = m_maxSpin;
+        }
+        m_spinUntil = now + m_spinWindow;
+    }
+    else if (m_spinUntil != 0 && !ShouldSpin(now))
+    {
+        // spun for nothing
+        m_spinWindow /= 2;
+        if (m_spinWindow < m_minSpin)
+            m_spinWindow = m_minSpin;
+        m_spinUntil = 0;
+    }
+}
@@ -0,0 +1,48 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Decides what a relay loop does between pumps. Once something moves it keeps pumping flat out for a while,
+// since more usually follows close behind, and parks once it goes quiet. How long it spins adapts to the traffic:
+// the window doubles every time spinning catches something and halves every time it runs out with nothing.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_PACER_H
+#define COPLAY_PACER_H
+#pragma once
+
+#include <stdint.h>
+
+// the window never shrinks below this fraction of the max, so it can grow back quickly
+#define COPLAY_PACER_MIN_SPIN_DIVISOR 16
+
+class CCoplayRelayPacer
+{
+public:
+    CCoplayRelayPacer() { Init(0); }
+
+    // maxSpinUsec 0 never spins, every pump is followed by a park
+    void Init(int64_t maxSpinUsec);
+
+    // After every pump
+    void OnPump(int64_t now, bool bTraffic);
+
+    // True to pump again straight away, false to park
+    bool ShouldSpin(int64_t now) const { return now < m_spinUntil; }
+
+    int64_t GetSpinWindow() const { return m_spinWindow; }
+
+private:
+    int64_t m_minSpin;
+    int64_t m_maxSpin;
+    int64_t m_spinWindow;
+    int64_t m_spinUntil; // 0 when we're not spinning
+};
+
+#endif
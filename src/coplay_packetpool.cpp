@@ -0,0 +1,101 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_packetpool.h"
+#include <stddef.h>
+
+CCoplayPacketPool::CCoplayPacketPool() : m_freeHead(0), m_numSlabs(0), m_numInUse(0)
+{
+    for (int i = 0; i < COPLAY_POOL_MAX_SLABS; i++)
+        m_slabs[i].store(NULL, std::memory_order_relaxed);
+}
+
+CCoplayPacketPool::~CCoplayPacketPool()
+{
+    for (int i = 0; i < COPLAY_POOL_MAX_SLABS; i++)
+        delete[] m_slabs[i].load(std::memory_order_relaxed);
+}
+
+uint8_t *CCoplayPacketPool::Alloc()
+{
+    uint64_t head = m_freeHead.load(std::memory_order_acquire);
+    for (;;)
+    {
+        uint32_t first = (uint32_t)head;
+        if (first == 0)
+        {
+            if (!Grow())
+                return NULL;
+            head = m_freeHead.load(std::memory_order_acquire);
+            continue;
+        }
+
+        // might already belong to someone else by now, the count in the head catches that
+        Buffer_t *pBuffer = GetBuffer(first - 1);
+        uint64_t  newHead = (((head >> 32) + 1) << 32) | pBuffer->next.load(std::memory_order_relaxed);
+        if (m_freeHead.compare_exchange_weak(head, newHead, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            m_numInUse.fetch_add(1, std::memory_order_relaxed);
+            return pBuffer->data;
+        }
+    }
+}
+
+void CCoplayPacketPool::Free(void *pData)
+{
+    if (!pData)
+        return;
+
+    Buffer_t *pBuffer = (Buffer_t*)((uint8_t*)pData - offsetof(Buffer_t, data));
+    m_numInUse.fetch_sub(1, std::memory_order_relaxed);
+    Push(pBuffer);
+}
+
+void CCoplayPacketPool::Push(Buffer_t *pBuffer)
+{
+    uint64_t head = m_freeHead.load(std::memory_order_relaxed);
+    uint64_t newHead;
+    do
+    {
+        pBuffer->next.store((uint32_t)head, std::memory_order_relaxed);
+        newHead = (((head >> 32) + 1) << 32) | (pBuffer->index + 1);
+    } while (!m_freeHead.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed));
+}
+
+bool CCoplayPacketPool::Grow()
+{
+    std::lock_guard<std::mutex> lock(m_growLock);
+
+    // someone else grew it or gave some back while we waited
+    if ((uint32_t)m_freeHead.load(std::memory_order_acquire) != 0)
+        return true;
+
+    int slab = m_numSlabs.load(std::memory_order_relaxed);
+    if (slab == COPLAY_POOL_MAX_SLABS)
+        return false;
+
+    Buffer_t *pSlab = new Buffer_t[COPLAY_POOL_SLAB_BUFFERS];
+    for (int i = 0; i < COPLAY_POOL_SLAB_BUFFERS; i++)
+        pSlab[i].index = slab * COPLAY_POOL_SLAB_BUFFERS + i;
+    m_slabs[slab].store(pSlab, std::memory_order_release);
+    m_numSlabs.store(slab + 1, std::memory_order_relaxed);
+
+    for (int i = COPLAY_POOL_SLAB_BUFFERS - 1; i >= 0; i--)
+        Push(&pSlab[i]);
+    return true;
+}
+
+CCoplayPacketPool *CoplayPacketPool()
+{
+    // never destroyed, Steam can still be handing buffers back as the process exits
+    static CCoplayPacketPool *s_pPool = new CCoplayPacketPool();
+    return s_pPool;
+}
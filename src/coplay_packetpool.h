@@ -0,0 +1,68 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Datagram sized buffers shared by every relay in the process. The game's packets are read straight into one
+// and the same buffer is what the transport sends, so after warming up nothing is allocated or copied per packet.
+// Buffers come in slabs that are kept till the process exits, taking and giving back is lock free from any thread.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_PACKETPOOL_H
+#define COPLAY_PACKETPOOL_H
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+// biggest datagram a buffer holds, net_maxroutable can't go over 1260 so this leaves room for the tools
+#define COPLAY_POOL_BUFFER_SIZE  2048
+#define COPLAY_POOL_SLAB_BUFFERS 64
+#define COPLAY_POOL_MAX_SLABS    128 // 16MB worth, anything past that and the relays fall back to copying
+
+class CCoplayPacketPool
+{
+public:
+    CCoplayPacketPool();
+    ~CCoplayPacketPool();
+
+    // COPLAY_POOL_BUFFER_SIZE bytes, NULL once every slab is out
+    uint8_t *Alloc();
+    void     Free(void *pBuffer);
+
+    int GetNumSlabs() const { return m_numSlabs.load(std::memory_order_relaxed); }
+    int GetNumInUse() const { return m_numInUse.load(std::memory_order_relaxed); }
+
+private:
+    struct Buffer_t
+    {
+        std::atomic<uint32_t> next; // index + 1 of the next free buffer, 0 at the end of the list
+        uint32_t              index;
+        uint8_t               data[COPLAY_POOL_BUFFER_SIZE];
+    };
+
+    Buffer_t *GetBuffer(uint32_t index) const
+    {
+        return &m_slabs[index / COPLAY_POOL_SLAB_BUFFERS].load(std::memory_order_acquire)[index % COPLAY_POOL_SLAB_BUFFERS];
+    }
+    void Push(Buffer_t *pBuffer);
+    bool Grow();
+
+    // Low half is the index + 1 of the first free buffer, high half counts every change so a thread that
+    // read the head before someone else popped and pushed it back can't swap in its stale next
+    std::atomic<uint64_t>  m_freeHead;
+    std::atomic<Buffer_t*> m_slabs[COPLAY_POOL_MAX_SLABS];
+    std::atomic<int>       m_numSlabs;
+    std::atomic<int>       m_numInUse;
+    std::mutex             m_growLock;
+};
+
+CCoplayPacketPool *CoplayPacketPool();
+
+#endif
@@ -0,0 +1,31 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_ports.h"
+#include "coplay_log.h"
+
+UDPsocket CoplayOpenSocketInRange(int begin, int end, uint16_t *pPort)
+{
+    // TODO - Do all ports need to be opened?
+    for (int port = begin; port < end && port <= 0xFFFF; port++)
+    {
+        UDPsocket sock = SDLNet_UDP_Open((uint16_t)port);
+        if (!sock)
+        {
+            CoplayLog(eCoplayLog_SocketCreation, eCoplayLogLevel_Debug, "[Coplay Debug] Couldn't bind to port %u\n", port);
+            continue;
+        }
+
+        *pPort = (uint16_t)port;
+        return sock;
+    }
+    return NULL;
+}
@@ -0,0 +1,24 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Finding a local port for each connection's socket within coplay_portrange_begin/end.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_PORTS_H
+#define COPLAY_PORTS_H
+#pragma once
+
+#include "SDL2/SDL_net.h"
+#include <stdint.h>
+
+// Opens a UDP socket on the first free port in [begin, end), NULL if none are free
+UDPsocket CoplayOpenSocketInRange(int begin, int end, uint16_t *pPort);
+
+#endif
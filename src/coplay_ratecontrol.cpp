@@ -0,0 +1,101 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_ratecontrol.h"
+
+static const char *s_problemNames[eCoplayLink_Count] = { "ok", "loss", "ping", "backlog", "dropped" };
+
+const char *CoplayLinkProblemName(CoplayLinkProblem problem)
+{
+    if (problem < 0 || problem >= eCoplayLink_Count)
+        return "unknown";
+    return s_problemNames[problem];
+}
+
+static int Clamp(int value, int min, int max)
+{
+    if (value < min)
+        value = min;
+    return value > max ? max : value;
+}
+
+void CCoplayRateController::Reset(int rate, int updateRate)
+{
+    m_rate       = rate;
+    m_updateRate = updateRate;
+    m_numBad     = 0;
+    m_numGood    = 0;
+    m_basePingMs = -1;
+    m_problem    = eCoplayLink_OK;
+}
+
+CoplayLinkProblem CCoplayRateController::Diagnose(const CoplayLinkSample_t &sample)
+{
+    if (sample.pingMs >= 0)
+    {
+        if (m_basePingMs < 0 || sample.pingMs < m_basePingMs)
+            m_basePingMs = sample.pingMs;
+        else
+            m_basePingMs++;
+    }
+
+    // Steam's quality covers both ways, it's the host's snapshots coming to us that rate limits but a path
+    // dropping our usercmds is just as full
+    if ((sample.qualityLocal >= 0 && sample.qualityLocal < COPLAY_RATECONTROL_MIN_QUALITY) ||
+        (sample.qualityRemote >= 0 && sample.qualityRemote < COPLAY_RATECONTROL_MIN_QUALITY))
+        return eCoplayLink_Loss;
+    if (sample.queueTimeUsec > COPLAY_RATECONTROL_MAX_QUEUE_USEC || sample.pendingBytes > COPLAY_RATECONTROL_MAX_PENDING)
+        return eCoplayLink_Backlog;
+    if (sample.packets > 0 && sample.dropped > sample.packets * COPLAY_RATECONTROL_MAX_DROPPED)
+        return eCoplayLink_Dropped;
+    if (m_basePingMs >= 0 && sample.pingMs > m_basePingMs + COPLAY_RATECONTROL_PING_RISE_MS)
+        return eCoplayLink_Ping;
+    return eCoplayLink_OK;
+}
+
+bool CCoplayRateController::OnSample(const CoplayLinkSample_t &sample, const CoplayRateLimits_t &limits)
+{
+    int rate       = m_rate;
+    int updateRate = m_updateRate;
+
+    m_problem = Diagnose(sample);
+    if (m_problem != eCoplayLink_OK)
+    {
+        m_numGood = 0;
+        if (++m_numBad >= COPLAY_RATECONTROL_BAD_SAMPLES)
+        {
+            // the next step down waits for another run of bad ones, the last one needs time to show
+            m_numBad   = 0;
+            rate       = (int)(rate * COPLAY_RATECONTROL_DECREASE);
+            updateRate = (int)(updateRate * COPLAY_RATECONTROL_DECREASE);
+        }
+    }
+    else
+    {
+        m_numBad = 0;
+        if (++m_numGood >= COPLAY_RATECONTROL_GOOD_SAMPLES)
+        {
+            // up a step at a time, every sample while it stays good
+            rate       += (int)((limits.maxRate - limits.minRate) * COPLAY_RATECONTROL_INCREASE) + 1;
+            updateRate += (int)((limits.maxUpdateRate - limits.minUpdateRate) * COPLAY_RATECONTROL_INCREASE) + 1;
+        }
+    }
+
+    // the limits can move under us too
+    rate       = Clamp(rate, limits.minRate, limits.maxRate);
+    updateRate = Clamp(updateRate, limits.minUpdateRate, limits.maxUpdateRate);
+    if (rate == m_rate && updateRate == m_updateRate)
+        return false;
+
+    m_rate       = rate;
+    m_updateRate = updateRate;
+    return true;
+}
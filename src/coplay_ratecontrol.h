@@ -0,0 +1,90 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Turns a client's rate and cl_updaterate down while the path to the host can't carry them, and back up once it can.
+// Each sample is a while of what Steam and the relay saw. Going down takes a couple of bad samples in a row and
+// going up takes a run of good ones, so one lost burst doesn't have it swinging back and forth.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_RATECONTROL_H
+#define COPLAY_RATECONTROL_H
+#pragma once
+
+#include <stdint.h>
+
+#define COPLAY_RATECONTROL_BAD_SAMPLES    2
+#define COPLAY_RATECONTROL_GOOD_SAMPLES   5
+#define COPLAY_RATECONTROL_DECREASE       0.75 // of what it's at now
+#define COPLAY_RATECONTROL_INCREASE       0.1  // of the range between the limits
+#define COPLAY_RATECONTROL_MIN_QUALITY    0.97 // Steam's connection quality, the fraction of packets that made it
+#define COPLAY_RATECONTROL_PING_RISE_MS   50   // over the lowest ping we've seen, it's queueing somewhere on the way
+#define COPLAY_RATECONTROL_MAX_QUEUE_USEC 50000
+#define COPLAY_RATECONTROL_MAX_PENDING    (16 * 1024) // usercmds are small, this much waiting to go means the path's full
+#define COPLAY_RATECONTROL_MAX_DROPPED    0.02 // of what the relay moved
+
+enum CoplayLinkProblem
+{
+    eCoplayLink_OK = 0,
+    eCoplayLink_Loss,    // Steam says packets aren't making it, either way
+    eCoplayLink_Ping,
+    eCoplayLink_Backlog, // what we send is waiting on Steam
+    eCoplayLink_Dropped, // the relay left things out or never got all of them
+    eCoplayLink_Count
+};
+
+const char *CoplayLinkProblemName(CoplayLinkProblem problem);
+
+struct CoplayLinkSample_t
+{
+    int     pingMs;
+    float   qualityLocal;  // negative if Steam doesn't know yet
+    float   qualityRemote;
+    int     pendingBytes;
+    int64_t queueTimeUsec;
+    uint64_t packets; // the relay moved both ways since the last sample
+    uint64_t dropped; // of those, shed, stale, lost in pieces or refused by Steam
+};
+
+struct CoplayRateLimits_t
+{
+    int minRate; // a min over the max is taken as the max
+    int maxRate; // what the player had it at themselves
+    int minUpdateRate;
+    int maxUpdateRate;
+};
+
+class CCoplayRateController
+{
+public:
+    CCoplayRateController() { Reset(0, 0); }
+
+    // Starts from where the game's at now
+    void Reset(int rate, int updateRate);
+
+    // True if the rate or update rate it wants has changed
+    bool OnSample(const CoplayLinkSample_t &sample, const CoplayRateLimits_t &limits);
+
+    int GetRate() const { return m_rate; }
+    int GetUpdateRate() const { return m_updateRate; }
+    // Why the last sample was bad, OK if it wasn't
+    CoplayLinkProblem GetProblem() const { return m_problem; }
+
+private:
+    CoplayLinkProblem Diagnose(const CoplayLinkSample_t &sample);
+
+    int m_rate;
+    int m_updateRate;
+    int m_numBad;
+    int m_numGood;
+    int m_basePingMs; // creeps up a little each sample, a route that got slower for good stops looking like queueing
+    CoplayLinkProblem m_problem;
+};
+
+#endif
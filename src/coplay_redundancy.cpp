@@ -0,0 +1,184 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_redundancy.h"
+#include "coplay_netchan.h"
+#include <math.h>
+#include <string.h>
+
+static void WriteLittleShort(uint8_t *pOut, uint16_t value)
+{
+    pOut[0] = (uint8_t)value;
+    pOut[1] = (uint8_t)(value >> 8);
+}
+
+static uint16_t ReadLittleShort(const uint8_t *pData)
+{
+    return (uint16_t)(pData[0] | (pData[1] << 8));
+}
+
+int CoplayRedundantCopies(double loss, int maxCopies)
+{
+    if (maxCopies > COPLAY_REDUNDANCY_MAX_COPIES)
+        maxCopies = COPLAY_REDUNDANCY_MAX_COPIES;
+    if (maxCopies <= 0)
+        return 0;
+    // till Steam's had a look, better a few bytes too many than losing usercmds
+    if (loss < 0 || loss >= 1)
+        return maxCopies;
+    if (loss <= COPLAY_REDUNDANCY_TARGET_LOSS)
+        return 0;
+
+    // the datagram and its copies all going missing is loss^(copies + 1)
+    int numCopies = (int)ceil(log(COPLAY_REDUNDANCY_TARGET_LOSS) / log(loss)) - 1;
+    if (numCopies < 1)
+        return 1;
+    return numCopies > maxCopies ? maxCopies : numCopies;
+}
+
+void CCoplayRedundancyWriter::Reset()
+{
+    m_newest     = 0;
+    m_numHistory = 0;
+}
+
+void CCoplayRedundancyWriter::SetCopies(int numCopies)
+{
+    if (numCopies < 0)
+        numCopies = 0;
+    m_numCopies = numCopies > COPLAY_REDUNDANCY_MAX_COPIES ? COPLAY_REDUNDANCY_MAX_COPIES : numCopies;
+}
+
+int CCoplayRedundancyWriter::Write(uint8_t *pOut, int maxLen, const uint8_t *pData, int len, int *pNumCopies)
+{
+    // newest first back from the last one, as many as fit
+    int total     = COPLAY_REDUNDANCY_HEADER_SIZE + 2 + len;
+    int numCopies = 0;
+    while (numCopies < m_numCopies && numCopies < m_numHistory)
+    {
+        int slot = (m_newest - numCopies + COPLAY_REDUNDANCY_MAX_COPIES) % COPLAY_REDUNDANCY_MAX_COPIES;
+        if (total + 2 + m_lens[slot] > maxLen)
+            break;
+        total += 2 + m_lens[slot];
+        numCopies++;
+    }
+
+    // then written oldest first, so the game gets them in the order they were sent
+    int offset = CoplayWriteRelayMessage(pOut, eCoplayRelayMsg_Redundant);
+    pOut[offset++] = (uint8_t)(numCopies + 1);
+    for (int i = numCopies - 1; i >= 0; i--)
+    {
+        int slot = (m_newest - i + COPLAY_REDUNDANCY_MAX_COPIES) % COPLAY_REDUNDANCY_MAX_COPIES;
+        WriteLittleShort(pOut + offset, (uint16_t)m_lens[slot]);
+        memcpy(pOut + offset + 2, m_history[slot], m_lens[slot]);
+        offset += 2 + m_lens[slot];
+    }
+    WriteLittleShort(pOut + offset, (uint16_t)len);
+    memcpy(pOut + offset + 2, pData, len);
+    offset += 2 + len;
+
+    m_newest = (m_newest + 1) % COPLAY_REDUNDANCY_MAX_COPIES;
+    memcpy(m_history[m_newest], pData, len);
+    m_lens[m_newest] = len;
+    if (m_numHistory < COPLAY_REDUNDANCY_MAX_COPIES)
+        m_numHistory++;
+
+    *pNumCopies = numCopies;
+    return offset;
+}
+
+void CCoplayRedundancyReader::Reset()
+{
+    m_lastSequence  = -1;
+    m_numRecovered  = 0;
+    m_numDuplicates = 0;
+}
+
+bool CCoplayRedundancyReader::Add(const uint8_t *pData, int len, CoplayRedundancyDeliverFn pfnDeliver, void *pContext)
+{
+    if (len < COPLAY_REDUNDANCY_HEADER_SIZE)
+        return false;
+
+    // all of it has to make sense before any of it goes
+    int count  = pData[COPLAY_RELAY_MSG_HEADER_SIZE];
+    int offset = COPLAY_REDUNDANCY_HEADER_SIZE;
+    for (int i = 0; i < count; i++)
+    {
+        if (offset + 2 > len || offset + 2 + ReadLittleShort(pData + offset) > len)
+            return false;
+        offset += 2 + ReadLittleShort(pData + offset);
+    }
+    if (count == 0 || offset != len)
+        return false;
+
+    offset = COPLAY_REDUNDANCY_HEADER_SIZE;
+    for (int i = 0; i < count; i++)
+    {
+        const uint8_t *pDatagram  = pData + offset + 2;
+        int            datagramLen = ReadLittleShort(pData + offset);
+        offset += 2 + datagramLen;
+
+        bool bNewest = i == count - 1;
+        CoplayNetchanHeader_t header;
+        if (!CoplayReadNetchanHeader(pDatagram, datagramLen, &header))
+        {
+            // nothing to tell copies apart by, so only the one it was sent with
+            if (bNewest)
+                pfnDeliver(pContext, pDatagram, datagramLen);
+            continue;
+        }
+
+        // the netchannel would throw these out anyway
+        if (!IsNew(header.sequence))
+        {
+            m_numDuplicates++;
+            continue;
+        }
+        if (!bNewest)
+            m_numRecovered++;
+        pfnDeliver(pContext, pDatagram, datagramLen);
+    }
+    return true;
+}
+
+bool CCoplayRedundancyReader::IsNew(int32_t sequence)
+{
+    // the relay outlives the netchannel, a reconnect over the same connection starts back at 1
+    if (sequence > m_lastSequence || m_lastSequence - sequence > COPLAY_REDUNDANCY_RESTART_GAP)
+    {
+        m_lastSequence = sequence;
+        return true;
+    }
+    return false;
+}
+
+void CCoplayRedundancyReader::OnDatagram(const uint8_t *pData, int len)
+{
+    CoplayNetchanHeader_t header;
+    if (CoplayReadNetchanHeader(pData, len, &header))
+        IsNew(header.sequence);
+    else if (CoplayIsConnectionless(pData, len))
+        m_lastSequence = -1;
+}
+
+int CCoplayRedundancyReader::TakeNumRecovered()
+{
+    int numRecovered = m_numRecovered;
+    m_numRecovered   = 0;
+    return numRecovered;
+}
+
+int CCoplayRedundancyReader::TakeNumDuplicates()
+{
+    int numDuplicates = m_numDuplicates;
+    m_numDuplicates   = 0;
+    return numDuplicates;
+}
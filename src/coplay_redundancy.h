@@ -0,0 +1,84 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Sends the client's last few usercmds again along with each new one, so one that got lost on the way still makes it
+// in the next packet. They're tiny and go out every tick, so a couple of extra copies costs next to nothing
+// next to a prediction error. The host's relay passes on whatever has a sequence it hasn't passed on yet, oldest
+// first, and leaves the rest out so the game never sees the same one twice.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_REDUNDANCY_H
+#define COPLAY_REDUNDANCY_H
+#pragma once
+
+#include <stdint.h>
+#include "coplay_fragment.h"
+
+#define COPLAY_REDUNDANCY_MAX_COPIES   4
+#define COPLAY_REDUNDANCY_MAX_DATAGRAM 256   // anything bigger isn't just a usercmd, it goes as it is
+#define COPLAY_REDUNDANCY_HEADER_SIZE  6     // relay header, then how many datagrams. Each has its length in front of it
+#define COPLAY_REDUNDANCY_TARGET_LOSS  0.001 // copies are added till losing one and all its copies is about this rare
+#define COPLAY_REDUNDANCY_RESTART_GAP  64    // a sequence this far behind can't be a copy, the client's netchannel started over
+
+// Copies to send along for the fraction of packets the peer's missing, up to maxCopies. Negative loss if nobody knows
+int CoplayRedundantCopies(double loss, int maxCopies);
+
+class CCoplayRedundancyWriter
+{
+public:
+    CCoplayRedundancyWriter() : m_numCopies(0) { Reset(); }
+
+    // Forgets what's been sent, the number of copies stays
+    void Reset();
+    void SetCopies(int numCopies);
+    int  GetCopies() const { return m_numCopies; }
+
+    // The datagram with as many of the last ones as fit in maxLen ahead of it, then remembers it for the next one.
+    // len can't be more than COPLAY_REDUNDANCY_MAX_DATAGRAM. Returns how much it wrote, *pNumCopies is how many went
+    int Write(uint8_t *pOut, int maxLen, const uint8_t *pData, int len, int *pNumCopies);
+
+private:
+    int     m_numCopies;
+    int     m_newest; // where the last one went, the ones before it are behind it
+    int     m_numHistory;
+    int     m_lens[COPLAY_REDUNDANCY_MAX_COPIES];
+    uint8_t m_history[COPLAY_REDUNDANCY_MAX_COPIES][COPLAY_REDUNDANCY_MAX_DATAGRAM];
+};
+
+// Gets datagrams that are ready for the game
+typedef void (*CoplayRedundancyDeliverFn)(void *pContext, const uint8_t *pData, int len);
+
+class CCoplayRedundancyReader
+{
+public:
+    CCoplayRedundancyReader() { Reset(); }
+
+    void Reset();
+
+    // Takes a bundle, passes on what the game hasn't had yet. False if it makes no sense
+    bool Add(const uint8_t *pData, int len, CoplayRedundancyDeliverFn pfnDeliver, void *pContext);
+    // Everything plain from the peer goes through here, copies of it or anything before it don't need passing on.
+    // Anything connectionless means a new netchannel's on its way, and it starts its sequences over
+    void OnDatagram(const uint8_t *pData, int len);
+
+    // Since the last call. Recovered is copies that got there when the one they were a copy of didn't
+    int TakeNumRecovered();
+    int TakeNumDuplicates();
+
+private:
+    // False if the game's already had this one
+    bool IsNew(int32_t sequence);
+
+    int32_t m_lastSequence; // newest the game's been given, -1 before anything
+    int     m_numRecovered;
+    int     m_numDuplicates;
+};
+
+#endif
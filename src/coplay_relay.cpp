@@ -0,0 +1,622 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_relay.h"
+#include "coplay_capture.h"
+#include "coplay_timer.h"
+#include "coplay_netchan.h"
+#include "coplay_handshake.h"
+#include "coplay_log.h"
+#include "SDL2/SDL_timer.h"
+
+// Fresh snapshots always go first, reliable data and split packets share whatever's left 3 to 1.
+// The game drops anything older than what it last got, so whatever waits behind a snapshot is lost rather than late
+static const int      s_lanePriorities[eCoplayTraffic_Count] = { 0, 1, 1 };
+static const uint16_t s_laneWeights[eCoplayTraffic_Count]    = { 1, 3, 1 };
+
+CCoplayRelay::CCoplayRelay() : m_localSocket(NULL), m_localSocketSet(NULL), m_localPackets(), m_pTransport(NULL), m_hPeer(COPLAY_INVALID_PEER), m_bLanes(false), m_staleBudgetUsec(0),
+    m_caps(0), m_bOffer(false), m_peerCaps(0), m_maxPeerDatagram(0), m_nextFragmentID(0), m_maxRedundantCopies(0), m_nextLossCheck(0), m_numLocalSendFailed(0), m_pCapture(NULL), m_lastPumpTime(0),
+    m_bDropHandshake(false), m_bHolding(false), m_holdBudget(0), m_heldBytes(0)
+{
+    for (int i = 0; i < COPLAY_MAX_PACKETS; i++)
+        m_ppLocalPackets[i] = &m_localPackets[i];
+    m_ppLocalPackets[COPLAY_MAX_PACKETS] = NULL;
+}
+
+CCoplayRelay::~CCoplayRelay()
+{
+    Shutdown();
+}
+
+bool CCoplayRelay::Init(UDPsocket localSocket, ICoplayTransport *pTransport, HCoplayPeer hPeer)
+{
+    Shutdown();
+
+    if (!localSocket || !pTransport || hPeer == COPLAY_INVALID_PEER)
+        return false;
+
+    // net_maxroutable can change under us, so don't go by it. SDL cuts off whatever doesn't fit without saying
+    for (int i = 0; i < COPLAY_MAX_PACKETS; i++)
+    {
+        m_localPackets[i].data   = CoplayPacketPool()->Alloc();
+        m_localPackets[i].maxlen = COPLAY_POOL_BUFFER_SIZE;
+        if (!m_localPackets[i].data)
+        {
+            Shutdown();
+            return false;
+        }
+    }
+
+    m_localSocketSet = SDLNet_AllocSocketSet(1);
+    if (m_localSocketSet)
+        SDLNet_UDP_AddSocket(m_localSocketSet, localSocket);
+
+    m_localSocket  = localSocket;
+    m_pTransport   = pTransport;
+    m_hPeer        = hPeer;
+    m_lastPumpTime = CoplayTimeUsec();
+    m_stats.Reset();
+    return true;
+}
+
+void CCoplayRelay::Shutdown()
+{
+    for (int i = 0; i < COPLAY_MAX_PACKETS; i++)
+    {
+        CoplayPacketPool()->Free(m_localPackets[i].data);
+        m_localPackets[i].data = NULL;
+    }
+    if (m_localSocketSet)
+    {
+        SDLNet_FreeSocketSet(m_localSocketSet);
+        m_localSocketSet = NULL;
+    }
+    m_localSocket = NULL;
+    m_pTransport  = NULL;
+    m_hPeer       = COPLAY_INVALID_PEER;
+    m_bLanes      = false;
+    m_bHolding    = false;
+    m_heldBytes   = 0;
+    m_held.clear();
+    m_bDropHandshake = false;
+
+    m_caps            = 0;
+    m_bOffer          = false;
+    m_peerCaps        = 0;
+    m_maxPeerDatagram = 0;
+    m_reassembler.Reset();
+    ResetPeerState();
+    SetRedundancy(0);
+}
+
+void CCoplayRelay::ResetPeerState()
+{
+    for (int i = 0; i < COPLAY_FEC_STREAMS; i++)
+    {
+        m_fecEncoders[i].Init(i);
+        m_fecDecoders[i].Reset();
+    }
+    m_redundancyWriter.Reset();
+    m_redundancyReader.Reset();
+    m_nextLossCheck = 0;
+}
+
+bool CCoplayRelay::ConfigureLanes()
+{
+    return m_pTransport->ConfigureLanes(m_hPeer, eCoplayTraffic_Count, s_lanePriorities, s_laneWeights);
+}
+
+bool CCoplayRelay::EnableLanes()
+{
+    m_bLanes = m_pTransport && ConfigureLanes();
+    return m_bLanes;
+}
+
+int CCoplayRelay::EnableRelayMessages(bool bOffer, int caps)
+{
+    if (!m_pTransport || !caps)
+        return 0;
+
+    m_caps            = caps;
+    m_bOffer          = bOffer;
+    m_maxPeerDatagram = m_pTransport->GetMaxDatagramSize(m_hPeer);
+    if (bOffer)
+        SendRelayMessage(eCoplayRelayMsg_Hello);
+    return caps & COPLAY_RELAY_CAP_FRAGMENTS ? m_maxPeerDatagram : 0;
+}
+
+void CCoplayRelay::SendRelayMessage(CoplayRelayMessage type)
+{
+    uint8_t msg[COPLAY_RELAY_MSG_HEADER_SIZE + 1];
+    int     len = CoplayWriteRelayMessage(msg, type);
+    msg[len++] = (uint8_t)m_caps;
+    m_pTransport->Send(m_hPeer, msg, len, eCoplaySend_Reliable);
+}
+
+void CCoplayRelay::HandleRelayMessage(CoplayRelayMessage type, const uint8_t *pData, int len, int64_t now, bool bStale)
+{
+    // with nothing on we act like a relay that doesn't know them, which would have given these to the game to drop
+    if (!m_caps)
+        return;
+
+    switch (type)
+    {
+    case eCoplayRelayMsg_Hello:
+    case eCoplayRelayMsg_HelloReply:
+        m_peerCaps = len > COPLAY_RELAY_MSG_HEADER_SIZE ? pData[COPLAY_RELAY_MSG_HEADER_SIZE] : COPLAY_RELAY_CAP_FRAGMENTS;
+        if (type == eCoplayRelayMsg_Hello)
+            SendRelayMessage(eCoplayRelayMsg_HelloReply);
+        if (m_caps & m_peerCaps & COPLAY_RELAY_CAP_FEC)
+            m_stats.SetFecGroupSize(m_fecEncoders[0].GetGroupSize());
+        break;
+    case eCoplayRelayMsg_FecData:
+    case eCoplayRelayMsg_FecParity:
+    {
+        int stream = CoplayReadFecStream(pData, len);
+        if ((m_caps & COPLAY_RELAY_CAP_FEC) && stream >= 0)
+            m_fecDecoders[stream].Add(pData, len, now, bStale, DeliverDatagram, this);
+        break;
+    }
+    case eCoplayRelayMsg_Redundant:
+        if (m_caps & COPLAY_RELAY_CAP_REDUNDANCY)
+            m_redundancyReader.Add(pData, len, DeliverDatagram, this);
+        break;
+    default:
+        break;
+    }
+}
+
+int CCoplayRelay::CountFragments(int len) const
+{
+    // one that can't be split small enough still goes, Steam splits it like it always did
+    int numFragments = (m_caps & m_peerCaps & COPLAY_RELAY_CAP_FRAGMENTS) ? CoplayCountFragments(len, m_maxPeerDatagram) : 1;
+    return numFragments > 0 ? numFragments : 1;
+}
+
+CoplaySendResult CCoplayRelay::SendFragments(const uint8_t *pData, int len, int numFragments, int sendFlags)
+{
+    uint8_t  fragment[COPLAY_POOL_BUFFER_SIZE];
+    uint16_t id = m_nextFragmentID++;
+    for (int i = 0; i < numFragments; i++)
+    {
+        int fragmentLen = CoplayWriteFragment(fragment, id, pData, len, i, numFragments);
+        CoplaySendResult result = m_pTransport->Send(m_hPeer, fragment, fragmentLen, sendFlags);
+        // the rest are no use without this one
+        if (result != eCoplaySendResult_OK)
+            return result;
+    }
+    m_stats.AddFragmented(numFragments);
+    return eCoplaySendResult_OK;
+}
+
+CoplaySendResult CCoplayRelay::SendCopy(const uint8_t *pData, int len, int sendFlags)
+{
+    int numFragments = CountFragments(len);
+    if (numFragments > 1)
+        return SendFragments(pData, len, numFragments, sendFlags);
+    return m_pTransport->Send(m_hPeer, pData, len, sendFlags);
+}
+
+CoplaySendResult CCoplayRelay::SendWithFec(int stream, const uint8_t *pData, int len, int sendFlags, int64_t now)
+{
+    uint8_t msg[COPLAY_POOL_BUFFER_SIZE];
+    int     msgLen = m_fecEncoders[stream].WriteData(msg, pData, len, now);
+    CoplaySendResult result = SendCopy(msg, msgLen, sendFlags);
+    // one that didn't go is still in the parity, the peer can rebuild it as if it was lost on the way
+    m_stats.AddFecOverhead(0, COPLAY_FEC_DATA_HEADER_SIZE);
+    SendFecParity(stream, sendFlags, now);
+    return result;
+}
+
+void CCoplayRelay::SendFecParity(int stream, int sendFlags, int64_t now)
+{
+    uint8_t parity[COPLAY_POOL_BUFFER_SIZE];
+    int     parityLen = m_fecEncoders[stream].WriteParity(parity, now);
+    if (parityLen <= 0)
+        return;
+
+    // it's only any use if it gets there about when the rest did, so it never waits and never counts as something of the game's that didn't go
+    SendCopy(parity, parityLen, sendFlags & ~eCoplaySend_NoDrop);
+    m_stats.AddFecOverhead(1, parityLen);
+}
+
+CoplaySendResult CCoplayRelay::SendRedundant(const uint8_t *pData, int len, int sendFlags)
+{
+    // the copies are only worth it in one packet, Steam splitting it up would have them all go missing together
+    int maxLen = m_maxPeerDatagram > 0 && m_maxPeerDatagram < COPLAY_POOL_BUFFER_SIZE ? m_maxPeerDatagram : COPLAY_POOL_BUFFER_SIZE;
+    uint8_t bundle[COPLAY_POOL_BUFFER_SIZE];
+    int     numCopies;
+    int     bundleLen = m_redundancyWriter.Write(bundle, maxLen, pData, len, &numCopies);
+    m_stats.AddRedundancy(numCopies, bundleLen - len);
+    return m_pTransport->Send(m_hPeer, bundle, bundleLen, sendFlags);
+}
+
+void CCoplayRelay::SetRedundancy(int maxCopies)
+{
+    if (maxCopies == m_maxRedundantCopies)
+        return;
+
+    // as many as we're allowed till the next check says otherwise
+    m_maxRedundantCopies = maxCopies;
+    m_redundancyWriter.SetCopies(CoplayRedundantCopies(-1, maxCopies));
+    m_stats.SetRedundantCopies(m_redundancyWriter.GetCopies());
+    m_nextLossCheck = 0;
+}
+
+void CCoplayRelay::AdaptToLoss(int64_t now)
+{
+    if (now < m_nextLossCheck)
+        return;
+    m_nextLossCheck = now + COPLAY_LOSS_CHECK_USEC;
+
+    CoplayPeerStatus_t status;
+    if (!m_pTransport->GetStatus(m_hPeer, &status))
+        return;
+    double loss = status.qualityRemote >= 0 ? 1.0 - status.qualityRemote : -1;
+
+    if ((m_caps & m_peerCaps & COPLAY_RELAY_CAP_FEC) && loss >= 0)
+    {
+        int groupSize = CoplayFecGroupSize(loss);
+        for (int i = 0; i < COPLAY_FEC_STREAMS; i++)
+            m_fecEncoders[i].SetGroupSize(groupSize);
+        m_stats.SetFecGroupSize(groupSize);
+    }
+    if (m_maxRedundantCopies > 0)
+    {
+        m_redundancyWriter.SetCopies(CoplayRedundantCopies(loss, m_maxRedundantCopies));
+        m_stats.SetRedundantCopies(m_redundancyWriter.GetCopies());
+    }
+}
+
+void CCoplayRelay::SetBackpressure(int64_t maxQueueUsec)
+{
+    if (maxQueueUsec != m_sendControl.GetMaxQueueUsec())
+        m_sendControl.Init(maxQueueUsec);
+}
+
+int CCoplayRelay::GetSendFlags(CoplayTrafficClass trafficClass, CoplaySendDecision decision) const
+{
+    int sendFlags = decision == eCoplaySendDecision_Queue ? eCoplaySend_NoDrop : eCoplaySend_Unreliable;
+    if (m_bLanes)
+        sendFlags = CoplaySendOnLane(sendFlags, trafficClass);
+    return sendFlags;
+}
+
+bool CCoplayRelay::CheckSendResult(CoplaySendResult result)
+{
+    m_sendControl.OnSendResult(result);
+    switch (result)
+    {
+    case eCoplaySendResult_OK:
+        return true;
+    case eCoplaySendResult_QueueFull:
+        m_stats.AddPeerDropped(eCoplayDrop_QueueFull, 1);
+        break;
+    case eCoplaySendResult_Ignored:
+        m_stats.AddPeerDropped(eCoplayDrop_Ignored, 1);
+        break;
+    case eCoplaySendResult_NoConnection:
+        m_stats.AddPeerDropped(eCoplayDrop_NoConnection, 1);
+        break;
+    default:
+        m_stats.AddPeerDropped(eCoplayDrop_Failed, 1);
+        break;
+    }
+    return false;
+}
+
+bool CCoplayRelay::SendToPeer(UDPpacket *pPacket)
+{
+    CoplayTrafficClass trafficClass = CoplayClassifyDatagram(pPacket->data, pPacket->len);
+    CoplaySendDecision decision     = m_sendControl.Decide(trafficClass);
+    if (decision == eCoplaySendDecision_Shed)
+    {
+        m_stats.AddPeerDropped(eCoplayDrop_Shed, 1);
+        return false;
+    }
+
+    int sendFlags = GetSendFlags(trafficClass, decision);
+    // a new netchannel starts its sequences over, the host would take copies from the old one as newer
+    if (m_maxRedundantCopies > 0 && CoplayIsConnectionless(pPacket->data, pPacket->len))
+        m_redundancyWriter.Reset();
+    // a usercmd that's already going with copies has no need for a parity as well
+    if (trafficClass == eCoplayTraffic_Realtime && m_redundancyWriter.GetCopies() > 0 && (m_caps & m_peerCaps & COPLAY_RELAY_CAP_REDUNDANCY)
+        && pPacket->len <= COPLAY_REDUNDANCY_MAX_DATAGRAM)
+        return CheckSendResult(SendRedundant(pPacket->data, pPacket->len, sendFlags));
+    // bulk is pieces of something the netchannel resends whole anyway, and it'd have the groups waiting on it.
+    // SendWithFec goes through SendCopy, so anything too big for one of the peer's packets is split after it's wrapped
+    if ((m_caps & m_peerCaps & COPLAY_RELAY_CAP_FEC) && trafficClass < COPLAY_FEC_STREAMS && pPacket->len <= COPLAY_FEC_MAX_PAYLOAD)
+        return CheckSendResult(SendWithFec(trafficClass, pPacket->data, pPacket->len, sendFlags, CoplayTimeUsec()));
+
+    int numFragments = CountFragments(pPacket->len);
+    if (numFragments > 1)
+        return CheckSendResult(SendFragments(pPacket->data, pPacket->len, numFragments, sendFlags));
+
+    // the pool running dry just means copying like we used to, this buffer stays with us
+    CoplaySendResult result;
+    uint8_t         *pReplacement = CoplayPacketPool()->Alloc();
+    if (pReplacement)
+    {
+        result        = m_pTransport->SendPooled(m_hPeer, pPacket->data, pPacket->len, sendFlags);
+        pPacket->data = pReplacement;
+    }
+    else
+    {
+        result = m_pTransport->Send(m_hPeer, pPacket->data, pPacket->len, sendFlags);
+    }
+    return CheckSendResult(result);
+}
+
+int CCoplayRelay::FindStale(const CoplayDatagram_t *pDatagrams, int numDatagrams, bool *pStale) const
+{
+    // from the newest back, a plain one with a higher sequence after it has been superseded once it's waited past the budget
+    int     numStale = 0;
+    int32_t newest   = -1;
+    for (int i = numDatagrams - 1; i >= 0; i--)
+    {
+        // with FEC on nearly everything comes wrapped
+        int            len;
+        const uint8_t *pData = CoplayUnwrapFecData(pDatagrams[i].pData, pDatagrams[i].len, &len);
+        CoplayNetchanHeader_t header;
+        if (!CoplayReadNetchanHeader(pData, len, &header))
+            continue;
+
+        if (header.sequence > newest)
+        {
+            newest = header.sequence;
+        }
+        else if (!(header.flags & COPLAY_PACKET_FLAG_RELIABLE) && pDatagrams[i].ageUsec > m_staleBudgetUsec)
+        {
+            pStale[i] = true;
+            numStale++;
+        }
+    }
+    return numStale;
+}
+
+void CCoplayRelay::Hold(int maxBytes)
+{
+    m_bHolding   = true;
+    m_holdBudget = maxBytes;
+}
+
+int CCoplayRelay::Resume(HCoplayPeer hPeer)
+{
+    m_hPeer    = hPeer;
+    m_bHolding = false;
+    if (m_bLanes && !ConfigureLanes())
+        m_bLanes = false;
+    m_sendControl.Reset();
+
+    // the pieces and groups we had are from the old peer, and the new one has to say what it can take again
+    m_reassembler.Reset();
+    ResetPeerState();
+    if (m_caps)
+    {
+        m_maxPeerDatagram = m_pTransport->GetMaxDatagramSize(m_hPeer);
+        if (m_bOffer)
+        {
+            m_peerCaps = 0;
+            SendRelayMessage(eCoplayRelayMsg_Hello);
+        }
+    }
+
+    int numSent = 0;
+    for (size_t i = 0; i < m_held.size(); i++)
+    {
+        const uint8_t *pData = (const uint8_t*)m_held[i].data();
+        int            len   = (int)m_held[i].length();
+        int sendFlags = GetSendFlags(CoplayClassifyDatagram(pData, len), eCoplaySendDecision_Send);
+        if (CheckSendResult(SendCopy(pData, len, sendFlags)))
+            numSent++;
+    }
+
+    m_held.clear();
+    m_heldBytes = 0;
+    return numSent;
+}
+
+void CCoplayRelay::DeliverToGame(const uint8_t *pData, int len)
+{
+    if (m_caps & COPLAY_RELAY_CAP_REDUNDANCY)
+        m_redundancyReader.OnDatagram(pData, len);
+    if (m_pCapture)
+        m_pCapture->Write(eCaptureDir_Inbound, pData, len);
+
+    UDPpacket packet = {};
+    packet.data = (Uint8*)pData;
+    packet.len  = len;
+    if (!SDLNet_UDP_Send(m_localSocket, 1, &packet))
+        m_numLocalSendFailed++;
+}
+
+void CCoplayRelay::DeliverDatagram(void *pContext, const uint8_t *pData, int len)
+{
+    ((CCoplayRelay*)pContext)->DeliverToGame(pData, len);
+}
+
+void CCoplayRelay::WaitForLocal(int timeoutMs)
+{
+    if (m_localSocketSet)
+        SDLNet_CheckSockets(m_localSocketSet, timeoutMs);
+    else
+        SDL_Delay(timeoutMs);
+}
+
+CoplayPumpResult_t CCoplayRelay::Pump()
+{
+    CoplayPumpResult_t result = {};
+
+    //Outbound to peer
+    result.numLocalRecv = SDLNet_UDP_RecvV(m_localSocket, m_ppLocalPackets);
+    if (result.numLocalRecv == -1)
+    {
+        result.localError   = true;
+        result.numLocalRecv = 0;
+        m_stats.AddLocalError();
+    }
+
+    // the last pump's time is close enough to decide if it's time to look again
+    if (result.numLocalRecv > 0 && !m_bHolding && m_sendControl.ShouldPoll(m_lastPumpTime))
+    {
+        CoplayPeerStatus_t status;
+        if (m_pTransport->GetStatus(m_hPeer, &status))
+            m_sendControl.OnStatus(m_lastPumpTime, status);
+    }
+
+    int bytesOut = 0;
+    for (int i = 0; i < result.numLocalRecv; i++)
+    {
+        UDPpacket *pPacket = m_ppLocalPackets[i];
+        if (m_pCapture)
+            m_pCapture->Write(eCaptureDir_Outbound, pPacket->data, pPacket->len);
+
+        if (m_bHolding)
+        {
+            m_held.push_back(std::string((const char*)pPacket->data, pPacket->len));
+            m_heldBytes += pPacket->len;
+            // whatever the game sent most recently matters most
+            while (m_heldBytes > m_holdBudget && !m_held.empty())
+            {
+                m_heldBytes -= (int)m_held.front().length();
+                m_held.pop_front();
+                m_stats.AddPeerDropped(eCoplayDrop_HoldOverflow, 1);
+                result.numPeerSendFailed++;
+            }
+        }
+        else if (!SendToPeer(pPacket))
+        {
+            result.numPeerSendFailed++;
+        }
+        bytesOut += pPacket->len;
+    }
+
+    // a group that's been open a while gets its parity even if the game's gone quiet
+    bool bFec = (m_caps & m_peerCaps & COPLAY_RELAY_CAP_FEC) != 0;
+    if ((bFec || m_maxRedundantCopies > 0) && !m_bHolding)
+    {
+        int64_t lossNow = CoplayTimeUsec();
+        for (int i = 0; bFec && i < COPLAY_FEC_STREAMS; i++)
+            SendFecParity(i, GetSendFlags((CoplayTrafficClass)i, eCoplaySendDecision_Send), lossNow);
+        AdaptToLoss(lossNow);
+    }
+
+    //Inbound from peer, nothing to read while we're holding
+    CoplayDatagram_t inbound[COPLAY_MAX_PACKETS];
+    result.numPeerRecv = m_bHolding ? 0 : m_pTransport->Receive(m_hPeer, inbound, COPLAY_MAX_PACKETS);
+    if (result.numPeerRecv < 0)
+        result.numPeerRecv = 0;
+
+    bool stale[COPLAY_MAX_PACKETS] = {};
+    if (m_staleBudgetUsec > 0 && result.numPeerRecv > 1)
+        result.numStaleShed = FindStale(inbound, result.numPeerRecv, stale);
+
+    int bytesIn = 0;
+    int numFragmentsIn = 0;
+    int numReassembled = 0;
+    m_numLocalSendFailed = 0;
+    for (int i = 0; i < result.numPeerRecv; i++)
+    {
+        bytesIn += inbound[i].len;
+
+        // the game and the capture only ever see whole datagrams, what was in pieces can be any of ours too
+        const uint8_t *pData = inbound[i].pData;
+        int            len   = inbound[i].len;
+        if (m_bDropHandshake)
+        {
+            CoplayNetchanHeader_t header;
+            if (CoplayIsHandshakeMessage(pData, len))
+            {
+                m_bDropHandshake = false;
+                CoplayLog(eCoplayLog_Handshake, eCoplayLogLevel_Debug, "[Coplay Debug] Left out a passcode or ticket nobody asked for\n");
+                continue;
+            }
+            if (CoplayReadNetchanHeader(pData, len, &header))
+                m_bDropHandshake = false;
+        }
+        int            relayMsg = CoplayReadRelayMessage(pData, len);
+        if (relayMsg == eCoplayRelayMsg_Fragment)
+        {
+            numFragmentsIn++;
+            len = m_reassembler.Add(inbound[i].pData, inbound[i].len, CoplayTimeUsec(), &pData);
+            if (len <= 0)
+                continue;
+            numReassembled++;
+            relayMsg = CoplayReadRelayMessage(pData, len);
+        }
+        if (relayMsg >= 0)
+        {
+            if (stale[i] && m_pCapture)
+            {
+                int            staleLen;
+                const uint8_t *pStaleData = CoplayUnwrapFecData(pData, len, &staleLen);
+                m_pCapture->Write(eCaptureDir_Inbound, pStaleData, staleLen);
+            }
+            HandleRelayMessage((CoplayRelayMessage)relayMsg, pData, len, CoplayTimeUsec(), stale[i]);
+            continue;
+        }
+
+        if (stale[i])
+        {
+            if (m_pCapture)
+                m_pCapture->Write(eCaptureDir_Inbound, pData, len);
+            continue;
+        }
+        DeliverToGame(pData, len);
+    }
+
+    if (result.numPeerRecv > 0)
+        m_pTransport->Release(inbound, result.numPeerRecv);
+
+    // anything we moved could have been waiting since the last pump, so thats how long the relay may have held it
+    int64_t now = CoplayTimeUsec();
+    if (m_caps & COPLAY_RELAY_CAP_FEC)
+    {
+        int numRecovered = 0;
+        int numLost      = 0;
+        for (int i = 0; i < COPLAY_FEC_STREAMS; i++)
+        {
+            m_fecDecoders[i].Expire(now, DeliverDatagram, this);
+            numRecovered += m_fecDecoders[i].TakeNumRecovered();
+            numLost      += m_fecDecoders[i].TakeNumLost();
+        }
+        if (numRecovered > 0 || numLost > 0)
+            m_stats.AddFecRecovered(numRecovered, numLost);
+    }
+    if (m_caps & COPLAY_RELAY_CAP_REDUNDANCY)
+    {
+        int numRecovered  = m_redundancyReader.TakeNumRecovered();
+        int numDuplicates = m_redundancyReader.TakeNumDuplicates();
+        if (numRecovered > 0 || numDuplicates > 0)
+            m_stats.AddRedundancyIn(numRecovered, numDuplicates);
+    }
+    // held ones can go to the game on a pump that got nothing
+    result.numLocalSendFailed = m_numLocalSendFailed;
+    if (result.numLocalSendFailed > 0)
+        m_stats.AddLocalSendFailed(result.numLocalSendFailed);
+    if (result.numLocalRecv > 0 || result.numPeerRecv > 0)
+    {
+        m_stats.AddOutbound(result.numLocalRecv, bytesOut);
+        m_stats.AddInbound(result.numPeerRecv, bytesIn);
+        if (result.numStaleShed > 0)
+            m_stats.AddStaleShed(result.numStaleShed);
+        m_stats.AddLatency(now - m_lastPumpTime);
+    }
+    m_lastPumpTime = now;
+
+    if (numFragmentsIn > 0)
+        m_stats.AddFragmentsIn(numFragmentsIn, numReassembled);
+    int numLost = m_reassembler.Expire(now);
+    if (numLost > 0)
+        m_stats.AddReassemblyFailed(numLost);
+
+    return result;
+}
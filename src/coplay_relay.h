@@ -0,0 +1,170 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// The data plane of a connection, moves datagrams between the local game socket and a remote peer.
+// Doesn't know about the engine or Steam so it can be driven by the standalone tools as well,
+// don't include cbase.h in here.
+#ifndef COPLAY_RELAY_H
+#define COPLAY_RELAY_H
+#pragma once
+
+#include <stdint.h>
+#include "SDL2/SDL_net.h"
+#include "coplay_stats.h"
+#include "coplay_transport.h"
+#include "coplay_sendcontrol.h"
+#include "coplay_fragment.h"
+#include "coplay_fec.h"
+#include "coplay_redundancy.h"
+#include <deque>
+#include <string>
+
+#define COPLAY_MAX_PACKETS 8 // max packets proccessed in a single loop of running the connection.
+#define COPLAY_LOSS_CHECK_USEC 1000000 // how often FEC and redundancy look at what the peer's losing
+
+class CCoplayCaptureWriter;
+
+struct CoplayPumpResult_t
+{
+    int  numLocalRecv;       // game -> peer
+    int  numPeerRecv;        // peer -> game
+    int  numPeerSendFailed;  // some of what the game gave us didn't go to the peer, the stats say why
+    int  numLocalSendFailed; // SDL wouldn't send some of what the peer gave us
+    bool localError;         // SDL errored reading the game socket, see SDLNet_GetError
+    int  numStaleShed;       // peer -> game, left out for a newer one that came with it
+};
+
+class CCoplayRelay
+{
+public:
+    CCoplayRelay();
+    ~CCoplayRelay();
+
+    // The socket should already have the game's address bound on channel 1.
+    // What the game sends is read into whole pool buffers, so nothing under COPLAY_POOL_BUFFER_SIZE gets cut short
+    bool Init(UDPsocket localSocket, ICoplayTransport *pTransport, HCoplayPeer hPeer);
+    void Shutdown();
+
+    // Not owned, pass NULL to stop capturing
+    void SetCapture(CCoplayCaptureWriter *pCapture) { m_pCapture = pCapture; }
+
+    // Sends what the game gives us on a lane per CoplayTrafficClass, so snapshots don't queue behind
+    // reliable data and split packets when the peer's backed up. False if the transport has no lanes
+    bool EnableLanes();
+
+    // Tells the peer what we can take of COPLAY_RELAY_CAP_*, and uses whatever it says it can take too.
+    // With fragments we put datagrams from the peer back together and split ours that wouldn't fit in one of its packets.
+    // With FEC what the game sends goes in groups with a parity after each, so the peer can rebuild one that went missing.
+    // The client offers, the host only answers so nothing of ours turns up in the middle of the client's handshake.
+    // Returns the biggest datagram that goes in one piece, 0 for no limit or no fragments
+    int  EnableRelayMessages(bool bOffer, int caps);
+
+    // Thins out what we send once it'd wait longer than this to go out, see CCoplaySendController. 0 to never
+    void SetBackpressure(int64_t maxQueueUsec);
+
+    // Of the datagrams a pump gets from the peer, plain ones that have waited longer than this with the transport
+    // are left out if a newer one came with them. Only for what the server sends, a usercmd is never superseded. 0 to never
+    void SetStaleBudget(int64_t budgetUsec) { m_staleBudgetUsec = budgetUsec; }
+
+    // Plain usercmds go with up to this many of the ones before them, fewer while the peer's losing less, once it
+    // says it can take them. Only for what the client sends, see coplay_redundancy.h. 0 to never
+    void SetRedundancy(int maxCopies);
+
+    // Move everything thats waiting in both directions, one loop of the connection
+    CoplayPumpResult_t Pump();
+
+    // Blocks till the game sends something or the timeout's up. Theres nothing to wait on for the peer,
+    // so the timeout is how long the peer's side can go unchecked
+    void WaitForLocal(int timeoutMs);
+
+    // For when the peer goes away but the game shouldn't notice. Pump keeps reading the game and holds on to
+    // up to maxBytes of what it sends, the oldest go first and count as failed sends
+    void Hold(int maxBytes);
+    // Carries on with a new peer, everything held goes to it first. Returns how many datagrams that was
+    int  Resume(HCoplayPeer hPeer);
+    bool IsHolding() const { return m_bHolding; }
+
+    // Host side, for peers let in without their first message being read. Clients send their passcode or ticket
+    // as soon as they're connected, whether the host wants one or not, and the game server shouldn't get it.
+    // Leaves out the first thing from the peer that looks like one, till the game's netchannel is up
+    void DropHandshake() { m_bDropHandshake = true; }
+
+    // Safe to read from any thread while the relay runs
+    const CCoplayRelayStats &GetStats() const { return m_stats; }
+
+private:
+    // Everything the game sends goes through here. The packet gets a new buffer if its old one went to the transport
+    bool SendToPeer(UDPpacket *pPacket);
+    int  GetSendFlags(CoplayTrafficClass trafficClass, CoplaySendDecision decision) const;
+    // Counts it in the stats if it didn't go, true if it did
+    bool CheckSendResult(CoplaySendResult result);
+    bool ConfigureLanes();
+    // Pieces a datagram goes to the peer in, 1 for as it is
+    int  CountFragments(int len) const;
+    CoplaySendResult SendFragments(const uint8_t *pData, int len, int numFragments, int sendFlags);
+    CoplaySendResult SendCopy(const uint8_t *pData, int len, int sendFlags);
+    CoplaySendResult SendWithFec(int stream, const uint8_t *pData, int len, int sendFlags, int64_t now);
+    // The stream's parity, if its group's due one
+    void SendFecParity(int stream, int sendFlags, int64_t now);
+    // FEC groups and usercmd copies, none of it carries over to a new peer
+    void ResetPeerState();
+    CoplaySendResult SendRedundant(const uint8_t *pData, int len, int sendFlags);
+    // Sizes the groups and the copies to the loss Steam says the peer's seeing
+    void AdaptToLoss(int64_t now);
+    void SendRelayMessage(CoplayRelayMessage type);
+    // bStale is from FindStale, FEC data that's been superseded still goes to the decoder but not on to the game
+    void HandleRelayMessage(CoplayRelayMessage type, const uint8_t *pData, int len, int64_t now, bool bStale);
+    void DeliverToGame(const uint8_t *pData, int len);
+    static void DeliverDatagram(void *pContext, const uint8_t *pData, int len);
+    int  FindStale(const CoplayDatagram_t *pDatagrams, int numDatagrams, bool *pStale) const;
+
+    UDPsocket         m_localSocket;
+    SDLNet_SocketSet  m_localSocketSet; // just the one, for WaitForLocal
+    // what the game sends is read straight into pool buffers, the transport gets each one as it is and we take a new one
+    UDPpacket         m_localPackets[COPLAY_MAX_PACKETS];
+    UDPpacket        *m_ppLocalPackets[COPLAY_MAX_PACKETS + 1]; // the vector SDLNet_UDP_RecvV wants, NULL terminated
+    ICoplayTransport *m_pTransport;
+    HCoplayPeer       m_hPeer;
+    bool              m_bLanes;
+
+    CCoplaySendController m_sendControl;
+    int64_t               m_staleBudgetUsec;
+
+    int                m_caps;     // COPLAY_RELAY_CAP_* we take, 0 acts like a relay that doesn't know any of it
+    bool               m_bOffer;
+    int                m_peerCaps; // and the peer takes, ours go in pieces or groups only once they're in both
+    int                m_maxPeerDatagram;
+    uint16_t           m_nextFragmentID;
+    CCoplayReassembler m_reassembler;
+
+    CCoplayFecEncoder  m_fecEncoders[COPLAY_FEC_STREAMS]; // by CoplayTrafficClass
+    CCoplayFecDecoder  m_fecDecoders[COPLAY_FEC_STREAMS];
+
+    int                     m_maxRedundantCopies;
+    CCoplayRedundancyWriter m_redundancyWriter;
+    CCoplayRedundancyReader m_redundancyReader;
+
+    int64_t            m_nextLossCheck;
+    int                m_numLocalSendFailed; // this pump, FEC and redundancy hand the game datagrams from wherever they get them
+
+    CCoplayCaptureWriter *m_pCapture;
+
+    CCoplayRelayStats m_stats;
+    int64_t           m_lastPumpTime;
+    bool              m_bDropHandshake;
+
+    bool                    m_bHolding;
+    int                     m_holdBudget;
+    int                     m_heldBytes;
+    std::deque<std::string> m_held;
+};
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_sendcontrol.h"
+
+void CCoplaySendController::Init(int64_t maxQueueUsec)
+{
+    m_maxQueueUsec = maxQueueUsec > 0 ? maxQueueUsec : 0;
+    Reset();
+}
+
+void CCoplaySendController::Reset()
+{
+    m_nextPoll  = 0;
+    m_bBackedUp = false;
+    m_numPlain  = 0;
+}
+
+void CCoplaySendController::OnStatus(int64_t now, const CoplayPeerStatus_t &status)
+{
+    m_nextPoll = now + COPLAY_SENDCONTROL_POLL_USEC;
+
+    if (status.queueTimeUsec > m_maxQueueUsec)
+    {
+        if (!m_bBackedUp)
+            m_numPlain = 0;
+        m_bBackedUp = true;
+    }
+    else if (status.queueTimeUsec < m_maxQueueUsec / 2)
+    {
+        m_bBackedUp = false;
+    }
+}
+
+void CCoplaySendController::OnSendResult(CoplaySendResult result)
+{
+    // the transport telling us is as good as the status saying so, the next poll decides when it's over
+    if (m_maxQueueUsec > 0 && (result == eCoplaySendResult_QueueFull || result == eCoplaySendResult_Ignored))
+    {
+        if (!m_bBackedUp)
+            m_numPlain = 0;
+        m_bBackedUp = true;
+    }
+}
+
+CoplaySendDecision CCoplaySendController::Decide(CoplayTrafficClass trafficClass)
+{
+    if (!m_bBackedUp)
+        return eCoplaySendDecision_Send;
+
+    // a lost piece of a split packet loses all of it, so bulk is queued like reliable
+    if (trafficClass != eCoplayTraffic_Realtime)
+        return eCoplaySendDecision_Queue;
+
+    return m_numPlain++ % COPLAY_SENDCONTROL_SHED_EVERY == 0 ? eCoplaySendDecision_Send : eCoplaySendDecision_Shed;
+}
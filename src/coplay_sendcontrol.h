@@ -0,0 +1,63 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Keeps track of how backed up sending to the peer is, from the transport's status and what each send comes back with.
+// While it's backed up every other plain snapshot or usercmd is left out, the game sends a fresh one soon enough and
+// each one we leave out makes room for the rest. Datagrams with reliable data in them get queued instead of letting
+// the transport drop them, otherwise the game has to wait a round trip to find out and send it all again.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_SENDCONTROL_H
+#define COPLAY_SENDCONTROL_H
+#pragma once
+
+#include <stdint.h>
+#include "coplay_transport.h"
+#include "coplay_netchan.h"
+
+#define COPLAY_SENDCONTROL_POLL_USEC  20000 // how often to ask the transport, Steam takes a lock for it
+#define COPLAY_SENDCONTROL_SHED_EVERY 2     // while backed up, one in this many plain datagrams still goes
+
+enum CoplaySendDecision
+{
+    eCoplaySendDecision_Send = 0,
+    eCoplaySendDecision_Queue, // send with eCoplaySend_NoDrop
+    eCoplaySendDecision_Shed,  // leave it out
+};
+
+class CCoplaySendController
+{
+public:
+    CCoplaySendController() { Init(0); }
+
+    // Backed up is once something would wait more than maxQueueUsec to go out, and it stays that way till
+    // it's back under half that. 0 never sheds anything
+    void Init(int64_t maxQueueUsec);
+    // For a new peer, forgets everything about the old one
+    void Reset();
+
+    // Whether it's time to give OnStatus something new
+    bool ShouldPoll(int64_t now) const { return m_maxQueueUsec > 0 && now >= m_nextPoll; }
+    void OnStatus(int64_t now, const CoplayPeerStatus_t &status);
+    void OnSendResult(CoplaySendResult result);
+
+    CoplaySendDecision Decide(CoplayTrafficClass trafficClass);
+
+    bool    IsBackedUp() const { return m_bBackedUp; }
+    int64_t GetMaxQueueUsec() const { return m_maxQueueUsec; }
+
+private:
+    int64_t m_maxQueueUsec;
+    int64_t m_nextPoll;
+    bool    m_bBackedUp;
+    int     m_numPlain; // plain datagrams since we got backed up
+};
+
+#endif
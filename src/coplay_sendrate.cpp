@@ -0,0 +1,40 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_sendrate.h"
+#include <stdlib.h>
+#include <algorithm>
+
+static bool IsClose(int a, int b)
+{
+    int larger = std::max(a, b);
+    return larger == 0 || std::abs(a - b) <= larger * COPLAY_SENDTUNE_TOLERANCE;
+}
+
+bool CoplaySendTuning_t::IsCloseTo(const CoplaySendTuning_t &other) const
+{
+    return IsClose(rateMin, other.rateMin) && IsClose(rateMax, other.rateMax) && IsClose(bufferSize, other.bufferSize);
+}
+
+void CoplayTuneSendRate(const CoplayRateSettings_t &settings, CoplaySendTuning_t *pTuning)
+{
+    // room for everything the game's allowed to send, or twice what it's sending if it's somehow over that
+    double gameRate = settings.gameRate > 0 ? settings.gameRate : COPLAY_SENDRATE_UNLIMITED;
+    double rateMax  = std::max(gameRate, settings.measuredRate * 2.0) * COPLAY_SENDRATE_HEADROOM;
+
+    // Steam's estimate starts at the min and only climbs once it sees the connection can take more,
+    // so start it at what the game is already doing instead of queuing behind the climb
+    double rateMin = std::min(std::max(settings.measuredRate * COPLAY_SENDRATE_HEADROOM, (double)COPLAY_SENDRATE_FLOOR), rateMax);
+
+    pTuning->rateMax    = (int)rateMax;
+    pTuning->rateMin    = (int)rateMin;
+    pTuning->bufferSize = std::max(COPLAY_SENDBUFFER_MIN, (int)(rateMax * COPLAY_SENDBUFFER_MSEC / 1000));
+}
@@ -0,0 +1,48 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Works out Steam's send rate limits and send buffer for a connection from what the game lets itself send and
+// what it's actually been sending. The game already paces itself by its rate cvars, Steam holding it back
+// on top of that just queues things up where nobody can see them.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_SENDRATE_H
+#define COPLAY_SENDRATE_H
+#pragma once
+
+#include <stdint.h>
+
+#define COPLAY_SENDRATE_UNLIMITED   (1024 * 1024) // the engine's MAX_RATE, what a netchannel tops out at with no limit set
+#define COPLAY_SENDRATE_FLOOR       (64 * 1024)   // never tell Steam to start out slower than this
+#define COPLAY_SENDRATE_HEADROOM    1.25          // Steam's headers, and bursts like a full update
+#define COPLAY_SENDBUFFER_MIN       (512 * 1024)  // Steam's own default
+#define COPLAY_SENDBUFFER_MSEC      500           // the buffer holds this long at the max rate
+#define COPLAY_SENDTUNE_TOLERANCE   0.1           // changes smaller than this fraction aren't worth applying
+
+struct CoplayRateSettings_t
+{
+    int gameRate;     // bytes a second the game limits the connection to, 0 for no limit
+    int measuredRate; // bytes a second it's been sending lately
+};
+
+struct CoplaySendTuning_t
+{
+    int rateMin    = 0; // all 0 till something's been applied, Steam's defaults till then
+    int rateMax    = 0;
+    int bufferSize = 0;
+
+    bool IsSet() const { return rateMax > 0; }
+    // Close enough to not bother Steam with the difference
+    bool IsCloseTo(const CoplaySendTuning_t &other) const;
+};
+
+void CoplayTuneSendRate(const CoplayRateSettings_t &settings, CoplaySendTuning_t *pTuning);
+
+#endif
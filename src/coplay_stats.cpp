@@ -0,0 +1,211 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_stats.h"
+
+const char *CoplayDropReasonName(CoplayDropReason reason)
+{
+    static const char *s_names[eCoplayDrop_Count] = { "shed", "hold_overflow", "queue_full", "ignored", "no_connection", "failed" };
+    if (reason < 0 || reason >= eCoplayDrop_Count)
+        return "unknown";
+    return s_names[reason];
+}
+
+static int LatencyBucket(int64_t usec)
+{
+    int bucket = 0;
+    while (usec >= 2 && bucket < COPLAY_LATENCY_BUCKETS - 1)
+    {
+        usec >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+double CoplayRelayStatsSnapshot_t::LatencyPercentileUsec(double pct) const
+{
+    // go by the buckets rather than latencyCount, the snapshot can catch them a sample apart
+    uint64_t total = 0;
+    for (int i = 0; i < COPLAY_LATENCY_BUCKETS; i++)
+        total += latencyBuckets[i];
+    if (total == 0)
+        return 0;
+
+    double target = total * pct / 100.0;
+    uint64_t seen = 0;
+    for (int i = 0; i < COPLAY_LATENCY_BUCKETS; i++)
+    {
+        if (latencyBuckets[i] == 0)
+            continue;
+
+        if (seen + latencyBuckets[i] >= target)
+        {
+            // assume they're spread evenly through the bucket
+            double low  = i == 0 ? 0 : (double)(1ll << i);
+            double high = (double)(1ll << (i + 1));
+            double frac = (target - seen) / latencyBuckets[i];
+            return low + (high - low) * frac;
+        }
+        seen += latencyBuckets[i];
+    }
+    return (double)(1ll << COPLAY_LATENCY_BUCKETS);
+}
+
+void CCoplayRelayStats::Reset()
+{
+    m_packetsOut      = 0;
+    m_bytesOut        = 0;
+    m_packetsIn       = 0;
+    m_bytesIn         = 0;
+    for (int i = 0; i < eCoplayDrop_Count; i++)
+        m_peerDropped[i] = 0;
+    m_localSendFailed = 0;
+    m_localErrors     = 0;
+    m_staleShed       = 0;
+    m_fragmentedOut    = 0;
+    m_fragmentsOut     = 0;
+    m_reassembledIn    = 0;
+    m_fragmentsIn      = 0;
+    m_reassemblyFailed = 0;
+    m_fecParityOut     = 0;
+    m_fecOverheadBytes = 0;
+    m_fecRecovered     = 0;
+    m_fecUnrecovered   = 0;
+    m_fecGroupSize     = 0;
+    m_redundantCopiesOut      = 0;
+    m_redundancyOverheadBytes = 0;
+    m_redundancyRecovered     = 0;
+    m_redundantDuplicates     = 0;
+    m_redundantCopies         = 0;
+    for (int i = 0; i < COPLAY_LATENCY_BUCKETS; i++)
+        m_latencyBuckets[i] = 0;
+    m_latencyCount   = 0;
+    m_latencySumUsec = 0;
+}
+
+void CCoplayRelayStats::AddOutbound(int packets, int bytes)
+{
+    Add(m_packetsOut, packets);
+    Add(m_bytesOut, bytes);
+}
+
+void CCoplayRelayStats::AddInbound(int packets, int bytes)
+{
+    Add(m_packetsIn, packets);
+    Add(m_bytesIn, bytes);
+}
+
+void CCoplayRelayStats::AddPeerDropped(CoplayDropReason reason, int packets)
+{
+    Add(m_peerDropped[reason], packets);
+}
+
+void CCoplayRelayStats::AddLocalSendFailed(int packets)
+{
+    Add(m_localSendFailed, packets);
+}
+
+void CCoplayRelayStats::AddLocalError()
+{
+    Add(m_localErrors, 1);
+}
+
+void CCoplayRelayStats::AddStaleShed(int packets)
+{
+    Add(m_staleShed, packets);
+}
+
+void CCoplayRelayStats::AddFragmented(int fragments)
+{
+    Add(m_fragmentedOut, 1);
+    Add(m_fragmentsOut, fragments);
+}
+
+void CCoplayRelayStats::AddFragmentsIn(int fragments, int reassembled)
+{
+    Add(m_fragmentsIn, fragments);
+    Add(m_reassembledIn, reassembled);
+}
+
+void CCoplayRelayStats::AddReassemblyFailed(int packets)
+{
+    Add(m_reassemblyFailed, packets);
+}
+
+void CCoplayRelayStats::AddFecOverhead(int parityPackets, int bytes)
+{
+    Add(m_fecParityOut, parityPackets);
+    Add(m_fecOverheadBytes, bytes);
+}
+
+void CCoplayRelayStats::AddFecRecovered(int recovered, int unrecovered)
+{
+    Add(m_fecRecovered, recovered);
+    Add(m_fecUnrecovered, unrecovered);
+}
+
+void CCoplayRelayStats::AddRedundancy(int copies, int bytes)
+{
+    Add(m_redundantCopiesOut, copies);
+    Add(m_redundancyOverheadBytes, bytes);
+}
+
+void CCoplayRelayStats::AddRedundancyIn(int recovered, int duplicates)
+{
+    Add(m_redundancyRecovered, recovered);
+    Add(m_redundantDuplicates, duplicates);
+}
+
+void CCoplayRelayStats::AddLatency(int64_t usec)
+{
+    if (usec < 0)
+        usec = 0;
+    Add(m_latencyBuckets[LatencyBucket(usec)], 1);
+    Add(m_latencySumUsec, usec);
+    Add(m_latencyCount, 1);
+}
+
+void CCoplayRelayStats::Snapshot(CoplayRelayStatsSnapshot_t *pSnapshot) const
+{
+    pSnapshot->packetsOut      = m_packetsOut.load(std::memory_order_relaxed);
+    pSnapshot->bytesOut        = m_bytesOut.load(std::memory_order_relaxed);
+    pSnapshot->packetsIn       = m_packetsIn.load(std::memory_order_relaxed);
+    pSnapshot->bytesIn         = m_bytesIn.load(std::memory_order_relaxed);
+    pSnapshot->peerSendFailed  = 0;
+    for (int i = 0; i < eCoplayDrop_Count; i++)
+    {
+        pSnapshot->peerDropped[i]  = m_peerDropped[i].load(std::memory_order_relaxed);
+        pSnapshot->peerSendFailed += pSnapshot->peerDropped[i];
+    }
+    pSnapshot->localSendFailed = m_localSendFailed.load(std::memory_order_relaxed);
+    pSnapshot->localErrors     = m_localErrors.load(std::memory_order_relaxed);
+    pSnapshot->staleShed       = m_staleShed.load(std::memory_order_relaxed);
+    pSnapshot->fragmentedOut    = m_fragmentedOut.load(std::memory_order_relaxed);
+    pSnapshot->fragmentsOut     = m_fragmentsOut.load(std::memory_order_relaxed);
+    pSnapshot->reassembledIn    = m_reassembledIn.load(std::memory_order_relaxed);
+    pSnapshot->fragmentsIn      = m_fragmentsIn.load(std::memory_order_relaxed);
+    pSnapshot->reassemblyFailed = m_reassemblyFailed.load(std::memory_order_relaxed);
+    pSnapshot->fecParityOut     = m_fecParityOut.load(std::memory_order_relaxed);
+    pSnapshot->fecOverheadBytes = m_fecOverheadBytes.load(std::memory_order_relaxed);
+    pSnapshot->fecRecovered     = m_fecRecovered.load(std::memory_order_relaxed);
+    pSnapshot->fecUnrecovered   = m_fecUnrecovered.load(std::memory_order_relaxed);
+    pSnapshot->fecGroupSize     = m_fecGroupSize.load(std::memory_order_relaxed);
+    pSnapshot->redundantCopiesOut      = m_redundantCopiesOut.load(std::memory_order_relaxed);
+    pSnapshot->redundancyOverheadBytes = m_redundancyOverheadBytes.load(std::memory_order_relaxed);
+    pSnapshot->redundancyRecovered     = m_redundancyRecovered.load(std::memory_order_relaxed);
+    pSnapshot->redundantDuplicates     = m_redundantDuplicates.load(std::memory_order_relaxed);
+    pSnapshot->redundantCopies         = m_redundantCopies.load(std::memory_order_relaxed);
+
+    pSnapshot->latencyCount   = m_latencyCount.load(std::memory_order_relaxed);
+    pSnapshot->latencySumUsec = m_latencySumUsec.load(std::memory_order_relaxed);
+    for (int i = 0; i < COPLAY_LATENCY_BUCKETS; i++)
+        pSnapshot->latencyBuckets[i] = m_latencyBuckets[i].load(std::memory_order_relaxed);
+}
@@ -0,0 +1,147 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Counters kept by a relay as it runs. Only the relay thread writes them,
+// anyone can take a snapshot at any time without locking or stopping it.
+#ifndef COPLAY_STATS_H
+#define COPLAY_STATS_H
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Why something the game sent never reached the peer
+enum CoplayDropReason
+{
+    eCoplayDrop_Shed = 0,     // the peer was backed up so we left it out
+    eCoplayDrop_HoldOverflow, // more than we could hold on to while resuming
+    eCoplayDrop_QueueFull,    // the transport had too much waiting already
+    eCoplayDrop_Ignored,      // the transport would have had it wait too long
+    eCoplayDrop_NoConnection,
+    eCoplayDrop_Failed,       // anything else the transport said no for
+    eCoplayDrop_Count
+};
+
+const char *CoplayDropReasonName(CoplayDropReason reason);
+
+// log2 buckets of microseconds, bucket 0 is under 2us and the last one is everything from ~8 seconds up
+#define COPLAY_LATENCY_BUCKETS 24
+
+// A copy of the counters at one point in time, safe to read however you like
+struct CoplayRelayStatsSnapshot_t
+{
+    uint64_t packetsOut; // game -> peer
+    uint64_t bytesOut;
+    uint64_t packetsIn;  // peer -> game
+    uint64_t bytesIn;
+
+    uint64_t peerSendFailed;  // everything the game sent that didn't go to the peer, all of peerDropped
+    uint64_t peerDropped[eCoplayDrop_Count];
+    uint64_t localSendFailed; // SDL wouldn't give the game something the peer sent
+    uint64_t localErrors;
+    uint64_t staleShed;       // from the peer, left out since a newer snapshot was right behind
+
+    // datagrams too big for one of the peer's packets, and the pieces they went in
+    uint64_t fragmentedOut;
+    uint64_t fragmentsOut;
+    uint64_t reassembledIn;
+    uint64_t fragmentsIn;
+    uint64_t reassemblyFailed; // from the peer, gave up waiting on the rest of it
+
+    uint64_t fecParityOut;     // parity packets sent
+    uint64_t fecOverheadBytes; // what FEC added on top of the game's datagrams, parity and headers
+    uint64_t fecRecovered;     // from the peer, rebuilt from a parity
+    uint64_t fecUnrecovered;   // from the peer, missing and couldn't be rebuilt
+    int      fecGroupSize;     // datagrams per parity we send in right now, 0 before FEC's picked one
+
+    uint64_t redundantCopiesOut;      // earlier usercmds sent again along with a new one
+    uint64_t redundancyOverheadBytes; // what that added, copies and framing
+    uint64_t redundancyRecovered;     // from the peer, copies the game got since the first one never came
+    uint64_t redundantDuplicates;     // from the peer, copies of what the game already had and were left out
+    int      redundantCopies;         // copies going with each usercmd right now
+
+    uint64_t latencyBuckets[COPLAY_LATENCY_BUCKETS];
+    uint64_t latencyCount;
+    uint64_t latencySumUsec;
+
+    // Estimated from the buckets, pct is 0-100
+    double LatencyPercentileUsec(double pct) const;
+};
+
+class CCoplayRelayStats
+{
+public:
+    CCoplayRelayStats() { Reset(); }
+
+    void Reset();
+
+    // relay thread only
+    void AddOutbound(int packets, int bytes);
+    void AddInbound(int packets, int bytes);
+    void AddPeerDropped(CoplayDropReason reason, int packets);
+    void AddLocalSendFailed(int packets);
+    void AddLocalError();
+    void AddStaleShed(int packets);
+    void AddFragmented(int fragments);
+    void AddFragmentsIn(int fragments, int reassembled);
+    void AddReassemblyFailed(int packets);
+    void AddFecOverhead(int parityPackets, int bytes);
+    void AddFecRecovered(int recovered, int unrecovered);
+    void SetFecGroupSize(int groupSize) { m_fecGroupSize.store(groupSize, std::memory_order_relaxed); }
+    void AddRedundancy(int copies, int bytes);
+    void AddRedundancyIn(int recovered, int duplicates);
+    void SetRedundantCopies(int copies) { m_redundantCopies.store(copies, std::memory_order_relaxed); }
+    void AddLatency(int64_t usec);
+
+    // any thread, the counters keep moving while this runs so they may be a packet apart from each other
+    void Snapshot(CoplayRelayStatsSnapshot_t *pSnapshot) const;
+
+private:
+    // with a single writer a plain load and store is enough, saves a locked add per packet
+    static void Add(std::atomic<uint64_t> &counter, uint64_t amount)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> m_packetsOut;
+    std::atomic<uint64_t> m_bytesOut;
+    std::atomic<uint64_t> m_packetsIn;
+    std::atomic<uint64_t> m_bytesIn;
+
+    std::atomic<uint64_t> m_peerDropped[eCoplayDrop_Count];
+    std::atomic<uint64_t> m_localSendFailed;
+    std::atomic<uint64_t> m_localErrors;
+    std::atomic<uint64_t> m_staleShed;
+
+    std::atomic<uint64_t> m_fragmentedOut;
+    std::atomic<uint64_t> m_fragmentsOut;
+    std::atomic<uint64_t> m_reassembledIn;
+    std::atomic<uint64_t> m_fragmentsIn;
+    std::atomic<uint64_t> m_reassemblyFailed;
+
+    std::atomic<uint64_t> m_fecParityOut;
+    std::atomic<uint64_t> m_fecOverheadBytes;
+    std::atomic<uint64_t> m_fecRecovered;
+    std::atomic<uint64_t> m_fecUnrecovered;
+    std::atomic<int>      m_fecGroupSize;
+
+    std::atomic<uint64_t> m_redundantCopiesOut;
+    std::atomic<uint64_t> m_redundancyOverheadBytes;
+    std::atomic<uint64_t> m_redundancyRecovered;
+    std::atomic<uint64_t> m_redundantDuplicates;
+    std::atomic<int>      m_redundantCopies;
+
+    std::atomic<uint64_t> m_latencyBuckets[COPLAY_LATENCY_BUCKETS];
+    std::atomic<uint64_t> m_latencyCount;
+    std::atomic<uint64_t> m_latencySumUsec;
+};
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "cbase.h"
+#include "coplay_steamtransport.h"
+#include "steam/isteamnetworkingutils.h"
+
+#include "tier0/valve_minmax_off.h"
+#include "coplay_relay.h"
+#include "tier0/valve_minmax_on.h"
+
+// what Steam puts in front of each message in a packet, its size and number and which lane it's on. A bit over to be safe
+#define COPLAY_STEAM_MESSAGE_OVERHEAD 16
+
+static int GetSteamSendFlags(int sendFlags)
+{
+    int steamFlags = k_nSteamNetworkingSend_UseCurrentThread;
+    if (sendFlags & eCoplaySend_Reliable)
+        steamFlags |= k_nSteamNetworkingSend_ReliableNoNagle;
+    else if (sendFlags & eCoplaySend_NoDrop)
+        steamFlags |= k_nSteamNetworkingSend_UnreliableNoNagle;
+    else
+        steamFlags |= k_nSteamNetworkingSend_UnreliableNoDelay;
+    return steamFlags;
+}
+
+static CoplaySendResult GetSendResult(EResult result)
+{
+    switch (result)
+    {
+    case k_EResultOK:
+        return eCoplaySendResult_OK;
+    case k_EResultLimitExceeded:
+        return eCoplaySendResult_QueueFull;
+    case k_EResultIgnored:
+        return eCoplaySendResult_Ignored;
+    case k_EResultNoConnection:
+    case k_EResultInvalidState:
+        return eCoplaySendResult_NoConnection;
+    default:
+        return eCoplaySendResult_Failed;
+    }
+}
+
+// SendMessages gives back a message number, or a negated EResult if it didn't go
+static CoplaySendResult GetSendMessagesResult(int64 messageNumber)
+{
+    return messageNumber >= 0 ? eCoplaySendResult_OK : GetSendResult((EResult)-messageNumber);
+}
+
+// Steam calls this from whichever thread it's on once the message is sent or thrown away
+static void FreePooledMessage(SteamNetworkingMessage_t *pMessage)
+{
+    CoplayPacketPool()->Free(pMessage->m_pData);
+}
+
+CoplaySendResult CCoplaySteamTransport::Send(HCoplayPeer hPeer, const void *pData, int len, int sendFlags)
+{
+    int lane = CoplaySendLane(sendFlags);
+    if (lane == 0)
+        return GetSendResult(SteamNetworkingSockets()->SendMessageToConnection(hPeer, pData, len, GetSteamSendFlags(sendFlags), NULL));
+
+    // only SendMessages takes a lane
+    SteamNetworkingMessage_t *pMessage = SteamNetworkingUtils()->AllocateMessage(len);
+    if (!pMessage)
+        return eCoplaySendResult_Failed;
+
+    memcpy(pMessage->m_pData, pData, len);
+    pMessage->m_conn    = hPeer;
+    pMessage->m_nFlags  = GetSteamSendFlags(sendFlags);
+    pMessage->m_idxLane = (uint16)lane;
+
+    int64 result;
+    SteamNetworkingSockets()->SendMessages(1, &pMessage, &result);
+    return GetSendMessagesResult(result);
+}
+
+CoplaySendResult CCoplaySteamTransport::SendPooled(HCoplayPeer hPeer, uint8_t *pBuffer, int len, int sendFlags)
+{
+    // no buffer of its own, Steam sends straight out of ours
+    SteamNetworkingMessage_t *pMessage = SteamNetworkingUtils()->AllocateMessage(0);
+    if (!pMessage)
+    {
+        CoplayPacketPool()->Free(pBuffer);
+        return eCoplaySendResult_Failed;
+    }
+
+    pMessage->m_pData       = pBuffer;
+    pMessage->m_cbSize      = len;
+    pMessage->m_pfnFreeData = FreePooledMessage;
+    pMessage->m_conn        = hPeer;
+    pMessage->m_nFlags      = GetSteamSendFlags(sendFlags);
+    pMessage->m_idxLane     = (uint16)CoplaySendLane(sendFlags);
+
+    // Steam releases the message whether it went or not
+    int64 result;
+    SteamNetworkingSockets()->SendMessages(1, &pMessage, &result);
+    return GetSendMessagesResult(result);
+}
+
+int CCoplaySteamTransport::Receive(HCoplayPeer hPeer, CoplayDatagram_t *pDatagrams, int maxDatagrams)
+{
+    SteamNetworkingMessage_t *messages[COPLAY_MAX_PACKETS];
+    if (maxDatagrams > COPLAY_MAX_PACKETS)
+        maxDatagrams = COPLAY_MAX_PACKETS;
+
+    int numMessages = SteamNetworkingSockets()->ReceiveMessagesOnConnection(hPeer, messages, maxDatagrams);
+    SteamNetworkingMicroseconds now = numMessages > 0 ? SteamNetworkingUtils()->GetLocalTimestamp() : 0;
+    for (int i = 0; i < numMessages; i++)
+    {
+        pDatagrams[i].pData   = (const uint8*)messages[i]->GetData();
+        pDatagrams[i].len     = messages[i]->GetSize();
+        pDatagrams[i].pHandle = messages[i];
+        pDatagrams[i].ageUsec = now - messages[i]->m_usecTimeReceived;
+    }
+    return numMessages;
+}
+
+void CCoplaySteamTransport::Release(CoplayDatagram_t *pDatagrams, int numDatagrams)
+{
+    for (int i = 0; i < numDatagrams; i++)
+        ((SteamNetworkingMessage_t*)pDatagrams[i].pHandle)->Release();
+}
+
+bool CCoplaySteamTransport::ConfigureLanes(HCoplayPeer hPeer, int numLanes, const int *pPriorities, const uint16_t *pWeights)
+{
+    return SteamNetworkingSockets()->ConfigureConnectionLanes(hPeer, numLanes, pPriorities, pWeights) == k_EResultOK;
+}
+
+int CCoplaySteamTransport::GetMaxDatagramSize(HCoplayPeer hPeer)
+{
+    // read only, what's left of the MTU once the packet's own headers are in. It's never set on the connection
+    // itself so it comes back as inherited, anything under OK is an error
+    int32  dataSize = 0;
+    size_t cbSize   = sizeof(dataSize);
+    ESteamNetworkingConfigDataType dataType;
+    ESteamNetworkingGetConfigValueResult result = SteamNetworkingUtils()->GetConfigValue(k_ESteamNetworkingConfig_MTU_DataSize,
+        k_ESteamNetworkingConfig_Connection, hPeer, &dataType, &dataSize, &cbSize);
+    if (result < k_ESteamNetworkingGetConfigValue_OK || dataType != k_ESteamNetworkingConfig_Int32)
+        return 0;
+    return dataSize > COPLAY_STEAM_MESSAGE_OVERHEAD ? dataSize - COPLAY_STEAM_MESSAGE_OVERHEAD : 0;
+}
+
+bool CCoplaySteamTransport::SetSendRate(HCoplayPeer hPeer, int rateMin, int rateMax, int bufferSize)
+{
+    ISteamNetworkingUtils *pUtils = SteamNetworkingUtils();
+
+    // the min can't be over the max in between. Going up the max has to move first, going down below the old min it's the min.
+    // Inherited comes back fine here, it's still what the connection's running with
+    int32  oldMin = 0;
+    size_t cbSize = sizeof(oldMin);
+    ESteamNetworkingConfigDataType dataType;
+    ESteamNetworkingGetConfigValueResult result = pUtils->GetConfigValue(k_ESteamNetworkingConfig_SendRateMin,
+        k_ESteamNetworkingConfig_Connection, hPeer, &dataType, &oldMin, &cbSize);
+    bool bMinFirst = result >= k_ESteamNetworkingGetConfigValue_OK && dataType == k_ESteamNetworkingConfig_Int32 && rateMax < oldMin;
+
+    ESteamNetworkingConfigValue first  = bMinFirst ? k_ESteamNetworkingConfig_SendRateMin : k_ESteamNetworkingConfig_SendRateMax;
+    ESteamNetworkingConfigValue second = bMinFirst ? k_ESteamNetworkingConfig_SendRateMax : k_ESteamNetworkingConfig_SendRateMin;
+    return pUtils->SetConnectionConfigValueInt32(hPeer, first, bMinFirst ? rateMin : rateMax) &&
+           pUtils->SetConnectionConfigValueInt32(hPeer, second, bMinFirst ? rateMax : rateMin) &&
+           pUtils->SetConnectionConfigValueInt32(hPeer, k_ESteamNetworkingConfig_SendBufferSize, bufferSize);
+}
+
+void CCoplaySteamTransport::Close(HCoplayPeer hPeer, int reason, const char *pszDebug, bool bEnableLinger)
+{
+    SteamNetworkingSockets()->CloseConnection(hPeer, reason, pszDebug, bEnableLinger);
+}
+
+bool CCoplaySteamTransport::GetRemoteID(HCoplayPeer hPeer, uint64_t *pID)
+{
+    SteamNetConnectionInfo_t info;
+    if (!SteamNetworkingSockets()->GetConnectionInfo(hPeer, &info))
+        return false;
+    *pID = info.m_identityRemote.GetSteamID64();
+    return true;
+}
+
+bool CCoplaySteamTransport::GetStatus(HCoplayPeer hPeer, CoplayPeerStatus_t *pStatus)
+{
+    SteamNetConnectionRealTimeStatus_t status;
+    if (SteamNetworkingSockets()->GetConnectionRealTimeStatus(hPeer, &status, 0, NULL) != k_EResultOK)
+        return false;
+
+    pStatus->pingMs        = status.m_nPing;
+    pStatus->qualityLocal  = status.m_flConnectionQualityLocal;
+    pStatus->qualityRemote = status.m_flConnectionQualityRemote;
+
+    pStatus->pendingUnreliableBytes = status.m_cbPendingUnreliable;
+    pStatus->pendingReliableBytes   = status.m_cbPendingReliable;
+    pStatus->queueTimeUsec          = status.m_usecQueueTime;
+    pStatus->sendRateBytesPerSec    = status.m_nSendRateBytesPerSecond;
+    return true;
+}
@@ -0,0 +1,42 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#ifndef COPLAY_STEAMTRANSPORT_H
+#define COPLAY_STEAMTRANSPORT_H
+#pragma once
+
+#include "steam/isteamnetworkingsockets.h"
+
+#include "tier0/valve_minmax_off.h"
+#include "coplay_transport.h"
+#include "tier0/valve_minmax_on.h"
+
+// Peers are Steam connections, handles are HSteamNetConnections.
+// Making the connections in the first place is still up to the host and client, that part is all Steam IDs and lobbies.
+class CCoplaySteamTransport : public ICoplayTransport
+{
+public:
+    virtual const char *GetName() const { return "steam"; }
+
+    virtual CoplaySendResult Send(HCoplayPeer hPeer, const void *pData, int len, int sendFlags);
+    virtual CoplaySendResult SendPooled(HCoplayPeer hPeer, uint8_t *pBuffer, int len, int sendFlags);
+    virtual int  Receive(HCoplayPeer hPeer, CoplayDatagram_t *pDatagrams, int maxDatagrams);
+    virtual void Release(CoplayDatagram_t *pDatagrams, int numDatagrams);
+    virtual bool ConfigureLanes(HCoplayPeer hPeer, int numLanes, const int *pPriorities, const uint16_t *pWeights);
+    virtual int  GetMaxDatagramSize(HCoplayPeer hPeer);
+    virtual bool SetSendRate(HCoplayPeer hPeer, int rateMin, int rateMax, int bufferSize);
+    virtual void Close(HCoplayPeer hPeer, int reason, const char *pszDebug, bool bEnableLinger);
+
+    virtual bool GetRemoteID(HCoplayPeer hPeer, uint64_t *pID);
+    virtual bool GetStatus(HCoplayPeer hPeer, CoplayPeerStatus_t *pStatus);
+};
+
+#endif
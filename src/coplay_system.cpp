@@ -29,13 +29,57 @@ ConVar coplay_use_lobbies("coplay_use_lobbies", "1", FCVAR_HIDDEN, "Use Steam Lo
 ConVar coplay_debuglog_steamconnstatus("coplay_debuglog_steamconnstatus", "0", 0, "Prints more detailed steam connection statuses.\n");
 ConVar coplay_debuglog_lobbyupdated("coplay_debuglog_lobbyupdated", "0", 0, "Prints when a lobby is created, joined or left.\n");
 ConVar coplay_autoopen("coplay_autoopen", "1", FCVAR_ARCHIVE, "Open game for listening on local server start");
+ConVar coplay_log_ratelimit("coplay_log_ratelimit", "20", 0, "Most messages of each kind a connection thread may print per second, the rest are counted and dropped. 0 for no limit.\n", true, 0, false, 0);
+ConVar coplay_metrics_file("coplay_metrics_file", "", 0, "Periodically write relay statistics in the Prometheus text format to this file, relative to the game directory unless absolute. Empty to disable.\n");
+ConVar coplay_metrics_interval("coplay_metrics_interval", "10", 0, "Seconds between writes of coplay_metrics_file.\n", true, 1, false, 0);
+ConVar coplay_profile_budget_ms("coplay_profile_budget_ms", "0", 0, "Warn when Coplay takes more than this many milliseconds of a frame on the main thread, 0 to never warn.\n", true, 0, false, 0);
+ConVar coplay_metrics_port("coplay_metrics_port", "0", 0, "Serve relay statistics in the Prometheus text format at http://127.0.0.1:<port>/metrics, 0 to disable.\n", true, 0, true, 65535);
+ConVar coplay_sendrate_autotune("coplay_sendrate_autotune", "1", FCVAR_ARCHIVE,
+    "Sets Steam's send rate limits and send buffer for each connection from sv_maxrate when hosting or rate when connected, "
+    "and how much is actually being sent. Checked every second, see coplay_status for what's applied.\n");
+ConVar coplay_ratecontrol("coplay_ratecontrol", "0", FCVAR_ARCHIVE,
+    "Clients only. Turns rate and cl_updaterate down while the connection to the host is losing packets or backing up, "
+    "and back up to what you had them at once it recovers. Checked every second, see coplay_status.\n");
+ConVar coplay_ratecontrol_minrate("coplay_ratecontrol_minrate", "20000", FCVAR_ARCHIVE, "Lowest rate coplay_ratecontrol turns it down to.\n", true, 1000, false, 0);
+ConVar coplay_ratecontrol_minupdaterate("coplay_ratecontrol_minupdaterate", "20", FCVAR_ARCHIVE, "Lowest cl_updaterate coplay_ratecontrol turns it down to.\n", true, 10, false, 0);
 extern ConVar coplay_joinfilter;
 
+// seconds between over budget warnings, the frames in between are just counted
+#define COPLAY_BUDGET_WARNING_INTERVAL 5.0f
+// seconds between looking at the rate cvars and what each connection is sending
+#define COPLAY_SENDTUNE_INTERVAL 1.0f
+// seconds of the connection to the host each rate control sample covers
+#define COPLAY_RATECONTROL_INTERVAL 1.0f
+
+static void CallbackRateChanged(IConVar* var, const char* pOldValue, float flOldValue)
+{
+    ConVarRef rate(var);
+    if (CCoplaySystem::GetInstance())
+        CCoplaySystem::GetInstance()->GetCallbackThread()->SetRate(rate.GetInt());
+}
+ConVar coplay_callback_rate("coplay_callback_rate", "500", FCVAR_ARCHIVE, "How many times a second to check for Steam connection changes, separately from the frame rate. 0 to only check once a frame.\n",
+                            true, 0, true, 1000, CallbackRateChanged);
+
 CCoplaySystem::CCoplaySystem() : CAutoGameSystemPerFrame("CoplaySystem")
 {
 	m_oldConnectCallback = NULL;
+	m_bRoleFailed = false;
+	m_bGameConnected = false;
+	m_gameServerPort = 27015;
+	m_clientPort = 27005;
+	m_lastMetricsWrite = 0;
+	m_lastBudgetWarning = 0;
+	m_overBudgetFrames = 0;
+	m_lastSendTuning = 0;
+	m_bRateControlled = false;
+	m_playerRate = 0;
+	m_playerUpdateRate = 0;
+	m_rateControlPackets = 0;
+	m_rateControlDropped = 0;
+	m_lastRateControl = 0;
 	s_instance = this;
-	SetRole(eConnectionRole_UNAVAILABLE);
+	// we're made before the engine interfaces are, SetRole has nothing to end yet anyway
+	m_role = eConnectionRole_UNAVAILABLE;
 }
 
 CCoplaySystem* CCoplaySystem::GetInstance()
@@ -58,12 +102,21 @@ bool CCoplaySystem::Init()
     }
 
     SteamNetworkingUtils()->InitRelayNetworkAccess();
+    PublishRelayConfig();
+
+    m_callbackThread.SetRate(coplay_callback_rate.GetInt());
+    m_callbackThread.Begin();
     return true;
 }
 
 void CCoplaySystem::Shutdown()
 {
+    m_callbackThread.End();
+    // rate is archived, what we turned it down to shouldn't end up in their config
+    StopRateControl();
     SetRole(eConnectionRole_INACTIVE);
+    m_metricsServer.Close();
+    PrintRelayLog();
 }
 
 static void ConnectOverride(const CCommand& args)
@@ -75,6 +128,7 @@ FnCommandCallback_t g_oldDisconnectCallback;
 static void DisconnectOverride(const CCommand& args)
 {
     g_oldDisconnectCallback(args);
+    AUTO_LOCK(CCoplaySystem::GetInstance()->GetLock());
     if (CCoplaySystem::GetInstance()->GetRole() == eConnectionRole_CLIENT)
         CCoplaySystem::GetInstance()->GetClient()->CloseConnection();
 
@@ -113,8 +167,47 @@ void CCoplaySystem::PostInit()
 
 void CCoplaySystem::Update(float frametime)
 {
-    SteamAPI_RunCallbacks();
-    GetHost()->Update();
+    m_profile.BeginFrame();
+    {
+        CCoplayScopedStage stage(&m_profile, eCoplayStage_Total);
+        RunFrame();
+    }
+    m_profile.EndFrame();
+    CheckFrameBudget();
+}
+
+void CCoplaySystem::RunFrame()
+{
+    AUTO_LOCK(m_lock);
+    UpdateGameState();
+
+    {
+        CCoplayScopedStage stage(&m_profile, eCoplayStage_Callbacks);
+        SteamAPI_RunCallbacks();
+        if (!m_callbackThread.IsPumping())
+            SteamNetworkingSockets()->RunCallbacks();
+    }
+    if (m_bRoleFailed)
+        SetRole(eConnectionRole_INACTIVE);
+
+    {
+        CCoplayScopedStage stage(&m_profile, eCoplayStage_Host);
+        GetHost()->Update();
+    }
+    {
+        CCoplayScopedStage stage(&m_profile, eCoplayStage_Client);
+        GetClient()->Update();
+    }
+    UpdateSendTuning();
+    UpdateRateControl();
+    {
+        CCoplayScopedStage stage(&m_profile, eCoplayStage_Log);
+        PrintRelayLog();
+    }
+    {
+        CCoplayScopedStage stage(&m_profile, eCoplayStage_Metrics);
+        UpdateMetrics();
+    }
 
 #ifndef COPLAY_DONT_UPDATE_RPC
 
@@ -122,6 +215,7 @@ void CCoplaySystem::Update(float frametime)
     static float lastupdated = 0;
     if (lastupdated + 1 < gpGlobals->realtime)
     {
+        CCoplayScopedStage stage(&m_profile, eCoplayStage_RichPresence);
         if (GetHost()->IsHosting() && coplay_joinfilter.GetInt() != eP2PFilter_CONTROLLED)
         {
             std::string connect = "+" + GetConnectCommand();
@@ -156,6 +250,293 @@ void CCoplaySystem::Update(float frametime)
     }
 }
 
+void CCoplaySystem::CheckFrameBudget()
+{
+    int64 budgetUsec = (int64)(coplay_profile_budget_ms.GetFloat() * 1000);
+    int64 frameUsec  = m_profile.GetLastFrameUsec();
+    if (budgetUsec <= 0 || frameUsec <= budgetUsec)
+        return;
+
+    m_overBudgetFrames++;
+    if (m_lastBudgetWarning + COPLAY_BUDGET_WARNING_INTERVAL > gpGlobals->realtime)
+        return;
+
+    Warning("[Coplay Warning] Coplay took %.2fms of this frame, over coplay_profile_budget_ms (%i frames over since the last warning). See coplay_profile\n",
+            frameUsec / 1000.0, m_overBudgetFrames);
+    m_overBudgetFrames  = 0;
+    m_lastBudgetWarning = gpGlobals->realtime;
+}
+
+void CCoplaySystem::PrintRelayLog()
+{
+    CCoplayLogRing *pRing = CoplayLogRing();
+    pRing->SetRateLimit(coplay_log_ratelimit.GetInt());
+
+    CoplayLogRecord_t record;
+    while (pRing->Pop(&record))
+    {
+        switch (record.level)
+        {
+        case eCoplayLogLevel_Info:
+            ConColorMsg(COPLAY_MSG_COLOR, "%s", record.text);
+            break;
+        case eCoplayLogLevel_Debug:
+            ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "%s", record.text);
+            break;
+        case eCoplayLogLevel_Warning:
+            Warning("%s", record.text);
+            break;
+        default:
+            Msg("%s", record.text);
+            break;
+        }
+    }
+
+    for (int i = 0; i < eCoplayLog_Count; i++)
+    {
+        uint32 suppressed = pRing->TakeSuppressed((CoplayLogType)i);
+        if (suppressed > 0)
+            ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] Skipped %u %s messages, see coplay_log_ratelimit\n",
+                        suppressed, CoplayLogTypeName((CoplayLogType)i));
+    }
+
+    uint32 overflowed = pRing->TakeOverflowed();
+    if (overflowed > 0)
+        ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] Lost %u connection thread messages, the log ring was full\n", overflowed);
+}
+
+void CCoplaySystem::UpdateMetrics()
+{
+    uint16 port = coplay_metrics_port.GetInt();
+    if (port != m_metricsServer.GetPort())
+    {
+        m_metricsServer.Close();
+        if (port != 0)
+        {
+            if (m_metricsServer.Open(port))
+                ConColorMsg(COPLAY_MSG_COLOR, "[Coplay] Serving metrics at http://127.0.0.1:%u/metrics\n", port);
+            else
+            {
+                Warning("[Coplay Warning] Couldn't listen for metrics on port %u!\n", port);
+                coplay_metrics_port.SetValue(0);
+            }
+        }
+    }
+
+    bool writeFile = coplay_metrics_file.GetString()[0] && m_lastMetricsWrite + coplay_metrics_interval.GetFloat() < gpGlobals->realtime;
+    bool scraped   = m_metricsServer.Poll();
+    if (!writeFile && !scraped)
+        return;
+
+    CoplayMetrics_t metrics;
+    CollectMetrics(metrics);
+    std::string text = CoplayFormatMetrics(metrics);
+
+    if (scraped)
+        m_metricsServer.Respond(text);
+
+    if (writeFile)
+    {
+        m_lastMetricsWrite = gpGlobals->realtime;
+
+        char path[MAX_PATH];
+        if (V_IsAbsolutePath(coplay_metrics_file.GetString()))
+            V_strncpy(path, coplay_metrics_file.GetString(), sizeof(path));
+        else
+            V_snprintf(path, sizeof(path), "%s/%s", engine->GetGameDirectory(), coplay_metrics_file.GetString());
+
+        if (!CoplayWriteMetricsFile(path, text))
+            ConColorMsg(COPLAY_DEBUG_MSG_COLOR, "[Coplay Debug] Couldn't write metrics to %s\n", path);
+    }
+}
+
+void CCoplaySystem::CollectMetrics(CoplayMetrics_t &metrics)
+{
+    metrics.numConnections       = 0;
+    metrics.numPendingHandshakes = 0;
+
+    metrics.numProfiledFrames = m_profile.GetNumFrames();
+    for (int i = 0; i < eCoplayStage_Count; i++)
+        m_profile.GetStage((CoplayFrameStage)i, &metrics.frameStages[i]);
+
+    switch (m_role)
+    {
+    case eConnectionRole_HOST:
+        metrics.pszRole              = "host";
+        metrics.numConnections       = GetHost()->GetConnectionCount();
+        metrics.numPendingHandshakes = GetHost()->GetPendingConnectionCount();
+        for (int i = 0; i < GetHost()->GetConnectionCount(); i++)
+            AddMetricsPeer(metrics, GetHost()->GetConnection(i));
+        break;
+    case eConnectionRole_CLIENT:
+        metrics.pszRole = "client";
+        if (GetClient()->GetConnection())
+        {
+            metrics.numConnections = 1;
+            AddMetricsPeer(metrics, GetClient()->GetConnection());
+        }
+        break;
+    default:
+        metrics.pszRole = "inactive";
+        break;
+    }
+}
+
+void CCoplaySystem::AddMetricsPeer(CoplayMetrics_t &metrics, CCoplayConnection *pConnection)
+{
+    CoplayMetricsPeer_t peer = {};
+    // the relay thread keeps going, this only reads its atomics
+    pConnection->GetStats().Snapshot(&peer.stats);
+
+    uint64_t remoteID;
+    if (pConnection->m_pTransport->GetRemoteID(pConnection->m_hPeer, &remoteID))
+        peer.steamID = remoteID;
+
+    CoplayPeerStatus_t status;
+    if (pConnection->m_pTransport->GetStatus(pConnection->m_hPeer, &status))
+    {
+        peer.hasSteamStatus = true;
+        peer.pingMs         = status.pingMs;
+        peer.qualityLocal   = status.qualityLocal;
+        peer.qualityRemote  = status.qualityRemote;
+        peer.pendingUnreliableBytes = status.pendingUnreliableBytes;
+        peer.pendingReliableBytes   = status.pendingReliableBytes;
+        peer.queueTimeUsec          = status.queueTimeUsec;
+    }
+
+    metrics.peers.push_back(peer);
+}
+
+void CCoplaySystem::UpdateSendTuning()
+{
+    float elapsed = gpGlobals->realtime - m_lastSendTuning;
+    if (elapsed < COPLAY_SENDTUNE_INTERVAL)
+        return;
+    m_lastSendTuning = gpGlobals->realtime;
+
+    if (!coplay_sendrate_autotune.GetBool())
+        return;
+
+    // what the game holds each of its netchannels to, the host's are capped by sv_maxrate and ours by rate
+    if (m_role == eConnectionRole_HOST)
+    {
+        ConVarRef sv_maxrate("sv_maxrate");
+        int gameRate = sv_maxrate.IsValid() ? sv_maxrate.GetInt() : 0;
+        for (int i = 0; i < GetHost()->GetConnectionCount(); i++)
+            TuneConnection(GetHost()->GetConnection(i), gameRate, elapsed);
+    }
+    else if (m_role == eConnectionRole_CLIENT && GetClient()->GetConnection())
+    {
+        ConVarRef rate("rate");
+        TuneConnection(GetClient()->GetConnection(), rate.IsValid() ? rate.GetInt() : 0, elapsed);
+    }
+}
+
+void CCoplaySystem::TuneConnection(CCoplayConnection *pConnection, int gameRate, float elapsed)
+{
+    CoplayRelayStatsSnapshot_t stats;
+    pConnection->GetStats().Snapshot(&stats);
+
+    CoplayRateSettings_t settings;
+    settings.gameRate     = gameRate;
+    settings.measuredRate = stats.bytesOut > pConnection->m_tunedBytesOut ? (int)((stats.bytesOut - pConnection->m_tunedBytesOut) / elapsed) : 0;
+    pConnection->m_tunedBytesOut = stats.bytesOut;
+
+    CoplaySendTuning_t tuning;
+    CoplayTuneSendRate(settings, &tuning);
+    HCoplayPeer hPeer = pConnection->m_hPeer;
+    if (hPeer == pConnection->m_tunedPeer && tuning.IsCloseTo(pConnection->m_sendTuning))
+        return;
+
+    if (pConnection->m_pTransport->SetSendRate(hPeer, tuning.rateMin, tuning.rateMax, tuning.bufferSize))
+    {
+        pConnection->m_sendTuning = tuning;
+        pConnection->m_tunedPeer  = hPeer;
+    }
+}
+
+void CCoplaySystem::UpdateRateControl()
+{
+    if (gpGlobals->realtime - m_lastRateControl < COPLAY_RATECONTROL_INTERVAL)
+        return;
+    m_lastRateControl = gpGlobals->realtime;
+
+    CCoplayConnection *pConnection = m_role == eConnectionRole_CLIENT ? GetClient()->GetConnection() : NULL;
+    if (!coplay_ratecontrol.GetBool() || !pConnection || !IsGameConnected())
+    {
+        StopRateControl();
+        return;
+    }
+
+    ConVarRef rate("rate");
+    ConVarRef cl_updaterate("cl_updaterate");
+    if (!rate.IsValid() || !cl_updaterate.IsValid())
+        return;
+
+    // the player setting them themselves starts us over from what they picked
+    if (m_bRateControlled && (rate.GetInt() != m_rateControl.GetRate() || cl_updaterate.GetInt() != m_rateControl.GetUpdateRate()))
+        m_bRateControlled = false;
+
+    CoplayRelayStatsSnapshot_t stats;
+    pConnection->GetStats().Snapshot(&stats);
+    uint64 packets = stats.packetsOut + stats.packetsIn;
+    uint64 dropped = stats.peerSendFailed + stats.staleShed + stats.reassemblyFailed;
+
+    CoplayPeerStatus_t status;
+    if (!m_bRateControlled)
+    {
+        m_bRateControlled  = true;
+        m_playerRate       = rate.GetInt();
+        m_playerUpdateRate = cl_updaterate.GetInt();
+        m_rateControl.Reset(m_playerRate, m_playerUpdateRate);
+    }
+    else if (pConnection->m_pTransport->GetStatus(pConnection->m_hPeer, &status))
+    {
+        CoplayLinkSample_t sample;
+        sample.pingMs        = status.pingMs;
+        sample.qualityLocal  = status.qualityLocal;
+        sample.qualityRemote = status.qualityRemote;
+        sample.pendingBytes  = status.pendingUnreliableBytes + status.pendingReliableBytes;
+        sample.queueTimeUsec = status.queueTimeUsec;
+        // a new connection starts its stats over
+        sample.packets = packets >= m_rateControlPackets ? packets - m_rateControlPackets : packets;
+        sample.dropped = dropped >= m_rateControlDropped ? dropped - m_rateControlDropped : dropped;
+
+        CoplayRateLimits_t limits;
+        limits.maxRate       = m_playerRate;
+        limits.minRate       = coplay_ratecontrol_minrate.GetInt();
+        limits.maxUpdateRate = m_playerUpdateRate;
+        limits.minUpdateRate = coplay_ratecontrol_minupdaterate.GetInt();
+        if (m_rateControl.OnSample(sample, limits))
+        {
+            rate.SetValue(m_rateControl.GetRate());
+            cl_updaterate.SetValue(m_rateControl.GetUpdateRate());
+            // on the way back up it's a step every second, only the ends are worth saying
+            if (m_rateControl.GetProblem() != eCoplayLink_OK)
+                ConColorMsg(COPLAY_MSG_COLOR, "[Coplay] Connection to the host is struggling (%s), rate %i and cl_updaterate %i for now.\n",
+                            CoplayLinkProblemName(m_rateControl.GetProblem()), m_rateControl.GetRate(), m_rateControl.GetUpdateRate());
+            else if (m_rateControl.GetRate() == m_playerRate && m_rateControl.GetUpdateRate() == m_playerUpdateRate)
+                ConColorMsg(COPLAY_MSG_COLOR, "[Coplay] Connection to the host recovered, rate and cl_updaterate are back to yours.\n");
+        }
+    }
+    m_rateControlPackets = packets;
+    m_rateControlDropped = dropped;
+}
+
+void CCoplaySystem::StopRateControl()
+{
+    if (!m_bRateControlled)
+        return;
+    m_bRateControlled = false;
+
+    ConVarRef rate("rate");
+    ConVarRef cl_updaterate("cl_updaterate");
+    if (rate.IsValid())
+        rate.SetValue(m_playerRate);
+    if (cl_updaterate.IsValid())
+        cl_updaterate.SetValue(m_playerUpdateRate);
+}
+
 void CCoplaySystem::LevelInitPostEntity()
 {
     // ensure we're in a local game
@@ -180,6 +561,9 @@ void CCoplaySystem::LevelShutdownPreEntity()
 
 void CCoplaySystem::SetRole(ConnectionRole role)
 {
+	AUTO_LOCK(m_lock);
+	m_bRoleFailed = false;
+
 	// no role change
     if (m_role == role)
         return;
@@ -208,14 +592,35 @@ void CCoplaySystem::SetRole(ConnectionRole role)
 	m_role = role;
 }
 
+void CCoplaySystem::UpdateGameState()
+{
+	m_bGameConnected = engine->IsConnected();
+	ConVarRef clientport("clientport");
+	m_clientPort = clientport.GetInt();
+
+	// netchannel is set to NULL when disconnecting as a host. be safe
+	m_gameServerPort = 27015;
+	INetChannelInfo* netinfo = engine->GetNetChannelInfo();
+	if (!netinfo)
+		return;
+
+	std::string ip = netinfo->GetAddress();
+	if (ip.find(':') != std::string::npos && ip.length() - 1 != ip.find(':'))
+		m_gameServerPort = std::stoi(ip.substr(ip.find(':') + 1, std::string::npos));
+}
+
 void CCoplaySystem::ConnectToHost(CSteamID host, std::string passcode)
 {
+	AUTO_LOCK(m_lock);
+	UpdateGameState();
 	SetRole(eConnectionRole_CLIENT);
 	GetClient()->ConnectToHost(host, passcode);
 }
 
+// Usually on the callback thread
 void CCoplaySystem::ConnectionStatusUpdated(SteamNetConnectionStatusChangedCallback_t* pParam)
 {
+	AUTO_LOCK(m_lock);
 	bool stateFailed = false;
 	//Msg("%i %i %s\n", pParam->m_info.m_eState, pParam->m_info.m_eEndReason, pParam->m_info.m_szEndDebug);
     switch(m_role)
@@ -230,9 +635,9 @@ void CCoplaySystem::ConnectionStatusUpdated(SteamNetConnectionStatusChangedCallb
 		break;
 	}
 
-	// the role is no longer active so return to the disconnected state
+	// the role is no longer active so return to the disconnected state, leaving the role resets cvars so that waits for the main thread
 	if (stateFailed)
-		SetRole(eConnectionRole_INACTIVE);
+		m_bRoleFailed = true;
 }
 
 void CCoplaySystem::LobbyJoined(LobbyEnter_t* pParam)
@@ -335,6 +740,8 @@ void CCoplaySystem::CoplayConnect(const CCommand& args)
 
 void CCoplaySystem::OpenSocket(const CCommand& args)
 {
+    AUTO_LOCK(m_lock);
+    UpdateGameState();
     SetRole(eConnectionRole_HOST);
 }
 
@@ -382,6 +789,7 @@ void CCoplaySystem::PrintAbout(const CCommand& args)
 
 std::string CCoplaySystem::GetConnectCommand()
 {
+    AUTO_LOCK(m_lock);
     std::string cmd = "";
     if (m_role != eConnectionRole_HOST)
         return cmd;
@@ -437,6 +845,7 @@ void CCoplaySystem::InvitePlayer(const CCommand& args)
 
 void CCoplaySystem::PrintStatus(const CCommand& args)
 {
+    AUTO_LOCK(m_lock);
     const char *role;
     int count;
     if (m_role == eConnectionRole_CLIENT)
@@ -455,6 +864,52 @@ void CCoplaySystem::PrintStatus(const CCommand& args)
         count = 0;
     }
     Msg("Role: %s\nConnection Count: %i\n", role, count);
+
+    for (int i = 0; i < count; i++)
+    {
+        CCoplayConnection *pConnection = m_role == eConnectionRole_CLIENT ? GetClient()->GetConnection() : GetHost()->GetConnection(i);
+        if (!pConnection)
+            continue;
+
+        CoplayThreadPlacement_t placement = pConnection->GetPlacement();
+        char cores[128];
+        CoplayFormatCoreList(placement.affinityMask, cores, sizeof(cores));
+        Msg("  Port %u: cores %s, %s priority\n", pConnection->m_port, cores, CoplayThreadPriorityName(placement.priority));
+
+        const CoplaySendTuning_t &tuning = pConnection->m_sendTuning;
+        if (tuning.IsSet())
+            Msg("    Steam send rate %i-%i KB/s, send buffer %i KB\n", tuning.rateMin / 1024, tuning.rateMax / 1024, tuning.bufferSize / 1024);
+        else
+            Msg("    Steam send rate and buffer left at Steam's defaults\n");
+
+        if (m_role == eConnectionRole_CLIENT && m_bRateControlled)
+        {
+            Msg("    Rate control: rate %i, cl_updaterate %i, yours are %i and %i. Last sample: %s\n", m_rateControl.GetRate(), m_rateControl.GetUpdateRate(),
+                m_playerRate, m_playerUpdateRate, CoplayLinkProblemName(m_rateControl.GetProblem()));
+        }
+
+        CoplayRelayStatsSnapshot_t stats;
+        pConnection->GetStats().Snapshot(&stats);
+        Msg("    Fragments: %llu datagrams sent in %llu pieces, %llu put back together from %llu pieces, %llu never finished\n",
+            (unsigned long long)stats.fragmentedOut, (unsigned long long)stats.fragmentsOut, (unsigned long long)stats.reassembledIn,
+            (unsigned long long)stats.fragmentsIn, (unsigned long long)stats.reassemblyFailed);
+        if (stats.fecGroupSize > 0)
+        {
+            Msg("    FEC: a parity every %i datagrams, %llu sent adding %llu KB, %llu rebuilt from the peer and %llu that couldn't be\n",
+                stats.fecGroupSize, (unsigned long long)stats.fecParityOut, (unsigned long long)(stats.fecOverheadBytes / 1024),
+                (unsigned long long)stats.fecRecovered, (unsigned long long)stats.fecUnrecovered);
+        }
+        if (stats.redundantCopies > 0 || stats.redundantCopiesOut > 0)
+        {
+            Msg("    Usercmd copies: %i with each now, %llu sent adding %llu KB\n", stats.redundantCopies,
+                (unsigned long long)stats.redundantCopiesOut, (unsigned long long)(stats.redundancyOverheadBytes / 1024));
+        }
+        if (stats.redundancyRecovered > 0 || stats.redundantDuplicates > 0)
+        {
+            Msg("    Usercmd copies from the peer: %llu passed on for ones that never came, %llu left out as already had\n",
+                (unsigned long long)stats.redundancyRecovered, (unsigned long long)stats.redundantDuplicates);
+        }
+    }
 }
 
 #ifdef COPLAY_USE_LOBBIES
@@ -473,8 +928,30 @@ void CCoplaySystem::ListLobbies(const CCommand& args)
 }
 #endif
 
+void CCoplaySystem::PrintProfile(const CCommand& args)
+{
+    if (args.ArgC() > 1 && !V_stricmp(args.Arg(1), "reset"))
+    {
+        m_profile.Reset();
+        return;
+    }
+
+    Msg("Main thread time over the last %i frames:\n", m_profile.GetNumFrames());
+    Msg("%-14s | %10s | %10s\n", "Stage", "Avg (us)", "Max (us)");
+    for (int i = 0; i < eCoplayStage_Count; i++)
+    {
+        CoplayFrameStageTiming_t timing;
+        m_profile.GetStage((CoplayFrameStage)i, &timing);
+        Msg("%-14s | %10.1f | %10lld\n", CoplayFrameStageName((CoplayFrameStage)i), timing.avgUsec, (long long)timing.maxUsec);
+    }
+
+    if (coplay_profile_budget_ms.GetFloat() > 0)
+        Msg("Budget: %.2fms\n", coplay_profile_budget_ms.GetFloat());
+}
+
 void CCoplaySystem::ReRandomizePassword(const CCommand& args)
 {
+    AUTO_LOCK(m_lock);
     if (GetRole() != eConnectionRole_HOST)
     {
         ConColorMsg(COPLAY_MSG_COLOR, "You're not currently hosting a game.");
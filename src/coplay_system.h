@@ -21,6 +21,14 @@
 #include "coplay_connection.h"
 #include "coplay_client.h"
 #include "coplay_host.h"
+#include "coplay_steamtransport.h"
+#include "coplay_callbackthread.h"
+
+#include "tier0/valve_minmax_off.h"
+#include "coplay_metrics.h"
+#include "coplay_frameprofile.h"
+#include "coplay_ratecontrol.h"
+#include "tier0/valve_minmax_on.h"
 
 struct PendingConnection// for when we make a steam connection to ask for a password but
     // not letting it send packets to the game server yet
@@ -50,19 +58,41 @@ public:
     ConnectionRole GetRole() { return m_role;  }
     CCoplayClient* GetClient() {return &m_client; }
     CCoplayHost*   GetHost() { return &m_host; }
+    ICoplayTransport* GetTransport() { return &m_steamTransport; }
+
+    // Held by whoever is touching the host or client, Steam's status changes come in on the callback thread
+    CThreadMutex& GetLock() { return m_lock; }
+    void ConnectionStatusUpdated(SteamNetConnectionStatusChangedCallback_t* pParam);
+
+    // What the engine looked like the last time the main thread checked, for code that could be on the callback thread
+    bool   IsGameConnected() { return m_bGameConnected != 0; }
+    uint16 GetGameServerPort() { return m_gameServerPort; }
+    uint16 GetClientPort() { return m_clientPort; }
+    CCoplayCallbackThread* GetCallbackThread() { return &m_callbackThread; }
 
     CON_COMMAND_MEMBER_F(CCoplaySystem, "coplay_connect", CoplayConnect, "Connect to a Coplay game", FCVAR_NONE);
 
     std::string GetConnectCommand();
 private:
 	void SetRole(ConnectionRole role);
+	void UpdateGameState();
 	void ConnectToHost(CSteamID host, std::string passcode = "");
 	void OnListLobbiesCmd(LobbyMatchList_t *pLobbyMatchList, bool IOFailure);
 
+	void RunFrame();
+	void CheckFrameBudget();
+	void PrintRelayLog();
+	void UpdateMetrics();
+	void CollectMetrics(CoplayMetrics_t &metrics);
+	void AddMetricsPeer(CoplayMetrics_t &metrics, CCoplayConnection *pConnection);
+	void UpdateSendTuning();
+	void TuneConnection(CCoplayConnection *pConnection, int gameRate, float elapsed);
+	void UpdateRateControl();
+	void StopRateControl(); // puts back the player's own rates
+
 
 private:
     // Callbacks
-    STEAM_CALLBACK(CCoplaySystem, ConnectionStatusUpdated, SteamNetConnectionStatusChangedCallback_t);
     STEAM_CALLBACK(CCoplaySystem, JoinGame,                GameRichPresenceJoinRequested_t);
 #ifdef COPLAY_USE_LOBBIES
     STEAM_CALLBACK(CCoplaySystem, LobbyJoined,             LobbyEnter_t);
@@ -82,6 +112,7 @@ private:
 	CON_COMMAND_MEMBER_F(CCoplaySystem, "coplay_invite", InvitePlayer, "Prints a command for other people to join you", FCVAR_NONE);
 	CON_COMMAND_MEMBER_F(CCoplaySystem, "coplay_rerandomize_password", ReRandomizePassword, "Randomizes the password given by coplay_getconnectcommand", FCVAR_NONE);
 	CON_COMMAND_MEMBER_F(CCoplaySystem, "coplay_status", PrintStatus, "", FCVAR_NONE);
+	CON_COMMAND_MEMBER_F(CCoplaySystem, "coplay_profile", PrintProfile, "Prints how long each part of Coplay's per frame update takes on the main thread. 'coplay_profile reset' starts over", FCVAR_NONE);
 
 #ifdef COPLAY_USE_LOBBIES
     CON_COMMAND_MEMBER_F(CCoplaySystem, "coplay_listlobbies", ListLobbies, "List all joinable lobbies", FCVAR_NONE);
@@ -93,10 +124,35 @@ private:
     FnCommandCallback_t m_oldConnectCallback;
 
     ConnectionRole m_role;
+    bool           m_bRoleFailed; // set off the main thread, the role is dropped in the next Update
+
+	CThreadMutex          m_lock;
+	CCoplayCallbackThread m_callbackThread;
+	CInterlockedInt       m_bGameConnected; // connection threads check it too
+	uint16                m_gameServerPort;
+	uint16                m_clientPort;
 
+	CCoplaySteamTransport m_steamTransport;
 	CCoplayClient	   m_client;
 	CCoplayHost		   m_host;
 
 	std::string	m_queuedCommand;
+
+	CCoplayMetricsServer m_metricsServer;
+	float                m_lastMetricsWrite;
+
+	CCoplayFrameProfile m_profile;
+	float               m_lastBudgetWarning;
+	int                 m_overBudgetFrames;
+
+	float m_lastSendTuning;
+
+	CCoplayRateController m_rateControl;
+	bool                  m_bRateControlled;
+	int                   m_playerRate;       // what they had rate and cl_updaterate at before we started
+	int                   m_playerUpdateRate;
+	uint64                m_rateControlPackets; // the connection's stats as of the last sample
+	uint64                m_rateControlDropped;
+	float                 m_lastRateControl;
 };
 #endif
@@ -0,0 +1,215 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_threadplacement.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#define COPLAY_MAX_CORES 64
+// how much further ahead than the main thread a High thread gets, in nice levels
+#define COPLAY_HIGH_NICE_BOOST 5
+
+static const char *s_priorityNames[eCoplayThreadPriority_Count] = { "normal", "high", "realtime" };
+
+const char *CoplayThreadPriorityName(CoplayThreadPriority priority)
+{
+    if (priority < 0 || priority >= eCoplayThreadPriority_Count)
+        return "unknown";
+    return s_priorityNames[priority];
+}
+
+bool CoplayParseCoreList(const char *pszList, uint64_t *pMask)
+{
+    uint64_t mask = 0;
+    const char *p = pszList;
+    while (*p)
+    {
+        char *pEnd;
+        long first = strtol(p, &pEnd, 10);
+        if (pEnd == p)
+            return false;
+        long last = first;
+
+        p = pEnd;
+        while (isspace((unsigned char)*p))
+            p++;
+        if (*p == '-')
+        {
+            p++;
+            last = strtol(p, &pEnd, 10);
+            if (pEnd == p)
+                return false;
+            p = pEnd;
+        }
+
+        if (first < 0 || last < first || last >= COPLAY_MAX_CORES)
+            return false;
+        for (long i = first; i <= last; i++)
+            mask |= 1ull << i;
+
+        while (isspace((unsigned char)*p))
+            p++;
+        if (*p == ',')
+            p++;
+        else if (*p)
+            return false;
+    }
+
+    *pMask = mask;
+    return true;
+}
+
+void CoplayFormatCoreList(uint64_t mask, char *pszOut, int outSize)
+{
+    if (!mask)
+    {
+        snprintf(pszOut, outSize, "any");
+        return;
+    }
+
+    int len = 0;
+    pszOut[0] = '\0';
+    for (int i = 0; i < COPLAY_MAX_CORES && len < outSize; i++)
+    {
+        if (!(mask & (1ull << i)))
+            continue;
+
+        int last = i;
+        while (last + 1 < COPLAY_MAX_CORES && (mask & (1ull << (last + 1))))
+            last++;
+
+        const char *pszSeparator = len ? "," : "";
+        if (last > i)
+            len += snprintf(pszOut + len, outSize - len, "%s%i-%i", pszSeparator, i, last);
+        else
+            len += snprintf(pszOut + len, outSize - len, "%s%i", pszSeparator, i);
+        i = last;
+    }
+}
+
+#ifdef _WIN32
+static void ApplyAffinity(uint64_t wanted, CoplayThreadPlacement_t *pResult)
+{
+    DWORD_PTR processMask, systemMask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+        return;
+
+    // cores we can't have are left out, if that's all of them we go back to anywhere
+    DWORD_PTR mask = (DWORD_PTR)wanted & processMask;
+    if (!SetThreadAffinityMask(GetCurrentThread(), mask ? mask : processMask))
+        return;
+    pResult->affinityMask = mask;
+}
+
+static void ApplyPriority(CoplayThreadPriority wanted, CoplayThreadPlacement_t *pResult)
+{
+    static const int s_threadPriorities[eCoplayThreadPriority_Count] =
+    {
+        THREAD_PRIORITY_NORMAL,
+        THREAD_PRIORITY_HIGHEST,
+        THREAD_PRIORITY_TIME_CRITICAL,
+    };
+
+    for (int priority = wanted; priority > eCoplayThreadPriority_Normal; priority--)
+    {
+        if (SetThreadPriority(GetCurrentThread(), s_threadPriorities[priority]))
+        {
+            pResult->priority = (CoplayThreadPriority)priority;
+            return;
+        }
+    }
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+}
+#elif defined(__linux__)
+static void ApplyAffinity(uint64_t wanted, CoplayThreadPlacement_t *pResult)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    long numCores = sysconf(_SC_NPROCESSORS_CONF);
+    for (int i = 0; i < COPLAY_MAX_CORES && i < numCores; i++)
+    {
+        if (wanted & (1ull << i))
+            CPU_SET(i, &set);
+    }
+
+    // with nothing left to pin to, take whatever the main thread is allowed. Its tid is the pid
+    bool pinned = CPU_COUNT(&set) > 0;
+    if (!pinned && sched_getaffinity(getpid(), sizeof(set), &set))
+        return;
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) || !pinned)
+        return;
+
+    // read it back, a cpuset can still take cores away from us
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set))
+        return;
+    for (int i = 0; i < COPLAY_MAX_CORES; i++)
+    {
+        if (CPU_ISSET(i, &set))
+            pResult->affinityMask |= 1ull << i;
+    }
+}
+
+static void ApplyPriority(CoplayThreadPriority wanted, CoplayThreadPlacement_t *pResult)
+{
+    sched_param param = {};
+    if (wanted >= eCoplayThreadPriority_Realtime)
+    {
+        // the lowest FIFO priority is still ahead of every normal thread, no need to go past the audio servers
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        if (!pthread_setschedparam(pthread_self(), SCHED_FIFO, &param))
+        {
+            pResult->priority = eCoplayThreadPriority_Realtime;
+            return;
+        }
+    }
+
+    // nice only means anything to normal threads, so come off FIFO first
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+
+    // setpriority takes a tid on Linux and only changes that thread
+    errno = 0;
+    int baseNice = getpriority(PRIO_PROCESS, getpid());
+    if (errno)
+        baseNice = 0;
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    if (wanted >= eCoplayThreadPriority_High && !setpriority(PRIO_PROCESS, tid, baseNice - COPLAY_HIGH_NICE_BOOST))
+    {
+        pResult->priority = eCoplayThreadPriority_High;
+        return;
+    }
+    setpriority(PRIO_PROCESS, tid, baseNice);
+}
+#else
+// nothing we can rely on elsewhere, the result says so
+static void ApplyAffinity(uint64_t wanted, CoplayThreadPlacement_t *pResult) {}
+static void ApplyPriority(CoplayThreadPriority wanted, CoplayThreadPlacement_t *pResult) {}
+#endif
+
+void CoplayApplyThreadPlacement(const CoplayThreadPlacement_t &wanted, CoplayThreadPlacement_t *pResult)
+{
+    *pResult = CoplayThreadPlacement_t();
+    ApplyAffinity(wanted.affinityMask, pResult);
+    ApplyPriority(wanted.priority, pResult);
+}
@@ -0,0 +1,49 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Which cores a thread runs on and how much the scheduler favours it over the game's own threads.
+// Always done from inside the thread itself, CThread doesn't give us a handle that works the same everywhere.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_THREADPLACEMENT_H
+#define COPLAY_THREADPLACEMENT_H
+#pragma once
+
+#include <stdint.h>
+
+enum CoplayThreadPriority
+{
+    eCoplayThreadPriority_Normal = 0,
+    eCoplayThreadPriority_High,     // ahead of the game's threads where the OS lets us
+    eCoplayThreadPriority_Realtime, // SCHED_FIFO on Linux, time critical on Windows
+    eCoplayThreadPriority_Count
+};
+
+struct CoplayThreadPlacement_t
+{
+    uint64_t             affinityMask = 0; // a bit per core, 0 for wherever the OS likes
+    CoplayThreadPriority priority     = eCoplayThreadPriority_Normal;
+
+    bool operator==(const CoplayThreadPlacement_t &other) const { return affinityMask == other.affinityMask && priority == other.priority; }
+    bool operator!=(const CoplayThreadPlacement_t &other) const { return !(*this == other); }
+};
+
+// Cores like "2,3" or "0-1,6", empty for no pinning. Only the first 64 cores can be named
+bool CoplayParseCoreList(const char *pszList, uint64_t *pMask);
+// The other way, "any" for 0
+void CoplayFormatCoreList(uint64_t mask, char *pszOut, int outSize);
+const char *CoplayThreadPriorityName(CoplayThreadPriority priority);
+
+// Applies to the calling thread and fills in what we actually got, which can be less than we asked for.
+// Cores the machine doesn't have are left out instead of failing the whole mask, and a priority we aren't
+// allowed steps down until one works. Asking for Normal and no cores puts back what the main thread has
+void CoplayApplyThreadPlacement(const CoplayThreadPlacement_t &wanted, CoplayThreadPlacement_t *pResult);
+
+#endif
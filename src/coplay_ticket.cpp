@@ -0,0 +1,114 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_ticket.h"
+#include <random>
+#include <stdio.h>
+#include <string.h>
+
+#define SIPROUND                                                           \
+    do                                                                     \
+    {                                                                      \
+        v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32);         \
+        v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2;                             \
+        v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0;                             \
+        v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32);         \
+    } while (0)
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+uint64_t CoplaySipHash(const uint64_t key[2], const void *pData, size_t len)
+{
+    const uint8_t *pBytes = (const uint8_t*)pData;
+    uint64_t v0 = 0x736f6d6570736575ull ^ key[0];
+    uint64_t v1 = 0x646f72616e646f6dull ^ key[1];
+    uint64_t v2 = 0x6c7967656e657261ull ^ key[0];
+    uint64_t v3 = 0x7465646279746573ull ^ key[1];
+
+    size_t tail = len & 7;
+    const uint8_t *pEnd = pBytes + len - tail;
+    for (; pBytes != pEnd; pBytes += 8)
+    {
+        uint64_t m = 0;
+        for (int i = 0; i < 8; i++)
+            m |= (uint64_t)pBytes[i] << (8 * i);
+        v3 ^= m;
+        SIPROUND;
+        SIPROUND;
+        v0 ^= m;
+    }
+
+    uint64_t b = (uint64_t)len << 56;
+    for (size_t i = 0; i < tail; i++)
+        b |= (uint64_t)pBytes[i] << (8 * i);
+
+    v3 ^= b;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= b;
+    v2 ^= 0xff;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    SIPROUND;
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+#undef SIPROUND
+#undef ROTL
+
+uint64_t CoplayRandom64()
+{
+    std::random_device random;
+    return ((uint64_t)random() << 32) | random();
+}
+
+CCoplayTicketAuthority::CCoplayTicketAuthority()
+{
+    NewKey();
+}
+
+void CCoplayTicketAuthority::NewKey()
+{
+    m_key[0] = CoplayRandom64();
+    m_key[1] = CoplayRandom64();
+}
+
+uint64_t CCoplayTicketAuthority::Sign(uint64_t remoteID, uint64_t serial) const
+{
+    uint8_t message[16];
+    for (int i = 0; i < 8; i++)
+    {
+        message[i]     = (uint8_t)(remoteID >> (8 * i));
+        message[8 + i] = (uint8_t)(serial >> (8 * i));
+    }
+    return CoplaySipHash(m_key, message, sizeof(message));
+}
+
+std::string CCoplayTicketAuthority::Issue(uint64_t remoteID, uint64_t serial) const
+{
+    char ticket[40];
+    snprintf(ticket, sizeof(ticket), "%016llx.%016llx", (unsigned long long)serial, (unsigned long long)Sign(remoteID, serial));
+    return ticket;
+}
+
+bool CCoplayTicketAuthority::Verify(const std::string &ticket, uint64_t remoteID, uint64_t *pSerial) const
+{
+    unsigned long long serial, signature;
+    char end;
+    if (ticket.length() != 33 || sscanf(ticket.c_str(), "%16llx.%16llx%c", &serial, &signature, &end) != 2)
+        return false;
+
+    if (Sign(remoteID, serial) != signature)
+        return false;
+
+    *pSerial = serial;
+    return true;
+}
@@ -0,0 +1,49 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Reconnect tickets, handed to a client along with OK so it can come back after a dropped connection
+// without going through the join filter or passcode again.
+// A ticket names the session it came from and is signed for the SteamID it was given to, only the host that made it can check it.
+// How long a ticket is good for is up to the host, it only keeps a dropped session around for so long.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_TICKET_H
+#define COPLAY_TICKET_H
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// Keyed 64 bit hash (SipHash-2-4)
+uint64_t CoplaySipHash(const uint64_t key[2], const void *pData, size_t len);
+
+// From the OS, for keys and session serials
+uint64_t CoplayRandom64();
+
+class CCoplayTicketAuthority
+{
+public:
+    CCoplayTicketAuthority();
+
+    // Every ticket handed out before this stops being valid
+    void NewKey();
+
+    // Tickets are text so they fit in handshake messages, "<serial>.<signature>" in hex
+    std::string Issue(uint64_t remoteID, uint64_t serial) const;
+    bool        Verify(const std::string &ticket, uint64_t remoteID, uint64_t *pSerial) const;
+
+private:
+    uint64_t Sign(uint64_t remoteID, uint64_t serial) const;
+
+    uint64_t m_key[2];
+};
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_timer.h"
+#include "SDL2/SDL_timer.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#define COPLAY_PAUSE() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define COPLAY_PAUSE() __asm__ __volatile__("yield")
+#else
+#define COPLAY_PAUSE()
+#endif
+
+int64_t CoplayTimeUsec()
+{
+    static const uint64_t s_frequency = SDL_GetPerformanceFrequency();
+    uint64_t counter = SDL_GetPerformanceCounter();
+
+    // split it up so we dont overflow on machines with a high counter frequency
+    return (int64_t)((counter / s_frequency) * 1000000 + ((counter % s_frequency) * 1000000) / s_frequency);
+}
+
+#ifdef _WIN32
+static double FileTimeToSeconds(const FILETIME &kernel, const FILETIME &user)
+{
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart) / 10000000.0; // 100ns units
+}
+#endif
+
+double CoplayThreadCPUTime()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0;
+    return FileTimeToSeconds(kernel, user);
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return 0;
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#endif
+}
+
+double CoplayProcessCPUTime()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0;
+    return FileTimeToSeconds(kernel, user);
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts))
+        return 0;
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#endif
+}
+
+void CoplayCPUPause()
+{
+    COPLAY_PAUSE();
+}
@@ -0,0 +1,30 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Engine independent timing, safe to call from any thread.
+// Don't include cbase.h in here, the relay core and the standalone tools share this.
+#ifndef COPLAY_TIMER_H
+#define COPLAY_TIMER_H
+#pragma once
+
+#include <stdint.h>
+
+// Monotonic time in microseconds, only meaningful relative to other calls
+int64_t CoplayTimeUsec();
+
+// CPU time used by the calling thread / the whole process in seconds, 0 if the platform cant tell us
+double CoplayThreadCPUTime();
+double CoplayProcessCPUTime();
+
+// Tells the CPU we're in a spin loop, so it can ease off and let the other hyperthread have the core
+void CoplayCPUPause();
+
+#endif
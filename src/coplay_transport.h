@@ -0,0 +1,111 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// How the relay, host and client reach remote peers. Steam in game, loopback UDP or an in-process mock
+// for the tools, so the data plane can be run and profiled without a Steam client.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_TRANSPORT_H
+#define COPLAY_TRANSPORT_H
+#pragma once
+
+#include <stdint.h>
+#include "coplay_packetpool.h"
+
+// A connection to one remote peer, Steam's HSteamNetConnection fits in here as is
+typedef uint32_t HCoplayPeer;
+#define COPLAY_INVALID_PEER 0
+
+enum CoplaySendFlags
+{
+    eCoplaySend_Unreliable = 0, // source already handles it, dont do double duty for no reason
+    eCoplaySend_Reliable   = 1 << 0, // handshake messages
+    eCoplaySend_NoDrop     = 1 << 1, // still unreliable, but queue it behind everything else rather than drop it when backed up
+};
+
+// What became of a send, Steam's EResults boiled down to what the relay can do something about
+enum CoplaySendResult
+{
+    eCoplaySendResult_OK = 0,
+    eCoplaySendResult_QueueFull,    // k_EResultLimitExceeded, too much already waiting to go
+    eCoplaySendResult_Ignored,      // k_EResultIgnored, it would have waited too long so it was dropped
+    eCoplaySendResult_NoConnection, // closed, or not connected yet
+    eCoplaySendResult_Failed,       // anything else
+};
+
+// Which lane to send on goes in the send flags above the flags themselves, lane 0 is what you get without it
+#define COPLAY_SEND_LANE_SHIFT 8
+#define COPLAY_MAX_LANES       8
+inline int CoplaySendOnLane(int sendFlags, int lane) { return sendFlags | (lane << COPLAY_SEND_LANE_SHIFT); }
+inline int CoplaySendLane(int sendFlags) { return (sendFlags >> COPLAY_SEND_LANE_SHIFT) & (COPLAY_MAX_LANES - 1); }
+
+// A datagram handed out by a transport, valid until its given back with Release
+struct CoplayDatagram_t
+{
+    const uint8_t *pData;
+    int            len;
+    void          *pHandle; // whatever the transport needs to free it
+    int64_t        ageUsec; // how long it sat with the transport before we got it, 0 if it can't tell
+};
+
+struct CoplayPeerStatus_t
+{
+    int   pingMs;
+    float qualityLocal;  // 0-1 fraction of packets delivered to us, negative if unknown
+    float qualityRemote; // as reported by the remote end
+
+    // How backed up sending to the peer is, 0 from transports that send straight away
+    int     pendingUnreliableBytes;
+    int     pendingReliableBytes;
+    int64_t queueTimeUsec;      // how long something sent now would wait before it goes out
+    int     sendRateBytesPerSec; // what the transport thinks the path can take, 0 if it doesn't know
+};
+
+class ICoplayTransport
+{
+public:
+    virtual ~ICoplayTransport() {}
+
+    virtual const char *GetName() const = 0;
+
+    // Send and Receive on a peer may be called from its relay thread while other threads use other peers
+    virtual CoplaySendResult Send(HCoplayPeer hPeer, const void *pData, int len, int sendFlags) = 0;
+    // Takes over a buffer from CoplayPacketPool(), it goes back to the pool once the transport is done with it, sent or not.
+    // Transports that can send from it as is override this, the rest copy it like Send
+    virtual CoplaySendResult SendPooled(HCoplayPeer hPeer, uint8_t *pBuffer, int len, int sendFlags)
+    {
+        CoplaySendResult result = Send(hPeer, pBuffer, len, sendFlags);
+        CoplayPacketPool()->Free(pBuffer);
+        return result;
+    }
+    virtual int  Receive(HCoplayPeer hPeer, CoplayDatagram_t *pDatagrams, int maxDatagrams) = 0;
+    virtual void Release(CoplayDatagram_t *pDatagrams, int numDatagrams) = 0;
+
+    // Splits what we send to a peer into lanes that don't wait on each other. Lower priorities go first,
+    // lanes with the same priority share by weight. Transports without lanes send everything in order and say no
+    virtual bool ConfigureLanes(HCoplayPeer hPeer, int numLanes, const int *pPriorities, const uint16_t *pWeights) { return false; }
+
+    // Biggest datagram that goes to the peer in a single packet, anything bigger gets split by the transport.
+    // 0 if there's no such limit
+    virtual int GetMaxDatagramSize(HCoplayPeer hPeer) { return 0; }
+
+    // Bytes a second the transport may send to the peer and how much it can have waiting, transports that
+    // don't pace what they send say no
+    virtual bool SetSendRate(HCoplayPeer hPeer, int rateMin, int rateMax, int bufferSize) { return false; }
+
+    // reason is one of ESteamNetConnectionEnd / ConnectionEndReason, transports without one ignore it
+    virtual void Close(HCoplayPeer hPeer, int reason, const char *pszDebug, bool bEnableLinger) = 0;
+
+    // Something that identifies who's on the other end, a SteamID for Steam
+    virtual bool GetRemoteID(HCoplayPeer hPeer, uint64_t *pID) = 0;
+    virtual bool GetStatus(HCoplayPeer hPeer, CoplayPeerStatus_t *pStatus) = 0;
+};
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_udptransport.h"
+#include "coplay_relay.h"
+
+CCoplayUDPTransport::CCoplayUDPTransport()
+{
+}
+
+CCoplayUDPTransport::~CCoplayUDPTransport()
+{
+    for (size_t i = 0; i < m_peers.size(); i++)
+        Close((HCoplayPeer)(i + 1), 0, "", false);
+}
+
+CCoplayUDPTransport::Peer_t *CCoplayUDPTransport::GetPeer(HCoplayPeer hPeer) const
+{
+    if (hPeer == COPLAY_INVALID_PEER || hPeer > m_peers.size())
+        return NULL;
+    return m_peers[hPeer - 1];
+}
+
+HCoplayPeer CCoplayUDPTransport::OpenPeer(uint16_t localPort, int maxDatagramSize)
+{
+    Peer_t *pPeer = new Peer_t;
+    pPeer->remote    = IPaddress();
+    pPeer->socket    = SDLNet_UDP_Open(localPort);
+    pPeer->ppPackets = pPeer->socket ? SDLNet_AllocPacketV(COPLAY_MAX_PACKETS, maxDatagramSize) : NULL;
+    if (!pPeer->ppPackets)
+    {
+        if (pPeer->socket)
+            SDLNet_UDP_Close(pPeer->socket);
+        delete pPeer;
+        return COPLAY_INVALID_PEER;
+    }
+
+    m_peers.push_back(pPeer);
+    return (HCoplayPeer)m_peers.size();
+}
+
+void CCoplayUDPTransport::SetRemote(HCoplayPeer hPeer, const IPaddress &remote)
+{
+    Peer_t *pPeer = GetPeer(hPeer);
+    if (pPeer)
+        pPeer->remote = remote;
+}
+
+uint16_t CCoplayUDPTransport::GetLocalPort(HCoplayPeer hPeer) const
+{
+    Peer_t *pPeer = GetPeer(hPeer);
+    IPaddress *pAddr = pPeer ? SDLNet_UDP_GetPeerAddress(pPeer->socket, -1) : NULL;
+    return pAddr ? SDL_SwapBE16(pAddr->port) : 0;
+}
+
+CoplaySendResult CCoplayUDPTransport::Send(HCoplayPeer hPeer, const void *pData, int len, int sendFlags)
+{
+    Peer_t *pPeer = GetPeer(hPeer);
+    if (!pPeer)
+        return eCoplaySendResult_NoConnection;
+
+    UDPpacket packet = {};
+    packet.channel = -1;
+    packet.data    = (Uint8*)pData;
+    packet.len     = len;
+    packet.address = pPeer->remote;
+    return SDLNet_UDP_Send(pPeer->socket, -1, &packet) == 1 ? eCoplaySendResult_OK : eCoplaySendResult_Failed;
+}
+
+int CCoplayUDPTransport::Receive(HCoplayPeer hPeer, CoplayDatagram_t *pDatagrams, int maxDatagrams)
+{
+    Peer_t *pPeer = GetPeer(hPeer);
+    if (!pPeer)
+        return -1;
+
+    int numRecv = SDLNet_UDP_RecvV(pPeer->socket, pPeer->ppPackets);
+    if (numRecv <= 0)
+        return numRecv;
+
+    // RecvV fills the whole vector, anything past what the caller can take is dropped like a full socket buffer would
+    if (numRecv > maxDatagrams)
+        numRecv = maxDatagrams;
+
+    for (int i = 0; i < numRecv; i++)
+    {
+        pDatagrams[i].pData   = pPeer->ppPackets[i]->data;
+        pDatagrams[i].len     = pPeer->ppPackets[i]->len;
+        pDatagrams[i].pHandle = NULL;
+        pDatagrams[i].ageUsec = 0;
+    }
+    return numRecv;
+}
+
+void CCoplayUDPTransport::Close(HCoplayPeer hPeer, int reason, const char *pszDebug, bool bEnableLinger)
+{
+    Peer_t *pPeer = GetPeer(hPeer);
+    if (!pPeer)
+        return;
+
+    SDLNet_FreePacketV(pPeer->ppPackets);
+    SDLNet_UDP_Close(pPeer->socket);
+    delete pPeer;
+    m_peers[hPeer - 1] = NULL;
+}
+
+bool CCoplayUDPTransport::GetRemoteID(HCoplayPeer hPeer, uint64_t *pID)
+{
+    Peer_t *pPeer = GetPeer(hPeer);
+    if (!pPeer)
+        return false;
+    *pID = ((uint64_t)pPeer->remote.host << 32) | pPeer->remote.port;
+    return true;
+}
+
+bool CCoplayUDPTransport::GetStatus(HCoplayPeer hPeer, CoplayPeerStatus_t *pStatus)
+{
+    // nothing measured, its loopback
+    if (!GetPeer(hPeer))
+        return false;
+    *pStatus = CoplayPeerStatus_t();
+    pStatus->qualityLocal  = -1;
+    pStatus->qualityRemote = -1;
+    return true;
+}
+
+IPaddress CoplayLoopbackAddress(UDPsocket socket)
+{
+    IPaddress addr = {};
+    IPaddress *pLocal = SDLNet_UDP_GetPeerAddress(socket, -1);
+    if (pLocal)
+        addr.port = pLocal->port;
+    addr.host = SDL_SwapBE32(INADDR_LOOPBACK);
+    return addr;
+}
@@ -0,0 +1,62 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Plain UDP in place of Steam, every peer is its own socket sending to one remote address.
+// There's no handshake, reliability or encryption, it's meant for loopback testing and benchmarking.
+// No engine headers in here, don't include cbase.h.
+#ifndef COPLAY_UDPTRANSPORT_H
+#define COPLAY_UDPTRANSPORT_H
+#pragma once
+
+#include "coplay_transport.h"
+#include "SDL2/SDL_net.h"
+#include <vector>
+
+class CCoplayUDPTransport : public ICoplayTransport
+{
+public:
+    CCoplayUDPTransport();
+    ~CCoplayUDPTransport();
+
+    // Open every peer before any thread starts using the transport, localPort 0 lets the OS pick
+    HCoplayPeer OpenPeer(uint16_t localPort, int maxDatagramSize);
+    void        SetRemote(HCoplayPeer hPeer, const IPaddress &remote);
+    uint16_t    GetLocalPort(HCoplayPeer hPeer) const; // host order
+
+    virtual const char *GetName() const { return "udp"; }
+
+    // sendFlags are ignored, everything goes out unreliable
+    virtual CoplaySendResult Send(HCoplayPeer hPeer, const void *pData, int len, int sendFlags);
+    virtual int  Receive(HCoplayPeer hPeer, CoplayDatagram_t *pDatagrams, int maxDatagrams);
+    virtual void Release(CoplayDatagram_t *pDatagrams, int numDatagrams) {} // packets are reused by the next Receive
+    virtual void Close(HCoplayPeer hPeer, int reason, const char *pszDebug, bool bEnableLinger);
+
+    // the remote's address, host in the top 32 bits and port in the bottom 16, both in network order
+    virtual bool GetRemoteID(HCoplayPeer hPeer, uint64_t *pID);
+    virtual bool GetStatus(HCoplayPeer hPeer, CoplayPeerStatus_t *pStatus);
+
+private:
+    struct Peer_t
+    {
+        UDPsocket   socket;
+        UDPpacket **ppPackets;
+        IPaddress   remote;
+    };
+
+    Peer_t *GetPeer(HCoplayPeer hPeer) const;
+
+    std::vector<Peer_t*> m_peers; // handle is the index + 1, closed peers leave a NULL
+};
+
+// Loopback address for a socket opened on port 0
+IPaddress CoplayLoopbackAddress(UDPsocket socket);
+
+#endif
@@ -0,0 +1,511 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Runs a host with N players through real CCoplayRelays on one machine.
+//
+//   server stand-in <-> host relay i <-> mock Steam connection i <-> client relay i <-> client stand-in i
+//
+// The server sends every player a snapshot each tick, the clients send a usercmd at their cmdrate.
+// Datagrams carry a Source style netchannel header and the time they were sent, so latency is end to end through both relays.
+
+#include "coplay_relay.h"
+#include "coplay_timer.h"
+#include "coplay_udptransport.h"
+#include "coplay_mocksteam.h"
+#include "coplay_toolcommon.h"
+
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Same layout CNetChan::SendDatagram writes
+#define BENCH_NETCHAN_HEADER_SIZE 16 // seq, ack, flags, checksum, reliable state, challenge
+#define BENCH_PACKET_FLAG_RELIABLE  (1<<0)
+#define BENCH_PACKET_FLAG_CHALLENGE (1<<5)
+// and what we hide after it
+#define BENCH_STAMP_OFFSET BENCH_NETCHAN_HEADER_SIZE
+#define BENCH_MIN_DATAGRAM (BENCH_STAMP_OFFSET + 8)
+
+struct BenchOptions_t
+{
+    int    players     = 16;
+    int    tickrate    = 66;
+    int    cmdrate     = 0; // 0 follows tickrate
+    int    snapshotMin = 300;
+    int    snapshotMax = 1000;
+    int    usercmdMin  = 60;
+    int    usercmdMax  = 120;
+    int    reliablePct = 5;
+    double seconds     = 10;
+    double warmup      = 1;
+    int    hz          = 300;
+    int    spin        = 500;
+    int    maxSize     = 2048;
+};
+
+// One direction of traffic from a stand-in's point of view
+struct BenchStream_t
+{
+    int32_t sequence = 0;
+    int64_t sent     = 0;
+    int64_t received = 0;
+    int64_t bytes    = 0;
+};
+
+struct BenchPlayer_t
+{
+    // host side
+    UDPsocket                   hostRelaySocket = NULL;
+    IPaddress                   hostRelayAddr;
+    HCoplayPeer                 hHostSteam      = COPLAY_INVALID_PEER;
+    CCoplayRelay                hostRelay;
+    // client side
+    UDPsocket                   clientRelaySocket = NULL;
+    IPaddress                   clientRelayAddr;
+    HCoplayPeer                 hClientSteam      = COPLAY_INVALID_PEER;
+    CCoplayRelay                clientRelay;
+    UDPsocket                   clientSocket = NULL; // stands in for the players engine
+
+    BenchStream_t snapshots; // server -> client
+    BenchStream_t usercmds;  // client -> server
+};
+
+struct BenchRelayThread_t
+{
+    std::thread thread;
+    double      cpu        = 0;
+    int64_t     iterations = 0;
+};
+
+class CCoplayBench
+{
+public:
+    bool Run(const BenchOptions_t &options);
+
+private:
+    bool Setup();
+    void Teardown();
+
+    void ServerThread();
+    void ClientThread();
+
+    int  BuildDatagram(uint8_t *pBuffer, BenchStream_t &stream, int minSize, int maxSize, uint32_t &seed);
+    void OnArrival(BenchStream_t &stream, const UDPpacket *pPacket, CCoplayLatencySamples &latency);
+    void Report(double wallSeconds, double processCPU);
+
+private:
+    BenchOptions_t m_options;
+
+    CCoplayMockSteamSockets     m_steam;
+    std::vector<BenchPlayer_t*> m_players;
+    UDPsocket                   m_serverSocket = NULL;
+
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_sending;
+    int64_t           m_measureStart = 0;
+
+    std::vector<BenchRelayThread_t*> m_relayThreads;
+    CCoplayLatencySamples            m_snapshotLatency; // only touched by the client thread
+    CCoplayLatencySamples            m_usercmdLatency;  // only touched by the server thread
+};
+
+static uint32_t BenchRandom(uint32_t &seed)
+{
+    // xorshift, good enough for packet sizes
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+bool CCoplayBench::Setup()
+{
+    m_serverSocket = SDLNet_UDP_Open(0);
+    if (!m_serverSocket)
+    {
+        fprintf(stderr, "Couldn't open the server socket: %s\n", SDLNet_GetError());
+        return false;
+    }
+    IPaddress serverAddr = CoplayLoopbackAddress(m_serverSocket);
+
+    for (int i = 0; i < m_options.players; i++)
+    {
+        BenchPlayer_t *pPlayer = new BenchPlayer_t;
+        m_players.push_back(pPlayer);
+
+        pPlayer->hostRelaySocket   = SDLNet_UDP_Open(0);
+        pPlayer->clientRelaySocket = SDLNet_UDP_Open(0);
+        pPlayer->clientSocket      = SDLNet_UDP_Open(0);
+        if (!pPlayer->hostRelaySocket || !pPlayer->clientRelaySocket || !pPlayer->clientSocket)
+        {
+            fprintf(stderr, "Couldn't open sockets for player %i: %s\n", i, SDLNet_GetError());
+            return false;
+        }
+
+        pPlayer->hostRelayAddr   = CoplayLoopbackAddress(pPlayer->hostRelaySocket);
+        pPlayer->clientRelayAddr = CoplayLoopbackAddress(pPlayer->clientRelaySocket);
+
+        // the host relay sends back to the game server, the client relay to the players engine
+        IPaddress clientAddr = CoplayLoopbackAddress(pPlayer->clientSocket);
+        SDLNet_UDP_Bind(pPlayer->hostRelaySocket, 1, &serverAddr);
+        SDLNet_UDP_Bind(pPlayer->clientRelaySocket, 1, &clientAddr);
+
+        m_steam.CreateConnectionPair(&pPlayer->hHostSteam, &pPlayer->hClientSteam);
+        if (!pPlayer->hostRelay.Init(pPlayer->hostRelaySocket, &m_steam, pPlayer->hHostSteam)
+            || !pPlayer->clientRelay.Init(pPlayer->clientRelaySocket, &m_steam, pPlayer->hClientSteam))
+        {
+            fprintf(stderr, "Couldn't start relays for player %i\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+void CCoplayBench::Teardown()
+{
+    for (size_t i = 0; i < m_players.size(); i++)
+    {
+        BenchPlayer_t *pPlayer = m_players[i];
+        pPlayer->hostRelay.Shutdown();
+        pPlayer->clientRelay.Shutdown();
+        if (pPlayer->hostRelaySocket)
+            SDLNet_UDP_Close(pPlayer->hostRelaySocket);
+        if (pPlayer->clientRelaySocket)
+            SDLNet_UDP_Close(pPlayer->clientRelaySocket);
+        if (pPlayer->clientSocket)
+            SDLNet_UDP_Close(pPlayer->clientSocket);
+        delete pPlayer;
+    }
+    m_players.clear();
+
+    if (m_serverSocket)
+        SDLNet_UDP_Close(m_serverSocket);
+    m_serverSocket = NULL;
+}
+
+int CCoplayBench::BuildDatagram(uint8_t *pBuffer, BenchStream_t &stream, int minSize, int maxSize, uint32_t &seed)
+{
+    int len = minSize + (int)(BenchRandom(seed) % (uint32_t)(maxSize - minSize + 1));
+    if (len < BENCH_MIN_DATAGRAM)
+        len = BENCH_MIN_DATAGRAM;
+    if (len > m_options.maxSize)
+        len = m_options.maxSize;
+
+    uint8_t flags = BENCH_PACKET_FLAG_CHALLENGE;
+    if ((int)(BenchRandom(seed) % 100) < m_options.reliablePct)
+        flags |= BENCH_PACKET_FLAG_RELIABLE;
+
+    int32_t sequence = SDL_SwapLE32(++stream.sequence);
+    memset(pBuffer, 0, BENCH_NETCHAN_HEADER_SIZE);
+    memcpy(pBuffer, &sequence, 4);
+    pBuffer[8] = flags;
+
+    int64_t now = CoplayTimeUsec();
+    memcpy(pBuffer + BENCH_STAMP_OFFSET, &now, 8);
+
+    stream.sent++;
+    return len;
+}
+
+void CCoplayBench::OnArrival(BenchStream_t &stream, const UDPpacket *pPacket, CCoplayLatencySamples &latency)
+{
+    if (pPacket->len < BENCH_MIN_DATAGRAM)
+        return;
+
+    int64_t sentTime;
+    memcpy(&sentTime, pPacket->data + BENCH_STAMP_OFFSET, 8);
+
+    stream.received++;
+    stream.bytes += pPacket->len;
+    if (sentTime >= m_measureStart)
+        latency.Add(CoplayTimeUsec() - sentTime);
+}
+
+void CCoplayBench::ServerThread()
+{
+    uint8_t   *pBuffer = new uint8_t[m_options.maxSize];
+    UDPpacket *pPacket = SDLNet_AllocPacket(m_options.maxSize);
+    SDLNet_SocketSet set = SDLNet_AllocSocketSet(1);
+    SDLNet_UDP_AddSocket(set, m_serverSocket);
+
+    uint32_t seed    = 0x5eed0001;
+    int64_t interval = 1000000 / m_options.tickrate;
+    int64_t nextTick = CoplayTimeUsec();
+    while (!m_stop)
+    {
+        int64_t now = CoplayTimeUsec();
+        if (now >= nextTick && m_sending)
+        {
+            // everyone gets a snapshot every tick
+            for (size_t i = 0; i < m_players.size(); i++)
+            {
+                BenchPlayer_t *pPlayer = m_players[i];
+                UDPpacket out = {};
+                out.channel = -1;
+                out.data    = pBuffer;
+                out.len     = BuildDatagram(pBuffer, pPlayer->snapshots, m_options.snapshotMin, m_options.snapshotMax, seed);
+                out.address = pPlayer->hostRelayAddr;
+                SDLNet_UDP_Send(m_serverSocket, -1, &out);
+            }
+            nextTick += interval;
+            continue;
+        }
+
+        int64_t wait = m_sending ? (nextTick - now) / 1000 : 10;
+        if (SDLNet_CheckSockets(set, (Uint32)(wait > 0 ? wait : 0)) <= 0)
+            continue;
+
+        while (SDLNet_UDP_Recv(m_serverSocket, pPacket) > 0)
+        {
+            // host relays are told apart by their port, same as the real server does
+            for (size_t i = 0; i < m_players.size(); i++)
+            {
+                if (m_players[i]->hostRelayAddr.port == pPacket->address.port)
+                {
+                    OnArrival(m_players[i]->usercmds, pPacket, m_usercmdLatency);
+                    break;
+                }
+            }
+        }
+    }
+
+    SDLNet_FreeSocketSet(set);
+    SDLNet_FreePacket(pPacket);
+    delete[] pBuffer;
+}
+
+void CCoplayBench::ClientThread()
+{
+    uint8_t   *pBuffer = new uint8_t[m_options.maxSize];
+    UDPpacket *pPacket = SDLNet_AllocPacket(m_options.maxSize);
+    SDLNet_SocketSet set = SDLNet_AllocSocketSet((int)m_players.size());
+    for (size_t i = 0; i < m_players.size(); i++)
+        SDLNet_UDP_AddSocket(set, m_players[i]->clientSocket);
+
+    uint32_t seed = 0x5eed0002;
+    int cmdrate = m_options.cmdrate > 0 ? m_options.cmdrate : m_options.tickrate;
+    int64_t interval = 1000000 / cmdrate;
+    int64_t nextCmd  = CoplayTimeUsec();
+    while (!m_stop)
+    {
+        int64_t now = CoplayTimeUsec();
+        if (now >= nextCmd && m_sending)
+        {
+            for (size_t i = 0; i < m_players.size(); i++)
+            {
+                BenchPlayer_t *pPlayer = m_players[i];
+                UDPpacket out = {};
+                out.channel = -1;
+                out.data    = pBuffer;
+                out.len     = BuildDatagram(pBuffer, pPlayer->usercmds, m_options.usercmdMin, m_options.usercmdMax, seed);
+                out.address = pPlayer->clientRelayAddr;
+                SDLNet_UDP_Send(pPlayer->clientSocket, -1, &out);
+            }
+            nextCmd += interval;
+            continue;
+        }
+
+        int64_t wait = m_sending ? (nextCmd - now) / 1000 : 10;
+        if (SDLNet_CheckSockets(set, (Uint32)(wait > 0 ? wait : 0)) <= 0)
+            continue;
+
+        for (size_t i = 0; i < m_players.size(); i++)
+        {
+            if (!SDLNet_SocketReady(m_players[i]->clientSocket))
+                continue;
+            while (SDLNet_UDP_Recv(m_players[i]->clientSocket, pPacket) > 0)
+                OnArrival(m_players[i]->snapshots, pPacket, m_snapshotLatency);
+        }
+    }
+
+    SDLNet_FreeSocketSet(set);
+    SDLNet_FreePacket(pPacket);
+    delete[] pBuffer;
+}
+
+bool CCoplayBench::Run(const BenchOptions_t &options)
+{
+    m_options = options;
+    if (!Setup())
+    {
+        Teardown();
+        return false;
+    }
+
+    printf("%i players, %i tick, cmdrate %i, snapshots %i-%i bytes, usercmds %i-%i bytes, relays at %i hz spinning up to %ius, %.1fs\n",
+           m_options.players, m_options.tickrate, m_options.cmdrate > 0 ? m_options.cmdrate : m_options.tickrate,
+           m_options.snapshotMin, m_options.snapshotMax, m_options.usercmdMin, m_options.usercmdMax,
+           m_options.hz, m_options.spin, m_options.seconds);
+
+    m_stop    = false;
+    m_sending = true;
+    for (size_t i = 0; i < m_players.size(); i++)
+    {
+        CCoplayRelay *relays[2] = { &m_players[i]->hostRelay, &m_players[i]->clientRelay };
+        for (int j = 0; j < 2; j++)
+        {
+            BenchRelayThread_t *pThread = new BenchRelayThread_t;
+            CCoplayRelay *pRelay = relays[j];
+            pThread->thread = std::thread([this, pThread, pRelay]()
+            {
+                pThread->cpu = CoplayToolRunRelay(pRelay, m_options.hz, m_options.spin, m_stop, &pThread->iterations);
+            });
+            m_relayThreads.push_back(pThread);
+        }
+    }
+
+    double  cpuStart = CoplayProcessCPUTime();
+    int64_t start    = CoplayTimeUsec();
+    m_measureStart   = start + (int64_t)(m_options.warmup * 1000000);
+
+    std::thread server(&CCoplayBench::ServerThread, this);
+    std::thread client(&CCoplayBench::ClientThread, this);
+
+    CoplayToolWaitUntil(start + (int64_t)((m_options.warmup + m_options.seconds) * 1000000));
+    double wallSeconds = (CoplayTimeUsec() - start) / 1000000.0;
+
+    // stop sending and give whats in flight a moment to arrive
+    m_sending = false;
+    CoplayToolWaitUntil(CoplayTimeUsec() + 250000);
+    m_stop = true;
+
+    server.join();
+    client.join();
+    for (size_t i = 0; i < m_relayThreads.size(); i++)
+        m_relayThreads[i]->thread.join();
+
+    Report(wallSeconds, CoplayProcessCPUTime() - cpuStart);
+
+    for (size_t i = 0; i < m_relayThreads.size(); i++)
+        delete m_relayThreads[i];
+    m_relayThreads.clear();
+    Teardown();
+    return true;
+}
+
+void CCoplayBench::Report(double wallSeconds, double processCPU)
+{
+    BenchStream_t snapshots, usercmds;
+    int64_t refused = 0;
+    for (size_t i = 0; i < m_players.size(); i++)
+    {
+        BenchPlayer_t *pPlayer = m_players[i];
+        snapshots.sent     += pPlayer->snapshots.sent;
+        snapshots.received += pPlayer->snapshots.received;
+        snapshots.bytes    += pPlayer->snapshots.bytes;
+        usercmds.sent      += pPlayer->usercmds.sent;
+        usercmds.received  += pPlayer->usercmds.received;
+        usercmds.bytes     += pPlayer->usercmds.bytes;
+        refused += m_steam.GetSendsRefused(pPlayer->hHostSteam) + m_steam.GetSendsRefused(pPlayer->hClientSteam);
+    }
+
+    printf("%-24s sent %-9lld received %-9lld lost %-7lld %.2f MB\n", "snapshots (srv->cl)", (long long)snapshots.sent,
+           (long long)snapshots.received, (long long)(snapshots.sent - snapshots.received), snapshots.bytes / (1024.0 * 1024.0));
+    printf("%-24s sent %-9lld received %-9lld lost %-7lld %.2f MB\n", "usercmds (cl->srv)", (long long)usercmds.sent,
+           (long long)usercmds.received, (long long)(usercmds.sent - usercmds.received), usercmds.bytes / (1024.0 * 1024.0));
+    if (refused)
+        printf("mock Steam refused %lld sends with a full queue\n", (long long)refused);
+
+    printf("\nEnd to end latency, two relays and the mock Steam connection\n");
+    m_snapshotLatency.Print("snapshots (srv->cl)");
+    m_usercmdLatency.Print("usercmds (cl->srv)");
+
+    double relayCPU = 0;
+    for (size_t i = 0; i < m_relayThreads.size(); i++)
+        relayCPU += m_relayThreads[i]->cpu;
+
+    int64_t delivered = snapshots.received + usercmds.received;
+    int64_t hops      = delivered * 2; // every datagram passes through a host and a client relay
+    printf("\nThroughput    %.0f datagrams/s delivered, %.0f relay hops/s, %.3f Mbit/s\n", delivered / wallSeconds,
+           hops / wallSeconds, (snapshots.bytes + usercmds.bytes) * 8 / wallSeconds / 1000000.0);
+    printf("Relay threads %.3fs CPU (%.1f%% of a core) over %i threads, %.2fus CPU per relay hop\n", relayCPU,
+           relayCPU * 100.0 / wallSeconds, (int)m_relayThreads.size(), hops ? relayCPU * 1000000.0 / hops : 0.0);
+    printf("Process       %.3fs CPU (%.1f%% of a core), stand-ins included\n", processCPU, processCPU * 100.0 / wallSeconds);
+    // the pool only grows while it warms up, if this keeps climbing with -seconds something is holding on to buffers
+    printf("Packet pool   %i slabs of %i buffers, %i out when the relays stopped\n", CoplayPacketPool()->GetNumSlabs(),
+           COPLAY_POOL_SLAB_BUFFERS, CoplayPacketPool()->GetNumInUse());
+}
+
+static void PrintUsage()
+{
+    printf("usage: coplay_bench [options]\n"
+           "  -players <n>          simulated players, each gets a host and client relay (default 16)\n"
+           "  -tickrate <n>         server snapshots per second (default 66)\n"
+           "  -cmdrate <n>          client usercmds per second (default tickrate)\n"
+           "  -snapshot <min> <max> snapshot datagram size in bytes (default 300 1000)\n"
+           "  -usercmd <min> <max>  usercmd datagram size in bytes (default 60 120)\n"
+           "  -reliable <pct>       percentage of datagrams flagged as carrying reliable data (default 5)\n"
+           "  -seconds <s>          how long to measure (default 10)\n"
+           "  -warmup <s>           run this long before measuring latency (default 1)\n"
+           "  -hz <n>               relay loop rate like coplay_connectionthread_hz, 0 never sleeps (default 300)\n"
+           "  -spin <us>            how long the relay loop keeps spinning after traffic like coplay_connectionthread_spin_us (default 500)\n"
+           "  -maxsize <n>          biggest datagram the fake games send (default 2048)\n");
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions_t options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (CoplayToolArgIs(argc, argv, i, "-players"))
+            options.players = CoplayToolArgInt(argc, argv, i, options.players);
+        else if (CoplayToolArgIs(argc, argv, i, "-tickrate"))
+            options.tickrate = CoplayToolArgInt(argc, argv, i, options.tickrate);
+        else if (CoplayToolArgIs(argc, argv, i, "-cmdrate"))
+            options.cmdrate = CoplayToolArgInt(argc, argv, i, options.cmdrate);
+        else if (CoplayToolArgIs(argc, argv, i, "-snapshot"))
+        {
+            options.snapshotMin = CoplayToolArgInt(argc, argv, i, options.snapshotMin);
+            options.snapshotMax = CoplayToolArgInt(argc, argv, i, options.snapshotMax);
+        }
+        else if (CoplayToolArgIs(argc, argv, i, "-usercmd"))
+        {
+            options.usercmdMin = CoplayToolArgInt(argc, argv, i, options.usercmdMin);
+            options.usercmdMax = CoplayToolArgInt(argc, argv, i, options.usercmdMax);
+        }
+        else if (CoplayToolArgIs(argc, argv, i, "-reliable"))
+            options.reliablePct = CoplayToolArgInt(argc, argv, i, options.reliablePct);
+        else if (CoplayToolArgIs(argc, argv, i, "-seconds"))
+            options.seconds = CoplayToolArgFloat(argc, argv, i, options.seconds);
+        else if (CoplayToolArgIs(argc, argv, i, "-warmup"))
+            options.warmup = CoplayToolArgFloat(argc, argv, i, options.warmup);
+        else if (CoplayToolArgIs(argc, argv, i, "-hz"))
+            options.hz = CoplayToolArgInt(argc, argv, i, options.hz);
+        else if (CoplayToolArgIs(argc, argv, i, "-spin"))
+            options.spin = CoplayToolArgInt(argc, argv, i, options.spin);
+        else if (CoplayToolArgIs(argc, argv, i, "-maxsize"))
+            options.maxSize = CoplayToolArgInt(argc, argv, i, options.maxSize);
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (options.players < 1 || options.tickrate < 1 || options.seconds <= 0 || options.warmup < 0
+        || options.snapshotMin > options.snapshotMax || options.usercmdMin > options.usercmdMax
+        || options.maxSize < BENCH_MIN_DATAGRAM)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if (!CoplayToolInit())
+        return 1;
+
+    CCoplayBench bench;
+    bool ok = bench.Run(options);
+
+    CoplayToolShutdown();
+    return ok ? 0 : 1;
+}
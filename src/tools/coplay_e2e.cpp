@@ -0,0 +1,998 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Runs hosts and clients through the whole way in, listen socket, join filter or lobby, accept and passcode handshake,
+// then sends game traffic between them, all on the offline Steam emulator. Clients can be cut off partway through
+// to see them come back with their reconnect tickets.
+// The hosts and clients here follow what CCoplayHost and CCoplayClient do and use the same handshake code.
+// Everything runs on emulated time so the same options always give the same numbers.
+// Exits with 1 if anyone ended up somewhere they shouldn't have, so it works as a check too.
+
+#include "coplay_handshake.h"
+#include "coplay_steamemu.h"
+#include "coplay_ticket.h"
+#include "coplay_timer.h"
+#include "coplay_toolcommon.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define E2E_STEP_USEC 500
+#define E2E_LEGACY_POLL_USEC 50000 // older clients slept this long between handshake checks
+
+// Same values as ConnectionEndReason in coplay.h
+#define E2E_END_REMOTEISSUE 1003
+#define E2E_END_NOTFRIEND   1006
+#define E2E_END_BADPASSWORD 1007
+#define E2E_END_TIMEOUT     5003
+#define E2E_END_APP_MIN     1000 // k_ESteamNetConnectionEnd_App_Min
+#define E2E_END_APP_MAX     1999
+
+#define E2E_RESUME_GRACE_USEC 1000000 // COPLAY_RESUME_GRACE
+
+#define E2E_STAMP_SIZE 8
+
+// Same values as JoinFilter in coplay.h
+enum E2EFilter
+{
+    eE2EFilter_Controlled = 0,
+    eE2EFilter_Friends    = 1,
+    eE2EFilter_Everyone   = 2,
+};
+
+struct E2EOptions_t
+{
+    int       hosts       = 1;
+    int       clients     = 8; // per host
+    int       badPasscode = 0; // of those, how many get the wrong passcode
+    int       strangers   = 0; // and how many aren't friends with the host
+    int       legacy      = 0; // and how many wait to be asked for their passcode like older versions
+    int       drops       = 0; // and how many lose their connection a third of the way into the traffic
+    double    detectMs    = 10000; // how long the host takes to notice a drop, Steam's connected timeout by default
+    double    resumeWindow = 15; // like coplay_resume_window
+    E2EFilter filter      = eE2EFilter_Controlled;
+    bool      lobbies     = false;
+    double    latencyMs   = 25;
+    double    jitterMs    = 0;
+    double    lossPct     = 0;
+    int       tickrate    = 66;
+    double    seconds     = 10;
+    double    timeout     = 30; // like coplay_timeoutduration
+    uint32_t  seed        = 1;
+};
+
+enum E2EClientState
+{
+    eE2EClient_JoiningLobby,
+    eE2EClient_Connecting,
+    eE2EClient_Handshake,
+    eE2EClient_Ready,
+    eE2EClient_Failed,
+};
+
+struct E2EStream_t
+{
+    int64_t sent     = 0;
+    int64_t received = 0;
+    int64_t bytes    = 0;
+};
+
+class CE2EHost : public IEmuCallbacks
+{
+public:
+    CE2EHost(CCoplaySteamEmulator *pEmu, const E2EOptions_t &options, int index);
+
+    void Update();
+    void SendSnapshots(uint32_t &seed);
+    void ReceiveUsercmds(CCoplayLatencySamples &latency);
+
+    virtual void ConnectionStatusChanged(const EmuConnectionStatusChanged_t &status);
+    virtual void LobbyEntered(uint64_t lobbyID, bool bSuccess);
+
+    uint64_t    m_user;
+    uint64_t    m_lobby = 0;
+    std::string m_name;
+    std::string m_passcode;
+    E2EStream_t m_snapshots; // only sent counts here, received is on the clients
+    E2EStream_t m_usercmds;
+
+private:
+    struct Pending_t
+    {
+        HCoplayPeer hConn;
+        int64_t     startTime;
+        bool        bResumable;
+    };
+
+    // what CCoplayConnection keeps for resuming
+    struct Session_t
+    {
+        HCoplayPeer hConn;
+        uint64_t    remoteID;
+        uint64_t    serial;
+    };
+
+    // CoplayParkedSlot_t, there's no socket to keep here
+    struct Parked_t
+    {
+        uint64_t remoteID;
+        uint64_t serial;
+        int64_t  expireTime;
+    };
+
+    void AddConnection(HCoplayPeer hConn, int parkedSlot = -1);
+    void CreatePending(HCoplayPeer hConn, bool bResumable);
+    void RemoveConnection(HCoplayPeer hConn, int reason);
+    void ParkConnection(HCoplayPeer hConn, int reason);
+    CoplayHandshakeState PollPending(Pending_t &pending);
+    bool PassesJoinFilter(uint64_t remoteID);
+    bool HasSession(uint64_t remoteID);
+    int  TakeOverSession(uint64_t remoteID, uint64_t serial);
+    int  FindParked(uint64_t remoteID);
+
+    CCoplaySteamEmulator     *m_pEmu;
+    const E2EOptions_t       &m_options;
+    HEmuListenSocket          m_hListenSocket;
+    HEmuPollGroup             m_hPollGroup;
+    std::vector<Pending_t>    m_pending;
+    std::vector<Session_t>    m_connections;
+    std::vector<Parked_t>     m_parked;
+    CCoplayTicketAuthority    m_tickets;
+    uint64_t                  m_numSessions = 0;
+};
+
+class CE2EClient : public IEmuCallbacks
+{
+public:
+    CE2EClient(CCoplaySteamEmulator *pEmu, CE2EHost *pHost, const std::string &passcode);
+
+    void Start();
+    void Update();
+    void Drop(int64_t hostDetectUsec);
+    void SendUsercmd(uint32_t &seed);
+    void ReceiveSnapshots(CCoplayLatencySamples &latency);
+
+    virtual void ConnectionStatusChanged(const EmuConnectionStatusChanged_t &status);
+    virtual void LobbyEntered(uint64_t lobbyID, bool bSuccess);
+
+    uint64_t       m_user;
+    E2EClientState m_state;
+    int            m_endReason = 0;
+    int64_t        m_startTime = 0;
+    int64_t        m_readyTime = 0;
+    bool           m_bExpectRejection = false;
+    bool           m_bLegacy = false;
+    int64_t        m_nextPoll = 0;
+    int64_t        m_dropTime = 0;
+    int64_t        m_backTime = 0; // when we were ready again after the drop
+    bool           m_bResumed = false;
+    E2EStream_t    m_snapshots;
+    E2EStream_t    m_usercmds; // only sent counts here, received is on the host
+
+private:
+    void Fail(int reason);
+    bool TryResume(); // CCoplayClient::TryResume
+
+    CCoplaySteamEmulator                   *m_pEmu;
+    CE2EHost                               *m_pHost;
+    std::string                             m_passcode;
+    std::string                             m_ticket;       // from the host, for next time
+    std::string                             m_resumeTicket; // the one we're redialing with
+    uint64_t                                m_hostUser = 0;
+    HCoplayPeer                             m_hConn = COPLAY_INVALID_PEER;
+    std::unique_ptr<CCoplayClientHandshake> m_pHandshake;
+};
+
+static uint32_t E2ERandom(uint32_t &seed)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static bool E2EIsAppEndReason(int reason)
+{
+    return reason >= E2E_END_APP_MIN && reason <= E2E_END_APP_MAX;
+}
+
+static int E2EBuildDatagram(uint8_t *pBuffer, int64_t now, int minSize, int maxSize, uint32_t &seed)
+{
+    int len = minSize + E2ERandom(seed) % (maxSize - minSize + 1);
+    memset(pBuffer, 0, len);
+    memcpy(pBuffer, &now, E2E_STAMP_SIZE);
+    return len;
+}
+
+static void E2EOnArrival(E2EStream_t &stream, const CoplayDatagram_t &datagram, int64_t now, CCoplayLatencySamples &latency)
+{
+    int64_t sent;
+    memcpy(&sent, datagram.pData, E2E_STAMP_SIZE);
+    stream.received++;
+    stream.bytes += datagram.len;
+    latency.Add(now - sent);
+}
+
+CE2EHost::CE2EHost(CCoplaySteamEmulator *pEmu, const E2EOptions_t &options, int index) : m_pEmu(pEmu), m_options(options)
+{
+    m_user = pEmu->CreateUser();
+
+    char name[32];
+    snprintf(name, sizeof(name), "e2ehost%i", index);
+    m_name = name;
+
+    // like RandomizePasscode, just not from rand() so runs don't affect each other
+    static const char validchars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    uint32_t seed = options.seed * 2654435761u + index + 1;
+    for (int i = 0; i < 32; i++)
+        m_passcode += validchars[E2ERandom(seed) % (sizeof(validchars) - 1)];
+
+    // StartHosting
+    m_hListenSocket = pEmu->CreateListenSocketP2P(m_user);
+    m_hPollGroup    = pEmu->CreatePollGroup(m_user);
+    if (options.lobbies)
+        pEmu->CreateLobby(m_user, (EmuLobbyType)options.filter, options.clients + 1);
+}
+
+void CE2EHost::LobbyEntered(uint64_t lobbyID, bool bSuccess)
+{
+    if (!bSuccess)
+        return;
+    m_lobby = lobbyID;
+    m_pEmu->SetLobbyData(m_user, lobbyID, "hostname", m_name.c_str());
+}
+
+void CE2EHost::ConnectionStatusChanged(const EmuConnectionStatusChanged_t &status)
+{
+    switch (status.info.state)
+    {
+    case eEmuConnection_Connecting:
+        if (HasSession(status.info.remoteID))
+        {
+            m_pEmu->AcceptConnection(status.hConn);
+        }
+        else if (m_options.lobbies)
+        {
+            // anyone who isn't in the lobby is left hanging until they time out, same as the real host
+            if (m_pEmu->IsUserInLobby(m_lobby, status.info.remoteID))
+                m_pEmu->AcceptConnection(status.hConn);
+        }
+        else if (m_options.filter == eE2EFilter_Friends && !m_pEmu->HasFriend(m_user, status.info.remoteID))
+        {
+            RemoveConnection(status.hConn, E2E_END_NOTFRIEND);
+        }
+        else
+        {
+            m_pEmu->AcceptConnection(status.hConn);
+        }
+        break;
+
+    case eEmuConnection_Connected:
+        if (HasSession(status.info.remoteID))
+            CreatePending(status.hConn, true);
+        else if (m_options.filter == eE2EFilter_Controlled)
+            CreatePending(status.hConn, false);
+        else
+            AddConnection(status.hConn);
+        break;
+
+    case eEmuConnection_ClosedByPeer:
+    case eEmuConnection_ProblemDetectedLocally:
+        if (status.info.state == eEmuConnection_ClosedByPeer && E2EIsAppEndReason(status.info.endReason))
+            RemoveConnection(status.hConn, status.info.endReason);
+        else
+            ParkConnection(status.hConn, status.info.endReason);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void CE2EHost::AddConnection(HCoplayPeer hConn, int parkedSlot)
+{
+    Session_t session;
+    session.hConn  = hConn;
+    session.serial = ++m_numSessions; // only has to be different each time here
+    m_pEmu->GetRemoteID(hConn, &session.remoteID);
+
+    if (parkedSlot != -1)
+    {
+        m_parked.erase(m_parked.begin() + parkedSlot);
+    }
+    else
+    {
+        int oldSlot = FindParked(session.remoteID);
+        if (oldSlot != -1)
+            m_parked.erase(m_parked.begin() + oldSlot);
+    }
+
+    std::string ticket;
+    if (m_options.resumeWindow > 0)
+        ticket = m_tickets.Issue(session.remoteID, session.serial);
+
+    m_pEmu->SetConnectionPollGroup(hConn, m_hPollGroup);
+    if (parkedSlot != -1)
+        CoplaySendResumed(m_pEmu, hConn, ticket);
+    else
+        CoplaySendOK(m_pEmu, hConn, ticket);
+    m_connections.push_back(session);
+}
+
+void CE2EHost::CreatePending(HCoplayPeer hConn, bool bResumable)
+{
+    // CreatePendingConnection, the passcode or ticket may be here already
+    Pending_t pending = { hConn, m_pEmu->GetTimeUsec(), bResumable };
+    if (PollPending(pending) != eCoplayHandshake_Waiting)
+        return;
+
+    m_pending.push_back(pending);
+    if (!bResumable)
+        CoplaySendNeedPasscode(m_pEmu, hConn);
+}
+
+void CE2EHost::ParkConnection(HCoplayPeer hConn, int reason)
+{
+    for (size_t i = 0; i < m_connections.size() && m_options.resumeWindow > 0; i++)
+    {
+        if (m_connections[i].hConn == hConn)
+        {
+            Parked_t parked = { m_connections[i].remoteID, m_connections[i].serial,
+                                m_pEmu->GetTimeUsec() + (int64_t)(m_options.resumeWindow * 1000000) };
+            m_parked.push_back(parked);
+            m_connections.erase(m_connections.begin() + i);
+            m_pEmu->Close(hConn, reason, "", false);
+            return;
+        }
+    }
+    RemoveConnection(hConn, reason);
+}
+
+bool CE2EHost::PassesJoinFilter(uint64_t remoteID)
+{
+    if (m_options.lobbies)
+        return m_pEmu->IsUserInLobby(m_lobby, remoteID);
+    return m_options.filter != eE2EFilter_Friends || m_pEmu->HasFriend(m_user, remoteID);
+}
+
+bool CE2EHost::HasSession(uint64_t remoteID)
+{
+    if (m_options.resumeWindow <= 0)
+        return false;
+    if (FindParked(remoteID) != -1)
+        return true;
+    for (size_t i = 0; i < m_connections.size(); i++)
+    {
+        if (m_connections[i].remoteID == remoteID)
+            return true;
+    }
+    return false;
+}
+
+int CE2EHost::TakeOverSession(uint64_t remoteID, uint64_t serial)
+{
+    for (size_t i = 0; i < m_connections.size(); i++)
+    {
+        if (m_connections[i].remoteID == remoteID && m_connections[i].serial == serial)
+        {
+            ParkConnection(m_connections[i].hConn, E2E_END_TIMEOUT);
+            return (int)m_parked.size() - 1;
+        }
+    }
+    return -1;
+}
+
+int CE2EHost::FindParked(uint64_t remoteID)
+{
+    for (size_t i = 0; i < m_parked.size(); i++)
+    {
+        if (m_parked[i].remoteID == remoteID)
+            return (int)i;
+    }
+    return -1;
+}
+
+void CE2EHost::RemoveConnection(HCoplayPeer hConn, int reason)
+{
+    for (size_t i = 0; i < m_connections.size(); i++)
+    {
+        if (m_connections[i].hConn == hConn)
+        {
+            m_connections.erase(m_connections.begin() + i);
+            break;
+        }
+    }
+    for (size_t i = 0; i < m_pending.size(); i++)
+    {
+        if (m_pending[i].hConn == hConn)
+        {
+            m_pending.erase(m_pending.begin() + i);
+            break;
+        }
+    }
+    m_pEmu->Close(hConn, reason, "", false);
+}
+
+void CE2EHost::Update()
+{
+    for (int i = (int)m_pending.size() - 1; i >= 0; i--)
+    {
+        HCoplayPeer hConn = m_pending[i].hConn;
+        if (m_pending[i].startTime + (int64_t)(m_options.timeout * 1000000) < m_pEmu->GetTimeUsec())
+        {
+            m_pending.erase(m_pending.begin() + i);
+            m_pEmu->Close(hConn, E2E_END_TIMEOUT, "pendingtimeout", false);
+            continue;
+        }
+
+        if (PollPending(m_pending[i]) != eCoplayHandshake_Waiting)
+            m_pending.erase(m_pending.begin() + i);
+    }
+
+    for (int i = (int)m_parked.size() - 1; i >= 0; i--)
+    {
+        if (m_parked[i].expireTime < m_pEmu->GetTimeUsec())
+            m_parked.erase(m_parked.begin() + i);
+    }
+}
+
+// CCoplayHost::PollPendingConnection
+CoplayHandshakeState CE2EHost::PollPending(Pending_t &pending)
+{
+    HCoplayPeer hConn = pending.hConn;
+    int resumeSlot = -1;
+    CoplayHandshakeState state;
+
+    if (!pending.bResumable)
+    {
+        state = CoplayPollPendingPeer(m_pEmu, hConn, m_passcode);
+    }
+    else
+    {
+        uint64_t remoteID = 0;
+        m_pEmu->GetRemoteID(hConn, &remoteID);
+
+        std::string value;
+        uint64_t serial;
+        CoplayPendingReply reply = CoplayReceivePendingReply(m_pEmu, hConn, &value);
+        bool validTicket = reply == eCoplayPending_Resume && m_tickets.Verify(value, remoteID, &serial);
+
+        int slot = FindParked(remoteID);
+        if (validTicket && slot == -1)
+            slot = TakeOverSession(remoteID, serial);
+
+        if (validTicket && slot != -1 && serial == m_parked[slot].serial)
+        {
+            resumeSlot = slot;
+            state      = eCoplayHandshake_Accepted;
+        }
+        else if (reply == eCoplayPending_None && HasSession(remoteID) && pending.startTime + E2E_RESUME_GRACE_USEC > m_pEmu->GetTimeUsec())
+        {
+            return eCoplayHandshake_Waiting;
+        }
+        else
+        {
+            pending.bResumable = false;
+            if (!PassesJoinFilter(remoteID))
+            {
+                m_pEmu->Close(hConn, E2E_END_NOTFRIEND, "accessdeny", false);
+                return eCoplayHandshake_Rejected;
+            }
+
+            if (m_options.filter != eE2EFilter_Controlled)
+            {
+                state = eCoplayHandshake_Accepted;
+            }
+            else if (reply == eCoplayPending_Passcode)
+            {
+                state = value == m_passcode ? eCoplayHandshake_Accepted : eCoplayHandshake_Rejected;
+            }
+            else
+            {
+                CoplaySendNeedPasscode(m_pEmu, hConn);
+                return eCoplayHandshake_Waiting;
+            }
+        }
+    }
+
+    if (state == eCoplayHandshake_Accepted)
+        AddConnection(hConn, resumeSlot);
+    else if (state == eCoplayHandshake_Rejected)
+        m_pEmu->Close(hConn, E2E_END_BADPASSWORD, "badpassword", false);
+    return state;
+}
+
+void CE2EHost::SendSnapshots(uint32_t &seed)
+{
+    uint8_t buffer[1024];
+    for (size_t i = 0; i < m_connections.size(); i++)
+    {
+        int len = E2EBuildDatagram(buffer, m_pEmu->GetTimeUsec(), 300, 1000, seed);
+        m_pEmu->Send(m_connections[i].hConn, buffer, len, eCoplaySend_Unreliable);
+        m_snapshots.sent++;
+    }
+}
+
+void CE2EHost::ReceiveUsercmds(CCoplayLatencySamples &latency)
+{
+    CoplayDatagram_t datagrams[64];
+    HCoplayPeer      from[64];
+    int numRecv;
+    while ((numRecv = m_pEmu->ReceiveMessagesOnPollGroup(m_hPollGroup, datagrams, from, 64)) > 0)
+    {
+        for (int i = 0; i < numRecv; i++)
+            E2EOnArrival(m_usercmds, datagrams[i], m_pEmu->GetTimeUsec(), latency);
+        m_pEmu->Release(datagrams, numRecv);
+    }
+}
+
+CE2EClient::CE2EClient(CCoplaySteamEmulator *pEmu, CE2EHost *pHost, const std::string &passcode)
+    : m_state(eE2EClient_Connecting), m_pEmu(pEmu), m_pHost(pHost), m_passcode(passcode)
+{
+    m_user = pEmu->CreateUser();
+}
+
+void CE2EClient::Start()
+{
+    m_startTime = m_pEmu->GetTimeUsec();
+    if (m_pHost->m_lobby)
+    {
+        // what connect_lobby does, find it in the list by the host's name
+        std::vector<uint64_t> lobbies;
+        m_pEmu->RequestLobbyList(m_user, lobbies);
+        uint64_t lobbyID = m_pHost->m_lobby;
+        for (size_t i = 0; i < lobbies.size(); i++)
+        {
+            if (m_pHost->m_name == m_pEmu->GetLobbyData(lobbies[i], "hostname"))
+                lobbyID = lobbies[i];
+        }
+        m_state = eE2EClient_JoiningLobby;
+        m_pEmu->JoinLobby(m_user, lobbyID);
+    }
+    else
+    {
+        m_hostUser = m_pHost->m_user;
+        m_hConn    = m_pEmu->ConnectP2P(m_user, m_hostUser);
+    }
+}
+
+void CE2EClient::LobbyEntered(uint64_t lobbyID, bool bSuccess)
+{
+    if (!bSuccess)
+    {
+        Fail(E2E_END_REMOTEISSUE);
+        return;
+    }
+    m_state    = eE2EClient_Connecting;
+    m_hostUser = m_pEmu->GetLobbyOwner(lobbyID);
+    m_hConn    = m_pEmu->ConnectP2P(m_user, m_hostUser);
+}
+
+void CE2EClient::ConnectionStatusChanged(const EmuConnectionStatusChanged_t &status)
+{
+    if (status.hConn != m_hConn)
+        return;
+
+    switch (status.info.state)
+    {
+    case eEmuConnection_Connected:
+        m_state = eE2EClient_Handshake;
+        m_pHandshake.reset(new CCoplayClientHandshake(m_pEmu, m_hConn, m_passcode, m_resumeTicket));
+        if (!m_bLegacy)
+            m_pHandshake->Start();
+        else
+            m_nextPoll = m_pEmu->GetTimeUsec() + E2E_LEGACY_POLL_USEC;
+        break;
+
+    case eEmuConnection_ClosedByPeer:
+    case eEmuConnection_ProblemDetectedLocally:
+        if (status.info.state == eEmuConnection_ClosedByPeer && E2EIsAppEndReason(status.info.endReason))
+            Fail(status.info.endReason);
+        else if (!TryResume())
+            Fail(status.info.endReason);
+        break;
+
+    default:
+        break;
+    }
+}
+
+bool CE2EClient::TryResume()
+{
+    if (m_state != eE2EClient_Ready || m_ticket.empty())
+        return false;
+
+    m_pEmu->Close(m_hConn, E2E_END_TIMEOUT, "", false);
+    m_resumeTicket = m_ticket;
+    m_ticket.clear();
+    m_state = eE2EClient_Connecting;
+    m_hConn = m_pEmu->ConnectP2P(m_user, m_hostUser);
+    return true;
+}
+
+void CE2EClient::Drop(int64_t hostDetectUsec)
+{
+    m_dropTime = m_pEmu->GetTimeUsec();
+    m_pEmu->BreakConnection(m_hConn, hostDetectUsec);
+}
+
+void CE2EClient::Fail(int reason)
+{
+    if (m_hConn != COPLAY_INVALID_PEER)
+        m_pEmu->Close(m_hConn, reason, "", false);
+    m_hConn     = COPLAY_INVALID_PEER;
+    m_state     = eE2EClient_Failed;
+    m_endReason = reason;
+    m_pHandshake.reset();
+}
+
+void CE2EClient::Update()
+{
+    if (m_state != eE2EClient_Handshake)
+        return;
+
+    if (m_bLegacy)
+    {
+        if (m_pEmu->GetTimeUsec() < m_nextPoll)
+            return;
+        m_nextPoll = m_pEmu->GetTimeUsec() + E2E_LEGACY_POLL_USEC;
+    }
+
+    if (m_pHandshake->Poll() == eCoplayHandshake_Accepted)
+    {
+        m_state = eE2EClient_Ready;
+        if (m_dropTime)
+        {
+            m_backTime = m_pEmu->GetTimeUsec();
+            m_bResumed = m_pHandshake->WasResumed();
+        }
+        else
+        {
+            m_readyTime = m_pEmu->GetTimeUsec();
+        }
+        // older versions never look past OK
+        if (!m_bLegacy)
+            m_ticket = m_pHandshake->GetTicket();
+        m_pHandshake.reset();
+    }
+}
+
+void CE2EClient::SendUsercmd(uint32_t &seed)
+{
+    if (m_state != eE2EClient_Ready)
+        return;
+    uint8_t buffer[128];
+    int len = E2EBuildDatagram(buffer, m_pEmu->GetTimeUsec(), 60, 120, seed);
+    m_pEmu->Send(m_hConn, buffer, len, eCoplaySend_Unreliable);
+    m_usercmds.sent++;
+}
+
+void CE2EClient::ReceiveSnapshots(CCoplayLatencySamples &latency)
+{
+    if (m_state != eE2EClient_Ready)
+        return;
+    CoplayDatagram_t datagrams[64];
+    int numRecv;
+    while ((numRecv = m_pEmu->Receive(m_hConn, datagrams, 64)) > 0)
+    {
+        for (int i = 0; i < numRecv; i++)
+            E2EOnArrival(m_snapshots, datagrams[i], m_pEmu->GetTimeUsec(), latency);
+        m_pEmu->Release(datagrams, numRecv);
+    }
+}
+
+static const char *E2EDescribeEnd(int reason)
+{
+    switch (reason)
+    {
+    case E2E_END_NOTFRIEND:   return "not a friend";
+    case E2E_END_BADPASSWORD: return "bad passcode";
+    case E2E_END_TIMEOUT:     return "timed out";
+    case E2E_END_REMOTEISSUE: return "couldn't join lobby";
+    default:                  return "other";
+    }
+}
+
+static bool RunE2E(const E2EOptions_t &options)
+{
+    SteamEmuOptions_t emuOptions;
+    emuOptions.latencyUsec = (int64_t)(options.latencyMs * 1000);
+    emuOptions.jitterUsec  = (int64_t)(options.jitterMs * 1000);
+    emuOptions.lossPct     = options.lossPct;
+    emuOptions.seed        = options.seed;
+    CCoplaySteamEmulator emu(emuOptions);
+
+    std::vector<CE2EHost*>   hosts;
+    std::vector<CE2EClient*> clients;
+    for (int h = 0; h < options.hosts; h++)
+    {
+        CE2EHost *pHost = new CE2EHost(&emu, options, h);
+        hosts.push_back(pHost);
+
+        for (int c = 0; c < options.clients; c++)
+        {
+            // the first ones get the wrong passcode, then the legacy ones, the last ones aren't friends
+            bool bBadPasscode = c < options.badPasscode;
+            bool bStranger    = c >= options.clients - options.strangers;
+            CE2EClient *pClient = new CE2EClient(&emu, pHost, bBadPasscode ? std::string("notthepasscode") : pHost->m_passcode);
+            if (!bStranger)
+                emu.SetFriends(pHost->m_user, pClient->m_user);
+
+            pClient->m_bLegacy = c >= options.badPasscode && c < options.badPasscode + options.legacy;
+            pClient->m_bExpectRejection = (bBadPasscode && options.filter == eE2EFilter_Controlled)
+                || (bStranger && options.filter == eE2EFilter_Friends);
+            clients.push_back(pClient);
+        }
+    }
+
+    double cpuStart = CoplayProcessCPUTime();
+
+    // hosts get their lobbies up first, then everyone joins at once
+    emu.Advance(E2E_STEP_USEC);
+    for (size_t i = 0; i < hosts.size(); i++)
+        emu.RunCallbacks(hosts[i]->m_user, hosts[i]);
+    for (size_t i = 0; i < clients.size(); i++)
+        clients[i]->Start();
+
+    // connect phase, until everyone is in or out
+    int64_t connectDeadline = (int64_t)((options.timeout + 15) * 1000000);
+    bool    bSettled        = false;
+    while (!bSettled && emu.GetTimeUsec() < connectDeadline)
+    {
+        emu.Advance(E2E_STEP_USEC);
+        for (size_t i = 0; i < hosts.size(); i++)
+        {
+            emu.RunCallbacks(hosts[i]->m_user, hosts[i]);
+            hosts[i]->Update();
+        }
+
+        bSettled = true;
+        for (size_t i = 0; i < clients.size(); i++)
+        {
+            emu.RunCallbacks(clients[i]->m_user, clients[i]);
+            clients[i]->Update();
+            bSettled &= clients[i]->m_state == eE2EClient_Ready || clients[i]->m_state == eE2EClient_Failed;
+        }
+    }
+    int64_t connectPhase = emu.GetTimeUsec();
+
+    // traffic phase
+    CCoplayLatencySamples snapshotLatency, usercmdLatency;
+    uint32_t seed     = options.seed;
+    int64_t  tickUsec = 1000000 / options.tickrate;
+    int64_t  end      = emu.GetTimeUsec() + (int64_t)(options.seconds * 1000000);
+    int64_t  nextTick = emu.GetTimeUsec();
+    int64_t  drained  = end + emuOptions.latencyUsec + emuOptions.jitterUsec + E2E_STEP_USEC; // let the last ones land
+    int64_t  dropAt   = emu.GetTimeUsec() + (end - emu.GetTimeUsec()) / 3;
+    bool     bDropped = options.drops == 0;
+    while (emu.GetTimeUsec() < drained)
+    {
+        if (!bDropped && emu.GetTimeUsec() >= dropAt)
+        {
+            // the first ones per host that are in and would know what to do with a ticket
+            bDropped = true;
+            std::map<CE2EHost*, int> numDropped;
+            for (size_t i = 0; i < clients.size(); i++)
+            {
+                CE2EClient *pClient = clients[i];
+                if (pClient->m_state == eE2EClient_Ready && !pClient->m_bLegacy && numDropped[hosts[i / options.clients]] < options.drops)
+                {
+                    numDropped[hosts[i / options.clients]]++;
+                    pClient->m_bExpectRejection = options.resumeWindow <= 0; // there's no rejoining from scratch here
+                    pClient->Drop((int64_t)(options.detectMs * 1000));
+                }
+            }
+        }
+
+
+        if (emu.GetTimeUsec() < end && emu.GetTimeUsec() >= nextTick)
+        {
+            nextTick += tickUsec;
+            for (size_t i = 0; i < hosts.size(); i++)
+                hosts[i]->SendSnapshots(seed);
+            for (size_t i = 0; i < clients.size(); i++)
+                clients[i]->SendUsercmd(seed);
+        }
+
+        emu.Advance(E2E_STEP_USEC);
+        for (size_t i = 0; i < hosts.size(); i++)
+        {
+            emu.RunCallbacks(hosts[i]->m_user, hosts[i]);
+            hosts[i]->Update();
+            hosts[i]->ReceiveUsercmds(usercmdLatency);
+        }
+        for (size_t i = 0; i < clients.size(); i++)
+        {
+            emu.RunCallbacks(clients[i]->m_user, clients[i]);
+            clients[i]->Update();
+            clients[i]->ReceiveSnapshots(snapshotLatency);
+        }
+    }
+    double cpu = CoplayProcessCPUTime() - cpuStart;
+
+    // report
+    CCoplayLatencySamples connectTimes, resumeTimes;
+    int numReady = 0, numWrong = 0, numDropped = 0, numResumed = 0;
+    std::map<int, int> failReasons;
+    E2EStream_t snapshots, usercmds;
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        CE2EClient *pClient = clients[i];
+        if (pClient->m_state == eE2EClient_Ready)
+        {
+            numReady++;
+            connectTimes.Add(pClient->m_readyTime - pClient->m_startTime);
+        }
+        else
+        {
+            failReasons[pClient->m_endReason]++;
+        }
+
+        // with a window to come back in the dropped ones should all get their sessions back
+        bool bRejected = pClient->m_state == eE2EClient_Failed;
+        if (bRejected != pClient->m_bExpectRejection || (pClient->m_dropTime && options.resumeWindow > 0 && !pClient->m_bResumed))
+            numWrong++;
+
+        if (pClient->m_dropTime)
+        {
+            numDropped++;
+            if (pClient->m_bResumed)
+            {
+                numResumed++;
+                resumeTimes.Add(pClient->m_backTime - pClient->m_dropTime);
+            }
+        }
+
+        snapshots.received += pClient->m_snapshots.received;
+        snapshots.bytes    += pClient->m_snapshots.bytes;
+        usercmds.sent      += pClient->m_usercmds.sent;
+    }
+    for (size_t i = 0; i < hosts.size(); i++)
+    {
+        snapshots.sent    += hosts[i]->m_snapshots.sent;
+        usercmds.received += hosts[i]->m_usercmds.received;
+        usercmds.bytes    += hosts[i]->m_usercmds.bytes;
+    }
+
+    static const char *s_filterNames[] = { "passcode", "friends", "everyone" };
+    printf("%i hosts, %i clients each, %s%s, %.1fms latency, %.1fms jitter, %.1f%% loss, seed %u\n", options.hosts,
+           options.clients, s_filterNames[options.filter], options.lobbies ? " with lobbies" : "", options.latencyMs,
+           options.jitterMs, options.lossPct, options.seed);
+    printf("\n%i of %i clients got in, everyone settled after %.3fs emulated\n", numReady, (int)clients.size(), connectPhase / 1000000.0);
+
+    for (std::map<int, int>::iterator it = failReasons.begin(); it != failReasons.end(); ++it)
+        printf("  %i turned away, %s\n", it->second, E2EDescribeEnd(it->first));
+    connectTimes.Print("connect to ready");
+    if (numDropped)
+    {
+        printf("%i of %i dropped clients resumed their session, the host noticed after %.0fms\n", numResumed, numDropped, options.detectMs);
+        if (numResumed)
+            resumeTimes.Print("drop to resumed");
+    }
+
+    printf("\nTraffic over %.1fs emulated at %i tick\n", options.seconds, options.tickrate);
+    printf("%-24s sent %-9lld received %-9lld %.2f MB\n", "snapshots (srv->cl)", (long long)snapshots.sent,
+           (long long)snapshots.received, snapshots.bytes / (1024.0 * 1024.0));
+    printf("%-24s sent %-9lld received %-9lld %.2f MB\n", "usercmds (cl->srv)", (long long)usercmds.sent,
+           (long long)usercmds.received, usercmds.bytes / (1024.0 * 1024.0));
+    printf("emulator lost %lld unreliable messages\n", (long long)emu.GetMessagesLost());
+    snapshotLatency.Print("snapshots (srv->cl)");
+    usercmdLatency.Print("usercmds (cl->srv)");
+    printf("\nTook %.3fs CPU to run\n", cpu);
+
+    if (numWrong)
+        printf("\n%i clients were let in or turned away when they shouldn't have been\n", numWrong);
+
+    for (size_t i = 0; i < clients.size(); i++)
+        delete clients[i];
+    for (size_t i = 0; i < hosts.size(); i++)
+        delete hosts[i];
+    return numWrong == 0;
+}
+
+static void PrintUsage()
+{
+    printf("usage: coplay_e2e [options]\n"
+           "  -hosts <n>       hosts, each with its own clients (default 1)\n"
+           "  -clients <n>     clients per host (default 8)\n"
+           "  -filter <name>   passcode, friends or everyone, like coplay_joinfilter (default passcode)\n"
+           "  -lobbies         go through lobbies like COPLAY_USE_LOBBIES, the filter picks the lobby type\n"
+           "  -badpasscode <n> clients per host that send the wrong passcode (default 0)\n"
+           "  -strangers <n>   clients per host that aren't friends with it (default 0)\n"
+           "  -legacy <n>      clients per host that wait to be asked for the passcode like older versions (default 0)\n"
+           "  -drops <n>       clients per host that lose their connection a third of the way into the traffic (default 0)\n"
+           "  -detect <ms>     how long the host takes to notice a dropped connection (default 10000)\n"
+           "  -resumewindow <s> how long the host keeps a dropped session, like coplay_resume_window (default 15)\n"
+           "  -latency <ms>    one way latency (default 25)\n"
+           "  -jitter <ms>     random extra latency on top (default 0)\n"
+           "  -loss <pct>      unreliable messages lost (default 0)\n"
+           "  -tickrate <n>    snapshots and usercmds per second once connected (default 66)\n"
+           "  -seconds <s>     emulated time to send traffic for (default 10)\n"
+           "  -timeout <s>     how long a host waits for a passcode, like coplay_timeoutduration (default 30)\n"
+           "  -seed <n>        anything random comes from this (default 1)\n");
+}
+
+int main(int argc, char **argv)
+{
+    E2EOptions_t options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (CoplayToolArgIs(argc, argv, i, "-hosts"))
+            options.hosts = CoplayToolArgInt(argc, argv, i, options.hosts);
+        else if (CoplayToolArgIs(argc, argv, i, "-clients"))
+            options.clients = CoplayToolArgInt(argc, argv, i, options.clients);
+        else if (CoplayToolArgIs(argc, argv, i, "-filter") && i + 1 < argc)
+        {
+            const char *pszFilter = argv[++i];
+            if (!strcmp(pszFilter, "passcode"))
+                options.filter = eE2EFilter_Controlled;
+            else if (!strcmp(pszFilter, "friends"))
+                options.filter = eE2EFilter_Friends;
+            else if (!strcmp(pszFilter, "everyone"))
+                options.filter = eE2EFilter_Everyone;
+            else
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (CoplayToolArgIs(argc, argv, i, "-lobbies"))
+            options.lobbies = true;
+        else if (CoplayToolArgIs(argc, argv, i, "-badpasscode"))
+            options.badPasscode = CoplayToolArgInt(argc, argv, i, options.badPasscode);
+        else if (CoplayToolArgIs(argc, argv, i, "-strangers"))
+            options.strangers = CoplayToolArgInt(argc, argv, i, options.strangers);
+        else if (CoplayToolArgIs(argc, argv, i, "-legacy"))
+            options.legacy = CoplayToolArgInt(argc, argv, i, options.legacy);
+        else if (CoplayToolArgIs(argc, argv, i, "-drops"))
+            options.drops = CoplayToolArgInt(argc, argv, i, options.drops);
+        else if (CoplayToolArgIs(argc, argv, i, "-detect"))
+            options.detectMs = CoplayToolArgFloat(argc, argv, i, options.detectMs);
+        else if (CoplayToolArgIs(argc, argv, i, "-resumewindow"))
+            options.resumeWindow = CoplayToolArgFloat(argc, argv, i, options.resumeWindow);
+        else if (CoplayToolArgIs(argc, argv, i, "-latency"))
+            options.latencyMs = CoplayToolArgFloat(argc, argv, i, options.latencyMs);
+        else if (CoplayToolArgIs(argc, argv, i, "-jitter"))
+            options.jitterMs = CoplayToolArgFloat(argc, argv, i, options.jitterMs);
+        else if (CoplayToolArgIs(argc, argv, i, "-loss"))
+            options.lossPct = CoplayToolArgFloat(argc, argv, i, options.lossPct);
+        else if (CoplayToolArgIs(argc, argv, i, "-tickrate"))
+            options.tickrate = CoplayToolArgInt(argc, argv, i, options.tickrate);
+        else if (CoplayToolArgIs(argc, argv, i, "-seconds"))
+            options.seconds = CoplayToolArgFloat(argc, argv, i, options.seconds);
+        else if (CoplayToolArgIs(argc, argv, i, "-timeout"))
+            options.timeout = CoplayToolArgFloat(argc, argv, i, options.timeout);
+        else if (CoplayToolArgIs(argc, argv, i, "-seed"))
+            options.seed = (uint32_t)CoplayToolArgInt(argc, argv, i, (int)options.seed);
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (options.hosts < 1 || options.clients < 1 || options.tickrate < 1 || options.seconds < 0 || options.timeout <= 0
+        || options.latencyMs < 0 || options.jitterMs < 0 || options.lossPct < 0 || options.lossPct > 100
+        || options.badPasscode < 0 || options.strangers < 0 || options.legacy < 0 || options.drops < 0
+        || options.detectMs < 0 || options.resumeWindow < 0
+        || options.badPasscode + options.legacy > options.clients || options.strangers > options.clients)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    return RunE2E(options) ? 0 : 1;
+}
@@ -0,0 +1,155 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_mocksteam.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Steam lets the send buffer grow to 512k by default before it starts refusing, close enough in messages
+#define MOCKSTEAM_MAX_QUEUED 1024
+
+CCoplayMockSteamSockets::~CCoplayMockSteamSockets()
+{
+    for (size_t i = 0; i < m_connections.size(); i++)
+    {
+        for (size_t j = 0; j < m_connections[i]->inbox.size(); j++)
+            FreeMessage(m_connections[i]->inbox[j]);
+        delete m_connections[i];
+    }
+}
+
+CCoplayMockSteamSockets::Connection_t *CCoplayMockSteamSockets::GetConnection(HCoplayPeer hPeer) const
+{
+    if (hPeer == COPLAY_INVALID_PEER || hPeer > m_connections.size())
+        return NULL;
+    return m_connections[hPeer - 1];
+}
+
+void CCoplayMockSteamSockets::CreateConnectionPair(HCoplayPeer *phA, HCoplayPeer *phB)
+{
+    m_connections.push_back(new Connection_t);
+    HCoplayPeer hA = (HCoplayPeer)m_connections.size();
+    m_connections.push_back(new Connection_t);
+    HCoplayPeer hB = (HCoplayPeer)m_connections.size();
+
+    GetConnection(hA)->hRemote = hB;
+    GetConnection(hB)->hRemote = hA;
+
+    *phA = hA;
+    *phB = hB;
+}
+
+int64_t CCoplayMockSteamSockets::GetSendsRefused(HCoplayPeer hPeer) const
+{
+    Connection_t *pConnection = GetConnection(hPeer);
+    return pConnection ? pConnection->sendsRefused : 0;
+}
+
+void CCoplayMockSteamSockets::FreeMessage(const MockSteamMessage_t &message)
+{
+    if (message.bPooled)
+        CoplayPacketPool()->Free(message.pData);
+    else
+        free(message.pData);
+}
+
+CoplaySendResult CCoplayMockSteamSockets::Queue(HCoplayPeer hPeer, const MockSteamMessage_t &message)
+{
+    Connection_t *pConnection = GetConnection(hPeer);
+    if (!pConnection)
+    {
+        FreeMessage(message);
+        return eCoplaySendResult_NoConnection;
+    }
+    Connection_t *pRemote = GetConnection(pConnection->hRemote);
+
+    std::lock_guard<std::mutex> lock(pRemote->lock);
+    if (pRemote->inbox.size() >= MOCKSTEAM_MAX_QUEUED)
+    {
+        FreeMessage(message);
+        pConnection->sendsRefused++;
+        return eCoplaySendResult_QueueFull;
+    }
+    pRemote->inbox.push_back(message);
+    return eCoplaySendResult_OK;
+}
+
+CoplaySendResult CCoplayMockSteamSockets::Send(HCoplayPeer hPeer, const void *pData, int len, int sendFlags)
+{
+    MockSteamMessage_t message;
+    message.pData   = (uint8_t*)malloc(len);
+    message.len     = len;
+    message.bPooled = false;
+    memcpy(message.pData, pData, len);
+    return Queue(hPeer, message);
+}
+
+CoplaySendResult CCoplayMockSteamSockets::SendPooled(HCoplayPeer hPeer, uint8_t *pBuffer, int len, int sendFlags)
+{
+    MockSteamMessage_t message;
+    message.pData   = pBuffer;
+    message.len     = len;
+    message.bPooled = true;
+    return Queue(hPeer, message);
+}
+
+int CCoplayMockSteamSockets::Receive(HCoplayPeer hPeer, CoplayDatagram_t *pDatagrams, int maxDatagrams)
+{
+    Connection_t *pConnection = GetConnection(hPeer);
+    if (!pConnection)
+        return -1;
+
+    std::lock_guard<std::mutex> lock(pConnection->lock);
+    int numRecv = 0;
+    while (numRecv < maxDatagrams && !pConnection->inbox.empty())
+    {
+        MockSteamMessage_t &message = pConnection->inbox.front();
+        pDatagrams[numRecv].pData   = message.pData;
+        pDatagrams[numRecv].len     = message.len;
+        // malloc and the pool both hand out aligned pointers, so the low bit is free to say which one it was
+        pDatagrams[numRecv].pHandle = (void*)((uintptr_t)message.pData | (message.bPooled ? 1 : 0));
+        pDatagrams[numRecv].ageUsec = 0;
+        pConnection->inbox.pop_front();
+        numRecv++;
+    }
+    return numRecv;
+}
+
+void CCoplayMockSteamSockets::Release(CoplayDatagram_t *pDatagrams, int numDatagrams)
+{
+    for (int i = 0; i < numDatagrams; i++)
+    {
+        uintptr_t handle = (uintptr_t)pDatagrams[i].pHandle;
+        MockSteamMessage_t message;
+        message.pData   = (uint8_t*)(handle & ~(uintptr_t)1);
+        message.bPooled = (handle & 1) != 0;
+        FreeMessage(message);
+    }
+}
+
+bool CCoplayMockSteamSockets::GetRemoteID(HCoplayPeer hPeer, uint64_t *pID)
+{
+    Connection_t *pConnection = GetConnection(hPeer);
+    if (!pConnection)
+        return false;
+    *pID = pConnection->hRemote;
+    return true;
+}
+
+bool CCoplayMockSteamSockets::GetStatus(HCoplayPeer hPeer, CoplayPeerStatus_t *pStatus)
+{
+    if (!GetConnection(hPeer))
+        return false;
+    *pStatus = CoplayPeerStatus_t();
+    pStatus->qualityLocal  = 1;
+    pStatus->qualityRemote = 1;
+    return true;
+}
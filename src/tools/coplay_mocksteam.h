@@ -0,0 +1,73 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// In-process stand-in for the parts of ISteamNetworkingSockets a relay uses.
+// Like the real thing every send copies into a newly allocated message unless its a pooled buffer, which is queued as is,
+// and every received message has to be released, so allocation and copy costs stay in the numbers. There is no latency or loss, it measures the relays and nothing else.
+#ifndef COPLAY_MOCKSTEAM_H
+#define COPLAY_MOCKSTEAM_H
+#pragma once
+
+#include "coplay_transport.h"
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct MockSteamMessage_t
+{
+    uint8_t *pData;
+    int      len;
+    bool     bPooled; // from CoplayPacketPool() rather than malloc
+};
+
+class CCoplayMockSteamSockets : public ICoplayTransport
+{
+public:
+    ~CCoplayMockSteamSockets();
+
+    // Two ends of a new connection, like a ConnectP2P and AcceptConnection would give you.
+    // Make them all before any thread starts using the transport
+    void CreateConnectionPair(HCoplayPeer *phA, HCoplayPeer *phB);
+
+    // sends that found the remote's queue full, like Steam's k_EResultLimitExceeded
+    int64_t GetSendsRefused(HCoplayPeer hPeer) const;
+
+    virtual const char *GetName() const { return "mocksteam"; }
+
+    virtual CoplaySendResult Send(HCoplayPeer hPeer, const void *pData, int len, int sendFlags);
+    virtual CoplaySendResult SendPooled(HCoplayPeer hPeer, uint8_t *pBuffer, int len, int sendFlags);
+    virtual int  Receive(HCoplayPeer hPeer, CoplayDatagram_t *pDatagrams, int maxDatagrams);
+    virtual void Release(CoplayDatagram_t *pDatagrams, int numDatagrams);
+    virtual void Close(HCoplayPeer hPeer, int reason, const char *pszDebug, bool bEnableLinger) {} // freed with the transport
+    virtual bool GetRemoteID(HCoplayPeer hPeer, uint64_t *pID);
+    virtual bool GetStatus(HCoplayPeer hPeer, CoplayPeerStatus_t *pStatus);
+
+private:
+    // One end of a mock connection
+    struct Connection_t
+    {
+        HCoplayPeer hRemote;
+
+        // written by the remote end, read by us
+        std::mutex                     lock;
+        std::deque<MockSteamMessage_t> inbox;
+
+        int64_t sendsRefused = 0; // only touched by the sending thread
+    };
+
+    Connection_t *GetConnection(HCoplayPeer hPeer) const;
+    CoplaySendResult Queue(HCoplayPeer hPeer, const MockSteamMessage_t &message);
+    static void   FreeMessage(const MockSteamMessage_t &message);
+
+    std::vector<Connection_t*> m_connections; // handle is the index + 1
+};
+
+#endif
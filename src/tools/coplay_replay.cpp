@@ -0,0 +1,402 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Replays a capture made with coplay_capture through a real CCoplayRelay.
+//
+//   game stand-in <-> relay local socket <-> [CCoplayRelay] <-> UDP link <-> peer stand-in
+//
+// Outbound records are sent from the game stand-in and expected at the peer stand-in, inbound the other way around.
+// The time between injecting a datagram and it coming out the other end is what the relay added.
+
+#include "coplay_relay.h"
+#include "coplay_capture.h"
+#include "coplay_timer.h"
+#include "coplay_udptransport.h"
+#include "coplay_toolcommon.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <stdio.h>
+
+struct ReplayInFlight_t
+{
+    uint64_t hash;
+    int64_t  sentTime;
+};
+
+struct ReplayDirection_t
+{
+    const char *pszName;
+    std::deque<ReplayInFlight_t> inFlight;
+
+    int64_t sent     = 0;
+    int64_t received = 0;
+    int64_t lost     = 0;
+    int64_t bytes    = 0;
+
+    CCoplayLatencySamples latency;
+};
+
+struct ReplayOptions_t
+{
+    const char *pszCapture = NULL;
+    bool   fast    = false;
+    double speed   = 1.0;
+    int    hz      = 300;
+    int    spin    = 500;
+    int    loops   = 1;
+    int    window  = 32;
+    int    maxSize = 2048;
+};
+
+class CCoplayReplay
+{
+public:
+    bool Run(const ReplayOptions_t &options);
+
+private:
+    bool Setup();
+    void Teardown();
+
+    void RelayThread();
+    void ReceiveThread();
+    void Inject(const CoplayCaptureRecord_t &record);
+    void WaitForWindow();
+    void Report(double wallSeconds);
+
+    void OnArrival(ReplayDirection_t &dir, const uint8_t *pData, int len, int64_t now);
+
+private:
+    ReplayOptions_t m_options;
+
+    // game side
+    UDPsocket m_gameSocket  = NULL; // stands in for the engine
+    UDPsocket m_relaySocket = NULL; // the relay's local socket, like CCoplayConnection::m_localSocket
+    // peer side
+    CCoplayUDPTransport m_transport;
+    HCoplayPeer         m_hLink      = COPLAY_INVALID_PEER; // the relay's end
+    UDPsocket           m_peerSocket = NULL; // stands in for the remote relay
+
+    CCoplayRelay m_relay;
+
+    std::thread       m_relayThread;
+    std::thread       m_receiveThread;
+    std::atomic<bool> m_stop;
+    double            m_relayCPU = 0;
+    int64_t           m_relayIterations = 0;
+
+    std::mutex              m_lock;
+    std::condition_variable m_arrived;
+    ReplayDirection_t       m_directions[2];
+};
+
+bool CCoplayReplay::Setup()
+{
+    m_gameSocket  = SDLNet_UDP_Open(0);
+    m_relaySocket = SDLNet_UDP_Open(0);
+    m_peerSocket  = SDLNet_UDP_Open(0);
+    m_hLink       = m_transport.OpenPeer(0, m_options.maxSize);
+    if (!m_gameSocket || !m_relaySocket || !m_peerSocket || m_hLink == COPLAY_INVALID_PEER)
+    {
+        fprintf(stderr, "Couldn't open loopback sockets: %s\n", SDLNet_GetError());
+        return false;
+    }
+
+    // same as CCoplayConnection, channel 1 sends back to the game
+    IPaddress gameAddr = CoplayLoopbackAddress(m_gameSocket);
+    SDLNet_UDP_Bind(m_relaySocket, 1, &gameAddr);
+    m_transport.SetRemote(m_hLink, CoplayLoopbackAddress(m_peerSocket));
+
+    if (!m_relay.Init(m_relaySocket, &m_transport, m_hLink))
+    {
+        fprintf(stderr, "Couldn't start the relay\n");
+        return false;
+    }
+
+    m_directions[eCaptureDir_Outbound].pszName = "outbound (game->peer)";
+    m_directions[eCaptureDir_Inbound].pszName  = "inbound (peer->game)";
+    return true;
+}
+
+void CCoplayReplay::Teardown()
+{
+    m_relay.Shutdown();
+    m_transport.Close(m_hLink, 0, "", false);
+    m_hLink = COPLAY_INVALID_PEER;
+    if (m_gameSocket)
+        SDLNet_UDP_Close(m_gameSocket);
+    if (m_relaySocket)
+        SDLNet_UDP_Close(m_relaySocket);
+    if (m_peerSocket)
+        SDLNet_UDP_Close(m_peerSocket);
+}
+
+void CCoplayReplay::RelayThread()
+{
+    m_relayCPU = CoplayToolRunRelay(&m_relay, m_options.hz, m_options.spin, m_stop, &m_relayIterations);
+}
+
+void CCoplayReplay::ReceiveThread()
+{
+    SDLNet_SocketSet set = SDLNet_AllocSocketSet(2);
+    SDLNet_UDP_AddSocket(set, m_gameSocket);
+    SDLNet_UDP_AddSocket(set, m_peerSocket);
+
+    UDPpacket *pPacket = SDLNet_AllocPacket(m_options.maxSize);
+    while (!m_stop)
+    {
+        if (SDLNet_CheckSockets(set, 10) <= 0)
+            continue;
+
+        while (SDLNet_UDP_Recv(m_peerSocket, pPacket) > 0)
+            OnArrival(m_directions[eCaptureDir_Outbound], pPacket->data, pPacket->len, CoplayTimeUsec());
+        while (SDLNet_UDP_Recv(m_gameSocket, pPacket) > 0)
+            OnArrival(m_directions[eCaptureDir_Inbound], pPacket->data, pPacket->len, CoplayTimeUsec());
+    }
+    SDLNet_FreePacket(pPacket);
+    SDLNet_FreeSocketSet(set);
+}
+
+void CCoplayReplay::OnArrival(ReplayDirection_t &dir, const uint8_t *pData, int len, int64_t now)
+{
+    uint64_t hash = CoplayToolHash(pData, len);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    // the relay keeps order, anything skipped over on the way to a match was dropped
+    for (size_t i = 0; i < dir.inFlight.size(); i++)
+    {
+        if (dir.inFlight[i].hash != hash)
+            continue;
+
+        dir.latency.Add(now - dir.inFlight[i].sentTime);
+        dir.lost     += i;
+        dir.received += 1;
+        dir.bytes    += len;
+        dir.inFlight.erase(dir.inFlight.begin(), dir.inFlight.begin() + i + 1);
+        m_arrived.notify_all();
+        return;
+    }
+}
+
+void CCoplayReplay::Inject(const CoplayCaptureRecord_t &record)
+{
+    if (record.direction > eCaptureDir_Inbound || record.len > m_options.maxSize)
+        return;
+
+    UDPpacket packet = {};
+    packet.channel = -1;
+    packet.data    = (Uint8*)record.data;
+    packet.len     = record.len;
+
+    UDPsocket from;
+    if (record.direction == eCaptureDir_Outbound)
+    {
+        from = m_gameSocket;
+        packet.address = CoplayLoopbackAddress(m_relaySocket);
+    }
+    else
+    {
+        from = m_peerSocket;
+        IPaddress linkAddr = {};
+        linkAddr.host = SDL_SwapBE32(INADDR_LOOPBACK);
+        linkAddr.port = SDL_SwapBE16(m_transport.GetLocalPort(m_hLink));
+        packet.address = linkAddr;
+    }
+
+    ReplayDirection_t &dir = m_directions[record.direction];
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        ReplayInFlight_t entry = { CoplayToolHash(record.data, record.len), CoplayTimeUsec() };
+        dir.inFlight.push_back(entry);
+        dir.sent++;
+    }
+    SDLNet_UDP_Send(from, -1, &packet);
+}
+
+void CCoplayReplay::WaitForWindow()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    while (m_directions[0].inFlight.size() + m_directions[1].inFlight.size() >= (size_t)m_options.window)
+    {
+        if (m_arrived.wait_for(lock, std::chrono::seconds(1)) == std::cv_status::timeout)
+        {
+            // nothing came back for a whole second, call the oldest ones lost so we dont hang
+            for (int i = 0; i < 2; i++)
+            {
+                if (!m_directions[i].inFlight.empty())
+                {
+                    m_directions[i].inFlight.pop_front();
+                    m_directions[i].lost++;
+                }
+            }
+        }
+    }
+}
+
+bool CCoplayReplay::Run(const ReplayOptions_t &options)
+{
+    m_options = options;
+
+    CCoplayCaptureReader reader;
+    if (!reader.Open(m_options.pszCapture))
+    {
+        fprintf(stderr, "Couldn't read capture %s\n", m_options.pszCapture);
+        return false;
+    }
+
+    if (!Setup())
+    {
+        Teardown();
+        return false;
+    }
+
+    printf("Replaying %s (recorded as %s), %s, ", m_options.pszCapture,
+           reader.GetRole() == 1 ? "host" : "client",
+           m_options.fast ? "as fast as possible" : "with captured timing");
+    if (m_options.hz > 0)
+        printf("relay at %i hz spinning up to %ius\n", m_options.hz, m_options.spin);
+    else
+        printf("relay never sleeping\n");
+
+    m_stop = false;
+    m_relayThread   = std::thread(&CCoplayReplay::RelayThread, this);
+    m_receiveThread = std::thread(&CCoplayReplay::ReceiveThread, this);
+
+    CoplayCaptureRecord_t *pRecord = new CoplayCaptureRecord_t;
+    int64_t start      = CoplayTimeUsec();
+    int64_t loopOffset = 0;
+    for (int loop = 0; loop < m_options.loops; loop++)
+    {
+        int64_t lastRecordTime = 0;
+        reader.Rewind();
+        while (reader.Next(pRecord))
+        {
+            if (m_options.fast)
+                WaitForWindow();
+            else
+                CoplayToolWaitUntil(start + (int64_t)((loopOffset + pRecord->timeUsec) / m_options.speed));
+
+            Inject(*pRecord);
+            lastRecordTime = pRecord->timeUsec;
+        }
+        loopOffset += lastRecordTime;
+    }
+    delete pRecord;
+
+    // let the stragglers through
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+        m_arrived.wait_for(lock, std::chrono::seconds(2), [this]()
+        {
+            return m_directions[0].inFlight.empty() && m_directions[1].inFlight.empty();
+        });
+        for (int i = 0; i < 2; i++)
+        {
+            m_directions[i].lost += m_directions[i].inFlight.size();
+            m_directions[i].inFlight.clear();
+        }
+    }
+    double wallSeconds = (CoplayTimeUsec() - start) / 1000000.0;
+
+    m_stop = true;
+    m_relayThread.join();
+    m_receiveThread.join();
+
+    Report(wallSeconds);
+    Teardown();
+    return true;
+}
+
+void CCoplayReplay::Report(double wallSeconds)
+{
+    int64_t totalPackets = 0, totalBytes = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        ReplayDirection_t &dir = m_directions[i];
+        printf("%-24s sent %-8lld received %-8lld lost %-6lld %.2f MB\n", dir.pszName, (long long)dir.sent,
+               (long long)dir.received, (long long)dir.lost, dir.bytes / (1024.0 * 1024.0));
+        totalPackets += dir.received;
+        totalBytes   += dir.bytes;
+    }
+
+    printf("\nRelay added latency\n");
+    CCoplayLatencySamples all;
+    for (int i = 0; i < 2; i++)
+    {
+        m_directions[i].latency.Print(m_directions[i].pszName);
+        all.Append(m_directions[i].latency);
+    }
+    all.Print("both");
+
+    printf("\nThroughput   %.0f packets/s, %.3f Mbit/s over %.2fs\n", totalPackets / wallSeconds,
+           totalBytes * 8 / wallSeconds / 1000000.0, wallSeconds);
+    printf("Relay thread %.3fs CPU over %lld loops, %.2fus CPU per packet\n", m_relayCPU, (long long)m_relayIterations,
+           totalPackets ? m_relayCPU * 1000000.0 / totalPackets : 0.0);
+}
+
+static void PrintUsage()
+{
+    printf("usage: coplay_replay <capture.cpcap> [options]\n"
+           "  -fast          replay as fast as possible instead of with the captured timing\n"
+           "  -speed <x>     scale the captured timing, 2 plays twice as fast (default 1)\n"
+           "  -hz <n>        relay loop rate like coplay_connectionthread_hz, 0 never sleeps (default 300)\n"
+           "  -spin <us>     how long the relay loop keeps spinning after traffic (default 500)\n"
+           "  -loops <n>     replay the capture this many times (default 1)\n"
+           "  -window <n>    datagrams allowed in flight with -fast (default 32)\n"
+           "  -maxsize <n>   biggest datagram to replay (default 2048)\n");
+}
+
+int main(int argc, char **argv)
+{
+    ReplayOptions_t options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (CoplayToolArgIs(argc, argv, i, "-fast"))
+            options.fast = true;
+        else if (CoplayToolArgIs(argc, argv, i, "-speed"))
+            options.speed = CoplayToolArgFloat(argc, argv, i, options.speed);
+        else if (CoplayToolArgIs(argc, argv, i, "-hz"))
+            options.hz = CoplayToolArgInt(argc, argv, i, options.hz);
+        else if (CoplayToolArgIs(argc, argv, i, "-spin"))
+            options.spin = CoplayToolArgInt(argc, argv, i, options.spin);
+        else if (CoplayToolArgIs(argc, argv, i, "-loops"))
+            options.loops = CoplayToolArgInt(argc, argv, i, options.loops);
+        else if (CoplayToolArgIs(argc, argv, i, "-window"))
+            options.window = CoplayToolArgInt(argc, argv, i, options.window);
+        else if (CoplayToolArgIs(argc, argv, i, "-maxsize"))
+            options.maxSize = CoplayToolArgInt(argc, argv, i, options.maxSize);
+        else if (argv[i][0] != '-' && !options.pszCapture)
+            options.pszCapture = argv[i];
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (!options.pszCapture || options.speed <= 0 || options.window < 1 || options.loops < 1)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if (!CoplayToolInit())
+        return 1;
+
+    CCoplayReplay replay;
+    bool ok = replay.Run(options);
+
+    CoplayToolShutdown();
+    return ok ? 0 : 1;
+}
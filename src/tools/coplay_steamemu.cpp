@@ -0,0 +1,521 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_steamemu.h"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+// k_ESteamNetConnectionEnd_Misc_Timeout
+#define EMU_END_TIMEOUT 5003
+
+#define EMU_LOBBY_BIT (1ull << 63)
+
+CCoplaySteamEmulator::CCoplaySteamEmulator(const SteamEmuOptions_t &options)
+    : m_options(options), m_now(0), m_eventOrder(0), m_random(options.seed ? options.seed : 1), m_messagesLost(0),
+      m_numUsers(0), m_nextLobby(1)
+{
+}
+
+CCoplaySteamEmulator::~CCoplaySteamEmulator()
+{
+    while (!m_events.empty())
+    {
+        free(m_events.top().message.pData);
+        m_events.pop();
+    }
+
+    for (size_t i = 0; i < m_connections.size(); i++)
+        Close((HCoplayPeer)(i + 1), 0, "", false);
+
+    for (std::map<uint64_t, Lobby_t*>::iterator it = m_lobbies.begin(); it != m_lobbies.end(); ++it)
+        delete it->second;
+}
+
+uint32_t CCoplaySteamEmulator::Random()
+{
+    // xorshift32, all we need is the same numbers every run
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return m_random;
+}
+
+int64_t CCoplaySteamEmulator::ArrivalTime(Connection_t *pFrom)
+{
+    int64_t arrival = m_now + m_options.latencyUsec;
+    if (m_options.jitterUsec > 0)
+        arrival += Random() % (uint32_t)(m_options.jitterUsec + 1);
+
+    // Steam keeps messages on a connection in order, jitter can't let one overtake another
+    arrival = std::max(arrival, pFrom->lastArrival);
+    pFrom->lastArrival = arrival;
+    return arrival;
+}
+
+void CCoplaySteamEmulator::Schedule(EventType type, HCoplayPeer hConn, int64_t time, int reason, Message_t message)
+{
+    Event_t event;
+    event.time    = time;
+    event.order   = m_eventOrder++;
+    event.type    = type;
+    event.hConn   = hConn;
+    event.reason  = reason;
+    event.message = message;
+    m_events.push(event);
+}
+
+void CCoplaySteamEmulator::Advance(int64_t usec)
+{
+    int64_t until = m_now + usec;
+    while (!m_events.empty() && m_events.top().time <= until)
+    {
+        Event_t event = m_events.top();
+        m_events.pop();
+        m_now = event.time;
+        RunEvent(event);
+    }
+    m_now = until;
+
+    for (size_t i = 0; i < m_connections.size(); i++)
+    {
+        Connection_t *pConnection = m_connections[i];
+        if (pConnection && pConnection->info.state == eEmuConnection_Connecting
+            && pConnection->created + m_options.connectTimeoutUsec <= m_now)
+        {
+            SetState((HCoplayPeer)(i + 1), eEmuConnection_ProblemDetectedLocally, EMU_END_TIMEOUT);
+        }
+    }
+}
+
+void CCoplaySteamEmulator::RunEvent(Event_t &event)
+{
+    Connection_t *pConnection = GetConnection(event.hConn);
+    switch (event.type)
+    {
+    case eEvent_Connect:
+    {
+        if (!pConnection || pConnection->info.state != eEmuConnection_Connecting)
+            break;
+
+        // nobody listening just looks like nobody answering, the connect timeout gets it
+        HEmuListenSocket hListenSocket = EMU_INVALID_HANDLE;
+        for (size_t i = 0; i < m_listenSockets.size() && hListenSocket == EMU_INVALID_HANDLE; i++)
+        {
+            if (m_listenSockets[i] == pConnection->info.remoteID)
+                hListenSocket = (HEmuListenSocket)(i + 1);
+        }
+        if (hListenSocket == EMU_INVALID_HANDLE)
+            break;
+
+        HCoplayPeer hIncoming = NewConnection(pConnection->info.remoteID, pConnection->user, hListenSocket);
+        GetConnection(hIncoming)->hRemote = event.hConn;
+        pConnection->hRemote = hIncoming;
+        SetState(hIncoming, eEmuConnection_Connecting, 0);
+        break;
+    }
+
+    case eEvent_Accepted:
+        if (pConnection && pConnection->info.state == eEmuConnection_Connecting)
+            SetState(event.hConn, eEmuConnection_Connected, 0);
+        break;
+
+    case eEvent_Closed:
+        if (pConnection && (pConnection->info.state == eEmuConnection_Connecting || pConnection->info.state == eEmuConnection_Connected))
+        {
+            pConnection->hRemote = COPLAY_INVALID_PEER;
+            SetState(event.hConn, eEmuConnection_ClosedByPeer, event.reason);
+        }
+        break;
+
+    case eEvent_Broken:
+        if (pConnection && (pConnection->info.state == eEmuConnection_Connecting || pConnection->info.state == eEmuConnection_Connected))
+            SetState(event.hConn, eEmuConnection_ProblemDetectedLocally, EMU_END_TIMEOUT);
+        break;
+
+    case eEvent_Message:
+        if (pConnection && pConnection->info.state == eEmuConnection_Connected)
+            pConnection->inbox.push_back(event.message);
+        else
+            free(event.message.pData);
+        break;
+    }
+}
+
+int CCoplaySteamEmulator::RunCallbacks(uint64_t user, IEmuCallbacks *pCallbacks)
+{
+    std::vector<Callback_t> callbacks;
+    callbacks.swap(m_callbacks[user]);
+    for (size_t i = 0; i < callbacks.size(); i++)
+    {
+        if (callbacks[i].bLobby)
+            pCallbacks->LobbyEntered(callbacks[i].lobbyID, callbacks[i].bSuccess);
+        else
+            pCallbacks->ConnectionStatusChanged(callbacks[i].status);
+    }
+    return (int)callbacks.size();
+}
+
+uint64_t CCoplaySteamEmulator::CreateUser()
+{
+    return ++m_numUsers;
+}
+
+void CCoplaySteamEmulator::SetFriends(uint64_t userA, uint64_t userB)
+{
+    m_friends.push_back(std::make_pair(std::min(userA, userB), std::max(userA, userB)));
+}
+
+bool CCoplaySteamEmulator::HasFriend(uint64_t user, uint64_t other) const
+{
+    std::pair<uint64_t, uint64_t> pair(std::min(user, other), std::max(user, other));
+    return std::find(m_friends.begin(), m_friends.end(), pair) != m_friends.end();
+}
+
+CCoplaySteamEmulator::Connection_t *CCoplaySteamEmulator::GetConnection(HCoplayPeer hConn) const
+{
+    if (hConn == COPLAY_INVALID_PEER || hConn > m_connections.size())
+        return NULL;
+    return m_connections[hConn - 1];
+}
+
+HCoplayPeer CCoplaySteamEmulator::NewConnection(uint64_t user, uint64_t remoteID, HEmuListenSocket hListenSocket)
+{
+    Connection_t *pConnection = new Connection_t;
+    pConnection->user               = user;
+    pConnection->info.remoteID      = remoteID;
+    pConnection->info.hListenSocket = hListenSocket;
+    pConnection->info.state         = eEmuConnection_None;
+    pConnection->info.endReason     = 0;
+    pConnection->created            = m_now;
+    m_connections.push_back(pConnection);
+    return (HCoplayPeer)m_connections.size();
+}
+
+void CCoplaySteamEmulator::SetState(HCoplayPeer hConn, EmuConnectionState state, int endReason)
+{
+    Connection_t *pConnection = GetConnection(hConn);
+
+    Callback_t callback = {};
+    callback.status.hConn    = hConn;
+    callback.status.oldState = pConnection->info.state;
+
+    pConnection->info.state     = state;
+    pConnection->info.endReason = endReason;
+
+    callback.status.info = pConnection->info;
+    m_callbacks[pConnection->user].push_back(callback);
+}
+
+HEmuListenSocket CCoplaySteamEmulator::CreateListenSocketP2P(uint64_t user)
+{
+    m_listenSockets.push_back(user);
+    return (HEmuListenSocket)m_listenSockets.size();
+}
+
+bool CCoplaySteamEmulator::CloseListenSocket(HEmuListenSocket hSocket)
+{
+    if (hSocket == EMU_INVALID_HANDLE || hSocket > m_listenSockets.size() || !m_listenSockets[hSocket - 1])
+        return false;
+
+    // like Steam, everything that came in through it goes with it
+    for (size_t i = 0; i < m_connections.size(); i++)
+    {
+        if (m_connections[i] && m_connections[i]->info.hListenSocket == hSocket)
+            Close((HCoplayPeer)(i + 1), 0, "listensocketclosed", false);
+    }
+    m_listenSockets[hSocket - 1] = 0;
+    return true;
+}
+
+HCoplayPeer CCoplaySteamEmulator::ConnectP2P(uint64_t user, uint64_t remote)
+{
+    HCoplayPeer hConn = NewConnection(user, remote, EMU_INVALID_HANDLE);
+    SetState(hConn, eEmuConnection_Connecting, 0);
+    Schedule(eEvent_Connect, hConn, ArrivalTime(GetConnection(hConn)));
+    return hConn;
+}
+
+bool CCoplaySteamEmulator::AcceptConnection(HCoplayPeer hConn)
+{
+    // only incoming connections can be accepted, Steam gives k_EResultInvalidParam for the rest
+    Connection_t *pConnection = GetConnection(hConn);
+    if (!pConnection || pConnection->info.hListenSocket == EMU_INVALID_HANDLE || pConnection->info.state != eEmuConnection_Connecting)
+        return false;
+
+    SetState(hConn, eEmuConnection_Connected, 0);
+    Schedule(eEvent_Accepted, pConnection->hRemote, ArrivalTime(pConnection));
+    return true;
+}
+
+bool CCoplaySteamEmulator::GetConnectionInfo(HCoplayPeer hConn, EmuConnectionInfo_t *pInfo) const
+{
+    Connection_t *pConnection = GetConnection(hConn);
+    if (!pConnection)
+        return false;
+    *pInfo = pConnection->info;
+    return true;
+}
+
+void CCoplaySteamEmulator::BreakConnection(HCoplayPeer hConn, int64_t remoteDetectUsec)
+{
+    Connection_t *pConnection = GetConnection(hConn);
+    if (!pConnection || pConnection->info.state != eEmuConnection_Connected)
+        return;
+
+    Connection_t *pRemote = GetConnection(pConnection->hRemote);
+    if (pRemote)
+    {
+        Schedule(eEvent_Broken, pConnection->hRemote, m_now + remoteDetectUsec);
+        pRemote->hRemote = COPLAY_INVALID_PEER;
+    }
+    pConnection->hRemote = COPLAY_INVALID_PEER;
+    SetState(hConn, eEmuConnection_ProblemDetectedLocally, EMU_END_TIMEOUT);
+}
+
+HEmuPollGroup CCoplaySteamEmulator::CreatePollGroup(uint64_t user)
+{
+    m_pollGroups.push_back(user);
+    return (HEmuPollGroup)m_pollGroups.size();
+}
+
+bool CCoplaySteamEmulator::SetConnectionPollGroup(HCoplayPeer hConn, HEmuPollGroup hGroup)
+{
+    Connection_t *pConnection = GetConnection(hConn);
+    if (!pConnection || hGroup > m_pollGroups.size())
+        return false;
+    pConnection->hPollGroup = hGroup;
+    return true;
+}
+
+int CCoplaySteamEmulator::ReceiveMessagesOnPollGroup(HEmuPollGroup hGroup, CoplayDatagram_t *pDatagrams, HCoplayPeer *pFrom, int maxDatagrams)
+{
+    if (hGroup == EMU_INVALID_HANDLE || hGroup > m_pollGroups.size())
+        return -1;
+
+    int numRecv = 0;
+    for (size_t i = 0; i < m_connections.size() && numRecv < maxDatagrams; i++)
+    {
+        if (!m_connections[i] || m_connections[i]->hPollGroup != hGroup)
+            continue;
+
+        int n = Receive((HCoplayPeer)(i + 1), pDatagrams + numRecv, maxDatagrams - numRecv);
+        for (int j = 0; j < n; j++)
+            pFrom[numRecv + j] = (HCoplayPeer)(i + 1);
+        numRecv += n;
+    }
+    return numRecv;
+}
+
+CCoplaySteamEmulator::Lobby_t *CCoplaySteamEmulator::GetLobby(uint64_t lobbyID) const
+{
+    std::map<uint64_t, Lobby_t*>::const_iterator it = m_lobbies.find(lobbyID);
+    return it != m_lobbies.end() ? it->second : NULL;
+}
+
+uint64_t CCoplaySteamEmulator::CreateLobby(uint64_t user, EmuLobbyType type, int maxMembers)
+{
+    Lobby_t *pLobby = new Lobby_t;
+    pLobby->owner      = user;
+    pLobby->type       = type;
+    pLobby->maxMembers = maxMembers;
+    pLobby->members.push_back(user);
+
+    uint64_t lobbyID = EMU_LOBBY_BIT | m_nextLobby++;
+    m_lobbies[lobbyID] = pLobby;
+
+    Callback_t callback = {};
+    callback.bLobby   = true;
+    callback.lobbyID  = lobbyID;
+    callback.bSuccess = true;
+    m_callbacks[user].push_back(callback);
+    return lobbyID;
+}
+
+void CCoplaySteamEmulator::JoinLobby(uint64_t user, uint64_t lobbyID)
+{
+    // private lobbies can still be joined by ID, that's what an invite hands out
+    Lobby_t *pLobby = GetLobby(lobbyID);
+    bool bSuccess = pLobby && (int)pLobby->members.size() < pLobby->maxMembers
+        && (pLobby->type != eEmuLobby_FriendsOnly || HasFriend(user, pLobby->owner));
+    if (bSuccess && !IsUserInLobby(lobbyID, user))
+        pLobby->members.push_back(user);
+
+    Callback_t callback = {};
+    callback.bLobby   = true;
+    callback.lobbyID  = lobbyID;
+    callback.bSuccess = bSuccess;
+    m_callbacks[user].push_back(callback);
+}
+
+void CCoplaySteamEmulator::LeaveLobby(uint64_t user, uint64_t lobbyID)
+{
+    Lobby_t *pLobby = GetLobby(lobbyID);
+    if (!pLobby)
+        return;
+
+    pLobby->members.erase(std::remove(pLobby->members.begin(), pLobby->members.end(), user), pLobby->members.end());
+    if (pLobby->members.empty())
+    {
+        delete pLobby;
+        m_lobbies.erase(lobbyID);
+    }
+    else if (pLobby->owner == user)
+    {
+        pLobby->owner = pLobby->members[0];
+    }
+}
+
+bool CCoplaySteamEmulator::SetLobbyData(uint64_t user, uint64_t lobbyID, const char *pszKey, const char *pszValue)
+{
+    Lobby_t *pLobby = GetLobby(lobbyID);
+    if (!pLobby || pLobby->owner != user)
+        return false;
+    pLobby->data[pszKey] = pszValue;
+    return true;
+}
+
+const char *CCoplaySteamEmulator::GetLobbyData(uint64_t lobbyID, const char *pszKey) const
+{
+    Lobby_t *pLobby = GetLobby(lobbyID);
+    if (!pLobby)
+        return "";
+    std::map<std::string, std::string>::const_iterator it = pLobby->data.find(pszKey);
+    return it != pLobby->data.end() ? it->second.c_str() : "";
+}
+
+int CCoplaySteamEmulator::GetNumLobbyMembers(uint64_t lobbyID) const
+{
+    Lobby_t *pLobby = GetLobby(lobbyID);
+    return pLobby ? (int)pLobby->members.size() : 0;
+}
+
+uint64_t CCoplaySteamEmulator::GetLobbyMemberByIndex(uint64_t lobbyID, int index) const
+{
+    Lobby_t *pLobby = GetLobby(lobbyID);
+    if (!pLobby || index < 0 || index >= (int)pLobby->members.size())
+        return 0;
+    return pLobby->members[index];
+}
+
+uint64_t CCoplaySteamEmulator::GetLobbyOwner(uint64_t lobbyID) const
+{
+    Lobby_t *pLobby = GetLobby(lobbyID);
+    return pLobby ? pLobby->owner : 0;
+}
+
+bool CCoplaySteamEmulator::IsUserInLobby(uint64_t lobbyID, uint64_t user) const
+{
+    Lobby_t *pLobby = GetLobby(lobbyID);
+    return pLobby && std::find(pLobby->members.begin(), pLobby->members.end(), user) != pLobby->members.end();
+}
+
+void CCoplaySteamEmulator::RequestLobbyList(uint64_t user, std::vector<uint64_t> &lobbies) const
+{
+    lobbies.clear();
+    for (std::map<uint64_t, Lobby_t*>::const_iterator it = m_lobbies.begin(); it != m_lobbies.end(); ++it)
+    {
+        if (it->second->type == eEmuLobby_Public || (it->second->type == eEmuLobby_FriendsOnly && HasFriend(user, it->second->owner)))
+            lobbies.push_back(it->first);
+    }
+}
+
+CoplaySendResult CCoplaySteamEmulator::Send(HCoplayPeer hPeer, const void *pData, int len, int sendFlags)
+{
+    Connection_t *pConnection = GetConnection(hPeer);
+    if (!pConnection || pConnection->info.state != eEmuConnection_Connected || pConnection->hRemote == COPLAY_INVALID_PEER)
+        return eCoplaySendResult_NoConnection;
+
+    // a lost message still counts as sent, Steam wouldn't know either
+    if (!(sendFlags & eCoplaySend_Reliable) && m_options.lossPct > 0 && Random() % 10000 < m_options.lossPct * 100)
+    {
+        m_messagesLost++;
+        return eCoplaySendResult_OK;
+    }
+
+    Message_t message;
+    message.pData = (uint8_t*)malloc(len);
+    message.len   = len;
+    memcpy(message.pData, pData, len);
+    Schedule(eEvent_Message, pConnection->hRemote, ArrivalTime(pConnection), 0, message);
+    return eCoplaySendResult_OK;
+}
+
+int CCoplaySteamEmulator::Receive(HCoplayPeer hPeer, CoplayDatagram_t *pDatagrams, int maxDatagrams)
+{
+    Connection_t *pConnection = GetConnection(hPeer);
+    if (!pConnection)
+        return -1;
+
+    int numRecv = 0;
+    while (numRecv < maxDatagrams && pConnection->inboxRead < pConnection->inbox.size())
+    {
+        Message_t &message = pConnection->inbox[pConnection->inboxRead++];
+        pDatagrams[numRecv].pData   = message.pData;
+        pDatagrams[numRecv].len     = message.len;
+        pDatagrams[numRecv].pHandle = message.pData;
+        pDatagrams[numRecv].ageUsec = 0;
+        numRecv++;
+    }
+
+    if (pConnection->inboxRead == pConnection->inbox.size())
+    {
+        pConnection->inbox.clear();
+        pConnection->inboxRead = 0;
+    }
+    return numRecv;
+}
+
+void CCoplaySteamEmulator::Release(CoplayDatagram_t *pDatagrams, int numDatagrams)
+{
+    for (int i = 0; i < numDatagrams; i++)
+        free(pDatagrams[i].pHandle);
+}
+
+void CCoplaySteamEmulator::Close(HCoplayPeer hPeer, int reason, const char *pszDebug, bool bEnableLinger)
+{
+    Connection_t *pConnection = GetConnection(hPeer);
+    if (!pConnection)
+        return;
+
+    if (pConnection->hRemote != COPLAY_INVALID_PEER)
+        Schedule(eEvent_Closed, pConnection->hRemote, ArrivalTime(pConnection), reason);
+
+    // the remote might still hold on to us as its other end
+    Connection_t *pRemote = GetConnection(pConnection->hRemote);
+    if (pRemote && pRemote->hRemote == hPeer)
+        pRemote->hRemote = COPLAY_INVALID_PEER;
+
+    for (size_t i = pConnection->inboxRead; i < pConnection->inbox.size(); i++)
+        free(pConnection->inbox[i].pData);
+    delete pConnection;
+    m_connections[hPeer - 1] = NULL;
+}
+
+bool CCoplaySteamEmulator::GetRemoteID(HCoplayPeer hPeer, uint64_t *pID)
+{
+    Connection_t *pConnection = GetConnection(hPeer);
+    if (!pConnection)
+        return false;
+    *pID = pConnection->info.remoteID;
+    return true;
+}
+
+bool CCoplaySteamEmulator::GetStatus(HCoplayPeer hPeer, CoplayPeerStatus_t *pStatus)
+{
+    if (!GetConnection(hPeer))
+        return false;
+    *pStatus = CoplayPeerStatus_t();
+    pStatus->pingMs        = (int)((m_options.latencyUsec * 2 + m_options.jitterUsec) / 1000);
+    pStatus->qualityLocal  = (float)(1 - m_options.lossPct / 100);
+    pStatus->qualityRemote = pStatus->qualityLocal;
+    return true;
+}
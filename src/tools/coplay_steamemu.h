@@ -0,0 +1,228 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Offline stand-in for the parts of ISteamNetworkingSockets, ISteamNetworkingUtils, ISteamFriends and ISteamMatchmaking
+// that the host and client use, with any number of users in one process.
+// Unlike CCoplayMockSteamSockets nothing here is thread safe and nothing happens on its own, time only moves
+// when Advance is called. With the same seed and the same calls every run plays out exactly the same,
+// latency and loss included.
+#ifndef COPLAY_STEAMEMU_H
+#define COPLAY_STEAMEMU_H
+#pragma once
+
+#include "coplay_transport.h"
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <queue>
+#include <string>
+#include <vector>
+
+typedef uint32_t HEmuListenSocket;
+typedef uint32_t HEmuPollGroup;
+#define EMU_INVALID_HANDLE 0
+
+// Same values as ESteamNetworkingConnectionState
+enum EmuConnectionState
+{
+    eEmuConnection_None                   = 0,
+    eEmuConnection_Connecting             = 1,
+    eEmuConnection_Connected              = 3,
+    eEmuConnection_ClosedByPeer           = 4,
+    eEmuConnection_ProblemDetectedLocally = 5,
+};
+
+// Same values as ELobbyType
+enum EmuLobbyType
+{
+    eEmuLobby_Private     = 0,
+    eEmuLobby_FriendsOnly = 1,
+    eEmuLobby_Public      = 2,
+};
+
+struct EmuConnectionInfo_t
+{
+    uint64_t           remoteID;
+    HEmuListenSocket   hListenSocket; // set on connections that came in through a listen socket
+    EmuConnectionState state;
+    int                endReason;
+};
+
+// What SteamNetConnectionStatusChangedCallback_t carries
+struct EmuConnectionStatusChanged_t
+{
+    HCoplayPeer         hConn;
+    EmuConnectionInfo_t info;
+    EmuConnectionState  oldState;
+};
+
+class IEmuCallbacks
+{
+public:
+    virtual ~IEmuCallbacks() {}
+    virtual void ConnectionStatusChanged(const EmuConnectionStatusChanged_t &status) = 0;
+    virtual void LobbyEntered(uint64_t lobbyID, bool bSuccess) = 0;
+};
+
+struct SteamEmuOptions_t
+{
+    int64_t  latencyUsec        = 25000;   // one way
+    int64_t  jitterUsec         = 0;       // added on top, uniformly random
+    double   lossPct            = 0;       // unreliable messages only, reliable ones always arrive
+    int64_t  connectTimeoutUsec = 10000000; // how long a connection can sit unaccepted before its dropped
+    uint32_t seed               = 1;
+};
+
+class CCoplaySteamEmulator : public ICoplayTransport
+{
+public:
+    explicit CCoplaySteamEmulator(const SteamEmuOptions_t &options);
+    ~CCoplaySteamEmulator();
+
+    // Time, starts at 0. Advance delivers everything due by then and runs timeouts,
+    // callbacks are queued until the user they're for calls RunCallbacks
+    int64_t GetTimeUsec() const { return m_now; }
+    void    Advance(int64_t usec);
+    int     RunCallbacks(uint64_t user, IEmuCallbacks *pCallbacks);
+
+    // Users, IDs start at 1
+    uint64_t CreateUser();
+    void     SetFriends(uint64_t userA, uint64_t userB);
+    bool     HasFriend(uint64_t user, uint64_t other) const;
+
+    // ISteamNetworkingSockets, each takes the user making the call where Steam would know it already
+    HEmuListenSocket CreateListenSocketP2P(uint64_t user);
+    bool             CloseListenSocket(HEmuListenSocket hSocket);
+    HCoplayPeer      ConnectP2P(uint64_t user, uint64_t remote);
+    bool             AcceptConnection(HCoplayPeer hConn);
+    bool             GetConnectionInfo(HCoplayPeer hConn, EmuConnectionInfo_t *pInfo) const;
+    // Cuts the path under a connection, this end finds out now and the other after remoteDetectUsec.
+    // Anything on the way is lost and neither end hears about the other closing
+    void             BreakConnection(HCoplayPeer hConn, int64_t remoteDetectUsec);
+    HEmuPollGroup    CreatePollGroup(uint64_t user);
+    bool             SetConnectionPollGroup(HCoplayPeer hConn, HEmuPollGroup hGroup);
+    int              ReceiveMessagesOnPollGroup(HEmuPollGroup hGroup, CoplayDatagram_t *pDatagrams, HCoplayPeer *pFrom, int maxDatagrams);
+
+    // ISteamMatchmaking, lobby IDs have the top bit set so they never clash with users
+    uint64_t    CreateLobby(uint64_t user, EmuLobbyType type, int maxMembers);
+    void        JoinLobby(uint64_t user, uint64_t lobbyID);
+    void        LeaveLobby(uint64_t user, uint64_t lobbyID);
+    bool        SetLobbyData(uint64_t user, uint64_t lobbyID, const char *pszKey, const char *pszValue);
+    const char *GetLobbyData(uint64_t lobbyID, const char *pszKey) const;
+    int         GetNumLobbyMembers(uint64_t lobbyID) const;
+    uint64_t    GetLobbyMemberByIndex(uint64_t lobbyID, int index) const;
+    uint64_t    GetLobbyOwner(uint64_t lobbyID) const;
+    bool        IsUserInLobby(uint64_t lobbyID, uint64_t user) const;
+    void        RequestLobbyList(uint64_t user, std::vector<uint64_t> &lobbies) const; // answers straight away
+
+    // ICoplayTransport, a peer is a connection handle
+    virtual const char *GetName() const { return "steamemu"; }
+
+    virtual CoplaySendResult Send(HCoplayPeer hPeer, const void *pData, int len, int sendFlags);
+    virtual int  Receive(HCoplayPeer hPeer, CoplayDatagram_t *pDatagrams, int maxDatagrams);
+    virtual void Release(CoplayDatagram_t *pDatagrams, int numDatagrams);
+    virtual void Close(HCoplayPeer hPeer, int reason, const char *pszDebug, bool bEnableLinger);
+    virtual bool GetRemoteID(HCoplayPeer hPeer, uint64_t *pID);
+    virtual bool GetStatus(HCoplayPeer hPeer, CoplayPeerStatus_t *pStatus);
+
+    // unreliable messages lost on the way so far
+    int64_t GetMessagesLost() const { return m_messagesLost; }
+
+private:
+    struct Message_t
+    {
+        uint8_t *pData;
+        int      len;
+    };
+
+    // One end of an emulated connection
+    struct Connection_t
+    {
+        uint64_t               user;
+        HCoplayPeer            hRemote = COPLAY_INVALID_PEER; // the other end, once it exists
+        HEmuPollGroup          hPollGroup = EMU_INVALID_HANDLE;
+        EmuConnectionInfo_t    info;
+        int64_t                created;
+        int64_t                lastArrival = 0; // of anything we sent, keeps delivery in order with jitter
+        std::vector<Message_t> inbox;
+        size_t                 inboxRead = 0;
+    };
+
+    struct Lobby_t
+    {
+        uint64_t                           owner;
+        EmuLobbyType                       type;
+        int                                maxMembers;
+        std::vector<uint64_t>              members;
+        std::map<std::string, std::string> data;
+    };
+
+    enum EventType
+    {
+        eEvent_Connect,  // hConn reaches its remote
+        eEvent_Accepted, // the remote accepted hConn
+        eEvent_Closed,   // hConn's remote closed it
+        eEvent_Broken,   // hConn notices its path is gone
+        eEvent_Message,
+    };
+
+    struct Event_t
+    {
+        int64_t     time;
+        uint64_t    order; // events due at the same time happen in the order they were made
+        EventType   type;
+        HCoplayPeer hConn;
+        int         reason;
+        Message_t   message;
+
+        bool operator>(const Event_t &other) const
+        {
+            return time != other.time ? time > other.time : order > other.order;
+        }
+    };
+
+    struct Callback_t
+    {
+        bool                         bLobby;
+        EmuConnectionStatusChanged_t status;
+        uint64_t                     lobbyID;
+        bool                         bSuccess;
+    };
+
+    Connection_t *GetConnection(HCoplayPeer hConn) const;
+    Lobby_t      *GetLobby(uint64_t lobbyID) const;
+    HCoplayPeer   NewConnection(uint64_t user, uint64_t remoteID, HEmuListenSocket hListenSocket);
+    void          SetState(HCoplayPeer hConn, EmuConnectionState state, int endReason);
+    void          Schedule(EventType type, HCoplayPeer hConn, int64_t time, int reason = 0, Message_t message = Message_t());
+    void          RunEvent(Event_t &event);
+    int64_t       ArrivalTime(Connection_t *pFrom); // when something sent now from pFrom gets to the other end
+    uint32_t      Random();
+
+    SteamEmuOptions_t m_options;
+    int64_t           m_now;
+    uint64_t          m_eventOrder;
+    uint32_t          m_random;
+    int64_t           m_messagesLost;
+
+    uint64_t                                m_numUsers;
+    std::vector<std::pair<uint64_t, uint64_t> > m_friends;
+    std::map<uint64_t, std::vector<Callback_t> > m_callbacks; // per user
+
+    std::vector<uint64_t>      m_listenSockets; // owning user, handle is the index + 1, 0 once closed
+    std::vector<uint64_t>      m_pollGroups;    // same
+    std::vector<Connection_t*> m_connections;   // handle is the index + 1
+    std::map<uint64_t, Lobby_t*> m_lobbies;
+    uint64_t                   m_nextLobby;
+
+    std::priority_queue<Event_t, std::vector<Event_t>, std::greater<Event_t> > m_events;
+};
+
+#endif
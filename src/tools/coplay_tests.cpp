@@ -0,0 +1,587 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Checks for the parts of coplay_core that don't need the engine, Steam or another process to try out.
+// Prints what failed and exits with 1 if anything did, ctest runs it as coplay_tests.
+
+#include "coplay_fec.h"
+#include "coplay_fragment.h"
+#include "coplay_handshake.h"
+#include "coplay_log.h"
+#include "coplay_netchan.h"
+#include "coplay_packetpool.h"
+#include "coplay_ports.h"
+#include "coplay_redundancy.h"
+#include "coplay_ticket.h"
+#include "coplay_toolcommon.h"
+
+#include <atomic>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int s_numChecks = 0;
+static int s_numFailed = 0;
+
+#define CHECK(cond) Check((cond), #cond, __FILE__, __LINE__)
+
+static void Check(bool bPassed, const char *pszWhat, const char *pszFile, int line)
+{
+    s_numChecks++;
+    if (bPassed)
+        return;
+    s_numFailed++;
+    printf("  FAILED %s:%i: %s\n", pszFile, line, pszWhat);
+}
+
+// A datagram the way the netchannel would send it, the rest of it says which one it is
+static int MakeDatagram(uint8_t *pOut, int32_t sequence, int len)
+{
+    for (int i = 0; i < 4; i++)
+        pOut[i] = (uint8_t)((uint32_t)sequence >> (i * 8));
+    memset(pOut + 4, 0, 5);
+    for (int i = COPLAY_NETCHAN_HEADER_SIZE; i < len; i++)
+        pOut[i] = (uint8_t)(sequence * 31 + i);
+    return len;
+}
+
+struct Delivered_t
+{
+    std::vector<std::vector<uint8_t> > datagrams;
+};
+
+static void Deliver(void *pContext, const uint8_t *pData, int len)
+{
+    ((Delivered_t*)pContext)->datagrams.push_back(std::vector<uint8_t>(pData, pData + len));
+}
+
+static int32_t DeliveredSequence(const Delivered_t &delivered, int i)
+{
+    CoplayNetchanHeader_t header;
+    if (!CoplayReadNetchanHeader(delivered.datagrams[i].data(), (int)delivered.datagrams[i].size(), &header))
+        return -1;
+    return header.sequence;
+}
+
+static void TestNetchan()
+{
+    uint8_t datagram[64];
+    CoplayNetchanHeader_t header;
+
+    MakeDatagram(datagram, 1234, 32);
+    datagram[4] = 0x10;
+    datagram[5] = 0x02;
+    datagram[8] = COPLAY_PACKET_FLAG_RELIABLE;
+    CHECK(CoplayReadNetchanHeader(datagram, 32, &header));
+    CHECK(header.sequence == 1234);
+    CHECK(header.sequenceAck == 0x210);
+    CHECK(header.flags == COPLAY_PACKET_FLAG_RELIABLE);
+    CHECK(CoplayClassifyDatagram(datagram, 32) == eCoplayTraffic_Reliable);
+    CHECK(!CoplayIsConnectionless(datagram, 32));
+
+    // too short for a header
+    CHECK(!CoplayReadNetchanHeader(datagram, COPLAY_NETCHAN_HEADER_SIZE - 1, &header));
+
+    datagram[8] = 0;
+    CHECK(CoplayClassifyDatagram(datagram, 32) == eCoplayTraffic_Realtime);
+
+    MakeDatagram(datagram, COPLAY_NET_HEADER_CONNECTIONLESS, 32);
+    CHECK(!CoplayReadNetchanHeader(datagram, 32, &header));
+    CHECK(CoplayIsConnectionless(datagram, 32));
+    CHECK(CoplayClassifyDatagram(datagram, 32) == eCoplayTraffic_Reliable);
+
+    MakeDatagram(datagram, COPLAY_NET_HEADER_SPLIT, 32);
+    CHECK(!CoplayReadNetchanHeader(datagram, 32, &header));
+    CHECK(!CoplayIsConnectionless(datagram, 32));
+    CHECK(CoplayClassifyDatagram(datagram, 32) == eCoplayTraffic_Bulk);
+
+    MakeDatagram(datagram, COPLAY_NET_HEADER_COMPRESSED, 32);
+    CHECK(CoplayClassifyDatagram(datagram, 32) == eCoplayTraffic_Bulk);
+}
+
+static void TestReassembly()
+{
+    uint8_t datagram[1200];
+    MakeDatagram(datagram, 77, sizeof(datagram));
+
+    const int maxLen = 300;
+    int count = CoplayCountFragments(sizeof(datagram), maxLen);
+    CHECK(count == 5);
+    CHECK(CoplayCountFragments(100, maxLen) == 1);
+    CHECK(CoplayCountFragments(100000, maxLen) == 0);
+
+    uint8_t pieces[8][COPLAY_POOL_BUFFER_SIZE];
+    int     lens[8];
+    for (int i = 0; i < count; i++)
+    {
+        lens[i] = CoplayWriteFragment(pieces[i], 9, datagram, sizeof(datagram), i, count);
+        CHECK(lens[i] <= maxLen);
+        CHECK(CoplayReadRelayMessage(pieces[i], lens[i]) == eCoplayRelayMsg_Fragment);
+    }
+    CHECK(CoplayReadRelayMessage(datagram, sizeof(datagram)) == -1);
+
+    // out of order, with a copy of one in the middle
+    CCoplayReassembler reassembler;
+    const uint8_t *pWhole = NULL;
+    int order[] = { 3, 0, 4, 0, 2 };
+    for (int i = 0; i < 5; i++)
+        CHECK(reassembler.Add(pieces[order[i]], lens[order[i]], 1000 + i, &pWhole) == 0);
+    CHECK(reassembler.Add(pieces[1], lens[1], 1010, &pWhole) == (int)sizeof(datagram));
+    CHECK(pWhole && !memcmp(pWhole, datagram, sizeof(datagram)));
+    CHECK(reassembler.Expire(1020) == 0);
+
+    // a piece that can't be right
+    CHECK(reassembler.Add(pieces[0], COPLAY_RELAY_MSG_HEADER_SIZE + 1, 2000, &pWhole) == -1);
+
+    // one that never finishes is given up on
+    CHECK(reassembler.Add(pieces[0], lens[0], 3000, &pWhole) == 0);
+    CHECK(reassembler.Expire(3000 + COPLAY_REASSEMBLY_TIMEOUT_MAX + 1) == 1);
+    CHECK(reassembler.Add(pieces[1], lens[1], 200000, &pWhole) == 0);
+}
+
+static void TestFec()
+{
+    CHECK(CoplayFecGroupSize(0) == COPLAY_FEC_MAX_GROUP);
+    CHECK(CoplayFecGroupSize(0.5) == COPLAY_FEC_MIN_GROUP);
+
+    uint8_t a[40], b[40];
+    for (int i = 0; i < 40; i++)
+    {
+        a[i] = (uint8_t)i;
+        b[i] = (uint8_t)(i * 7 + 3);
+    }
+    uint8_t x[40];
+    memcpy(x, a, sizeof(x));
+    CoplayXorBytes(x, b, sizeof(x));
+    CoplayXorBytes(x, b, sizeof(x));
+    CHECK(!memcmp(x, a, sizeof(x)));
+
+    // a group of 4 with the third one lost, it comes back from the parity and everything stays in order
+    CCoplayFecEncoder encoder;
+    encoder.Init(0);
+    encoder.SetGroupSize(4);
+    CCoplayFecDecoder decoder;
+    Delivered_t delivered;
+
+    uint8_t datagram[256];
+    uint8_t message[COPLAY_POOL_BUFFER_SIZE];
+    int64_t now = 1000;
+    int     parityLen = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        int len = MakeDatagram(datagram, 100 + i, 40 + i * 30);
+        int messageLen = encoder.WriteData(message, datagram, len, now);
+        CHECK(CoplayReadRelayMessage(message, messageLen) == eCoplayRelayMsg_FecData);
+
+        int unwrappedLen;
+        const uint8_t *pUnwrapped = CoplayUnwrapFecData(message, messageLen, &unwrappedLen);
+        CHECK(unwrappedLen == len && !memcmp(pUnwrapped, datagram, len));
+
+        if (i != 2)
+            decoder.Add(message, messageLen, now, false, Deliver, &delivered);
+        parityLen = encoder.WriteParity(message, now);
+    }
+    CHECK(parityLen > 0);
+    CHECK(delivered.datagrams.size() == 2); // the fourth waits on the third
+    decoder.Add(message, parityLen, now, false, Deliver, &delivered);
+
+    CHECK(delivered.datagrams.size() == 4);
+    for (int i = 0; i < (int)delivered.datagrams.size(); i++)
+    {
+        MakeDatagram(datagram, 100 + i, 40 + i * 30);
+        CHECK(DeliveredSequence(delivered, i) == 100 + i);
+        CHECK((int)delivered.datagrams[i].size() == 40 + i * 30);
+        CHECK(!memcmp(delivered.datagrams[i].data(), datagram, delivered.datagrams[i].size()));
+    }
+    CHECK(decoder.TakeNumRecovered() == 1);
+    CHECK(decoder.TakeNumLost() == 0);
+
+    // two lost in one group can't be rebuilt, nothing's held once that's clear
+    delivered.datagrams.clear();
+    for (int i = 0; i < 4; i++)
+    {
+        int len = MakeDatagram(datagram, 200 + i, 60);
+        int messageLen = encoder.WriteData(message, datagram, len, now);
+        if (i != 0 && i != 1)
+            decoder.Add(message, messageLen, now, false, Deliver, &delivered);
+        parityLen = encoder.WriteParity(message, now);
+    }
+    decoder.Add(message, parityLen, now, false, Deliver, &delivered);
+    CHECK(delivered.datagrams.size() == 2);
+    CHECK(DeliveredSequence(delivered, 0) == 202 && DeliveredSequence(delivered, 1) == 203);
+    CHECK(decoder.TakeNumRecovered() == 0);
+    CHECK(decoder.TakeNumLost() == 2);
+
+    // and when the parity never comes, what was held goes once it's waited long enough
+    delivered.datagrams.clear();
+    for (int i = 0; i < 4; i++)
+    {
+        int len = MakeDatagram(datagram, 300 + i, 60);
+        int messageLen = encoder.WriteData(message, datagram, len, now);
+        if (i != 1)
+            decoder.Add(message, messageLen, now, false, Deliver, &delivered);
+        encoder.WriteParity(message, now);
+    }
+    CHECK(delivered.datagrams.size() == 1);
+    decoder.Expire(now + COPLAY_FEC_HOLD_USEC - 1, Deliver, &delivered);
+    CHECK(delivered.datagrams.size() == 1);
+    decoder.Expire(now + COPLAY_FEC_HOLD_USEC + 1, Deliver, &delivered);
+    CHECK(delivered.datagrams.size() == 3);
+}
+
+static void TestRedundancy()
+{
+    CHECK(CoplayRedundantCopies(0, 3) == 0);
+    CHECK(CoplayRedundantCopies(-1, 3) == 3);
+    CHECK(CoplayRedundantCopies(0.05, 0) == 0);
+    CHECK(CoplayRedundantCopies(0.05, 100) <= COPLAY_REDUNDANCY_MAX_COPIES);
+
+    CCoplayRedundancyWriter writer;
+    writer.SetCopies(2);
+    CCoplayRedundancyReader reader;
+    Delivered_t delivered;
+
+    uint8_t datagram[64];
+    uint8_t bundle[COPLAY_POOL_BUFFER_SIZE];
+    int     bundleLens[6];
+    uint8_t bundles[6][COPLAY_POOL_BUFFER_SIZE];
+    for (int i = 0; i < 6; i++)
+    {
+        int len = MakeDatagram(datagram, 10 + i, 40);
+        int numCopies;
+        bundleLens[i] = writer.Write(bundles[i], sizeof(bundles[i]), datagram, len, &numCopies);
+        CHECK(numCopies == (i < 2 ? i : 2));
+        CHECK(CoplayReadRelayMessage(bundles[i], bundleLens[i]) == eCoplayRelayMsg_Redundant);
+    }
+
+    // 12 and 13 go missing, 14 brings them along. Everything reaches the game once and in order
+    for (int i = 0; i < 6; i++)
+    {
+        if (i != 2 && i != 3)
+            CHECK(reader.Add(bundles[i], bundleLens[i], Deliver, &delivered));
+    }
+    CHECK(delivered.datagrams.size() == 6);
+    for (int i = 0; i < (int)delivered.datagrams.size(); i++)
+        CHECK(DeliveredSequence(delivered, i) == 10 + i);
+    CHECK(reader.TakeNumRecovered() == 2);
+    CHECK(reader.TakeNumDuplicates() > 0);
+
+    // the same bundle again has nothing new in it
+    delivered.datagrams.clear();
+    CHECK(reader.Add(bundles[5], bundleLens[5], Deliver, &delivered));
+    CHECK(delivered.datagrams.empty());
+
+    // one that got there plain means its copies don't go again
+    int len = MakeDatagram(datagram, 16, 40);
+    reader.OnDatagram(datagram, len);
+    int numCopies;
+    int bundleLen = writer.Write(bundle, sizeof(bundle), datagram, len, &numCopies);
+    CHECK(reader.Add(bundle, bundleLen, Deliver, &delivered));
+    CHECK(delivered.datagrams.empty());
+
+    // a new netchannel starts its sequences over
+    len = MakeDatagram(datagram, COPLAY_NET_HEADER_CONNECTIONLESS, 20);
+    reader.OnDatagram(datagram, len);
+    writer.Reset();
+    len = MakeDatagram(datagram, 1, 40);
+    bundleLen = writer.Write(bundle, sizeof(bundle), datagram, len, &numCopies);
+    CHECK(reader.Add(bundle, bundleLen, Deliver, &delivered));
+    CHECK(delivered.datagrams.size() == 1);
+
+    // and so does one we weren't told about, as long as it's well behind where the last one was
+    CCoplayRedundancyReader restarted;
+    len = MakeDatagram(datagram, 5000, 40);
+    restarted.OnDatagram(datagram, len);
+    len = MakeDatagram(datagram, 5000 - COPLAY_REDUNDANCY_RESTART_GAP - 1, 40);
+    delivered.datagrams.clear();
+    writer.Reset();
+    bundleLen = writer.Write(bundle, sizeof(bundle), datagram, len, &numCopies);
+    CHECK(restarted.Add(bundle, bundleLen, Deliver, &delivered));
+    CHECK(delivered.datagrams.size() == 1);
+
+    // cut short
+    CHECK(!reader.Add(bundle, bundleLen - 1, Deliver, &delivered));
+}
+
+static void TestTicket()
+{
+    // the reference vector from the SipHash paper
+    uint64_t key[2] = { 0x0706050403020100ull, 0x0f0e0d0c0b0a0908ull };
+    uint8_t  message[15];
+    for (int i = 0; i < 15; i++)
+        message[i] = (uint8_t)i;
+    CHECK(CoplaySipHash(key, message, sizeof(message)) == 0xa129ca6149be45e5ull);
+
+    CCoplayTicketAuthority authority;
+    std::string ticket = authority.Issue(76561197960287930ull, 42);
+    uint64_t serial = 0;
+    CHECK(authority.Verify(ticket, 76561197960287930ull, &serial));
+    CHECK(serial == 42);
+
+    // someone else's ticket, or one that's been messed with
+    CHECK(!authority.Verify(ticket, 76561197960287931ull, &serial));
+    std::string tampered = ticket;
+    tampered[0] = tampered[0] == '0' ? '1' : '0';
+    CHECK(!authority.Verify(tampered, 76561197960287930ull, &serial));
+    CHECK(!authority.Verify(ticket + "0", 76561197960287930ull, &serial));
+    CHECK(!authority.Verify("", 76561197960287930ull, &serial));
+
+    // a new key throws out everything from before
+    authority.NewKey();
+    CHECK(!authority.Verify(ticket, 76561197960287930ull, &serial));
+}
+
+static void TestHandshake()
+{
+    const char passcode[] = "aB3dE5gH7jK9mN1pQ3sT5vW7yZ9bC1eF";
+    CHECK(CoplayIsHandshakeMessage((const uint8_t*)passcode, sizeof(passcode) - 1));
+    const char resume[] = "Resume\0" "0123456789abcdef.0123456789abcdef";
+    CHECK(CoplayIsHandshakeMessage((const uint8_t*)resume, sizeof(resume) - 1));
+    CHECK(!CoplayIsHandshakeMessage((const uint8_t*)"", 0));
+
+    // what the game sends before its netchannel is up, and the relay's own messages, never look like one
+    uint8_t datagram[64];
+    MakeDatagram(datagram, COPLAY_NET_HEADER_CONNECTIONLESS, 32);
+    memcpy(datagram + 4, "getchallenge", 12);
+    CHECK(!CoplayIsHandshakeMessage(datagram, 16));
+    int len = CoplayWriteRelayMessage(datagram, eCoplayRelayMsg_Hello);
+    CHECK(!CoplayIsHandshakeMessage(datagram, len));
+    MakeDatagram(datagram, 1, 32);
+    CHECK(!CoplayIsHandshakeMessage(datagram, 32));
+}
+
+static void TestPorts()
+{
+    // the range is somewhere up high that nothing else should be using
+    const int begin = 47100;
+    uint16_t  firstPort = 0, secondPort = 0;
+    UDPsocket first = CoplayOpenSocketInRange(begin, begin + 16, &firstPort);
+    CHECK(first != NULL);
+    UDPsocket second = CoplayOpenSocketInRange(begin, begin + 16, &secondPort);
+    CHECK(second != NULL);
+    CHECK(firstPort >= begin && firstPort < begin + 16);
+    CHECK(secondPort > firstPort && secondPort < begin + 16);
+
+    // nothing left in a range that's only the one that's taken
+    uint16_t port = 0;
+    CHECK(CoplayOpenSocketInRange(firstPort, firstPort + 1, &port) == NULL);
+    CHECK(CoplayOpenSocketInRange(begin, begin, &port) == NULL);
+
+    SDLNet_UDP_Close(first);
+    SDLNet_UDP_Close(second);
+}
+
+static void TestPacketPool()
+{
+    CCoplayPacketPool pool;
+    uint8_t *pFirst  = pool.Alloc();
+    uint8_t *pSecond = pool.Alloc();
+    CHECK(pFirst && pSecond && pFirst != pSecond);
+    CHECK(pool.GetNumInUse() == 2);
+    pool.Free(pFirst);
+    CHECK(pool.GetNumInUse() == 1);
+    CHECK(pool.Alloc() == pFirst);
+    pool.Free(pFirst);
+    pool.Free(pSecond);
+
+    // every buffer handed out is only ever someone's at a time
+    const int numThreads = 4;
+    const int numRounds  = 20000;
+    std::vector<std::thread> threads;
+    std::vector<int> numBad(numThreads, 0);
+    for (int t = 0; t < numThreads; t++)
+    {
+        threads.push_back(std::thread([&pool, &numBad, t]()
+        {
+            uint8_t *pHeld[8];
+            for (int round = 0; round < numRounds; round++)
+            {
+                for (int i = 0; i < 8; i++)
+                {
+                    pHeld[i] = pool.Alloc();
+                    memset(pHeld[i], t * 8 + i, 64);
+                }
+                for (int i = 0; i < 8; i++)
+                {
+                    for (int j = 0; j < 64; j++)
+                    {
+                        if (pHeld[i][j] != (uint8_t)(t * 8 + i))
+                        {
+                            numBad[t]++;
+                            break;
+                        }
+                    }
+                    pool.Free(pHeld[i]);
+                }
+            }
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    for (int t = 0; t < numThreads; t++)
+        CHECK(numBad[t] == 0);
+    CHECK(pool.GetNumInUse() == 0);
+
+    // runs out once every slab is out
+    std::vector<uint8_t*> held;
+    std::set<uint8_t*> unique;
+    while (uint8_t *pBuffer = pool.Alloc())
+    {
+        held.push_back(pBuffer);
+        unique.insert(pBuffer);
+    }
+    CHECK(held.size() == COPLAY_POOL_MAX_SLABS * COPLAY_POOL_SLAB_BUFFERS);
+    CHECK(unique.size() == held.size());
+    CHECK(pool.GetNumSlabs() == COPLAY_POOL_MAX_SLABS);
+    for (size_t i = 0; i < held.size(); i++)
+        pool.Free(held[i]);
+    CHECK(pool.GetNumInUse() == 0);
+}
+
+static bool PushLog(CCoplayLogRing *pRing, CoplayLogType type, const char *pszFormat, ...)
+{
+    va_list args;
+    va_start(args, pszFormat);
+    bool bPushed = pRing->Push(type, eCoplayLogLevel_Info, pszFormat, args);
+    va_end(args);
+    return bPushed;
+}
+
+static void TestLogRing()
+{
+    CCoplayLogRing ring;
+    ring.SetRateLimit(0);
+    CoplayLogRecord_t record;
+    CHECK(!ring.Pop(&record));
+
+    // fills up, then throws out the rest and says how many
+    for (int i = 0; i < COPLAY_LOG_RING_SIZE; i++)
+        CHECK(PushLog(&ring, eCoplayLog_General, "message %i", i));
+    CHECK(!PushLog(&ring, eCoplayLog_General, "one too many"));
+    CHECK(ring.TakeOverflowed() == 1);
+    CHECK(ring.TakeOverflowed() == 0);
+
+    // comes out in the order it went in
+    for (int i = 0; i < COPLAY_LOG_RING_SIZE; i++)
+    {
+        char expected[32];
+        snprintf(expected, sizeof(expected), "message %i", i);
+        CHECK(ring.Pop(&record) && !strcmp(record.text, expected));
+    }
+    CHECK(!ring.Pop(&record));
+
+    // each type's limited on its own
+    ring.SetRateLimit(3);
+    int numPushed = 0;
+    for (int i = 0; i < 10; i++)
+        numPushed += PushLog(&ring, eCoplayLog_Scream, "scream") ? 1 : 0;
+    CHECK(numPushed <= 6); // the second can roll over partway through
+    CHECK(PushLog(&ring, eCoplayLog_Handshake, "handshake"));
+    CHECK(ring.TakeSuppressed(eCoplayLog_Scream) == (uint32_t)(10 - numPushed));
+    CHECK(ring.TakeSuppressed(eCoplayLog_Handshake) == 0);
+    while (ring.Pop(&record))
+        ;
+
+    // text too long for a record is cut off, not overrun
+    ring.SetRateLimit(0);
+    std::string longText(COPLAY_LOG_MAX_TEXT * 2, 'x');
+    CHECK(PushLog(&ring, eCoplayLog_General, "%s", longText.c_str()));
+    CHECK(ring.Pop(&record) && strlen(record.text) == COPLAY_LOG_MAX_TEXT - 1);
+
+    // a few threads at once, nothing lost or doubled
+    const int numThreads = 4;
+    const int perThread  = 2000;
+    std::vector<std::thread> threads;
+    std::vector<int> seen(numThreads * perThread, 0);
+    std::atomic<int> numDone(0);
+    for (int t = 0; t < numThreads; t++)
+    {
+        threads.push_back(std::thread([&ring, &numDone, t]()
+        {
+            for (int i = 0; i < perThread; i++)
+            {
+                while (!PushLog(&ring, eCoplayLog_General, "%i", t * perThread + i))
+                    std::this_thread::yield();
+            }
+            numDone++;
+        }));
+    }
+    for (;;)
+    {
+        // one more go once they're all done, for whatever they pushed last
+        bool bDone = numDone == numThreads;
+        while (ring.Pop(&record))
+        {
+            int value = atoi(record.text);
+            if (value >= 0 && value < (int)seen.size())
+                seen[value]++;
+        }
+        if (bDone)
+            break;
+        std::this_thread::yield();
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    int numWrong = 0;
+    for (size_t i = 0; i < seen.size(); i++)
+        numWrong += seen[i] != 1 ? 1 : 0;
+    CHECK(numWrong == 0);
+}
+
+struct CoplayTest_t
+{
+    const char *pszName;
+    void (*pfnRun)();
+};
+
+static const CoplayTest_t s_tests[] =
+{
+    { "netchan",    TestNetchan },
+    { "reassembly", TestReassembly },
+    { "fec",        TestFec },
+    { "redundancy", TestRedundancy },
+    { "ticket",     TestTicket },
+    { "handshake",  TestHandshake },
+    { "ports",      TestPorts },
+    { "packetpool", TestPacketPool },
+    { "logring",    TestLogRing },
+};
+
+int main(int argc, char **argv)
+{
+    if (!CoplayToolInit())
+        return 1;
+
+    for (size_t i = 0; i < sizeof(s_tests) / sizeof(s_tests[0]); i++)
+    {
+        // just the ones named, if any are
+        bool bRun = argc < 2;
+        for (int arg = 1; arg < argc; arg++)
+            bRun |= !strcmp(argv[arg], s_tests[i].pszName);
+        if (!bRun)
+            continue;
+
+        int numFailedBefore = s_numFailed;
+        printf("%s\n", s_tests[i].pszName);
+        s_tests[i].pfnRun();
+        if (s_numFailed != numFailedBefore)
+            printf("  %i failed\n", s_numFailed - numFailedBefore);
+    }
+
+    CoplayToolShutdown();
+    printf("%i of %i checks passed\n", s_numChecks - s_numFailed, s_numChecks);
+    return s_numFailed ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+#include "coplay_toolcommon.h"
+#include "coplay_timer.h"
+#include "coplay_pacer.h"
+#include "coplay_relay.h"
+#include "SDL2/SDL.h"
+#include "SDL2/SDL_net.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool CoplayToolInit()
+{
+    if (SDL_Init(0))
+    {
+        fprintf(stderr, "SDL Failed to Initialize: \"%s\"\n", SDL_GetError());
+        return false;
+    }
+
+    if (SDLNet_Init())
+    {
+        fprintf(stderr, "SDLNet Failed to Initialize: \"%s\"\n", SDLNet_GetError());
+        SDL_Quit();
+        return false;
+    }
+    return true;
+}
+
+void CoplayToolShutdown()
+{
+    SDLNet_Quit();
+    SDL_Quit();
+}
+
+void CoplayToolWaitUntil(int64_t timeUsec)
+{
+    for (;;)
+    {
+        int64_t remaining = timeUsec - CoplayTimeUsec();
+        if (remaining <= 0)
+            return;
+
+        // SDL_Delay can oversleep by a scheduler tick, only trust it for the long waits
+        if (remaining > 2000)
+            SDL_Delay((Uint32)(remaining / 1000) - 1);
+    }
+}
+
+uint64_t CoplayToolHash(const void *pData, int len)
+{
+    // FNV-1a
+    const uint8_t *pBytes = (const uint8_t*)pData;
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < len; i++)
+    {
+        hash ^= pBytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+double CoplayToolRunRelay(CCoplayRelay *pRelay, int hz, int spinUsec, const std::atomic<bool> &stop, int64_t *pIterations)
+{
+    double  cpuStart   = CoplayThreadCPUTime();
+    int64_t iterations = 0;
+
+    // the same as CCoplayConnection::RelayLoop
+    CCoplayRelayPacer pacer;
+    pacer.Init(spinUsec);
+    while (!stop)
+    {
+        CoplayPumpResult_t result = pRelay->Pump();
+        iterations++;
+
+        int64_t now = CoplayTimeUsec();
+        pacer.OnPump(now, result.numLocalRecv > 0 || result.numPeerRecv > 0);
+        if (hz <= 0 || pacer.ShouldSpin(now))
+            CoplayCPUPause();
+        else
+            pRelay->WaitForLocal(1000 / hz);
+    }
+
+    if (pIterations)
+        *pIterations = iterations;
+    return CoplayThreadCPUTime() - cpuStart;
+}
+
+void CCoplayLatencySamples::Append(const CCoplayLatencySamples &other)
+{
+    m_samples.insert(m_samples.end(), other.m_samples.begin(), other.m_samples.end());
+    m_sorted = false;
+}
+
+int64_t CCoplayLatencySamples::Percentile(double pct)
+{
+    if (m_samples.empty())
+        return 0;
+
+    if (!m_sorted)
+    {
+        std::sort(m_samples.begin(), m_samples.end());
+        m_sorted = true;
+    }
+
+    size_t index = (size_t)(pct / 100.0 * (m_samples.size() - 1) + 0.5);
+    if (index >= m_samples.size())
+        index = m_samples.size() - 1;
+    return m_samples[index];
+}
+
+int64_t CCoplayLatencySamples::Max()
+{
+    return Percentile(100);
+}
+
+void CCoplayLatencySamples::Print(const char *pszLabel)
+{
+    printf("%-24s n %-8i p50 %6lldus  p90 %6lldus  p99 %6lldus  p99.9 %6lldus  max %6lldus\n", pszLabel, Count(),
+           (long long)Percentile(50), (long long)Percentile(90), (long long)Percentile(99),
+           (long long)Percentile(99.9), (long long)Max());
+}
+
+bool CoplayToolArgIs(int argc, char **argv, int &i, const char *pszName)
+{
+    return i < argc && !strcmp(argv[i], pszName);
+}
+
+int CoplayToolArgInt(int argc, char **argv, int &i, int fallback)
+{
+    if (i + 1 >= argc)
+        return fallback;
+    return atoi(argv[++i]);
+}
+
+double CoplayToolArgFloat(int argc, char **argv, int &i, double fallback)
+{
+    if (i + 1 >= argc)
+        return fallback;
+    return atof(argv[++i]);
+}
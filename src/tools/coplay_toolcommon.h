@@ -0,0 +1,61 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ */
+
+//================================================
+// CoaXioN Implementation of Steam P2P networking on Source SDK: "CoaXioN Coplay"
+// Author : Tholp / Jackson S
+//================================================
+
+// Bits shared by the standalone tools
+#ifndef COPLAY_TOOLCOMMON_H
+#define COPLAY_TOOLCOMMON_H
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+class CCoplayRelay;
+
+// Sets up SDL and SDL_net, prints why and returns false if it couldnt
+bool CoplayToolInit();
+void CoplayToolShutdown();
+
+// Sleep until the given CoplayTimeUsec, sleeps coarse then spins out the last bit
+void CoplayToolWaitUntil(int64_t timeUsec);
+
+uint64_t CoplayToolHash(const void *pData, int len);
+
+// Runs a relay like CCoplayConnection::Run does until stop is set.
+// Returns the CPU time the calling thread spent, pIterations gets the number of loops.
+double CoplayToolRunRelay(CCoplayRelay *pRelay, int hz, int spinUsec, const std::atomic<bool> &stop, int64_t *pIterations);
+
+// Collected latencies in microseconds
+class CCoplayLatencySamples
+{
+public:
+    void  Add(int64_t usec) { m_samples.push_back(usec); m_sorted = false; }
+    void  Append(const CCoplayLatencySamples &other);
+    int   Count() const { return (int)m_samples.size(); }
+
+    // sorts on first call after adding
+    int64_t Percentile(double pct);
+    int64_t Max();
+
+    // "p50 12us p90 .." on one line
+    void Print(const char *pszLabel);
+
+private:
+    std::vector<int64_t> m_samples;
+    bool                 m_sorted = false;
+};
+
+// Argument helpers, index is advanced past any value that was used
+bool   CoplayToolArgIs(int argc, char **argv, int &i, const char *pszName);
+int    CoplayToolArgInt(int argc, char **argv, int &i, int fallback);
+double CoplayToolArgFloat(int argc, char **argv, int &i, double fallback);
+
+#endif